@@ -0,0 +1,220 @@
+// Replays a frame captured with Babylon::CommandCapture through the command handlers of NativeEngine, without the
+// JavaScript that produced it, to measure the CPU cost of the native side of the frame in isolation. By default bgfx
+// runs with the Noop renderer, so that replays also run on machines without a GPU.
+//
+// NativeEngine is a JavaScript object, so a JavaScript runtime is created to host the engine. No script runs in it:
+// the commands are submitted straight to the engine's handlers.
+
+#include <Babylon/AppRuntime.h>
+#include <Babylon/CommandReplay.h>
+#include <Babylon/Graphics/Device.h>
+#include <Babylon/JsRuntime.h>
+#include <Babylon/Plugins/NativeEngine.h>
+#include <Babylon/Plugins/NativeEngine/CommandCaptureFormat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::vector<uint32_t> ReadCapture(const std::string& filePath)
+    {
+        std::ifstream file{filePath, std::ios::binary | std::ios::ate};
+        if (!file)
+        {
+            throw std::runtime_error{"Failed to open " + filePath + "."};
+        }
+
+        const auto size{static_cast<size_t>(file.tellg())};
+        std::vector<uint32_t> words(size / sizeof(uint32_t));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(uint32_t));
+        return words;
+    }
+
+    // The back buffer size recorded in the capture, which is the first record when there is one.
+    std::pair<uint32_t, uint32_t> GetFrameSize(const std::vector<uint32_t>& capture)
+    {
+        if (capture.size() >= 6 && capture[2] == static_cast<uint32_t>(Babylon::CaptureRecordType::FrameInfo))
+        {
+            return {capture[4], capture[5]};
+        }
+
+        return {1, 1};
+    }
+
+    void PrintUsage()
+    {
+        std::cout << "Usage: CommandReplay <capture file> [--iterations <count>] [--renderer noop|default]" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string filePath{};
+    uint32_t iterations{100};
+    bool noopRenderer{true};
+
+    for (int index = 1; index < argc; ++index)
+    {
+        const std::string argument{argv[index]};
+        if (argument == "--iterations" && index + 1 < argc)
+        {
+            iterations = static_cast<uint32_t>(std::stoul(argv[++index]));
+        }
+        else if (argument == "--renderer" && index + 1 < argc)
+        {
+            const std::string renderer{argv[++index]};
+            if (renderer != "noop" && renderer != "default")
+            {
+                PrintUsage();
+                return 1;
+            }
+
+            noopRenderer = renderer == "noop";
+        }
+        else if (filePath.empty())
+        {
+            filePath = argument;
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (filePath.empty() || iterations == 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<uint32_t> capture{};
+    try
+    {
+        capture = ReadCapture(filePath);
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << exception.what() << std::endl;
+        return 1;
+    }
+
+    // The device has no window, so the frame is rendered off screen, by the renderer of the build unless Noop.
+    const auto [width, height]{GetFrameSize(capture)};
+    Babylon::Graphics::Configuration config{};
+    config.Width = width;
+    config.Height = height;
+    config.NoopRenderer = noopRenderer;
+
+    Babylon::Graphics::Device device{config};
+    std::optional<Babylon::Graphics::DeviceUpdate> update{device.GetUpdate("update")};
+    std::optional<Babylon::CommandReplay> replay{};
+
+    Babylon::AppRuntime runtime{};
+
+    // Calls the given function on the JavaScript thread and waits for it, reporting its exceptions to this thread.
+    const auto dispatch{[&runtime](std::function<void(Napi::Env)> function) {
+        std::promise<void> done{};
+        runtime.Dispatch([&done, &function](Napi::Env env) {
+            try
+            {
+                function(env);
+                done.set_value();
+            }
+            catch (...)
+            {
+                done.set_exception(std::current_exception());
+            }
+        });
+        done.get_future().get();
+    }};
+
+    int exitCode{0};
+    device.StartRenderingCurrentFrame();
+    update->Start();
+    try
+    {
+        dispatch([&device, &replay, &capture](Napi::Env env) {
+            device.AddToJavaScript(env);
+            Babylon::Plugins::NativeEngine::Initialize(env);
+
+            auto engine{Babylon::JsRuntime::NativeObject::GetFromJavaScript(env).Get("Engine").As<Napi::Function>().New({})};
+            replay.emplace(engine, std::move(capture));
+        });
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << exception.what() << std::endl;
+        exitCode = 1;
+    }
+    update->Finish();
+    device.FinishRenderingCurrentFrame();
+
+    if (exitCode != 0)
+    {
+        return exitCode;
+    }
+
+    try
+    {
+        using clock = std::chrono::high_resolution_clock;
+        std::chrono::duration<double, std::milli> replayTotal{};
+        std::chrono::duration<double, std::milli> replayMin{std::numeric_limits<double>::max()};
+        std::chrono::duration<double, std::milli> replayMax{};
+        std::chrono::duration<double, std::milli> frameTotal{};
+        size_t commands{};
+
+        for (uint32_t iteration = 0; iteration < iterations; ++iteration)
+        {
+            device.StartRenderingCurrentFrame();
+            update->Start();
+
+            std::chrono::duration<double, std::milli> replayTime{};
+            dispatch([&replay, &commands, &replayTime](Napi::Env) {
+                const auto start{clock::now()};
+                commands = replay->Run();
+                replayTime = clock::now() - start;
+            });
+
+            const auto replayed{clock::now()};
+            update->Finish();
+            device.FinishRenderingCurrentFrame();
+            const auto rendered{clock::now()};
+
+            replayTotal += replayTime;
+            replayMin = std::min(replayMin, replayTime);
+            replayMax = std::max(replayMax, replayTime);
+            frameTotal += rendered - replayed;
+        }
+
+        std::cout << "Renderer: " << (noopRenderer ? "noop" : "default") << std::endl;
+        std::cout << "Frame: " << replay->Width() << "x" << replay->Height() << ", " << commands << " commands" << std::endl;
+        std::cout << "Iterations: " << iterations << std::endl;
+        std::cout << "Replay (ms): avg " << replayTotal.count() / iterations << ", min " << replayMin.count() << ", max " << replayMax.count() << std::endl;
+        std::cout << "Frame end (ms): avg " << frameTotal.count() / iterations << std::endl;
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << exception.what() << std::endl;
+        exitCode = 1;
+    }
+
+    // Resources of the replay are destroyed on the JavaScript thread, before the device.
+    dispatch([&replay](Napi::Env) {
+        replay.reset();
+    });
+
+    return exitCode;
+}
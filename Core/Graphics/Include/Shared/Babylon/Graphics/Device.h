@@ -28,6 +28,10 @@ namespace Babylon::Graphics
 
         // When enabled, back buffer will be premultiplied with alpha value.
         bool AlphaPremultiplied{};
+
+        // When enabled, bgfx runs with its Noop renderer, which submits nothing to a GPU. This lets the CPU side of
+        // frames run on machines without a GPU, such as build machines.
+        bool NoopRenderer{};
     };
 
     class Device;
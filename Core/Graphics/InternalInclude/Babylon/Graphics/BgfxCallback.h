@@ -1,10 +1,15 @@
 #pragma once
 
+#include <arcana/threading/task.h>
+
+#include <exception>
 #include <queue>
 #include <functional>
+#include <vector>
 
 #include <bgfx/bgfx.h>
 #include <bgfx/platform.h>
+#include <bimg/bimg.h>
 
 namespace Babylon::Graphics
 {
@@ -22,10 +27,24 @@ namespace Babylon::Graphics
             uint32_t DataSize{};
         };
 
+        enum class ScreenShotFormat
+        {
+            // Top down RGBA8 pixels.
+            RGBA8,
+            // A PNG file of the RGBA8 pixels.
+            PNG,
+        };
+
+        // Called on a worker thread with the data of a screenshot, or with the error that prevented producing it.
+        using ScreenShotCallback = std::function<void(std::vector<uint8_t> data, std::exception_ptr error)>;
+
         BgfxCallback(std::function<void(const CaptureData&)>);
         virtual ~BgfxCallback() = default;
 
-        void AddScreenShotCallback(std::function<void(std::vector<uint8_t>)> callback);
+        void AddScreenShotCallback(ScreenShotCallback callback, ScreenShotFormat format);
+
+        // Encodes pixels to a PNG file. Throws if bimg cannot encode them, such as pixels of a format it cannot write.
+        static std::vector<uint8_t> EncodePng(const void* pixels, uint32_t width, uint32_t height, uint32_t pitch, bimg::TextureFormat::Enum format);
         void SetDiagnosticOutput(std::function<void(const char* output)> outputFunction);
         void trace(const char* _filePath, uint16_t _line, const char* _format, ...);
 
@@ -46,7 +65,16 @@ namespace Babylon::Graphics
     private:
         std::function<void(const char* output)> m_outputFunction;
 
-        std::queue<std::function<void(std::vector<uint8_t>)>> m_screenShotCallbacks;
+        struct ScreenShotRequest
+        {
+            ScreenShotCallback Callback{};
+            ScreenShotFormat Format{};
+        };
+
+        std::queue<ScreenShotRequest> m_screenShotRequests;
+
+        // The conversion of the last screenshot, which the next one follows.
+        arcana::task<void, std::exception_ptr> m_screenShotTask{arcana::task_from_result<std::exception_ptr>()};
 
         CaptureData m_captureData{};
         const std::function<void(const CaptureData&)> m_captureCallback{};
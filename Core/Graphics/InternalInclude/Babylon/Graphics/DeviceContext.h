@@ -95,7 +95,8 @@ namespace Babylon::Graphics
 
         Update GetUpdate(const char* updateName);
 
-        void RequestScreenShot(std::function<void(std::vector<uint8_t>)> callback);
+        // Calls the callback with the next frame of the default frame buffer, on a worker thread.
+        void RequestScreenShot(BgfxCallback::ScreenShotCallback callback, BgfxCallback::ScreenShotFormat format = BgfxCallback::ScreenShotFormat::RGBA8);
         void SetRenderResetCallback(std::function<void()> callback);
 
         arcana::task<void, std::exception_ptr> ReadTextureAsync(bgfx::TextureHandle handle, gsl::span<uint8_t> data, uint8_t mipLevel = 0);
@@ -113,8 +114,27 @@ namespace Babylon::Graphics
         using CaptureCallbackTicketT = arcana::ticketed_collection<std::function<void(const BgfxCallback::CaptureData&)>>::ticket;
         CaptureCallbackTicketT AddCaptureCallback(std::function<void(const BgfxCallback::CaptureData&)> callback);
 
+        // The last views of a frame are never acquired, so that work that must follow all the other views of the
+        // frame, such as the blits of read backs, has views of its own.
+        enum class ReservedView : bgfx::ViewId
+        {
+            // Blits to textures that are read back. This is the last view.
+            ReadBack,
+            // Renders to textures whose mips bgfx generates when the view ends, right before the read back view.
+            MipGeneration,
+            Count,
+        };
+
+        static bgfx::ViewId GetReservedViewId(ReservedView view);
+
         bgfx::ViewId AcquireNewViewId(bgfx::Encoder&);
 
+        // Returns true if the given view is the last one acquired during the current frame.
+        bool IsLastViewId(bgfx::ViewId viewId) const;
+
+        // Returns a number that identifies the frame being recorded, which changes every time a frame is rendered.
+        uint32_t GetFrameNumber() const;
+
         // TODO: find a different way to get the texture info for frame capture
         void AddTexture(bgfx::TextureHandle handle, uint16_t width, uint16_t height, bool hasMips, uint16_t numLayers, bgfx::TextureFormat::Enum format);
         void RemoveTexture(bgfx::TextureHandle handle);
@@ -36,10 +36,18 @@ namespace Babylon::Graphics
         void Bind(bgfx::Encoder& encoder);
         void Unbind(bgfx::Encoder& encoder);
 
+        // Returns true if binding this frame buffer again would not change the order of the draws submitted to it,
+        // which is the case when it has no view yet or when no other view was acquired since its own.
+        bool HasLastView() const;
+
         void Clear(bgfx::Encoder& encoder, uint16_t flags, uint32_t rgba, float depth, uint8_t stencil);
         void SetViewPort(bgfx::Encoder& encoder, float x, float y, float width, float height);
         void SetScissor(bgfx::Encoder& encoder, float x, float y, float width, float height);
         void Submit(bgfx::Encoder& encoder, bgfx::ProgramHandle programHandle, uint8_t flags);
+
+        // Returns the view that draws to this frame buffer are submitted to, acquiring a new view if the viewport or
+        // scissor changed. Draws can be submitted to the returned view from any encoder.
+        bgfx::ViewId PrepareView(bgfx::Encoder& encoder);
         void SetStencil(bgfx::Encoder& encoder, uint32_t stencilState);
         void Blit(bgfx::Encoder& encoder, bgfx::TextureHandle dst, uint16_t dstX, uint16_t dstY, bgfx::TextureHandle src, uint16_t srcX = 0, uint16_t srcY = 0, uint16_t width = UINT16_MAX, uint16_t height = UINT16_MAX);
 
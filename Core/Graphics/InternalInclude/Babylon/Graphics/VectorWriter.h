@@ -0,0 +1,29 @@
+#pragma once
+
+#include <bx/readerwriter.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Babylon::Graphics
+{
+    // Appends what bimg encodes to a vector, which the caller may clear and reuse from image to image.
+    class VectorWriter final : public bx::WriterI
+    {
+    public:
+        explicit VectorWriter(std::vector<uint8_t>& data)
+            : m_data{data}
+        {
+        }
+
+        int32_t write(const void* data, int32_t size, bx::Error*) override
+        {
+            const auto bytes{static_cast<const uint8_t*>(data)};
+            m_data.insert(m_data.end(), bytes, bytes + size);
+            return size;
+        }
+
+    private:
+        std::vector<uint8_t>& m_data;
+    };
+}
@@ -1,11 +1,62 @@
 #include "BgfxCallback.h"
+#include "VectorWriter.h"
 #include <bx/bx.h>
 #include <bx/string.h>
 #include <bx/platform.h>
 #include <bx/debug.h>
 #include <stdarg.h>
 #include <bgfx/bgfx.h>
+#include <bimg/bimg.h>
+#include <bx/error.h>
+#include <arcana/threading/task.h>
+#include <arcana/threading/task_schedulers.h>
 #include <cassert>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BGFX_CALLBACK_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define BGFX_CALLBACK_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // Converts a row of BGRA8 pixels to RGBA8.
+    void SwizzleRow(const uint8_t* source, uint8_t* destination, uint32_t width)
+    {
+        uint32_t x{0};
+#if defined(BGFX_CALLBACK_SSE2)
+        // Red and blue swap places within each 32 bit pixel, while green and alpha stay.
+        const __m128i greenAlphaMask{_mm_set1_epi32(static_cast<int>(0xFF00FF00))};
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i pixels{_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * 4))};
+            const __m128i redBlue{_mm_andnot_si128(greenAlphaMask, pixels)};
+            const __m128i swapped{_mm_or_si128(_mm_slli_epi32(redBlue, 16), _mm_srli_epi32(redBlue, 16))};
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x * 4), _mm_or_si128(_mm_and_si128(pixels, greenAlphaMask), swapped));
+        }
+#elif defined(BGFX_CALLBACK_NEON)
+        for (; x + 16 <= width; x += 16)
+        {
+            uint8x16x4_t pixels{vld4q_u8(source + x * 4)};
+            const uint8x16_t blue{pixels.val[0]};
+            pixels.val[0] = pixels.val[2];
+            pixels.val[2] = blue;
+            vst4q_u8(destination + x * 4, pixels);
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            destination[x * 4 + 0] = source[x * 4 + 2];
+            destination[x * 4 + 1] = source[x * 4 + 1];
+            destination[x * 4 + 2] = source[x * 4 + 0];
+            destination[x * 4 + 3] = source[x * 4 + 3];
+        }
+    }
+}
 
 namespace Babylon::Graphics
 {
@@ -14,9 +65,24 @@ namespace Babylon::Graphics
     {
     }
 
-    void BgfxCallback::AddScreenShotCallback(std::function<void(std::vector<uint8_t>)> callback)
+    void BgfxCallback::AddScreenShotCallback(ScreenShotCallback callback, ScreenShotFormat format)
+    {
+        m_screenShotRequests.push({std::move(callback), format});
+    }
+
+    std::vector<uint8_t> BgfxCallback::EncodePng(const void* pixels, uint32_t width, uint32_t height, uint32_t pitch, bimg::TextureFormat::Enum format)
     {
-        m_screenShotCallbacks.emplace(std::move(callback));
+        std::vector<uint8_t> encoded{};
+        VectorWriter writer{encoded};
+        bx::Error error{};
+        bimg::imageWritePng(&writer, width, height, pitch, pixels, format, false, &error);
+        if (!error.isOk())
+        {
+            const bx::StringView message{error.getMessage()};
+            throw std::runtime_error{"Failed to encode the screenshot to PNG: " + std::string{message.getPtr(), static_cast<size_t>(message.getLength())}};
+        }
+
+        return encoded;
     }
 
     void BgfxCallback::SetDiagnosticOutput(std::function<void(const char* output)> outputFunction)
@@ -87,28 +153,47 @@ namespace Babylon::Graphics
     {
     }
 
-    void BgfxCallback::screenShot(const char* /*filePath*/, uint32_t width, uint32_t height, uint32_t pitch, const void* data, uint32_t /*size*/, bool yflip)
+    void BgfxCallback::screenShot(const char* /*filePath*/, uint32_t width, uint32_t height, uint32_t pitch, const void* data, uint32_t size, bool yflip)
     {
-        assert(!m_screenShotCallbacks.empty()); // addScreenShotCallback not called before doing the screenshot call on bgfx
+        assert(!m_screenShotRequests.empty()); // addScreenShotCallback not called before doing the screenshot call on bgfx
 
-        std::vector<uint8_t> array(width * height * 4); // do not use pitch to define output size because it's padded
-        uint8_t* bitmap{array.data()};
+        // bgfx frees the data when this returns, within bgfx::frame on the render thread, so it is only copied here.
+        // The conversion to RGBA, and the encoding, are done on a worker thread. Each screenshot continues the previous
+        // one, whatever its outcome, so that the callbacks are called in the order of the requests.
+        const auto bytes{static_cast<const uint8_t*>(data)};
+        std::vector<uint8_t> pixels(bytes, bytes + size);
 
-        for (uint32_t py = 0; py < height; py++)
-        {
-            const uint8_t* ptr = static_cast<const uint8_t*>(data) + (yflip ? (height - py - 1) : py) * pitch;
-            for (uint32_t px = 0; px < width; px++)
+        m_screenShotTask = m_screenShotTask.then(arcana::threadpool_scheduler, arcana::cancellation::none(), [width, height, pitch, yflip, pixels{std::move(pixels)}, request{std::move(m_screenShotRequests.front())}](const arcana::expected<void, std::exception_ptr>&) {
+            std::vector<uint8_t> array{};
+            try
             {
-                // bgfx screenshot is BGRA
-                *bitmap++ = ptr[px * 4 + 2];
-                *bitmap++ = ptr[px * 4 + 1];
-                *bitmap++ = ptr[px * 4 + 0];
-                *bitmap++ = ptr[px * 4 + 3];
+                if (pitch < static_cast<uint64_t>(width) * 4 || pixels.size() < static_cast<uint64_t>(pitch) * height)
+                {
+                    throw std::runtime_error{"The screenshot data is smaller than its size."};
+                }
+
+                array.resize(static_cast<size_t>(width) * height * 4); // do not use pitch to define output size because it's padded
+                for (uint32_t y = 0; y < height; ++y)
+                {
+                    // bgfx screenshot is BGRA
+                    SwizzleRow(pixels.data() + static_cast<size_t>(yflip ? height - y - 1 : y) * pitch, array.data() + static_cast<size_t>(y) * width * 4, width);
+                }
+
+                if (request.Format == ScreenShotFormat::PNG)
+                {
+                    array = EncodePng(array.data(), width, height, width * 4, bimg::TextureFormat::RGBA8);
+                }
             }
-        }
+            catch (...)
+            {
+                request.Callback({}, std::current_exception());
+                return;
+            }
+
+            request.Callback(std::move(array), {});
+        });
 
-        m_screenShotCallbacks.front()(std::move(array));
-        m_screenShotCallbacks.pop();
+        m_screenShotRequests.pop();
     }
 
     void BgfxCallback::captureBegin(uint32_t width, uint32_t height, uint32_t pitch, bgfx::TextureFormat::Enum format, bool yflip)
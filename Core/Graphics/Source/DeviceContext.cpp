@@ -56,9 +56,9 @@ namespace Babylon::Graphics
         return {m_graphicsImpl.GetSafeTimespanGuarantor(updateName), *this};
     }
 
-    void DeviceContext::RequestScreenShot(std::function<void(std::vector<uint8_t>)> callback)
+    void DeviceContext::RequestScreenShot(BgfxCallback::ScreenShotCallback callback, BgfxCallback::ScreenShotFormat format)
     {
-        return m_graphicsImpl.RequestScreenShot(std::move(callback));
+        return m_graphicsImpl.RequestScreenShot(std::move(callback), format);
     }
 
     void DeviceContext::SetRenderResetCallback(std::function<void()> callback)
@@ -101,11 +101,26 @@ namespace Babylon::Graphics
         return m_graphicsImpl.AddCaptureCallback(std::move(callback));
     }
 
+    bgfx::ViewId DeviceContext::GetReservedViewId(ReservedView view)
+    {
+        return static_cast<bgfx::ViewId>(bgfx::getCaps()->limits.maxViews - 1 - static_cast<bgfx::ViewId>(view));
+    }
+
     bgfx::ViewId DeviceContext::AcquireNewViewId(bgfx::Encoder& encoder)
     {
         return m_graphicsImpl.AcquireNewViewId(encoder);
     }
 
+    bool DeviceContext::IsLastViewId(bgfx::ViewId viewId) const
+    {
+        return m_graphicsImpl.IsLastViewId(viewId);
+    }
+
+    uint32_t DeviceContext::GetFrameNumber() const
+    {
+        return m_graphicsImpl.GetFrameNumber();
+    }
+
     void DeviceContext::AddTexture(bgfx::TextureHandle handle, uint16_t width, uint16_t height, bool hasMips, uint16_t numLayers, bgfx::TextureFormat::Enum format)
     {
         std::scoped_lock lock{m_textureHandleToInfoMutex};
@@ -37,7 +37,7 @@ namespace Babylon::Graphics
         m_state.Bgfx.Initialized = false;
 
         auto& init = m_state.Bgfx.InitState;
-        init.type = s_bgfxRenderType;
+        init.type = config.NoopRenderer ? bgfx::RendererType::Noop : s_bgfxRenderType;
         init.resolution.reset = BGFX_RESET_VSYNC | BGFX_RESET_MAXANISOTROPY | BGFX_RESET_FLIP_AFTER_RENDER;
         init.resolution.maxFrameLatency = 1;
 
@@ -327,9 +327,9 @@ namespace Babylon::Graphics
         return m_afterRenderDispatcher.scheduler();
     }
 
-    void DeviceImpl::RequestScreenShot(std::function<void(std::vector<uint8_t>)> callback)
+    void DeviceImpl::RequestScreenShot(BgfxCallback::ScreenShotCallback callback, BgfxCallback::ScreenShotFormat format)
     {
-        m_screenShotCallbacks.push(std::move(callback));
+        m_screenShotRequests.push({std::move(callback), format});
     }
 
     arcana::task<void, std::exception_ptr> DeviceImpl::ReadTextureAsync(bgfx::TextureHandle handle, gsl::span<uint8_t> data, uint8_t mipLevel)
@@ -357,13 +357,23 @@ namespace Babylon::Graphics
     bgfx::ViewId DeviceImpl::AcquireNewViewId(bgfx::Encoder&)
     {
         bgfx::ViewId viewId = m_nextViewId.fetch_add(1);
-        if (viewId >= bgfx::getCaps()->limits.maxViews)
+        if (viewId >= bgfx::getCaps()->limits.maxViews - static_cast<bgfx::ViewId>(DeviceContext::ReservedView::Count))
         {
             throw std::runtime_error{"Too many views"};
         }
         return viewId;
     }
 
+    bool DeviceImpl::IsLastViewId(bgfx::ViewId viewId) const
+    {
+        return viewId + 1 == m_nextViewId.load();
+    }
+
+    uint32_t DeviceImpl::GetFrameNumber() const
+    {
+        return m_frameNumber.load();
+    }
+
     void DeviceImpl::UpdateBgfxState()
     {
         std::scoped_lock lock{m_state.Mutex};
@@ -394,10 +404,10 @@ namespace Babylon::Graphics
 
     void DeviceImpl::RequestScreenShots()
     {
-        std::function<void(std::vector<uint8_t>)> callback;
-        while (m_screenShotCallbacks.try_pop(callback, *m_cancellationSource))
+        std::pair<BgfxCallback::ScreenShotCallback, BgfxCallback::ScreenShotFormat> request;
+        while (m_screenShotRequests.try_pop(request, *m_cancellationSource))
         {
-            m_bgfxCallback.AddScreenShotCallback(std::move(callback));
+            m_bgfxCallback.AddScreenShotCallback(std::move(request.first), request.second);
 #if D3D12
             // D3D12 capture is immediate but needs an extra frame swap because back buffer is captured.
             // Because of previous swapchain flip, back buffer is not what's just been rendered.
@@ -431,11 +441,28 @@ namespace Babylon::Graphics
         }
 
         m_nextViewId.store(0);
+        m_frameNumber.store(frameNumber);
     }
 
     bgfx::Encoder* DeviceImpl::GetEncoderForThread()
     {
         assert(!m_renderThreadAffinity.check());
+
+        // Encoders are only ended by EndEncoders while no update token is held, so the cached encoder remains valid
+        // for as long as the generation it was cached with is current.
+        thread_local struct
+        {
+            const DeviceImpl* Device{};
+            uint64_t Generation{};
+            bgfx::Encoder* Encoder{};
+        } cache{};
+
+        const auto generation{m_encoderGeneration.load(std::memory_order_acquire)};
+        if (cache.Device == this && cache.Generation == generation)
+        {
+            return cache.Encoder;
+        }
+
         std::scoped_lock lock{m_threadIdToEncoderMutex};
 
         const auto threadId{std::this_thread::get_id()};
@@ -446,6 +473,7 @@ namespace Babylon::Graphics
             it = m_threadIdToEncoder.emplace(threadId, encoder).first;
         }
 
+        cache = {this, generation, it->second};
         return it->second;
     }
 
@@ -459,6 +487,7 @@ namespace Babylon::Graphics
         }
 
         m_threadIdToEncoder.clear();
+        m_encoderGeneration.store(s_nextEncoderGeneration.fetch_add(1), std::memory_order_release);
     }
 
     void DeviceImpl::CaptureCallback(const BgfxCallback::CaptureData& data)
@@ -17,6 +17,7 @@
 #include <bgfx/bgfx.h>
 #include <bgfx/platform.h>
 
+#include <atomic>
 #include <memory>
 #include <map>
 #include <optional>
@@ -82,7 +83,7 @@ namespace Babylon::Graphics
         continuation_scheduler<>& BeforeRenderScheduler();
         continuation_scheduler<>& AfterRenderScheduler();
 
-        void RequestScreenShot(std::function<void(std::vector<uint8_t>)> callback);
+        void RequestScreenShot(BgfxCallback::ScreenShotCallback callback, BgfxCallback::ScreenShotFormat format);
 
         arcana::task<void, std::exception_ptr> ReadTextureAsync(bgfx::TextureHandle handle, gsl::span<uint8_t> data, uint8_t mipLevel);
 
@@ -90,6 +91,8 @@ namespace Babylon::Graphics
         CaptureCallbackTicketT AddCaptureCallback(std::function<void(const BgfxCallback::CaptureData&)> callback);
 
         bgfx::ViewId AcquireNewViewId(bgfx::Encoder&);
+        bool IsLastViewId(bgfx::ViewId viewId) const;
+        uint32_t GetFrameNumber() const;
 
         /* ********** END DEVICE CONTEXT CONTRACT ********** */
 
@@ -120,6 +123,7 @@ namespace Babylon::Graphics
         bool m_rendering{};
 
         std::atomic<bgfx::ViewId> m_nextViewId{0};
+        std::atomic<uint32_t> m_frameNumber{0};
 
         std::optional<arcana::cancellation_source> m_cancellationSource{};
 
@@ -152,11 +156,17 @@ namespace Babylon::Graphics
         std::mutex m_captureCallbacksMutex{};
         arcana::ticketed_collection<std::function<void(const BgfxCallback::CaptureData&)>> m_captureCallbacks{};
 
-        arcana::blocking_concurrent_queue<std::function<void(std::vector<uint8_t>)>> m_screenShotCallbacks{};
+        arcana::blocking_concurrent_queue<std::pair<BgfxCallback::ScreenShotCallback, BgfxCallback::ScreenShotFormat>> m_screenShotRequests{};
 
         std::map<std::thread::id, bgfx::Encoder*> m_threadIdToEncoder{};
         std::mutex m_threadIdToEncoderMutex{};
 
+        // Encoders are cached per thread until the generation changes, which happens whenever EndEncoders is called.
+        // Generations are unique across devices so that a device allocated at the address of a destroyed one does not
+        // match stale cache entries.
+        static inline std::atomic<uint64_t> s_nextEncoderGeneration{1};
+        std::atomic<uint64_t> m_encoderGeneration{s_nextEncoderGeneration.fetch_add(1)};
+
         std::queue<std::pair<uint32_t, arcana::task_completion_source<void, std::exception_ptr>>> m_readTextureRequests{};
 
         std::map<std::string, SafeTimespanGuarantor> m_updateSafeTimespans{};
@@ -68,6 +68,11 @@ namespace Babylon::Graphics
     {
     }
 
+    bool FrameBuffer::HasLastView() const
+    {
+        return !m_viewId.has_value() || m_deviceContext.IsLastViewId(m_viewId.value());
+    }
+
     void FrameBuffer::Clear(bgfx::Encoder& encoder, uint16_t flags, uint32_t rgba, float depth, uint8_t stencil)
     {
         // BGFX requires us to create a new viewID, this will ensure that the view gets cleared.
@@ -127,9 +132,14 @@ namespace Babylon::Graphics
     }
 
     void FrameBuffer::Submit(bgfx::Encoder& encoder, bgfx::ProgramHandle programHandle, uint8_t flags)
+    {
+        encoder.submit(PrepareView(encoder), programHandle, 0, flags);
+    }
+
+    bgfx::ViewId FrameBuffer::PrepareView(bgfx::Encoder& encoder)
     {
         SetBgfxViewPortAndScissor(encoder, m_desiredViewPort, m_desiredScissor);
-        encoder.submit(m_viewId.value(), programHandle, 0, flags);
+        return m_viewId.value();
     }
 
     void FrameBuffer::Blit(bgfx::Encoder& encoder, bgfx::TextureHandle dst, uint16_t dstX, uint16_t dstY, bgfx::TextureHandle src, uint16_t srcX, uint16_t srcY, uint16_t width, uint16_t height)
@@ -135,7 +135,7 @@ if(TARGET NativeCapture)
 endif()
 
 if(TARGET NativeEngine)
-    install_targets(NativeEngine)
+    install_targets(NativeEngine NativeEngineImageKernels)
     install_include_for_targets(NativeEngine)
 endif()
 
@@ -0,0 +1,123 @@
+#include "CaptureRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Babylon::Plugins
+{
+    CaptureRing::CaptureRing(size_t size, DropPolicy dropPolicy)
+        : m_dropPolicy{dropPolicy}
+        , m_buffers(size)
+    {
+        if (size == 0)
+        {
+            throw std::invalid_argument{"A capture ring needs at least one buffer."};
+        }
+    }
+
+    bool CaptureRing::Write(uint32_t width, uint32_t height, FrameFormat format, bool yFlip, size_t size, const std::function<void(gsl::span<uint8_t>)>& writer)
+    {
+        const auto time{std::chrono::steady_clock::now()};
+
+        std::unique_lock lock{m_mutex};
+
+        const uint64_t number{m_capturedFrames++};
+
+        auto it{std::find_if(m_buffers.begin(), m_buffers.end(), [](const Buffer& buffer) { return buffer.Status == State::Free; })};
+        if (it == m_buffers.end())
+        {
+            ++m_droppedFrames;
+
+            // Buffers taken by JavaScript are never written to, so when all of them are taken the new frame is dropped
+            // whatever the policy.
+            if (m_dropPolicy == DropPolicy::DropNewest || m_pending.empty())
+            {
+                return false;
+            }
+
+            it = m_buffers.begin() + m_pending.front();
+            m_pending.pop_front();
+        }
+
+        Buffer& buffer{*it};
+        buffer.Status = State::Writing;
+
+        // The frame is written outside of the lock so that JavaScript can take and release other frames meanwhile.
+        lock.unlock();
+
+        Frame& frame{buffer.Contents};
+        frame.Width = width;
+        frame.Height = height;
+        frame.Format = format;
+        frame.YFlip = yFlip;
+        frame.Number = number;
+        frame.Time = time;
+
+        // The previous data may still be referenced by an ArrayBuffer, so it is replaced rather than resized.
+        if (!frame.Data || frame.Data->size() != size)
+        {
+            frame.Data = std::make_shared<std::vector<uint8_t>>(size);
+        }
+
+        writer(*frame.Data);
+
+        lock.lock();
+        buffer.Status = State::Pending;
+        m_pending.push_back(static_cast<size_t>(it - m_buffers.begin()));
+        return true;
+    }
+
+    bool CaptureRing::Write(uint32_t width, uint32_t height, FrameFormat format, bool yFlip, gsl::span<const uint8_t> data)
+    {
+        return Write(width, height, format, yFlip, static_cast<size_t>(data.size()), [data](gsl::span<uint8_t> destination) {
+            std::memcpy(destination.data(), data.data(), static_cast<size_t>(data.size()));
+        });
+    }
+
+    std::optional<size_t> CaptureRing::Take()
+    {
+        std::scoped_lock lock{m_mutex};
+
+        if (m_pending.empty())
+        {
+            return {};
+        }
+
+        const size_t index{m_pending.front()};
+        m_pending.pop_front();
+        m_buffers[index].Status = State::Taken;
+        return index;
+    }
+
+    const CaptureRing::Frame& CaptureRing::Get(size_t index) const
+    {
+        return m_buffers[index].Contents;
+    }
+
+    bool CaptureRing::Release(size_t index, uint64_t number)
+    {
+        std::scoped_lock lock{m_mutex};
+
+        Buffer& buffer{m_buffers[index]};
+        if (buffer.Status != State::Taken || buffer.Contents.Number != number)
+        {
+            return false;
+        }
+
+        buffer.Status = State::Free;
+        return true;
+    }
+
+    uint64_t CaptureRing::CapturedFrames() const
+    {
+        std::scoped_lock lock{m_mutex};
+        return m_capturedFrames;
+    }
+
+    uint64_t CaptureRing::DroppedFrames() const
+    {
+        std::scoped_lock lock{m_mutex};
+        return m_droppedFrames;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "FrameConverter.h"
+
+#include <gsl/gsl>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace Babylon::Plugins
+{
+    // A fixed number of reusable buffers that captured frames are copied to on the render thread and handed to
+    // JavaScript from, so that a consumer that falls behind makes frames drop instead of queue without bound.
+    class CaptureRing final
+    {
+    public:
+        enum class DropPolicy
+        {
+            // A new frame replaces the oldest frame that is not handed to JavaScript yet.
+            DropOldest,
+            // A new frame is dropped while no buffer is free.
+            DropNewest,
+        };
+
+        struct Frame
+        {
+            uint32_t Width{};
+            uint32_t Height{};
+            FrameFormat Format{FrameFormat::Unknown};
+            bool YFlip{};
+            uint64_t Number{};
+
+            // When the frame was captured, before it was written.
+            std::chrono::steady_clock::time_point Time{};
+
+            // Shared with the external ArrayBuffers that expose it, so that it outlives them even if it is replaced
+            // by a buffer of another size.
+            std::shared_ptr<std::vector<uint8_t>> Data{};
+        };
+
+        CaptureRing(size_t size, DropPolicy dropPolicy);
+
+        // Writes a frame of the given size to a free buffer, or to the buffer of the oldest pending frame under
+        // DropOldest, with a writer that fills the buffer. Returns false if the frame was dropped. Called from the
+        // thread that produces the frames.
+        bool Write(uint32_t width, uint32_t height, FrameFormat format, bool yFlip, size_t size, const std::function<void(gsl::span<uint8_t>)>& writer);
+
+        // Copies a frame to a buffer.
+        bool Write(uint32_t width, uint32_t height, FrameFormat format, bool yFlip, gsl::span<const uint8_t> data);
+
+        // Takes the oldest pending frame, which is not written to until it is released. Returns its buffer index.
+        std::optional<size_t> Take();
+
+        // The frame of a buffer that was taken and not released yet.
+        const Frame& Get(size_t index) const;
+
+        // Releases a taken frame. Returns false if the frame was already released.
+        bool Release(size_t index, uint64_t number);
+
+        size_t Size() const
+        {
+            return m_buffers.size();
+        }
+
+        uint64_t CapturedFrames() const;
+        uint64_t DroppedFrames() const;
+
+    private:
+        enum class State
+        {
+            Free,
+            Writing,
+            Pending,
+            Taken,
+        };
+
+        struct Buffer
+        {
+            State Status{State::Free};
+            Frame Contents{};
+        };
+
+        const DropPolicy m_dropPolicy;
+
+        mutable std::mutex m_mutex{};
+        std::vector<Buffer> m_buffers{};
+        std::deque<size_t> m_pending{};
+        uint64_t m_capturedFrames{};
+        uint64_t m_droppedFrames{};
+    };
+}
@@ -0,0 +1,402 @@
+#include "FrameConverter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRAME_CONVERTER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define FRAME_CONVERTER_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    using Babylon::Plugins::FrameFormat;
+
+    // BT.709 limited range luma coefficients of red, green and blue, out of 256.
+    constexpr uint32_t Y_RED{47};
+    constexpr uint32_t Y_GREEN{157};
+    constexpr uint32_t Y_BLUE{16};
+
+    // BT.709 limited range chroma coefficients, out of 256, and the offset of 128 * 256 + 128 that centers chroma and
+    // rounds it. The coefficients of each sum to 0 so that grays have no chroma, and the offset keeps the sums positive.
+    constexpr short U_RED{26};
+    constexpr short U_GREEN{86};
+    constexpr short U_BLUE{112};
+    constexpr short V_RED{112};
+    constexpr short V_GREEN{102};
+    constexpr short V_BLUE{10};
+    constexpr uint16_t CHROMA_OFFSET{32896};
+
+    // The two source pixels that an output pixel is interpolated from, and the weight of the second one out of 256.
+    struct Tap
+    {
+        uint32_t First{};
+        uint32_t Second{};
+        uint32_t Weight{};
+    };
+
+    std::vector<Tap> ComputeTaps(uint32_t sourceSize, uint32_t size)
+    {
+        std::vector<Tap> taps(size);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            // The centers of the output pixels are mapped to the source, so that the scaled image stays centered.
+            const float position{std::max(0.0f, (i + 0.5f) * sourceSize / size - 0.5f)};
+            const uint32_t first{std::min(static_cast<uint32_t>(position), sourceSize - 1)};
+            const uint32_t weight{std::min(static_cast<uint32_t>((position - first) * 256.0f + 0.5f), 256u)};
+            taps[i] = {first, std::min(first + 1, sourceSize - 1), weight};
+        }
+
+        return taps;
+    }
+
+    uint32_t LoadPixel(const uint8_t* row, uint32_t x)
+    {
+        uint32_t pixel;
+        std::memcpy(&pixel, row + x * 4, sizeof(pixel));
+        return pixel;
+    }
+
+    // Interpolates two pixels with two channels at a time in 16 bit lanes of 32 bit integers, where weighted channels
+    // of up to 255 * 256 cannot overflow into the next lane.
+    uint32_t Lerp(uint32_t first, uint32_t second, uint32_t weight)
+    {
+        constexpr uint32_t MASK{0x00FF00FF};
+        constexpr uint32_t HALF{0x00800080};
+        const uint32_t inverse{256 - weight};
+        const uint32_t redBlue{((first & MASK) * inverse + (second & MASK) * weight + HALF) >> 8};
+        const uint32_t greenAlpha{((first >> 8) & MASK) * inverse + ((second >> 8) & MASK) * weight + HALF};
+        return (redBlue & MASK) | (greenAlpha & ~MASK);
+    }
+
+    uint8_t ComputeY(uint32_t r, uint32_t g, uint32_t b)
+    {
+        return static_cast<uint8_t>(((Y_RED * r + Y_GREEN * g + Y_BLUE * b + 128) >> 8) + 16);
+    }
+
+    uint8_t ComputeU(uint32_t r, uint32_t g, uint32_t b)
+    {
+        return static_cast<uint8_t>((U_BLUE * b + CHROMA_OFFSET - U_RED * r - U_GREEN * g) >> 8);
+    }
+
+    uint8_t ComputeV(uint32_t r, uint32_t g, uint32_t b)
+    {
+        return static_cast<uint8_t>((V_RED * r + CHROMA_OFFSET - V_GREEN * g - V_BLUE * b) >> 8);
+    }
+
+    // Interpolates two rows of bytes, 16 bytes at a time where SIMD is available.
+    void BlendRows(const uint8_t* firstRow, const uint8_t* secondRow, uint32_t weight, size_t size, uint8_t* destination)
+    {
+        size_t i{0};
+#if defined(FRAME_CONVERTER_SSE2)
+        const __m128i zero{_mm_setzero_si128()};
+        const __m128i firstWeight{_mm_set1_epi16(static_cast<short>(256 - weight))};
+        const __m128i secondWeight{_mm_set1_epi16(static_cast<short>(weight))};
+        const __m128i half{_mm_set1_epi16(128)};
+        for (; i + 16 <= size; i += 16)
+        {
+            const __m128i first{_mm_loadu_si128(reinterpret_cast<const __m128i*>(firstRow + i))};
+            const __m128i second{_mm_loadu_si128(reinterpret_cast<const __m128i*>(secondRow + i))};
+            const __m128i low{_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(first, zero), firstWeight), _mm_mullo_epi16(_mm_unpacklo_epi8(second, zero), secondWeight))};
+            const __m128i high{_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(first, zero), firstWeight), _mm_mullo_epi16(_mm_unpackhi_epi8(second, zero), secondWeight))};
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(low, half), 8), _mm_srli_epi16(_mm_add_epi16(high, half), 8)));
+        }
+#elif defined(FRAME_CONVERTER_NEON)
+        const uint16x8_t firstWeight{vdupq_n_u16(static_cast<uint16_t>(256 - weight))};
+        const uint16x8_t secondWeight{vdupq_n_u16(static_cast<uint16_t>(weight))};
+        for (; i + 16 <= size; i += 16)
+        {
+            const uint8x16_t first{vld1q_u8(firstRow + i)};
+            const uint8x16_t second{vld1q_u8(secondRow + i)};
+            const uint16x8_t low{vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(first)), firstWeight), vmovl_u8(vget_low_u8(second)), secondWeight)};
+            const uint16x8_t high{vmlaq_u16(vmulq_u16(vmovl_u8(vget_high_u8(first)), firstWeight), vmovl_u8(vget_high_u8(second)), secondWeight)};
+            vst1q_u8(destination + i, vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8)));
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            destination[i] = static_cast<uint8_t>((firstRow[i] * (256 - weight) + secondRow[i] * weight + 128) >> 8);
+        }
+    }
+
+    // Converts two rows of pixels to a row of chroma samples, each the average of the 2x2 pixels it covers, 4 samples
+    // at a time where SIMD is available. Samples are written step bytes apart, to interleave them or not.
+    void ConvertChroma(const uint8_t* row0, const uint8_t* row1, uint32_t width, size_t red, uint8_t* u, uint8_t* v, size_t step)
+    {
+        const size_t blue{2 - red};
+        const uint32_t chromaWidth{(width + 1) / 2};
+        uint32_t chromaX{0};
+#if defined(FRAME_CONVERTER_SSE2)
+        const __m128i zero{_mm_setzero_si128()};
+        const __m128i two{_mm_set1_epi16(2)};
+        const __m128i offset{_mm_set1_epi32(CHROMA_OFFSET)};
+        const auto coefficients{[red](short redCoefficient, short greenCoefficient, short blueCoefficient) {
+            return red == 0
+                       ? _mm_setr_epi16(redCoefficient, greenCoefficient, blueCoefficient, 0, redCoefficient, greenCoefficient, blueCoefficient, 0)
+                       : _mm_setr_epi16(blueCoefficient, greenCoefficient, redCoefficient, 0, blueCoefficient, greenCoefficient, redCoefficient, 0);
+        }};
+        const __m128i uCoefficients{coefficients(-U_RED, -U_GREEN, U_BLUE)};
+        const __m128i vCoefficients{coefficients(V_RED, -V_GREEN, -V_BLUE)};
+
+        // Sums the channels of the 2x2 pixels of two samples, from the channels of two pixels of each row.
+        const auto sum{[&](__m128i pixels0, __m128i pixels1) {
+            const __m128i low{_mm_add_epi16(_mm_unpacklo_epi8(pixels0, zero), _mm_unpacklo_epi8(pixels1, zero))};
+            const __m128i high{_mm_add_epi16(_mm_unpackhi_epi8(pixels0, zero), _mm_unpackhi_epi8(pixels1, zero))};
+            return _mm_unpacklo_epi64(_mm_add_epi16(low, _mm_srli_si128(low, 8)), _mm_add_epi16(high, _mm_srli_si128(high, 8)));
+        }};
+
+        // Computes the chroma of 4 samples from their average channels, as luma is computed.
+        const auto convert{[&](__m128i samples01, __m128i samples23, __m128i sampleCoefficients) {
+            const auto dot{[&](__m128i samples) {
+                return _mm_castsi128_ps(_mm_madd_epi16(samples, sampleCoefficients));
+            }};
+            const __m128 low{dot(samples01)};
+            const __m128 high{dot(samples23)};
+            const __m128i even{_mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)))};
+            const __m128i odd{_mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)))};
+            const __m128i values{_mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(even, odd), offset), 8)};
+            return _mm_packus_epi16(_mm_packs_epi32(values, zero), zero);
+        }};
+
+        for (; (chromaX + 4) * 2 <= width; chromaX += 4)
+        {
+            const uint8_t* pixels0{row0 + chromaX * 8};
+            const uint8_t* pixels1{row1 + chromaX * 8};
+            const __m128i samples01{_mm_srli_epi16(_mm_add_epi16(sum(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels0)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels1))), two), 2)};
+            const __m128i samples23{_mm_srli_epi16(_mm_add_epi16(sum(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels0 + 16)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels1 + 16))), two), 2)};
+            const __m128i us{convert(samples01, samples23, uCoefficients)};
+            const __m128i vs{convert(samples01, samples23, vCoefficients)};
+
+            uint8_t values[8];
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(values), _mm_unpacklo_epi8(us, vs));
+            for (size_t i = 0; i < 4; ++i)
+            {
+                u[(chromaX + i) * step] = values[i * 2];
+                v[(chromaX + i) * step] = values[i * 2 + 1];
+            }
+        }
+#elif defined(FRAME_CONVERTER_NEON)
+        const uint16x4_t offset{vdup_n_u16(CHROMA_OFFSET)};
+        for (; (chromaX + 4) * 2 <= width; chromaX += 4)
+        {
+            const uint8x8x4_t channels0{vld4_u8(row0 + chromaX * 8)};
+            const uint8x8x4_t channels1{vld4_u8(row1 + chromaX * 8)};
+            const auto average{[&](size_t channel) {
+                const uint16x8_t columns{vaddl_u8(channels0.val[channel], channels1.val[channel])};
+                return vrshr_n_u16(vpadd_u16(vget_low_u16(columns), vget_high_u16(columns)), 2);
+            }};
+            const uint16x4_t r{average(red)};
+            const uint16x4_t g{average(1)};
+            const uint16x4_t b{average(blue)};
+            const uint16x4_t us{vshr_n_u16(vmls_n_u16(vmls_n_u16(vmla_n_u16(offset, b, U_BLUE), r, U_RED), g, U_GREEN), 8)};
+            const uint16x4_t vs{vshr_n_u16(vmls_n_u16(vmls_n_u16(vmla_n_u16(offset, r, V_RED), g, V_GREEN), b, V_BLUE), 8)};
+
+            uint8_t values[8];
+            vst1_u8(values, vmovn_u16(vcombine_u16(us, vs)));
+            for (size_t i = 0; i < 4; ++i)
+            {
+                u[(chromaX + i) * step] = values[i];
+                v[(chromaX + i) * step] = values[i + 4];
+            }
+        }
+#endif
+        for (; chromaX < chromaWidth; ++chromaX)
+        {
+            const uint32_t x0{chromaX * 2 * 4};
+            const uint32_t x1{std::min(chromaX * 2 + 1, width - 1) * 4};
+            const uint32_t r{static_cast<uint32_t>((row0[x0 + red] + row0[x1 + red] + row1[x0 + red] + row1[x1 + red] + 2) >> 2)};
+            const uint32_t g{static_cast<uint32_t>((row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1] + 2) >> 2)};
+            const uint32_t b{static_cast<uint32_t>((row0[x0 + blue] + row0[x1 + blue] + row1[x0 + blue] + row1[x1 + blue] + 2) >> 2)};
+            u[chromaX * step] = ComputeU(r, g, b);
+            v[chromaX * step] = ComputeV(r, g, b);
+        }
+    }
+
+    // Scales a row horizontally, from a row interpolated between the two source rows of the output row.
+    void ScaleRow(const uint8_t* row, const std::vector<Tap>& columns, uint8_t* destination)
+    {
+        for (const Tap& column : columns)
+        {
+            const uint32_t pixel{Lerp(LoadPixel(row, column.First), LoadPixel(row, column.Second), column.Weight)};
+            std::memcpy(destination, &pixel, sizeof(pixel));
+            destination += 4;
+        }
+    }
+
+    // Converts a row of pixels to luma, 8 pixels at a time where SIMD is available.
+    void ConvertLuma(const uint8_t* pixels, uint32_t width, size_t red, uint8_t* luma)
+    {
+        const size_t blue{2 - red};
+        uint32_t x{0};
+#if defined(FRAME_CONVERTER_SSE2)
+        const __m128i zero{_mm_setzero_si128()};
+        const __m128i coefficients{red == 0
+                                       ? _mm_setr_epi16(Y_RED, Y_GREEN, Y_BLUE, 0, Y_RED, Y_GREEN, Y_BLUE, 0)
+                                       : _mm_setr_epi16(Y_BLUE, Y_GREEN, Y_RED, 0, Y_BLUE, Y_GREEN, Y_RED, 0)};
+        const __m128i offset{_mm_set1_epi32(128 + (16 << 8))};
+
+        // The products of the channels of 4 pixels are summed in pairs by madd, then the two pairs of each pixel.
+        const auto sum{[&](__m128i pixels4) {
+            const __m128 low{_mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(pixels4, zero), coefficients))};
+            const __m128 high{_mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(pixels4, zero), coefficients))};
+            const __m128i even{_mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)))};
+            const __m128i odd{_mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)))};
+            return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(even, odd), offset), 8);
+        }};
+
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m128i first{sum(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + x * 4)))};
+            const __m128i second{sum(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + x * 4 + 16)))};
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(luma + x), _mm_packus_epi16(_mm_packs_epi32(first, second), zero));
+        }
+#elif defined(FRAME_CONVERTER_NEON)
+        const uint8x8_t redCoefficient{vdup_n_u8(Y_RED)};
+        const uint8x8_t greenCoefficient{vdup_n_u8(Y_GREEN)};
+        const uint8x8_t blueCoefficient{vdup_n_u8(Y_BLUE)};
+        const uint8x8_t offset{vdup_n_u8(16)};
+        for (; x + 8 <= width; x += 8)
+        {
+            const uint8x8x4_t channels{vld4_u8(pixels + x * 4)};
+            uint16x8_t y{vmull_u8(channels.val[red], redCoefficient)};
+            y = vmlal_u8(y, channels.val[1], greenCoefficient);
+            y = vmlal_u8(y, channels.val[blue], blueCoefficient);
+            vst1_u8(luma + x, vadd_u8(vrshrn_n_u16(y, 8), offset));
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            const uint8_t* pixel{pixels + x * 4};
+            luma[x] = ComputeY(pixel[red], pixel[1], pixel[blue]);
+        }
+    }
+}
+
+namespace Babylon::Plugins
+{
+    size_t FrameConverter::GetSize(FrameFormat format, uint32_t width, uint32_t height)
+    {
+        switch (format)
+        {
+            case FrameFormat::RGBA8:
+            case FrameFormat::BGRA8:
+                return static_cast<size_t>(width) * height * 4;
+            case FrameFormat::NV12:
+            case FrameFormat::I420:
+                return static_cast<size_t>(width) * height + static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2) * 2;
+            default:
+                return 0;
+        }
+    }
+
+    void FrameConverter::Convert(gsl::span<const uint8_t> source, uint32_t sourceWidth, uint32_t sourceHeight, size_t sourcePitch, FrameFormat sourceFormat, bool yFlip,
+        gsl::span<uint8_t> destination, uint32_t width, uint32_t height, FrameFormat format)
+    {
+        if (sourceFormat != FrameFormat::RGBA8 && sourceFormat != FrameFormat::BGRA8)
+        {
+            throw std::runtime_error{"Captured frames can only be converted from RGBA8 or BGRA8."};
+        }
+
+        if (static_cast<size_t>(source.size()) < sourcePitch * sourceHeight || sourcePitch < static_cast<size_t>(sourceWidth) * 4 ||
+            static_cast<size_t>(destination.size()) < GetSize(format, width, height))
+        {
+            throw std::runtime_error{"Captured frame buffers are too small for their size."};
+        }
+
+        if (width == 0 || height == 0 || sourceWidth == 0 || sourceHeight == 0)
+        {
+            return;
+        }
+
+        const bool scale{sourceWidth != width || sourceHeight != height};
+        const std::vector<Tap> columns{scale ? ComputeTaps(sourceWidth, width) : std::vector<Tap>{}};
+        const std::vector<Tap> rows{scale ? ComputeTaps(sourceHeight, height) : std::vector<Tap>{}};
+        std::vector<uint8_t> blended(scale ? static_cast<size_t>(sourceWidth) * 4 : 0);
+        std::vector<uint8_t> scratch(scale ? static_cast<size_t>(width) * 4 * 2 : 0);
+
+        const auto sourceRow{[&](uint32_t y) {
+            return source.data() + (yFlip ? sourceHeight - 1 - y : y) * sourcePitch;
+        }};
+
+        // Returns a row of the output size in the channel order of the source, scaled to one of two scratch rows.
+        const auto row{[&](uint32_t y, size_t scratchRow) {
+            if (!scale)
+            {
+                return sourceRow(y);
+            }
+
+            uint8_t* scaled{scratch.data() + scratchRow * width * 4};
+            BlendRows(sourceRow(rows[y].First), sourceRow(rows[y].Second), rows[y].Weight, blended.size(), blended.data());
+            ScaleRow(blended.data(), columns, scaled);
+            return static_cast<const uint8_t*>(scaled);
+        }};
+
+        if (format == FrameFormat::RGBA8 || format == FrameFormat::BGRA8)
+        {
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                const uint8_t* pixels{row(y, 0)};
+                uint8_t* destinationRow{destination.data() + static_cast<size_t>(y) * width * 4};
+                if (format == sourceFormat)
+                {
+                    std::memcpy(destinationRow, pixels, static_cast<size_t>(width) * 4);
+                }
+                else
+                {
+                    for (uint32_t x = 0; x < width; ++x, pixels += 4, destinationRow += 4)
+                    {
+                        destinationRow[0] = pixels[2];
+                        destinationRow[1] = pixels[1];
+                        destinationRow[2] = pixels[0];
+                        destinationRow[3] = pixels[3];
+                    }
+                }
+            }
+
+            return;
+        }
+
+        if (format != FrameFormat::NV12 && format != FrameFormat::I420)
+        {
+            throw std::runtime_error{"Captured frames can only be converted to RGBA8, BGRA8, NV12 or I420."};
+        }
+
+        const size_t red{sourceFormat == FrameFormat::BGRA8 ? 2u : 0u};
+        const uint32_t chromaWidth{(width + 1) / 2};
+        const uint32_t chromaHeight{(height + 1) / 2};
+        uint8_t* const luma{destination.data()};
+        uint8_t* const chroma{luma + static_cast<size_t>(width) * height};
+        const size_t chromaPlaneSize{static_cast<size_t>(chromaWidth) * chromaHeight};
+
+        // Rows are converted in pairs, so that each chroma sample is the average of the 2x2 pixels it covers.
+        for (uint32_t chromaY = 0; chromaY < chromaHeight; ++chromaY)
+        {
+            const uint32_t y0{chromaY * 2};
+            const uint32_t y1{std::min(y0 + 1, height - 1)};
+            const uint8_t* row0{row(y0, 0)};
+            const uint8_t* row1{y1 == y0 ? row0 : row(y1, 1)};
+
+            ConvertLuma(row0, width, red, luma + static_cast<size_t>(y0) * width);
+            if (y1 != y0)
+            {
+                ConvertLuma(row1, width, red, luma + static_cast<size_t>(y1) * width);
+            }
+
+            if (format == FrameFormat::NV12)
+            {
+                uint8_t* uv{chroma + static_cast<size_t>(chromaY) * chromaWidth * 2};
+                ConvertChroma(row0, row1, width, red, uv, uv + 1, 2);
+            }
+            else
+            {
+                uint8_t* u{chroma + static_cast<size_t>(chromaY) * chromaWidth};
+                ConvertChroma(row0, row1, width, red, u, u + chromaPlaneSize, 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <gsl/gsl>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Babylon::Plugins
+{
+    enum class FrameFormat
+    {
+        Unknown,
+        RGBA8,
+        BGRA8,
+        // A plane of luma followed by a plane of interleaved chroma at half resolution, as video encoders expect.
+        NV12,
+        // A plane of luma followed by a plane of each chroma at half resolution.
+        I420,
+    };
+
+    // Scales captured frames and converts them to the output format of a capture, in a single pass from the captured
+    // pixels to the buffer that JavaScript reads them from.
+    class FrameConverter final
+    {
+    public:
+        static size_t GetSize(FrameFormat format, uint32_t width, uint32_t height);
+
+        // Scales RGBA8 or BGRA8 pixels, whose rows are sourcePitch bytes apart and are bottom up when yFlip is set,
+        // with a bilinear filter, and converts them to top down pixels of the destination format. YUV formats use
+        // BT.709 limited range coefficients.
+        static void Convert(gsl::span<const uint8_t> source, uint32_t sourceWidth, uint32_t sourceHeight, size_t sourcePitch, FrameFormat sourceFormat, bool yFlip,
+            gsl::span<uint8_t> destination, uint32_t width, uint32_t height, FrameFormat format);
+    };
+}
@@ -0,0 +1,285 @@
+#include "FrameRecorder.h"
+
+#include <Babylon/Graphics/VectorWriter.h>
+
+#include <bimg/bimg.h>
+#include <bx/error.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+namespace
+{
+    // Frames are numbered from 0 in the order they are recorded, so that image sequences have no gaps.
+    constexpr auto PNG_FILE_NAME_FORMAT{"%06llu.png"};
+    constexpr auto PNG_INDEX_FILE_NAME{"timestamps.csv"};
+    constexpr auto STREAM_INDEX_EXTENSION{".timestamps.csv"};
+}
+
+namespace Babylon::Plugins
+{
+    void FrameRecorder::StageStats::Add(std::chrono::nanoseconds duration)
+    {
+        ++Count;
+        Total += duration;
+        Max = std::max(Max, duration);
+    }
+
+    FrameRecorder::FrameRecorder(std::string path, Container container, size_t queueSize, uint32_t frameRate)
+        : m_path{std::move(path)}
+        , m_container{container}
+        , m_frameRate{frameRate}
+        , m_ring{queueSize, CaptureRing::DropPolicy::DropNewest}
+    {
+        std::string indexPath{};
+        if (m_container == Container::PNG)
+        {
+            std::filesystem::create_directories(m_path);
+            indexPath = (std::filesystem::path{m_path} / PNG_INDEX_FILE_NAME).string();
+        }
+        else
+        {
+            m_stream.open(m_path, std::ios::binary | std::ios::trunc);
+            if (!m_stream)
+            {
+                throw std::runtime_error{"Failed to create the recording file " + m_path};
+            }
+
+            indexPath = m_path + STREAM_INDEX_EXTENSION;
+        }
+
+        m_index.open(indexPath, std::ios::trunc);
+        if (!m_index)
+        {
+            throw std::runtime_error{"Failed to create the recording index " + indexPath};
+        }
+
+        m_index << "frame,captureFrame,microseconds,width,height\n";
+
+        m_thread = std::thread{[this]() { Run(); }};
+    }
+
+    FrameRecorder::~FrameRecorder()
+    {
+        Stop({});
+        m_thread.join();
+    }
+
+    bool FrameRecorder::Record(gsl::span<const uint8_t> data, uint32_t width, uint32_t height, size_t pitch, FrameFormat format, bool yFlip, uint32_t outputWidth, uint32_t outputHeight)
+    {
+        if (m_closed || (format != FrameFormat::RGBA8 && format != FrameFormat::BGRA8) || width == 0 || height == 0 ||
+            pitch < static_cast<size_t>(width) * 4 || static_cast<size_t>(data.size()) < pitch * height)
+        {
+            return false;
+        }
+
+        if (m_width == 0 || m_height == 0)
+        {
+            m_width = outputWidth;
+            m_height = outputHeight;
+        }
+
+        // The rows are copied with their pitch, which the writer thread finds from the size of the copy.
+        const bool written{m_ring.Write(width, height, format, yFlip, data.first(pitch * height))};
+        if (written)
+        {
+            {
+                std::scoped_lock lock{m_mutex};
+                m_signaled = true;
+            }
+
+            m_condition.notify_one();
+        }
+
+        return written;
+    }
+
+    void FrameRecorder::Stop(std::function<void(std::exception_ptr)> onStopped)
+    {
+        m_closed = true;
+
+        std::unique_lock lock{m_mutex};
+        if (m_stopped)
+        {
+            const auto error{m_error};
+            lock.unlock();
+
+            if (onStopped)
+            {
+                onStopped(error);
+            }
+
+            return;
+        }
+
+        if (onStopped)
+        {
+            m_onStopped.push_back(std::move(onStopped));
+        }
+
+        m_stopping = true;
+        lock.unlock();
+
+        m_condition.notify_one();
+    }
+
+    FrameRecorder::Stats FrameRecorder::GetStats() const
+    {
+        std::scoped_lock lock{m_mutex};
+        Stats stats{m_stats};
+        stats.DroppedFrames = m_ring.DroppedFrames();
+        return stats;
+    }
+
+    void FrameRecorder::Run()
+    {
+        bool failed{};
+        bool stopping{};
+        while (!stopping)
+        {
+            {
+                std::unique_lock lock{m_mutex};
+                m_condition.wait(lock, [this]() { return m_signaled || m_stopping; });
+                m_signaled = false;
+                stopping = m_stopping;
+            }
+
+            // The queued frames are written even when stopping, and released without being written after a failure so
+            // that the render thread is never blocked.
+            while (const auto index{m_ring.Take()})
+            {
+                const CaptureRing::Frame& frame{m_ring.Get(*index)};
+                if (!failed)
+                {
+                    try
+                    {
+                        WriteFrame(frame);
+                    }
+                    catch (...)
+                    {
+                        failed = true;
+                        m_closed = true;
+
+                        std::scoped_lock lock{m_mutex};
+                        m_error = std::current_exception();
+                    }
+                }
+
+                m_ring.Release(*index, frame.Number);
+            }
+        }
+
+        m_stream.close();
+        m_index.close();
+
+        std::vector<std::function<void(std::exception_ptr)>> onStopped{};
+        std::exception_ptr error{};
+        {
+            std::scoped_lock lock{m_mutex};
+            m_stopped = true;
+            onStopped.swap(m_onStopped);
+            error = m_error;
+        }
+
+        for (const auto& callback : onStopped)
+        {
+            callback(error);
+        }
+    }
+
+    void FrameRecorder::WriteFrame(const CaptureRing::Frame& frame)
+    {
+        const auto start{std::chrono::steady_clock::now()};
+
+        m_converted.resize(FrameConverter::GetSize(Format(), m_width, m_height));
+        FrameConverter::Convert(*frame.Data, frame.Width, frame.Height, frame.Data->size() / frame.Height, frame.Format, frame.YFlip, m_converted, m_width, m_height, Format());
+
+        const auto converted{std::chrono::steady_clock::now()};
+
+        if (m_recordedFrames == 0)
+        {
+            m_startTime = frame.Time;
+
+            if (m_container == Container::Y4M)
+            {
+                // Chroma is averaged over 2x2 pixels, which puts its samples at the center of the luma samples.
+                const std::string header{"YUV4MPEG2 W" + std::to_string(m_width) + " H" + std::to_string(m_height) + " F" + std::to_string(m_frameRate) + ":1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n"};
+                WriteFile(m_stream, header.data(), header.size());
+            }
+        }
+
+        std::chrono::nanoseconds encodeTime{};
+        switch (m_container)
+        {
+            case Container::Y4M:
+            {
+                constexpr char FRAME_HEADER[]{"FRAME\n"};
+                WriteFile(m_stream, FRAME_HEADER, sizeof(FRAME_HEADER) - 1);
+                WriteFile(m_stream, m_converted.data(), m_converted.size());
+                break;
+            }
+            case Container::RGBA:
+            {
+                WriteFile(m_stream, m_converted.data(), m_converted.size());
+                break;
+            }
+            case Container::PNG:
+            {
+                m_encoded.clear();
+                Babylon::Graphics::VectorWriter writer{m_encoded};
+                bx::Error error{};
+                bimg::imageWritePng(&writer, m_width, m_height, m_width * 4, m_converted.data(), bimg::TextureFormat::RGBA8, false, &error);
+                if (!error.isOk())
+                {
+                    throw std::runtime_error{"Failed to encode a recorded frame to PNG."};
+                }
+
+                encodeTime = std::chrono::steady_clock::now() - converted;
+
+                char fileName[32]{};
+                std::snprintf(fileName, sizeof(fileName), PNG_FILE_NAME_FORMAT, static_cast<unsigned long long>(m_recordedFrames));
+                const auto filePath{(std::filesystem::path{m_path} / fileName).string()};
+                std::ofstream file{filePath, std::ios::binary | std::ios::trunc};
+                if (!file)
+                {
+                    throw std::runtime_error{"Failed to create the recorded frame " + filePath};
+                }
+
+                WriteFile(file, m_encoded.data(), m_encoded.size());
+                break;
+            }
+        }
+
+        const auto microseconds{std::chrono::duration_cast<std::chrono::microseconds>(frame.Time - m_startTime).count()};
+        m_index << m_recordedFrames << ',' << frame.Number << ',' << microseconds << ',' << m_width << ',' << m_height << '\n';
+        if (!m_index)
+        {
+            throw std::runtime_error{"Failed to write the recording index."};
+        }
+
+        ++m_recordedFrames;
+
+        const auto end{std::chrono::steady_clock::now()};
+
+        std::scoped_lock lock{m_mutex};
+        m_stats.RecordedFrames = m_recordedFrames;
+        m_stats.Convert.Add(converted - start);
+        m_stats.Queue.Add(start - frame.Time);
+        if (m_container == Container::PNG)
+        {
+            m_stats.Encode.Add(encodeTime);
+        }
+        m_stats.Write.Add(end - converted - encodeTime);
+    }
+
+    void FrameRecorder::WriteFile(std::ofstream& file, const void* data, size_t size)
+    {
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        if (!file)
+        {
+            throw std::runtime_error{"Failed to write a recorded frame to " + m_path};
+        }
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "CaptureRing.h"
+#include "FrameConverter.h"
+
+#include <gsl/gsl>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Babylon::Plugins
+{
+    // Streams captured frames to files on a dedicated thread, so that recording never brings frames into JavaScript.
+    // The render thread only copies frames into a small ring of buffers, which bounds the queue of the writer thread:
+    // frames captured while all the buffers wait to be written are dropped. The writer thread scales and converts them
+    // to the format of the container before writing them. The timestamp of every recorded frame goes to a sidecar
+    // index next to the frames.
+    class FrameRecorder final
+    {
+    public:
+        enum class Container
+        {
+            // A YUV4MPEG2 stream of I420 frames.
+            Y4M,
+            // A stream of RGBA8 frames without header, as read by tools given the size and pixel format.
+            RGBA,
+            // A directory of numbered PNG files.
+            PNG,
+        };
+
+        struct StageStats
+        {
+            uint64_t Count{};
+            std::chrono::nanoseconds Total{};
+            std::chrono::nanoseconds Max{};
+
+            void Add(std::chrono::nanoseconds duration);
+        };
+
+        struct Stats
+        {
+            uint64_t RecordedFrames{};
+            uint64_t DroppedFrames{};
+
+            // Scaling and conversion on the writer thread, the time from the capture of a frame until the writer thread
+            // picks it up, and encoding and file writes on the writer thread.
+            StageStats Convert{};
+            StageStats Queue{};
+            StageStats Encode{};
+            StageStats Write{};
+        };
+
+        // Opens the output at the given path, which is a file for streams and a directory for image sequences, and
+        // starts the writer thread. Throws if the output cannot be created.
+        FrameRecorder(std::string path, Container container, size_t queueSize, uint32_t frameRate);
+
+        // Writes the queued frames and closes the output.
+        ~FrameRecorder();
+
+        // The format that frames are recorded in.
+        FrameFormat Format() const
+        {
+            return m_container == Container::Y4M ? FrameFormat::I420 : FrameFormat::RGBA8;
+        }
+
+        // Queues a copy of a frame of RGBA8 or BGRA8 pixels, which the writer thread scales and converts to the format
+        // of the container. Frames are recorded at the given size of the first frame, as streams cannot change size.
+        // Returns false if the frame was dropped. Called from the render thread.
+        bool Record(gsl::span<const uint8_t> data, uint32_t width, uint32_t height, size_t pitch, FrameFormat format, bool yFlip, uint32_t outputWidth, uint32_t outputHeight);
+
+        // Stops recording. The queued frames are written and the output is closed on the writer thread, which then
+        // calls the given callback with the first error that interrupted the recording, if any. The callback is called
+        // right away if the recording is already stopped.
+        void Stop(std::function<void(std::exception_ptr)> onStopped);
+
+        Stats GetStats() const;
+
+    private:
+        void Run();
+        void WriteFrame(const CaptureRing::Frame& frame);
+        void WriteFile(std::ofstream& file, const void* data, size_t size);
+
+        const std::string m_path;
+        const Container m_container;
+        const uint32_t m_frameRate;
+
+        CaptureRing m_ring;
+
+        // The size of the recorded frames, set by the first frame on the render thread before it is queued, and read
+        // by the writer thread once it takes frames from the ring.
+        uint32_t m_width{};
+        uint32_t m_height{};
+
+        // Owned by the writer thread.
+        std::ofstream m_stream{};
+        std::ofstream m_index{};
+        std::vector<uint8_t> m_converted{};
+        std::vector<uint8_t> m_encoded{};
+        uint64_t m_recordedFrames{};
+        std::chrono::steady_clock::time_point m_startTime{};
+
+        mutable std::mutex m_mutex{};
+        std::condition_variable m_condition{};
+        bool m_signaled{};
+        bool m_stopping{};
+        bool m_stopped{};
+        std::vector<std::function<void(std::exception_ptr)>> m_onStopped{};
+        std::exception_ptr m_error{};
+        Stats m_stats{};
+
+        // Set once frames must no longer be queued, because the recording is stopping or has failed.
+        std::atomic<bool> m_closed{};
+
+        std::thread m_thread{};
+    };
+}
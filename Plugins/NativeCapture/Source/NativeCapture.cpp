@@ -3,10 +3,23 @@
 #include <Babylon/Graphics/DeviceContext.h>
 #include <Babylon/Graphics/FrameBuffer.h>
 
+#include "CaptureRing.h"
+#include "FrameConverter.h"
+#include "FrameRecorder.h"
+
 #include <napi/pointer.h>
 
 #include <arcana/containers/ticketed_collection.h>
-
+#include <arcana/threading/task.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <utility>
 #include <vector>
 
 namespace
@@ -15,7 +28,11 @@ namespace
     using FrameProviderCleanup = std::function<void()>;
     using FrameProviderTicket = gsl::final_action<FrameProviderCleanup>;
 
-    FrameProviderTicket BeginFrameCapture(Babylon::Graphics::DeviceContext& graphicsContext, bgfx::FrameBufferHandle frameBufferHandle, FrameCallback callback)
+    // Frames of off screen frame buffers are reduced on the GPU to the smallest power of two fraction of their size that
+    // is at least the target size, by reading them back from a mip, where the renderer generates mips for their format.
+    // A target dimension of 0 does not constrain the reduction. Frames of the default frame buffer are captured at
+    // their size.
+    FrameProviderTicket BeginFrameCapture(Babylon::Graphics::DeviceContext& graphicsContext, bgfx::FrameBufferHandle frameBufferHandle, uint32_t targetWidth, uint32_t targetHeight, FrameCallback callback)
     {
         class DefaultBufferFrameProvider final : public std::enable_shared_from_this<DefaultBufferFrameProvider>
         {
@@ -52,9 +69,9 @@ namespace
         class OffScreenBufferFrameProvider final : public std::enable_shared_from_this<OffScreenBufferFrameProvider>
         {
         public:
-            static FrameProviderTicket Create(Babylon::Graphics::DeviceContext& graphicsContext, bgfx::FrameBufferHandle frameBufferHandle, FrameCallback callback)
+            static FrameProviderTicket Create(Babylon::Graphics::DeviceContext& graphicsContext, bgfx::FrameBufferHandle frameBufferHandle, uint32_t targetWidth, uint32_t targetHeight, FrameCallback callback)
             {
-                std::shared_ptr<OffScreenBufferFrameProvider> frameProvider{new OffScreenBufferFrameProvider(graphicsContext, frameBufferHandle, std::move(callback))};
+                std::shared_ptr<OffScreenBufferFrameProvider> frameProvider{new OffScreenBufferFrameProvider(graphicsContext, frameBufferHandle, targetWidth, targetHeight, std::move(callback))};
                 // Note: ReadTextureAsync is "asynchronously recursive" (it calls itself to read the next frame).
                 frameProvider->ReadTextureAsync();
                 return gsl::finally<FrameProviderCleanup>([frameProvider{std::move(frameProvider)}]() mutable {
@@ -65,26 +82,88 @@ namespace
             ~OffScreenBufferFrameProvider()
             {
                 bgfx::destroy(m_blitTextureHandle);
+
+                if (bgfx::isValid(m_mipFrameBufferHandle))
+                {
+                    bgfx::destroy(m_mipFrameBufferHandle);
+                }
             }
 
         private:
-            OffScreenBufferFrameProvider(Babylon::Graphics::DeviceContext& graphicsContext, bgfx::FrameBufferHandle frameBufferHandle, FrameCallback callback)
+            OffScreenBufferFrameProvider(Babylon::Graphics::DeviceContext& graphicsContext, bgfx::FrameBufferHandle frameBufferHandle, uint32_t targetWidth, uint32_t targetHeight, FrameCallback callback)
                 : m_graphicsContext{graphicsContext}
                 , m_frameBufferTextureHandle{bgfx::getTexture(frameBufferHandle)}
                 , m_frameCallback{std::move(callback)}
                 , m_textureInfo{m_graphicsContext.GetTextureInfo(m_frameBufferTextureHandle)}
-                , m_blitTextureHandle{bgfx::createTexture2D(m_textureInfo.Width, m_textureInfo.Height, m_textureInfo.HasMips, m_textureInfo.NumLayers, m_textureInfo.Format, BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK)}
             {
-                bgfx::TextureInfo textureInfo{};
-                bgfx::calcTextureSize(textureInfo, m_textureInfo.Width, m_textureInfo.Height, 1, false, m_textureInfo.HasMips, m_textureInfo.NumLayers, m_textureInfo.Format);
-                m_textureBuffer.resize(textureInfo.storageSize);
+                // Whether and how the mips of a render target are generated at the end of its view depends on the renderer,
+                // which reports it per format.
+                constexpr uint32_t mipCaps{BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER | BGFX_CAPS_FORMAT_TEXTURE_MIP_AUTOGEN};
+                const bool canReduce{(bgfx::getCaps()->formats[m_textureInfo.Format] & mipCaps) == mipCaps};
+                if (canReduce && (targetWidth != 0 || targetHeight != 0))
+                {
+                    while (static_cast<uint32_t>(m_textureInfo.Width >> (m_mipLevel + 1)) >= std::max(targetWidth, 1u) && static_cast<uint32_t>(m_textureInfo.Height >> (m_mipLevel + 1)) >= std::max(targetHeight, 1u))
+                    {
+                        ++m_mipLevel;
+                    }
+                }
+
+                m_readWidth = static_cast<uint16_t>(m_textureInfo.Width >> m_mipLevel);
+                m_readHeight = static_cast<uint16_t>(m_textureInfo.Height >> m_mipLevel);
+
+                if (m_mipLevel == 0)
+                {
+                    m_blitTextureHandle = bgfx::createTexture2D(m_textureInfo.Width, m_textureInfo.Height, m_textureInfo.HasMips, m_textureInfo.NumLayers, m_textureInfo.Format, BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK);
+
+                    bgfx::TextureInfo textureInfo{};
+                    bgfx::calcTextureSize(textureInfo, m_textureInfo.Width, m_textureInfo.Height, 1, false, m_textureInfo.HasMips, m_textureInfo.NumLayers, m_textureInfo.Format);
+                    m_textureBuffer.resize(textureInfo.storageSize);
+                }
+                else
+                {
+                    // bgfx generates the mips of a frame buffer texture when a view that renders to it ends.
+                    const bgfx::TextureHandle mipTextureHandle{bgfx::createTexture2D(m_textureInfo.Width, m_textureInfo.Height, /*hasMips*/ true, /*numLayers*/ 1, m_textureInfo.Format, BGFX_TEXTURE_RT | BGFX_TEXTURE_BLIT_DST)};
+                    m_mipFrameBufferHandle = bgfx::createFrameBuffer(1, &mipTextureHandle, /*destroyTextures*/ true);
+                    m_mipTextureHandle = mipTextureHandle;
+
+                    m_blitTextureHandle = bgfx::createTexture2D(m_readWidth, m_readHeight, /*hasMips*/ false, /*numLayers*/ 1, m_textureInfo.Format, BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK);
+
+                    bgfx::TextureInfo textureInfo{};
+                    bgfx::calcTextureSize(textureInfo, m_readWidth, m_readHeight, 1, false, /*hasMips*/ false, /*numLayers*/ 1, m_textureInfo.Format);
+                    m_textureBuffer.resize(textureInfo.storageSize);
+                }
+            }
+
+            // Blits the frame buffer texture to the texture that is read back, through a mip of the mip frame buffer
+            // when the frame is reduced.
+            void Blit()
+            {
+                const bgfx::ViewId readView{Babylon::Graphics::DeviceContext::GetReservedViewId(Babylon::Graphics::DeviceContext::ReservedView::ReadBack)};
+                if (m_mipLevel == 0)
+                {
+                    bgfx::blit(readView, m_blitTextureHandle, 0, 0, m_frameBufferTextureHandle);
+                    return;
+                }
+
+                // The frame is copied to the top mip in a view that renders to the mip frame buffer. Moving on to the
+                // read view, which is touched so that the renderer switches to it, ends that view and generates the
+                // mips, before the blits of the read view copy the reduced mip.
+                const bgfx::ViewId mipView{Babylon::Graphics::DeviceContext::GetReservedViewId(Babylon::Graphics::DeviceContext::ReservedView::MipGeneration)};
+                bgfx::setViewFrameBuffer(mipView, m_mipFrameBufferHandle);
+                bgfx::setViewRect(mipView, 0, 0, m_textureInfo.Width, m_textureInfo.Height);
+                bgfx::setViewClear(mipView, BGFX_CLEAR_NONE);
+                bgfx::blit(mipView, m_mipTextureHandle, 0, 0, m_frameBufferTextureHandle);
+                bgfx::touch(mipView);
+
+                bgfx::touch(readView);
+                bgfx::blit(readView, m_blitTextureHandle, /*dstMip*/ 0, /*dstX*/ 0, /*dstY*/ 0, /*dstZ*/ 0, m_mipTextureHandle, m_mipLevel, /*srcX*/ 0, /*srcY*/ 0, /*srcZ*/ 0, m_readWidth, m_readHeight, /*depth*/ 0);
             }
 
             arcana::task<void, std::exception_ptr> ReadTextureAsync()
             {
                 return arcana::make_task(m_graphicsContext.AfterRenderScheduler(), m_cancellationToken, [thisRef{shared_from_this()}] {
                     // bgfx does not allow readback of render textures, so the frame buffer render texture needs to be blitted to a texture with readback enabled.
-                    bgfx::blit(static_cast<uint16_t>(bgfx::getCaps()->limits.maxViews - 1), thisRef->m_blitTextureHandle, 0, 0, thisRef->m_frameBufferTextureHandle);
+                    thisRef->Blit();
 
                     // Reading the texture is an async operation, but everything that needs to be done prior to future write operations on that texture is completed synchronously,
                     // so we kick off the read for the next frame prior to the read for the current frame completes.
@@ -93,7 +172,7 @@ namespace
                     arcana::task<void, std::exception_ptr> readCurrentFrameTask{
                         thisRef->m_graphicsContext.ReadTextureAsync(thisRef->m_blitTextureHandle, thisRef->m_textureBuffer)
                             .then(arcana::inline_scheduler, thisRef->m_cancellationToken, [thisRef] {
-                                thisRef->m_frameCallback(thisRef->m_textureInfo.Width, thisRef->m_textureInfo.Height, thisRef->m_textureInfo.Format, bgfx::getCaps()->originBottomLeft, thisRef->m_textureBuffer);
+                                thisRef->m_frameCallback(thisRef->m_readWidth, thisRef->m_readHeight, thisRef->m_textureInfo.Format, bgfx::getCaps()->originBottomLeft, thisRef->m_textureBuffer);
                             })};
 
                     arcana::task<void, std::exception_ptr> readNextFrameTask{thisRef->ReadTextureAsync()};
@@ -111,6 +190,11 @@ namespace
             FrameCallback m_frameCallback{};
             Babylon::Graphics::TextureInfo m_textureInfo{};
             bgfx::TextureHandle m_blitTextureHandle{bgfx::kInvalidHandle};
+            uint8_t m_mipLevel{0};
+            bgfx::FrameBufferHandle m_mipFrameBufferHandle{bgfx::kInvalidHandle};
+            bgfx::TextureHandle m_mipTextureHandle{bgfx::kInvalidHandle};
+            uint16_t m_readWidth{0};
+            uint16_t m_readHeight{0};
             std::vector<uint8_t> m_textureBuffer{};
             arcana::cancellation_source m_cancellationToken{};
         };
@@ -122,7 +206,7 @@ namespace
         }
         else
         {
-            return OffScreenBufferFrameProvider::Create(graphicsContext, frameBufferHandle, std::move(callback));
+            return OffScreenBufferFrameProvider::Create(graphicsContext, frameBufferHandle, targetWidth, targetHeight, std::move(callback));
         }
     }
 }
@@ -143,7 +227,12 @@ namespace Babylon::Plugins::Internal
                 JS_CLASS_NAME,
                 {
                     NativeCapture::InstanceMethod("addCallback", &NativeCapture::AddCallback),
+                    NativeCapture::InstanceMethod("releaseFrame", &NativeCapture::ReleaseFrame),
+                    NativeCapture::InstanceMethod("stopRecording", &NativeCapture::StopRecording),
                     NativeCapture::InstanceMethod("dispose", &NativeCapture::Dispose),
+                    NativeCapture::InstanceAccessor("capturedFrames", &NativeCapture::GetCapturedFrames, nullptr),
+                    NativeCapture::InstanceAccessor("droppedFrames", &NativeCapture::GetDroppedFrames, nullptr),
+                    NativeCapture::InstanceAccessor("recordingStats", &NativeCapture::GetRecordingStats, nullptr),
                 });
 
             env.Global().Set(JS_CLASS_NAME, func);
@@ -152,13 +241,9 @@ namespace Babylon::Plugins::Internal
         NativeCapture(const Napi::CallbackInfo& info)
             : Napi::ObjectWrap<NativeCapture>{info}
             , m_runtime{JsRuntime::GetFromJavaScript(info.Env())}
-            , m_jsData{Napi::Persistent(Napi::Object::New(info.Env()))}
         {
             auto& graphicsContext = Graphics::DeviceContext::GetFromJavaScript(info.Env());
 
-            Napi::Object jsData = m_jsData.Value();
-            jsData.Set("data", Napi::ArrayBuffer::New(info.Env(), 0));
-
             FrameCallback frameCallback{[this](uint32_t width, uint32_t height, bgfx::TextureFormat::Enum format, bool yFlip, gsl::span<const uint8_t> data) {
                 CaptureDataReceived(width, height, format, yFlip, data);
             }};
@@ -166,7 +251,7 @@ namespace Babylon::Plugins::Internal
             bgfx::FrameBufferHandle frameBufferHandle{bgfx::kInvalidHandle};
 
             // For an off screen frame buffer, the frame buffer must be passed into the constructor. Otherwise, we capture the on screen / default frame buffer.
-            if (info.Length() > 1)
+            if (info.Length() > 2)
             {
                 throw Napi::Error::New(info.Env(), "Too many arguments passed to NativeCapture constructor.");
             }
@@ -176,7 +261,89 @@ namespace Babylon::Plugins::Internal
                 frameBufferHandle = frameBuffer.Handle();
             }
 
-            m_frameProviderTicket.emplace(BeginFrameCapture(graphicsContext, frameBufferHandle, std::move(frameCallback)));
+            size_t bufferCount{DEFAULT_BUFFER_COUNT};
+            CaptureRing::DropPolicy dropPolicy{CaptureRing::DropPolicy::DropOldest};
+            if (info.Length() > 1 && info[1].IsObject())
+            {
+                const auto options{info[1].As<Napi::Object>()};
+
+                if (options.Has("bufferCount"))
+                {
+                    bufferCount = options.Get("bufferCount").As<Napi::Number>().Uint32Value();
+                    if (bufferCount == 0)
+                    {
+                        throw Napi::Error::New(info.Env(), "NativeCapture needs at least one buffer.");
+                    }
+                }
+
+                if (options.Has("dropPolicy"))
+                {
+                    const auto policy{options.Get("dropPolicy").As<Napi::String>().Utf8Value()};
+                    if (policy == "dropOldest")
+                    {
+                        dropPolicy = CaptureRing::DropPolicy::DropOldest;
+                    }
+                    else if (policy == "dropNewest")
+                    {
+                        dropPolicy = CaptureRing::DropPolicy::DropNewest;
+                    }
+                    else
+                    {
+                        throw Napi::Error::New(info.Env(), "Unknown NativeCapture drop policy: " + policy);
+                    }
+                }
+
+                if (options.Has("explicitRelease"))
+                {
+                    m_explicitRelease = options.Get("explicitRelease").ToBoolean();
+                }
+
+                if (options.Has("width"))
+                {
+                    m_width = options.Get("width").As<Napi::Number>().Uint32Value();
+                }
+
+                if (options.Has("height"))
+                {
+                    m_height = options.Get("height").As<Napi::Number>().Uint32Value();
+                }
+
+                if (options.Has("format"))
+                {
+                    const auto format{options.Get("format").As<Napi::String>().Utf8Value()};
+                    if (format == "rgba")
+                    {
+                        m_format = FrameFormat::RGBA8;
+                    }
+                    else if (format == "nv12")
+                    {
+                        m_format = FrameFormat::NV12;
+                    }
+                    else if (format == "i420")
+                    {
+                        m_format = FrameFormat::I420;
+                    }
+                    else
+                    {
+                        throw Napi::Error::New(info.Env(), "Unknown NativeCapture format: " + format);
+                    }
+                }
+
+                if (options.Has("record"))
+                {
+                    StartRecording(info.Env(), options.Get("record").As<Napi::Object>());
+                }
+            }
+
+            m_ring.emplace(bufferCount, dropPolicy);
+            m_jsFrames.resize(bufferCount);
+
+            if (m_width != 0 || m_height != 0 || m_format != FrameFormat::Unknown)
+            {
+                m_staging.emplace(STAGING_BUFFER_COUNT, CaptureRing::DropPolicy::DropOldest);
+            }
+
+            m_frameProviderTicket.emplace(BeginFrameCapture(graphicsContext, frameBufferHandle, m_width, m_height, std::move(frameCallback)));
         }
 
         ~NativeCapture()
@@ -196,50 +363,343 @@ namespace Babylon::Plugins::Internal
             m_callbacks.push_back(Napi::Persistent(listener));
         }
 
+        void StartRecording(Napi::Env env, const Napi::Object& record)
+        {
+            const auto path{record.Get("path").As<Napi::String>().Utf8Value()};
+
+            FrameRecorder::Container container{FrameRecorder::Container::Y4M};
+            if (record.Has("container"))
+            {
+                const auto name{record.Get("container").As<Napi::String>().Utf8Value()};
+                if (name == "y4m")
+                {
+                    container = FrameRecorder::Container::Y4M;
+                }
+                else if (name == "rgba")
+                {
+                    container = FrameRecorder::Container::RGBA;
+                }
+                else if (name == "png")
+                {
+                    container = FrameRecorder::Container::PNG;
+                }
+                else
+                {
+                    throw Napi::Error::New(env, "Unknown NativeCapture recording container: " + name);
+                }
+            }
+
+            size_t queueSize{DEFAULT_RECORDING_QUEUE_SIZE};
+            if (record.Has("queueSize"))
+            {
+                queueSize = record.Get("queueSize").As<Napi::Number>().Uint32Value();
+                if (queueSize == 0)
+                {
+                    throw Napi::Error::New(env, "NativeCapture needs a recording queue of at least one frame.");
+                }
+            }
+
+            uint32_t frameRate{DEFAULT_RECORDING_FRAME_RATE};
+            if (record.Has("frameRate"))
+            {
+                frameRate = std::max(record.Get("frameRate").As<Napi::Number>().Uint32Value(), 1u);
+            }
+
+            // Recorded frames go to JavaScript as well only when asked to, so that long recordings stay off the
+            // JavaScript thread.
+            m_deliverFrames = record.Has("deliverFrames") && record.Get("deliverFrames").ToBoolean();
+
+            try
+            {
+                m_recorder.emplace(path, container, queueSize, frameRate);
+            }
+            catch (const std::exception& exception)
+            {
+                throw Napi::Error::New(env, exception.what());
+            }
+        }
+
+        Napi::Value StopRecording(const Napi::CallbackInfo& info)
+        {
+            auto env{info.Env()};
+            auto deferred{Napi::Promise::Deferred::New(env)};
+            if (!m_recorder.has_value())
+            {
+                deferred.Reject(Napi::Error::New(env, "NativeCapture is not recording.").Value());
+                return deferred.Promise();
+            }
+
+            // The promise resolves once the writer thread has written the queued frames and closed the files.
+            m_recorder->Stop([&runtime{m_runtime}, deferred](std::exception_ptr error) {
+                runtime.Dispatch([deferred, error](Napi::Env env) {
+                    if (error)
+                    {
+                        deferred.Reject(Napi::Error::New(env, error).Value());
+                    }
+                    else
+                    {
+                        deferred.Resolve(env.Undefined());
+                    }
+                });
+            });
+
+            return deferred.Promise();
+        }
+
+        Napi::Value GetRecordingStats(const Napi::CallbackInfo& info)
+        {
+            auto env{info.Env()};
+            if (!m_recorder.has_value())
+            {
+                return env.Undefined();
+            }
+
+            const auto stats{m_recorder->GetStats()};
+
+            // Durations are in milliseconds.
+            const auto toObject{[env](const FrameRecorder::StageStats& stage) {
+                using Milliseconds = std::chrono::duration<double, std::milli>;
+                Napi::Object jsStage{Napi::Object::New(env)};
+                jsStage.Set("frames", static_cast<double>(stage.Count));
+                jsStage.Set("totalTime", std::chrono::duration_cast<Milliseconds>(stage.Total).count());
+                jsStage.Set("averageTime", stage.Count == 0 ? 0.0 : std::chrono::duration_cast<Milliseconds>(stage.Total).count() / stage.Count);
+                jsStage.Set("maxTime", std::chrono::duration_cast<Milliseconds>(stage.Max).count());
+                return jsStage;
+            }};
+
+            Napi::Object jsStats{Napi::Object::New(env)};
+            jsStats.Set("recordedFrames", static_cast<double>(stats.RecordedFrames));
+            jsStats.Set("droppedFrames", static_cast<double>(stats.DroppedFrames));
+            jsStats.Set("convert", toObject(stats.Convert));
+            jsStats.Set("queue", toObject(stats.Queue));
+            jsStats.Set("encode", toObject(stats.Encode));
+            jsStats.Set("write", toObject(stats.Write));
+            return jsStats;
+        }
+
+        void ReleaseFrame(const Napi::CallbackInfo& info)
+        {
+            const auto number{static_cast<uint64_t>(info[0].As<Napi::Object>().Get("frameNumber").As<Napi::Number>().Int64Value())};
+            for (size_t index = 0; index < m_jsFrames.size(); ++index)
+            {
+                if (m_jsFrames[index].Number == number)
+                {
+                    m_ring->Release(index, number);
+                    return;
+                }
+            }
+        }
+
+        // Frames that are converted arrive in the staging ring, and may be dropped there or in the ring.
+        Napi::Value GetCapturedFrames(const Napi::CallbackInfo& info)
+        {
+            return Napi::Value::From(info.Env(), static_cast<double>(m_staging.has_value() ? m_staging->CapturedFrames() : m_ring->CapturedFrames()));
+        }
+
+        Napi::Value GetDroppedFrames(const Napi::CallbackInfo& info)
+        {
+            return Napi::Value::From(info.Env(), static_cast<double>(m_ring->DroppedFrames() + (m_staging.has_value() ? m_staging->DroppedFrames() : 0)));
+        }
+
+        // The size that frames are scaled to. A dimension that is not given follows the aspect ratio of the frame,
+        // rounded to even for YUV formats.
+        std::pair<uint32_t, uint32_t> GetOutputSize(uint32_t width, uint32_t height, bool yuv) const
+        {
+            const auto scaleDimension{[yuv](uint32_t dimension, uint32_t otherDimension, uint32_t otherTarget) {
+                const uint32_t scaled{std::max(static_cast<uint32_t>((static_cast<uint64_t>(dimension) * otherTarget + otherDimension / 2) / otherDimension), 1u)};
+                return yuv ? scaled + (scaled & 1) : scaled;
+            }};
+
+            return {
+                m_width != 0 ? m_width : m_height != 0 ? scaleDimension(width, height, m_height) : width,
+                m_height != 0 ? m_height : m_width != 0 ? scaleDimension(height, width, m_width) : height,
+            };
+        }
+
         void CaptureDataReceived(uint32_t width, uint32_t height, bgfx::TextureFormat::Enum format, bool yFlip, gsl::span<const uint8_t> data)
         {
-            std::vector<uint8_t> bytes{};
-            bytes.resize(data.size());
-            std::memcpy(bytes.data(), data.data(), data.size());
-            m_runtime.Dispatch([this, width, height, format, yFlip, bytes{std::move(bytes)}](Napi::Env env) mutable {
-                Napi::Object jsData = m_jsData.Value();
-                jsData.Set("width", static_cast<double>(width));
-                jsData.Set("height", static_cast<double>(height));
+            const FrameFormat sourceFormat{format == bgfx::TextureFormat::RGBA8 ? FrameFormat::RGBA8 : format == bgfx::TextureFormat::BGRA8 ? FrameFormat::BGRA8 : FrameFormat::Unknown};
+
+            // The recorder copies frames to its own buffers, and converts them to the format of its container and writes
+            // them on its own thread.
+            if (m_recorder.has_value() && height != 0)
+            {
+                const auto recordedSize{GetOutputSize(width, height, m_recorder->Format() == FrameFormat::I420)};
+                m_recorder->Record(data, width, height, static_cast<size_t>(data.size()) / height, sourceFormat, yFlip, recordedSize.first, recordedSize.second);
+            }
+
+            if (!m_deliverFrames)
+            {
+                return;
+            }
+
+            // Without conversion, the frame is copied once, to a buffer of the ring that JavaScript reads in place.
+            // Frames that JavaScript has no buffer for are dropped by the policy of the ring.
+            if (!m_staging.has_value())
+            {
+                if (m_ring->Write(width, height, sourceFormat, yFlip, data))
+                {
+                    m_runtime.Dispatch([this](Napi::Env env) {
+                        DeliverFrames(env);
+                    });
+                }
+
+                return;
+            }
+
+            // Otherwise the render thread only copies the frame to the staging ring, and the frame is scaled and
+            // converted to a buffer of the ring on a worker thread. A single conversion task runs at a time, so that
+            // frames are delivered in order, and frames that arrive faster than they are converted replace the oldest
+            // frame waiting in the staging ring.
+            m_staging->Write(width, height, sourceFormat, yFlip, data);
+
+            std::scoped_lock lock{m_conversionMutex};
+            if (!m_converting)
+            {
+                m_converting = true;
+                arcana::make_task(arcana::threadpool_scheduler, arcana::cancellation::none(), [this]() {
+                    ConvertFrames();
+                });
+            }
+        }
+
+        // Converts the frames of the staging ring to the ring, until the staging ring is empty. Called from a worker
+        // thread.
+        void ConvertFrames()
+        {
+            while (true)
+            {
+                std::optional<size_t> index{};
+                {
+                    std::scoped_lock lock{m_conversionMutex};
+                    index = m_staging->Take();
+                    if (!index.has_value())
+                    {
+                        m_converting = false;
+                        m_conversionCondition.notify_all();
+                        return;
+                    }
+                }
+
+                const auto& frame{m_staging->Get(*index)};
+                const gsl::span<const uint8_t> data{*frame.Data};
+
+                bool written{};
+                if (frame.Format == FrameFormat::Unknown || frame.Width == 0 || frame.Height == 0)
+                {
+                    written = m_ring->Write(frame.Width, frame.Height, frame.Format, frame.YFlip, data);
+                }
+                else
+                {
+                    const FrameFormat outputFormat{m_format == FrameFormat::Unknown ? frame.Format : m_format};
+                    const auto outputSize{GetOutputSize(frame.Width, frame.Height, outputFormat == FrameFormat::NV12 || outputFormat == FrameFormat::I420)};
+                    const uint32_t outputWidth{outputSize.first};
+                    const uint32_t outputHeight{outputSize.second};
+
+                    written = m_ring->Write(outputWidth, outputHeight, outputFormat, false, FrameConverter::GetSize(outputFormat, outputWidth, outputHeight), [&](gsl::span<uint8_t> destination) {
+                        FrameConverter::Convert(data, frame.Width, frame.Height, static_cast<size_t>(data.size()) / frame.Height, frame.Format, frame.YFlip, destination, outputWidth, outputHeight, outputFormat);
+                    });
+                }
+
+                m_staging->Release(*index, frame.Number);
+
+                if (written)
+                {
+                    m_runtime.Dispatch([this](Napi::Env env) {
+                        DeliverFrames(env);
+                    });
+                }
+            }
+        }
+
+        void DeliverFrames(Napi::Env env)
+        {
+            while (const auto index{m_ring->Take()})
+            {
+                const auto& frame{m_ring->Get(*index)};
+                auto& jsFrame{m_jsFrames[*index]};
+                jsFrame.Number = frame.Number;
+
+                // Without explicit release, JavaScript may keep the data of a frame for as long as it likes, so the
+                // frame is copied out and its buffer released right away.
+                Napi::ArrayBuffer data{};
+                if (!m_explicitRelease)
+                {
+                    data = Napi::ArrayBuffer::New(env, frame.Data->size());
+                    std::memcpy(data.Data(), frame.Data->data(), frame.Data->size());
+                }
+                else
+                {
+                    // The ArrayBuffer of a buffer is external and reused for as long as the buffer keeps its data. It
+                    // shares ownership of the data, which stays valid even if the ArrayBuffer outlives this object.
+                    if (jsFrame.Data != frame.Data.get())
+                    {
+                        jsFrame.Buffer = Napi::Persistent(Napi::ArrayBuffer::New(
+                            env, frame.Data->data(), frame.Data->size(),
+                            [](Napi::Env, void*, std::shared_ptr<std::vector<uint8_t>>* owner) { delete owner; },
+                            new std::shared_ptr<std::vector<uint8_t>>{frame.Data}));
+                        jsFrame.Data = frame.Data.get();
+                    }
+
+                    data = jsFrame.Buffer.Value();
+                }
+
+                // Each frame gets its own object, so that releasing a frame twice cannot release a later frame.
+                Napi::Object jsData = Napi::Object::New(env);
+                jsData.Set("width", static_cast<double>(frame.Width));
+                jsData.Set("height", static_cast<double>(frame.Height));
                 constexpr auto FORMAT_MEMBER_NAME = "format";
-                switch (format)
+                switch (frame.Format)
                 {
-                    case bgfx::TextureFormat::RGBA8:
+                    case FrameFormat::RGBA8:
                         jsData.Set(FORMAT_MEMBER_NAME, "RGBA8");
                         break;
-                    case bgfx::TextureFormat::BGRA8:
+                    case FrameFormat::BGRA8:
                         jsData.Set(FORMAT_MEMBER_NAME, "BGRA8");
                         break;
+                    case FrameFormat::NV12:
+                        jsData.Set(FORMAT_MEMBER_NAME, "NV12");
+                        break;
+                    case FrameFormat::I420:
+                        jsData.Set(FORMAT_MEMBER_NAME, "I420");
+                        break;
                     default:
                         jsData.Set(FORMAT_MEMBER_NAME, env.Undefined());
                         break;
                 }
-                jsData.Set("yFlip", yFlip);
+                jsData.Set("yFlip", frame.YFlip);
+                jsData.Set("frameNumber", static_cast<double>(frame.Number));
+                jsData.Set("data", data);
 
-                auto jsBytes = jsData.Get("data").As<Napi::ArrayBuffer>();
-                if (static_cast<size_t>(bytes.size()) != jsBytes.ByteLength())
+                const uint64_t number{frame.Number};
+                if (!m_explicitRelease || m_callbacks.empty())
                 {
-                    jsBytes = Napi::ArrayBuffer::New(env, bytes.size());
-                    jsData.Set("data", jsBytes);
+                    m_ring->Release(*index, number);
                 }
-                std::memcpy(jsBytes.Data(), bytes.data(), bytes.size());
-                bytes.clear();
 
                 for (const auto& callback : m_callbacks)
                 {
                     callback.Call({jsData});
                 }
-            });
+            }
         }
 
         void Dispose()
         {
             m_frameProviderTicket.reset();
             m_callbacks.clear();
+
+            // The conversion task refers to this object, so it must be done before this object goes away.
+            {
+                std::unique_lock lock{m_conversionMutex};
+                m_conversionCondition.wait(lock, [this]() { return !m_converting; });
+            }
+
+            // The writer thread finishes writing the queued frames, and is joined when this object is destroyed.
+            if (m_recorder.has_value())
+            {
+                m_recorder->Stop({});
+            }
         }
 
         void Dispose(const Napi::CallbackInfo&)
@@ -247,9 +707,47 @@ namespace Babylon::Plugins::Internal
             Dispose();
         }
 
+        // The ArrayBuffer of a buffer of the ring, and the number of the frame last handed to JavaScript from it.
+        struct JsFrame
+        {
+            Napi::Reference<Napi::ArrayBuffer> Buffer{};
+            const std::vector<uint8_t>* Data{};
+            uint64_t Number{std::numeric_limits<uint64_t>::max()};
+        };
+
+        // Three buffers let a frame be written while JavaScript holds the previous one and another one is pending.
+        static constexpr size_t DEFAULT_BUFFER_COUNT{3};
+
+        // One frame waits in the staging ring while the previous one is converted.
+        static constexpr size_t STAGING_BUFFER_COUNT{2};
+
+        // A few frames of slack absorb the occasional slow write without dropping frames.
+        static constexpr size_t DEFAULT_RECORDING_QUEUE_SIZE{4};
+        static constexpr uint32_t DEFAULT_RECORDING_FRAME_RATE{30};
+
         JsRuntime& m_runtime;
         std::vector<Napi::FunctionReference> m_callbacks{};
-        Napi::ObjectReference m_jsData{};
+        std::optional<CaptureRing> m_ring{};
+        std::vector<JsFrame> m_jsFrames{};
+        bool m_explicitRelease{};
+
+        // The size and format that frames are delivered in. A size of 0 keeps the size of the frames, or follows the
+        // aspect ratio of the frames when the other dimension is given, and an Unknown format keeps their format.
+        uint32_t m_width{};
+        uint32_t m_height{};
+        FrameFormat m_format{FrameFormat::Unknown};
+
+        // Frames that are scaled or converted are copied to the staging ring on the render thread, and converted by a
+        // task on a worker thread while m_converting is set.
+        std::optional<CaptureRing> m_staging{};
+        std::mutex m_conversionMutex{};
+        std::condition_variable m_conversionCondition{};
+        bool m_converting{};
+
+        // Frames are streamed to files when recording, and delivered to JavaScript unless only recorded.
+        std::optional<FrameRecorder> m_recorder{};
+        bool m_deliverFrames{true};
+
         std::optional<FrameProviderTicket> m_frameProviderTicket{};
     };
 }
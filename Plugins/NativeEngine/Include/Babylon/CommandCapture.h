@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+
+namespace Babylon
+{
+    namespace CommandCapture
+    {
+        // Enables journaling of the resources created by NativeEngine so that frames can be captured. This must be
+        // enabled before the resources used by the captured frames are created, typically at startup.
+        void Enabled(bool enabled);
+        bool Enabled();
+
+        // Writes the commands of the next frame, along with the resources they reference, to the given file.
+        // The capture can be replayed without the JavaScript that produced it using CommandReplay.
+        void CaptureNextFrame(std::string filePath);
+    };
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Babylon
+{
+    namespace CommandProfiler
+    {
+        struct CommandStats
+        {
+            const char* Name{};
+            uint32_t Count{};
+
+            // Number of calls that were filtered out because they would not have changed any state.
+            uint32_t Skipped{};
+
+            uint64_t TotalTimeNs{};
+            uint64_t MaxTimeNs{};
+            uint64_t Bytes{};
+        };
+
+        // Enables per-command instrumentation of the NativeEngine command stream. While enabled, the number of calls,
+        // the CPU time spent and the number of bytes read are recorded for every command of every frame.
+        void Enabled(bool enabled);
+        bool Enabled();
+
+        // Returns the statistics of the commands submitted during the last rendered frame, for the commands that were
+        // submitted at least once.
+        std::vector<CommandStats> GetLastFrameStats();
+    };
+}
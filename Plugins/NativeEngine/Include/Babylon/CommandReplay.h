@@ -0,0 +1,39 @@
+#pragma once
+#include <napi/env.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Babylon
+{
+    class CommandReplayImpl;
+
+    // Replays a frame captured with CommandCapture through the command handlers of a NativeEngine, without the
+    // JavaScript that produced it, so that the native side of a frame can be profiled in isolation.
+    class CommandReplay final
+    {
+    public:
+        // Creates the resources referenced by the capture with the given engine, an object created in JavaScript with
+        // `new _native.Engine()`. Texture contents are not captured, so textures are left uninitialized. Throws if the
+        // capture is invalid. Called on the JavaScript thread.
+        CommandReplay(Napi::Object engine, std::vector<uint32_t> capture);
+        ~CommandReplay();
+
+        CommandReplay(const CommandReplay&) = delete;
+        CommandReplay& operator=(const CommandReplay&) = delete;
+
+        // The size of the back buffer when the frame was captured.
+        uint32_t Width() const;
+        uint32_t Height() const;
+
+        // Submits the commands of the captured frame to the engine, along with the dynamic buffer updates made between
+        // them, and returns the number of commands submitted. Called on the JavaScript thread at most once per frame,
+        // while the update of the frame is running. Every replay starts with nothing bound to the engine.
+        size_t Run();
+
+    private:
+        std::unique_ptr<CommandReplayImpl> m_impl;
+    };
+}
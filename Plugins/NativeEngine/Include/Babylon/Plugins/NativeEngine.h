@@ -3,7 +3,71 @@
 #include <napi/env.h>
 #include <Babylon/Api.h>
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
 namespace Babylon::Plugins::NativeEngine
 {
+    // The GPU formats that the Basis Universal payloads of KTX2 containers are transcoded to, in the order in which
+    // they are preferred when the device supports them. BC3 and ETC2A are used for payloads with alpha, BC1 and ETC2
+    // for payloads without.
+    enum class TranscodeFormat
+    {
+        BC7,
+        BC3,
+        BC1,
+        ETC2A,
+        ETC2,
+        ASTC4x4,
+        RGBA8,
+    };
+
+    // Transcodes a mip level of a face of a KTX2 container with a Basis Universal payload (ETC1S or UASTC) to a
+    // format, writing the blocks of the image to a destination of exactly the size of the image in that format.
+    // Returns false if the payload cannot be transcoded. Called from worker threads, possibly concurrently.
+    using BasisTranscoder = std::function<bool(const uint8_t* container, size_t containerSize, uint32_t level, uint32_t face, TranscodeFormat format, uint8_t* destination, size_t destinationSize)>;
+
+    struct Options
+    {
+        // Encodes the draws of every command submission on worker threads, splitting them at view boundaries.
+        // This only pays off for scenes with many draws spread over several views (render targets, viewports).
+        bool ParallelEncoding{};
+
+        // Merges consecutive indexed draws of contiguous index ranges that share all their state into a single draw.
+        // This is ignored when ParallelEncoding is set.
+        bool DrawMerging{};
+
+        // Creates non-dynamic vertex and index buffers from the ArrayBuffers given by JavaScript instead of copies of
+        // them. The ArrayBuffers are kept alive until bgfx has uploaded them and must not be modified in the meantime.
+        bool ReferenceStaticGeometry{};
+
+        // Reorders the triangles of non-dynamic index buffers for the post-transform vertex cache on worker threads.
+        // This keeps a second copy of the indices on the GPU, used by draws of whole triangle lists.
+        bool VertexCacheOptimization{};
+
+        // Interleaves the static vertex buffers of a vertex array that were not uploaded yet into a single buffer when
+        // the vertex array is first drawn, so that their attributes are bound as a single vertex stream.
+        bool VertexInterleaving{};
+
+        // Keeps a copy of the indices of index buffers, from which indexed line loops and triangle fans are drawn
+        // with converted indices cached per index buffer.
+        bool TopologyConversion{};
+
+        // Transcodes the Basis Universal payloads of the KTX2 containers given to loadTexture and loadCubeTexture,
+        // typically with the KTX2 transcoder of Basis Universal. KTX2 containers in GPU formats are loaded without it.
+        BasisTranscoder Ktx2Transcoder{};
+    };
+
+    struct Statistics
+    {
+        // Bytes of index data saved by storing 32-bit indices whose values fit in 16 bits as 16-bit indices, over the
+        // index buffers currently alive.
+        uint64_t NarrowedIndexBytes{};
+    };
+
     void BABYLON_API Initialize(Napi::Env env);
+    void BABYLON_API Initialize(Napi::Env env, const Options& options);
+
+    Statistics BABYLON_API GetStatistics();
 }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CommandOpcodes.h"
+
+#include <cstdint>
+
+namespace Babylon
+{
+    // Layout of the files written by CommandCapture and replayed by CommandReplay.
+    //
+    // A capture is a sequence of little-endian uint32 words. It starts with COMMAND_CAPTURE_MAGIC and
+    // COMMAND_CAPTURE_VERSION, followed by records. Each record is a CaptureRecordType, the size of its payload in
+    // words, and the payload. Byte blobs are stored as a byte length followed by the bytes, padded to a multiple of 4.
+    // Object references are ids that are unique per object kind within a capture.
+    constexpr uint32_t COMMAND_CAPTURE_MAGIC{0x53434E42}; // "BNCS"
+    constexpr uint32_t COMMAND_CAPTURE_VERSION{2};
+    constexpr uint32_t COMMAND_CAPTURE_NO_OBJECT{0xFFFFFFFF};
+
+    enum class CaptureRecordType : uint32_t
+    {
+        // back buffer width, back buffer height
+        FrameInfo,
+
+        // id, flags, dynamic, bytes
+        IndexBuffer,
+
+        // id, dynamic, bytes
+        VertexBuffer,
+
+        // id, index buffer id, binding count, then for each binding:
+        // vertex buffer id, location, byte offset, byte stride, element count, attribute type, normalized, divisor
+        VertexArray,
+
+        // id, vertex shader bytes, fragment shader bytes
+        Program,
+
+        // id, stage, uniform type, element count, name bytes
+        Uniform,
+
+        // id, width, height, has mips, layer count, format, low flags, high flags, sampler flags
+        Texture,
+
+        // id, texture id, width, height, has stencil, has depth, samples
+        FrameBuffer,
+
+        // id, start index, bytes
+        IndexBufferUpdate,
+
+        // id, byte offset, bytes
+        VertexBufferUpdate,
+
+        // Commands in opcode encoding. Each command is its opcode, the number of words of its arguments, the number of
+        // object references among its arguments, the references as pairs of a word offset into the arguments and a
+        // CaptureObjectType, and finally the arguments, in which every native pointer is replaced by a single id word.
+        // References make it possible to replay commands without knowing the arguments of their handlers.
+        Commands,
+    };
+
+    // Kinds of native objects referenced by commands. Ids are unique per kind within a capture.
+    enum class CaptureObjectType : uint32_t
+    {
+        VertexArray,
+        IndexBuffer,
+        VertexBuffer,
+        Program,
+        Uniform,
+        Texture,
+        FrameBuffer,
+        Count,
+    };
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Babylon
+{
+    // Encodings of the command identifier that starts every command in the NativeEngine command stream.
+    enum class CommandEncoding : uint32_t
+    {
+        // Each command starts with a native member function pointer (16 bytes on Itanium ABIs, 8 bytes on MSVC x64).
+        FunctionPointer = 0,
+
+        // Each command starts with a single uint32 CommandOpcode dispatched through a jump table.
+        Opcode = 1,
+    };
+
+    // Version of the opcode table below, published to JavaScript as COMMAND_OPCODE_VERSION.
+    constexpr uint32_t COMMAND_OPCODE_VERSION{1};
+
+    // Dense command identifiers used by CommandEncoding::Opcode. These values are part of the JavaScript protocol:
+    // new commands must be appended right before Count and existing values must never change.
+    enum class CommandOpcode : uint32_t
+    {
+        DeleteVertexArray,
+        DeleteIndexBuffer,
+        DeleteVertexBuffer,
+        SetProgram,
+        DeleteProgram,
+        SetMatrices,
+        SetMatrix,
+        SetMatrix3x3,
+        SetMatrix2x2,
+        SetInt,
+        SetIntArray,
+        SetIntArray2,
+        SetIntArray3,
+        SetIntArray4,
+        SetFloatArray,
+        SetFloatArray2,
+        SetFloatArray3,
+        SetFloatArray4,
+        SetTextureSampling,
+        SetTextureWrapMode,
+        SetTextureAnisotropicLevel,
+        SetTexture,
+        UnsetTexture,
+        DiscardAllTextures,
+        BindVertexArray,
+        SetState,
+        SetZOffset,
+        SetZOffsetUnits,
+        SetDepthTest,
+        SetDepthWrite,
+        SetColorWrite,
+        SetBlendMode,
+        SetFloat,
+        SetFloat2,
+        SetFloat3,
+        SetFloat4,
+        BindFrameBuffer,
+        UnbindFrameBuffer,
+        DeleteFrameBuffer,
+        DrawIndexed,
+        DrawIndexedInstanced,
+        Draw,
+        DrawInstanced,
+        Clear,
+        SetStencil,
+        SetViewPort,
+        SetScissor,
+
+        Count
+    };
+
+    // Returns the name of a command, for diagnostics.
+    inline const char* GetCommandOpcodeName(CommandOpcode opcode)
+    {
+        switch (opcode)
+        {
+            case CommandOpcode::DeleteVertexArray:
+                return "DeleteVertexArray";
+            case CommandOpcode::DeleteIndexBuffer:
+                return "DeleteIndexBuffer";
+            case CommandOpcode::DeleteVertexBuffer:
+                return "DeleteVertexBuffer";
+            case CommandOpcode::SetProgram:
+                return "SetProgram";
+            case CommandOpcode::DeleteProgram:
+                return "DeleteProgram";
+            case CommandOpcode::SetMatrices:
+                return "SetMatrices";
+            case CommandOpcode::SetMatrix:
+                return "SetMatrix";
+            case CommandOpcode::SetMatrix3x3:
+                return "SetMatrix3x3";
+            case CommandOpcode::SetMatrix2x2:
+                return "SetMatrix2x2";
+            case CommandOpcode::SetInt:
+                return "SetInt";
+            case CommandOpcode::SetIntArray:
+                return "SetIntArray";
+            case CommandOpcode::SetIntArray2:
+                return "SetIntArray2";
+            case CommandOpcode::SetIntArray3:
+                return "SetIntArray3";
+            case CommandOpcode::SetIntArray4:
+                return "SetIntArray4";
+            case CommandOpcode::SetFloatArray:
+                return "SetFloatArray";
+            case CommandOpcode::SetFloatArray2:
+                return "SetFloatArray2";
+            case CommandOpcode::SetFloatArray3:
+                return "SetFloatArray3";
+            case CommandOpcode::SetFloatArray4:
+                return "SetFloatArray4";
+            case CommandOpcode::SetTextureSampling:
+                return "SetTextureSampling";
+            case CommandOpcode::SetTextureWrapMode:
+                return "SetTextureWrapMode";
+            case CommandOpcode::SetTextureAnisotropicLevel:
+                return "SetTextureAnisotropicLevel";
+            case CommandOpcode::SetTexture:
+                return "SetTexture";
+            case CommandOpcode::UnsetTexture:
+                return "UnsetTexture";
+            case CommandOpcode::DiscardAllTextures:
+                return "DiscardAllTextures";
+            case CommandOpcode::BindVertexArray:
+                return "BindVertexArray";
+            case CommandOpcode::SetState:
+                return "SetState";
+            case CommandOpcode::SetZOffset:
+                return "SetZOffset";
+            case CommandOpcode::SetZOffsetUnits:
+                return "SetZOffsetUnits";
+            case CommandOpcode::SetDepthTest:
+                return "SetDepthTest";
+            case CommandOpcode::SetDepthWrite:
+                return "SetDepthWrite";
+            case CommandOpcode::SetColorWrite:
+                return "SetColorWrite";
+            case CommandOpcode::SetBlendMode:
+                return "SetBlendMode";
+            case CommandOpcode::SetFloat:
+                return "SetFloat";
+            case CommandOpcode::SetFloat2:
+                return "SetFloat2";
+            case CommandOpcode::SetFloat3:
+                return "SetFloat3";
+            case CommandOpcode::SetFloat4:
+                return "SetFloat4";
+            case CommandOpcode::BindFrameBuffer:
+                return "BindFrameBuffer";
+            case CommandOpcode::UnbindFrameBuffer:
+                return "UnbindFrameBuffer";
+            case CommandOpcode::DeleteFrameBuffer:
+                return "DeleteFrameBuffer";
+            case CommandOpcode::DrawIndexed:
+                return "DrawIndexed";
+            case CommandOpcode::DrawIndexedInstanced:
+                return "DrawIndexedInstanced";
+            case CommandOpcode::Draw:
+                return "Draw";
+            case CommandOpcode::DrawInstanced:
+                return "DrawInstanced";
+            case CommandOpcode::Clear:
+                return "Clear";
+            case CommandOpcode::SetStencil:
+                return "SetStencil";
+            case CommandOpcode::SetViewPort:
+                return "SetViewPort";
+            case CommandOpcode::SetScissor:
+                return "SetScissor";
+            case CommandOpcode::Count:
+                break;
+        }
+
+        return "Unknown";
+    }
+}
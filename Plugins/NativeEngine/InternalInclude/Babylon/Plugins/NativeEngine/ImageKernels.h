@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Pixel transforms of the texture load path, vectorized with SSE2 or NEON where available and scalar otherwise.
+namespace Babylon::ImageKernels
+{
+    // The EXIF orientations of images, as reported by bimg. Each orientation names the transform that displays the
+    // stored pixels upright.
+    enum class Orientation
+    {
+        R0,
+        R90,
+        R180,
+        R270,
+        HFlip,
+        HFlipR90,
+        HFlipR270,
+        VFlip,
+    };
+
+    // Expands grayscale pixels to RGBA8 pixels whose color channels are the gray value. R8 pixels become opaque and
+    // RG8 pixels keep their second channel as alpha.
+    void ExpandR8ToRGBA8(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+    void ExpandRG8ToRGBA8(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+
+    // Reverses the order of the rows of an image in place.
+    void FlipRows(uint8_t* data, size_t rowPitch, uint32_t height);
+
+    // Writes the transpose of an image of 32-bit pixels, whose width is the height of the source, to a separate
+    // destination. The image is processed in tiles that fit in the L1 cache.
+    void Transpose(const uint32_t* source, uint32_t* destination, uint32_t width, uint32_t height);
+
+    // Writes an image of 32-bit pixels transformed by an orientation to a separate destination. The destination is
+    // height pixels wide and width pixels high for the orientations that rotate by 90 or 270 degrees.
+    void Reorient(const uint32_t* source, uint32_t* destination, uint32_t width, uint32_t height, Orientation orientation);
+
+    // Whether the orientation swaps the width and height of the image.
+    bool SwapsDimensions(Orientation orientation);
+}
@@ -0,0 +1,494 @@
+#pragma once
+
+#include <Babylon/JsRuntime.h>
+#include <napi/env.h>
+#include <gsl/gsl>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <typeinfo>
+#include <vector>
+
+namespace Babylon
+{
+    class NativeDataStream final : public Napi::ObjectWrap<NativeDataStream>
+    {
+        static constexpr auto JS_CLASS_NAME = "_NativeDataStream";
+        static constexpr auto JS_ENGINE_CONSTRUCTOR_NAME = "NativeDataStream";
+
+        static constexpr auto VALIDATION_ENABLED = false;
+
+        enum class ValidationType : uint32_t
+        {
+            Uint32,
+            Int32,
+            Float32,
+            Uint32Array,
+            Int32Array,
+            Float32Array,
+            NativeData,
+            Boolean,
+        };
+
+        template<ValidationType T, typename ReaderT>
+        static inline void Validate(ReaderT& reader)
+        {
+            if constexpr (VALIDATION_ENABLED)
+            {
+                uint32_t value{reader.template Read<uint32_t>()};
+                if (value != static_cast<uint32_t>(T))
+                {
+                    throw std::runtime_error{"Data stream validation error: data type mismatch."};
+                }
+            }
+        }
+
+    public:
+        class Reader final
+        {
+        public:
+            Reader(const Reader&) = delete;
+            Reader operator=(const Reader&) = delete;
+
+            bool CanRead()
+            {
+                assert(m_position <= static_cast<size_t>(m_segment.size()));
+                while (m_position == static_cast<size_t>(m_segment.size()) && NextSegment())
+                {
+                }
+
+                return m_position < static_cast<size_t>(m_segment.size());
+            }
+
+            uint32_t ReadUint32()
+            {
+                Validate<ValidationType::Uint32>(*this);
+                return Read<uint32_t>();
+            }
+
+            int32_t ReadInt32()
+            {
+                Validate<ValidationType::Int32>(*this);
+                return Read<int32_t>();
+            }
+
+            float ReadFloat32()
+            {
+                Validate<ValidationType::Float32>(*this);
+                return Read<float>();
+            }
+
+            gsl::span<uint32_t> ReadUint32Array()
+            {
+                Validate<ValidationType::Uint32Array>(*this);
+                return ReadArray<uint32_t>();
+            }
+
+            gsl::span<int32_t> ReadInt32Array()
+            {
+                Validate<ValidationType::Int32Array>(*this);
+                return ReadArray<int32_t>();
+            }
+
+            gsl::span<float> ReadFloat32Array()
+            {
+                Validate<ValidationType::Float32Array>(*this);
+                return ReadArray<float>();
+            }
+
+            template<typename T>
+            T ReadNativeData()
+            {
+                Validate<ValidationType::NativeData>(*this);
+                static_assert(sizeof(T) % 4 == 0);
+                return Read<T>();
+            }
+
+            template<typename T, class = typename std::enable_if<!std::is_pointer<T>::value>::type>
+            auto ReadPointer()
+            {
+                using PointerT = typename std::conditional<std::is_member_pointer<T>::value, T, T*>::type;
+                static_assert(sizeof(PointerT) % 4 == 0);
+
+                Validate<ValidationType::NativeData>(*this);
+                if (m_pointerListener != nullptr)
+                {
+                    (*m_pointerListener)(typeid(T));
+                }
+
+                return Read<PointerT>();
+            }
+
+            // Called with the type of every native object read with ReadPointer while set, right before the pointer is
+            // read, so that the object references of a command can be found without knowing its arguments.
+            using PointerListenerT = std::function<void(const std::type_info&)>;
+
+            void SetPointerListener(const PointerListenerT* listener)
+            {
+                m_pointerListener = listener;
+            }
+
+            struct Position
+            {
+                size_t Segment{};
+                size_t Offset{};
+            };
+
+            Position GetPosition() const
+            {
+                return {m_segmentIndex, m_position};
+            }
+
+            // Appends the raw words read between the given position and the current position.
+            void CopySince(Position start, std::vector<uint32_t>& destination) const
+            {
+                for (size_t segment = start.Segment; segment <= m_segmentIndex; ++segment)
+                {
+                    const auto data{m_segments[segment]};
+                    const size_t begin{segment == start.Segment ? start.Offset : 0};
+                    const size_t end{segment == m_segmentIndex ? m_position : static_cast<size_t>(data.size())};
+                    destination.insert(destination.end(), data.data() + begin, data.data() + end);
+                }
+            }
+
+            // Returns the number of words read between the given position and the current position.
+            size_t WordsSince(Position start) const
+            {
+                size_t words{};
+                for (size_t segment = start.Segment; segment <= m_segmentIndex; ++segment)
+                {
+                    const size_t begin{segment == start.Segment ? start.Offset : 0};
+                    const size_t end{segment == m_segmentIndex ? m_position : static_cast<size_t>(m_segments[segment].size())};
+                    words += end - begin;
+                }
+
+                return words;
+            }
+
+        private:
+            gsl::span<const gsl::span<uint32_t>> m_segments{};
+            size_t m_segmentIndex{0};
+            gsl::span<uint32_t> m_segment{};
+            size_t m_position{0};
+            std::vector<std::vector<uint32_t>> m_joinedArrays{};
+            const PointerListenerT* m_pointerListener{};
+            const gsl::final_action<std::function<void()>> m_scopeGuard;
+
+            friend class NativeDataStream;
+
+            template<typename CallableT>
+            Reader(gsl::span<const gsl::span<uint32_t>> segments, CallableT&& callable)
+                : m_segments{segments}
+                , m_segment{segments.empty() ? gsl::span<uint32_t>{} : segments[0]}
+                , m_scopeGuard{std::forward<CallableT>(callable)}
+            {
+            }
+
+            size_t Available() const
+            {
+                return static_cast<size_t>(m_segment.size()) - m_position;
+            }
+
+            bool NextSegment()
+            {
+                if (m_segmentIndex + 1 >= static_cast<size_t>(m_segments.size()))
+                {
+                    return false;
+                }
+
+                m_segment = m_segments[++m_segmentIndex];
+                m_position = 0;
+                return true;
+            }
+
+            // Slow path for values that straddle two segments. Segments are committed by JavaScript whenever a
+            // buffer fills up, which is not necessarily on a command boundary.
+            void ReadWords(uint32_t* destination, size_t count)
+            {
+                while (count > 0)
+                {
+                    if (Available() == 0 && !NextSegment())
+                    {
+                        throw std::runtime_error{"Data stream read past the end of the committed data."};
+                    }
+
+                    const size_t words{std::min(count, Available())};
+                    std::memcpy(destination, m_segment.data() + m_position, words * sizeof(uint32_t));
+                    m_position += words;
+                    destination += words;
+                    count -= words;
+                }
+            }
+
+            template<typename T>
+            T Read()
+            {
+                static_assert(sizeof(T) % 4 == 0);
+                constexpr size_t words{sizeof(T) / 4};
+
+                if (Available() >= words)
+                {
+                    T t{*reinterpret_cast<T*>(m_segment.data() + m_position)};
+                    m_position += words;
+                    return t;
+                }
+
+                std::array<uint32_t, words> data{};
+                ReadWords(data.data(), words);
+                T t{};
+                std::memcpy(&t, data.data(), sizeof(T));
+                return t;
+            }
+
+            template<typename T>
+            gsl::span<T> ReadArray()
+            {
+                static_assert(sizeof(T) % 4 == 0);
+
+                // The first 32 bit number is a length
+                uint32_t length = Read<uint32_t>();
+                const size_t words{length * (sizeof(T) / 4)};
+
+                if (Available() >= words)
+                {
+                    auto span = gsl::make_span<T>(reinterpret_cast<T*>(m_segment.data() + m_position), length);
+                    m_position += words;
+                    return span;
+                }
+
+                // The array was split across two segments, so join it into storage owned by the reader.
+                auto& joined = m_joinedArrays.emplace_back(words);
+                ReadWords(joined.data(), words);
+                return gsl::make_span<T>(reinterpret_cast<T*>(joined.data()), length);
+            }
+        };
+
+        static void Initialize(Napi::Env env)
+        {
+            Napi::HandleScope scope{env};
+            if constexpr (VALIDATION_ENABLED)
+            {
+                Napi::Function func = DefineClass(
+                    env,
+                    JS_CLASS_NAME,
+                    {
+                        InstanceMethod("writeBuffer", &NativeDataStream::WriteBuffer),
+                        InstanceMethod("getSharedBuffers", &NativeDataStream::GetSharedBuffers),
+                        InstanceMethod("acquireSharedBuffer", &NativeDataStream::AcquireSharedBuffer),
+                        InstanceMethod("commitSharedBuffer", &NativeDataStream::CommitSharedBuffer),
+
+                        StaticValue("VALIDATION_ENABLED", Napi::Boolean::From(env, VALIDATION_ENABLED)),
+                        StaticValue("VALIDATION_UINT_32", Napi::Number::From(env, static_cast<uint32_t>(ValidationType::Uint32))),
+                        StaticValue("VALIDATION_INT_32", Napi::Number::From(env, static_cast<uint32_t>(ValidationType::Int32))),
+                        StaticValue("VALIDATION_FLOAT_32", Napi::Number::From(env, static_cast<uint32_t>(ValidationType::Float32))),
+                        StaticValue("VALIDATION_UINT_32_ARRAY", Napi::Number::From(env, static_cast<uint32_t>(ValidationType::Uint32Array))),
+                        StaticValue("VALIDATION_INT_32_ARRAY", Napi::Number::From(env, static_cast<uint32_t>(ValidationType::Int32Array))),
+                        StaticValue("VALIDATION_FLOAT_32_ARRAY", Napi::Number::From(env, static_cast<uint32_t>(ValidationType::Float32Array))),
+                        StaticValue("VALIDATION_NATIVE_DATA", Napi::Number::From(env, static_cast<uint32_t>(ValidationType::NativeData))),
+                        StaticValue("VALIDATION_BOOLEAN", Napi::Number::From(env, static_cast<uint32_t>(ValidationType::Boolean))),
+                    });
+                JsRuntime::NativeObject::GetFromJavaScript(env).Set(JS_ENGINE_CONSTRUCTOR_NAME, func);
+            }
+            else
+            {
+                Napi::Function func = DefineClass(
+                    env,
+                    JS_CLASS_NAME,
+                    {
+                        InstanceMethod("writeBuffer", &NativeDataStream::WriteBuffer),
+                        InstanceMethod("getSharedBuffers", &NativeDataStream::GetSharedBuffers),
+                        InstanceMethod("acquireSharedBuffer", &NativeDataStream::AcquireSharedBuffer),
+                        InstanceMethod("commitSharedBuffer", &NativeDataStream::CommitSharedBuffer),
+                    });
+
+                JsRuntime::NativeObject::GetFromJavaScript(env).Set(JS_ENGINE_CONSTRUCTOR_NAME, func);
+            }
+        }
+
+        NativeDataStream(const Napi::CallbackInfo& info)
+            : Napi::ObjectWrap<NativeDataStream>(info)
+            , m_requestFlushCallback{Napi::Persistent(info[0].As<Napi::Function>())}
+        {
+        }
+
+        void WriteBuffer(const Napi::CallbackInfo& info)
+        {
+            assert(!m_locked); // Cannot write bytes while the stream is locked for reading.
+
+            const auto& buffer = info[0].As<Napi::ArrayBuffer>();
+            const auto& length = info[1].ToNumber().Uint32Value();
+
+            auto span = gsl::make_span(reinterpret_cast<uint32_t*>(buffer.Data()), static_cast<ptrdiff_t>(length));
+            AppendCopy(span);
+        }
+
+        // Allocates a ring of native-owned buffers that JavaScript writes commands into directly. Committed buffers are
+        // read in place by the command reader, which avoids copying the command data into m_buffer.
+        Napi::Value GetSharedBuffers(const Napi::CallbackInfo& info)
+        {
+            assert(!m_locked);
+
+            const auto count{info[0].As<Napi::Number>().Uint32Value()};
+            const auto byteLength{info[1].As<Napi::Number>().Uint32Value()};
+            if (count == 0 || byteLength < sizeof(uint32_t))
+            {
+                throw Napi::Error::New(info.Env(), "Shared command buffers require a non-zero count and byte length.");
+            }
+
+            // Existing segments may still reference the previous ring, so copy them out before replacing it.
+            for (size_t slot = 0; slot < m_sharedBuffers.size(); ++slot)
+            {
+                SpillSharedBuffer(slot);
+            }
+
+            m_sharedBuffers.clear();
+            m_sharedBufferSegments.assign(count, NO_SEGMENT);
+
+            auto jsBuffers{Napi::Array::New(info.Env(), count)};
+            for (uint32_t slot = 0; slot < count; ++slot)
+            {
+                auto& storage{m_sharedBuffers.emplace_back(std::make_shared<std::vector<uint32_t>>(byteLength / sizeof(uint32_t)))};
+
+                // The JavaScript buffer shares ownership of the storage so that it stays valid even if it outlives this stream.
+                auto jsBuffer{Napi::ArrayBuffer::New(
+                    info.Env(), storage->data(), storage->size() * sizeof(uint32_t),
+                    [](Napi::Env, void*, std::shared_ptr<std::vector<uint32_t>>* owner) { delete owner; },
+                    new std::shared_ptr<std::vector<uint32_t>>{storage})};
+
+                jsBuffers.Set(slot, jsBuffer);
+            }
+
+            return jsBuffers;
+        }
+
+        // Hands a shared buffer back to JavaScript for writing. It must be called before writing into a buffer that may
+        // have been committed since the last submit: the pending commands of the buffer are then copied out of the ring
+        // before JavaScript overwrites them. Buffers that have been read by a submit are handed back without a copy.
+        void AcquireSharedBuffer(const Napi::CallbackInfo& info)
+        {
+            assert(!m_locked);
+
+            const auto slot{info[0].As<Napi::Number>().Uint32Value()};
+            if (slot >= m_sharedBuffers.size())
+            {
+                throw Napi::Error::New(info.Env(), "Invalid shared command buffer.");
+            }
+
+            SpillSharedBuffer(slot);
+        }
+
+        // Marks the first `length` uint32 values of a shared buffer as ready to be read. The buffer must be acquired
+        // again before it is written to until the next submit, and committing a buffer that was not acquired again
+        // throws, since its pending commands may have been overwritten.
+        void CommitSharedBuffer(const Napi::CallbackInfo& info)
+        {
+            assert(!m_locked);
+
+            const auto slot{info[0].As<Napi::Number>().Uint32Value()};
+            const auto length{info[1].As<Napi::Number>().Uint32Value()};
+            if (slot >= m_sharedBuffers.size() || length > m_sharedBuffers[slot]->size())
+            {
+                throw Napi::Error::New(info.Env(), "Invalid shared command buffer commit.");
+            }
+
+            if (m_sharedBufferSegments[slot] != NO_SEGMENT)
+            {
+                throw Napi::Error::New(info.Env(), "Shared command buffer committed again without being acquired since the last commit.");
+            }
+
+            if (length == 0)
+            {
+                return;
+            }
+
+            m_sharedBufferSegments[slot] = m_segments.size();
+            m_segments.push_back({static_cast<int32_t>(slot), 0, length});
+        }
+
+        // Returns a reader of commands that do not come from JavaScript, such as the commands of a replayed capture.
+        // The segments must outlive the reader.
+        static Reader GetReader(gsl::span<const gsl::span<uint32_t>> segments)
+        {
+            return {segments, []() {}};
+        }
+
+        Reader GetReader()
+        {
+            assert(!m_locked);
+            m_requestFlushCallback.Call({});
+            m_locked = true;
+
+            m_readerSegments.clear();
+            for (const auto& segment : m_segments)
+            {
+                uint32_t* data{segment.SharedBuffer == COPIED_SEGMENT ? m_buffer.data() : m_sharedBuffers[segment.SharedBuffer]->data()};
+                m_readerSegments.push_back(gsl::make_span(data + segment.Offset, static_cast<ptrdiff_t>(segment.Length)));
+            }
+
+            return {m_readerSegments, [this]() {
+                        m_buffer.clear();
+                        m_segments.clear();
+                        m_sharedBufferSegments.assign(m_sharedBufferSegments.size(), NO_SEGMENT);
+                        m_locked = false;
+                    }};
+        }
+
+    private:
+        static constexpr int32_t COPIED_SEGMENT{-1};
+        static constexpr size_t NO_SEGMENT{std::numeric_limits<size_t>::max()};
+
+        // A run of command data, either copied into m_buffer or living in place in one of the shared buffers.
+        struct Segment
+        {
+            int32_t SharedBuffer{COPIED_SEGMENT};
+            size_t Offset{};
+            size_t Length{};
+        };
+
+        void AppendCopy(gsl::span<const uint32_t> data)
+        {
+            const size_t offset{m_buffer.size()};
+            m_buffer.insert(m_buffer.end(), data.begin(), data.end());
+
+            // Consecutive writes are merged so that the legacy path still produces a single segment.
+            if (!m_segments.empty() && m_segments.back().SharedBuffer == COPIED_SEGMENT && m_segments.back().Offset + m_segments.back().Length == offset)
+            {
+                m_segments.back().Length += static_cast<size_t>(data.size());
+            }
+            else
+            {
+                m_segments.push_back({COPIED_SEGMENT, offset, static_cast<size_t>(data.size())});
+            }
+        }
+
+        // Copies the pending commands of a committed shared buffer out of the ring so that JavaScript can write into it
+        // again.
+        void SpillSharedBuffer(size_t slot)
+        {
+            const size_t segmentIndex{m_sharedBufferSegments[slot]};
+            if (segmentIndex == NO_SEGMENT)
+            {
+                return;
+            }
+
+            auto& segment{m_segments[segmentIndex]};
+            const auto& storage{*m_sharedBuffers[slot]};
+            segment.SharedBuffer = COPIED_SEGMENT;
+            segment.Offset = m_buffer.size();
+            m_buffer.insert(m_buffer.end(), storage.begin(), storage.begin() + segment.Length);
+            m_sharedBufferSegments[slot] = NO_SEGMENT;
+        }
+
+        std::vector<uint32_t> m_buffer{};
+        std::vector<Segment> m_segments{};
+        std::vector<gsl::span<uint32_t>> m_readerSegments{};
+        std::vector<std::shared_ptr<std::vector<uint32_t>>> m_sharedBuffers{};
+        std::vector<size_t> m_sharedBufferSegments{};
+        Napi::FunctionReference m_requestFlushCallback{};
+        bool m_locked{false};
+    };
+}
@@ -0,0 +1,499 @@
+#include "CommandCapture.h"
+#include "NativeEngine.h"
+
+#include <Babylon/Graphics/FrameBuffer.h>
+#include <Babylon/Graphics/Texture.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t POINTER_WORDS{sizeof(void*) / sizeof(uint32_t)};
+
+    size_t BeginRecord(std::vector<uint32_t>& words, Babylon::CaptureRecordType type)
+    {
+        words.push_back(static_cast<uint32_t>(type));
+        words.push_back(0);
+        return words.size();
+    }
+
+    void EndRecord(std::vector<uint32_t>& words, size_t payloadStart)
+    {
+        words[payloadStart - 1] = static_cast<uint32_t>(words.size() - payloadStart);
+    }
+
+    void AppendBytes(std::vector<uint32_t>& words, gsl::span<const uint8_t> bytes)
+    {
+        words.push_back(static_cast<uint32_t>(bytes.size()));
+        const size_t start{words.size()};
+        words.resize(start + (static_cast<size_t>(bytes.size()) + 3) / 4);
+        if (!bytes.empty())
+        {
+            std::memcpy(words.data() + start, bytes.data(), bytes.size());
+        }
+    }
+
+    void WriteBytes(std::vector<uint8_t>& destination, gsl::span<const uint8_t> bytes, size_t byteOffset)
+    {
+        if (destination.size() < byteOffset + bytes.size())
+        {
+            destination.resize(byteOffset + bytes.size());
+        }
+
+        std::memcpy(destination.data() + byteOffset, bytes.data(), bytes.size());
+    }
+}
+
+namespace Babylon
+{
+    std::shared_ptr<CommandCaptureImpl> CommandCaptureImpl::GetImpl()
+    {
+        return std::atomic_load(&Instance);
+    }
+
+    std::optional<CaptureObjectType> CommandCaptureImpl::GetObjectType(const std::type_info& type)
+    {
+        if (type == typeid(VertexArray))
+        {
+            return CaptureObjectType::VertexArray;
+        }
+        else if (type == typeid(IndexBuffer))
+        {
+            return CaptureObjectType::IndexBuffer;
+        }
+        else if (type == typeid(VertexBuffer))
+        {
+            return CaptureObjectType::VertexBuffer;
+        }
+        else if (type == typeid(ProgramData))
+        {
+            return CaptureObjectType::Program;
+        }
+        else if (type == typeid(UniformInfo))
+        {
+            return CaptureObjectType::Uniform;
+        }
+        else if (type == typeid(Graphics::Texture))
+        {
+            return CaptureObjectType::Texture;
+        }
+        else if (type == typeid(Graphics::FrameBuffer))
+        {
+            return CaptureObjectType::FrameBuffer;
+        }
+
+        return {};
+    }
+
+    void CommandCaptureImpl::AddIndexBuffer(const IndexBuffer* indexBuffer, gsl::span<const uint8_t> bytes, uint16_t flags, bool dynamic)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_indexBuffers[indexBuffer] = {{bytes.begin(), bytes.end()}, flags, dynamic};
+    }
+
+    void CommandCaptureImpl::UpdateIndexBuffer(const IndexBuffer* indexBuffer, gsl::span<const uint8_t> bytes, uint32_t startIndex)
+    {
+        std::scoped_lock lock{m_mutex};
+        auto it{m_indexBuffers.find(indexBuffer)};
+        if (it == m_indexBuffers.end())
+        {
+            return;
+        }
+
+        // Updates to a buffer already referenced by the frame being captured are recorded in the frame, the initial
+        // contents of the buffer having been written when it was first referenced.
+        auto& ids{m_objectIds[static_cast<size_t>(CaptureObjectType::IndexBuffer)]};
+        const auto idIt{ids.find(indexBuffer)};
+        if (m_capturingFrame && idIt != ids.end())
+        {
+            CloseCommandsRecord();
+            const auto record{BeginRecord(m_frameRecords, CaptureRecordType::IndexBufferUpdate)};
+            m_frameRecords.push_back(idIt->second);
+            m_frameRecords.push_back(startIndex);
+            AppendBytes(m_frameRecords, bytes);
+            EndRecord(m_frameRecords, record);
+        }
+
+        const size_t indexSize{(it->second.Flags & BGFX_BUFFER_INDEX32) ? 4u : 2u};
+        WriteBytes(it->second.Bytes, bytes, startIndex * indexSize);
+    }
+
+    void CommandCaptureImpl::RemoveIndexBuffer(const IndexBuffer* indexBuffer)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_indexBuffers.erase(indexBuffer);
+        m_objectIds[static_cast<size_t>(CaptureObjectType::IndexBuffer)].erase(indexBuffer);
+    }
+
+    void CommandCaptureImpl::AddVertexBuffer(const VertexBuffer* vertexBuffer, gsl::span<const uint8_t> bytes, bool dynamic)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_vertexBuffers[vertexBuffer] = {{bytes.begin(), bytes.end()}, 0, dynamic};
+    }
+
+    void CommandCaptureImpl::UpdateVertexBuffer(const VertexBuffer* vertexBuffer, gsl::span<const uint8_t> bytes, uint32_t byteOffset)
+    {
+        std::scoped_lock lock{m_mutex};
+        auto it{m_vertexBuffers.find(vertexBuffer)};
+        if (it == m_vertexBuffers.end())
+        {
+            return;
+        }
+
+        auto& ids{m_objectIds[static_cast<size_t>(CaptureObjectType::VertexBuffer)]};
+        const auto idIt{ids.find(vertexBuffer)};
+        if (m_capturingFrame && idIt != ids.end())
+        {
+            CloseCommandsRecord();
+            const auto record{BeginRecord(m_frameRecords, CaptureRecordType::VertexBufferUpdate)};
+            m_frameRecords.push_back(idIt->second);
+            m_frameRecords.push_back(byteOffset);
+            AppendBytes(m_frameRecords, bytes);
+            EndRecord(m_frameRecords, record);
+        }
+
+        WriteBytes(it->second.Bytes, bytes, byteOffset);
+    }
+
+    void CommandCaptureImpl::RemoveVertexBuffer(const VertexBuffer* vertexBuffer)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_vertexBuffers.erase(vertexBuffer);
+        m_objectIds[static_cast<size_t>(CaptureObjectType::VertexBuffer)].erase(vertexBuffer);
+    }
+
+    void CommandCaptureImpl::RecordIndexBuffer(const VertexArray* vertexArray, const IndexBuffer* indexBuffer)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_vertexArrays[vertexArray].Indices = indexBuffer;
+    }
+
+    void CommandCaptureImpl::RecordVertexBuffer(const VertexArray* vertexArray, const VertexBuffer* vertexBuffer, uint32_t location, uint32_t byteOffset, uint32_t byteStride, uint32_t numElements, uint32_t type, bool normalized, uint32_t divisor)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_vertexArrays[vertexArray].Bindings.push_back({vertexBuffer, location, byteOffset, byteStride, numElements, type, normalized, divisor});
+    }
+
+    void CommandCaptureImpl::RemoveVertexArray(const VertexArray* vertexArray)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_vertexArrays.erase(vertexArray);
+        m_objectIds[static_cast<size_t>(CaptureObjectType::VertexArray)].erase(vertexArray);
+    }
+
+    void CommandCaptureImpl::AddProgram(bgfx::ProgramHandle handle, gsl::span<const uint8_t> vertexBytes, gsl::span<const uint8_t> fragmentBytes)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_programs[handle.idx] = {{vertexBytes.begin(), vertexBytes.end()}, {fragmentBytes.begin(), fragmentBytes.end()}};
+    }
+
+    void CommandCaptureImpl::AddFrameBuffer(const Graphics::FrameBuffer* frameBuffer, const Graphics::Texture* texture, uint16_t width, uint16_t height, bool hasStencil, bool hasDepth, uint32_t samples)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_frameBuffers[frameBuffer] = {texture, width, height, hasStencil, hasDepth, samples};
+    }
+
+    void CommandCaptureImpl::RemoveFrameBuffer(const Graphics::FrameBuffer* frameBuffer)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_frameBuffers.erase(frameBuffer);
+        m_objectIds[static_cast<size_t>(CaptureObjectType::FrameBuffer)].erase(frameBuffer);
+    }
+
+    void CommandCaptureImpl::RequestFrame(std::string filePath)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_requestedFilePath = std::move(filePath);
+    }
+
+    bool CommandCaptureImpl::BeginFrame(size_t width, size_t height)
+    {
+        std::scoped_lock lock{m_mutex};
+        if (m_capturingFrame || m_requestedFilePath.empty())
+        {
+            return false;
+        }
+
+        const auto filePath{std::move(m_requestedFilePath)};
+        m_requestedFilePath.clear();
+
+        m_file.open(filePath, std::ios::binary | std::ios::trunc);
+        if (!m_file)
+        {
+            throw std::runtime_error{"Failed to open command capture file " + filePath + "."};
+        }
+
+        for (auto& ids : m_objectIds)
+        {
+            ids.clear();
+        }
+
+        m_objectCounts = {};
+        m_resourceRecords.clear();
+        m_frameRecords.clear();
+        m_commandsRecordOpen = false;
+
+        const auto record{BeginRecord(m_resourceRecords, CaptureRecordType::FrameInfo)};
+        m_resourceRecords.push_back(static_cast<uint32_t>(width));
+        m_resourceRecords.push_back(static_cast<uint32_t>(height));
+        EndRecord(m_resourceRecords, record);
+
+        m_capturingFrame = true;
+        return true;
+    }
+
+    bool CommandCaptureImpl::IsCapturingFrame() const
+    {
+        return m_capturingFrame;
+    }
+
+    void CommandCaptureImpl::RecordCommand(CommandOpcode opcode, gsl::span<const uint32_t> arguments, gsl::span<const ObjectReference> references)
+    {
+        std::scoped_lock lock{m_mutex};
+        if (!m_capturingFrame)
+        {
+            return;
+        }
+
+        if (!m_commandsRecordOpen)
+        {
+            m_commandsRecordStart = BeginRecord(m_frameRecords, CaptureRecordType::Commands);
+            m_commandsRecordOpen = true;
+        }
+
+        // Every pointer becomes a single id word, which shifts the offsets of the words that follow it.
+        const size_t argumentCount{static_cast<size_t>(arguments.size()) - static_cast<size_t>(references.size()) * (POINTER_WORDS - 1)};
+        m_frameRecords.push_back(static_cast<uint32_t>(opcode));
+        m_frameRecords.push_back(static_cast<uint32_t>(argumentCount));
+        m_frameRecords.push_back(static_cast<uint32_t>(references.size()));
+        for (size_t index = 0; index < static_cast<size_t>(references.size()); ++index)
+        {
+            m_frameRecords.push_back(static_cast<uint32_t>(references[index].Offset - index * (POINTER_WORDS - 1)));
+            m_frameRecords.push_back(static_cast<uint32_t>(references[index].Type));
+        }
+
+        size_t position{};
+        for (const auto& reference : references)
+        {
+            if (reference.Offset < position || reference.Offset + POINTER_WORDS > static_cast<size_t>(arguments.size()))
+            {
+                throw std::runtime_error{"Command capture references do not match the command arguments."};
+            }
+
+            m_frameRecords.insert(m_frameRecords.end(), arguments.data() + position, arguments.data() + reference.Offset);
+
+            const void* object{};
+            std::memcpy(&object, arguments.data() + reference.Offset, sizeof(object));
+
+            // Resource records may be appended while looking up the id, which is fine since they are kept separate
+            // from the frame records.
+            m_frameRecords.push_back(GetObjectId(reference.Type, object));
+            position = reference.Offset + POINTER_WORDS;
+        }
+
+        m_frameRecords.insert(m_frameRecords.end(), arguments.data() + position, arguments.data() + arguments.size());
+    }
+
+    void CommandCaptureImpl::EndFrame()
+    {
+        std::scoped_lock lock{m_mutex};
+        if (!m_capturingFrame)
+        {
+            return;
+        }
+
+        CloseCommandsRecord();
+
+        const uint32_t header[]{COMMAND_CAPTURE_MAGIC, COMMAND_CAPTURE_VERSION};
+        m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        m_file.write(reinterpret_cast<const char*>(m_resourceRecords.data()), m_resourceRecords.size() * sizeof(uint32_t));
+        m_file.write(reinterpret_cast<const char*>(m_frameRecords.data()), m_frameRecords.size() * sizeof(uint32_t));
+        m_file.close();
+
+        for (auto& ids : m_objectIds)
+        {
+            ids.clear();
+        }
+
+        m_resourceRecords = {};
+        m_frameRecords = {};
+        m_capturingFrame = false;
+    }
+
+    uint32_t CommandCaptureImpl::GetObjectId(CaptureObjectType type, const void* object)
+    {
+        if (object == nullptr)
+        {
+            return COMMAND_CAPTURE_NO_OBJECT;
+        }
+
+        auto& ids{m_objectIds[static_cast<size_t>(type)]};
+        const auto it{ids.find(object)};
+        if (it != ids.end())
+        {
+            return it->second;
+        }
+
+        const auto id{m_objectCounts[static_cast<size_t>(type)]++};
+        ids.emplace(object, id);
+        WriteObjectRecord(type, id, object);
+        return id;
+    }
+
+    void CommandCaptureImpl::WriteObjectRecord(CaptureObjectType type, uint32_t id, const void* object)
+    {
+        switch (type)
+        {
+            case CaptureObjectType::IndexBuffer:
+            {
+                const auto it{m_indexBuffers.find(static_cast<const IndexBuffer*>(object))};
+                const BufferEntry empty{};
+                const auto& entry{it == m_indexBuffers.end() ? empty : it->second};
+
+                const auto record{BeginRecord(m_resourceRecords, CaptureRecordType::IndexBuffer)};
+                m_resourceRecords.push_back(id);
+                m_resourceRecords.push_back(entry.Flags);
+                m_resourceRecords.push_back(entry.Dynamic);
+                AppendBytes(m_resourceRecords, entry.Bytes);
+                EndRecord(m_resourceRecords, record);
+                break;
+            }
+            case CaptureObjectType::VertexBuffer:
+            {
+                const auto it{m_vertexBuffers.find(static_cast<const VertexBuffer*>(object))};
+                const BufferEntry empty{};
+                const auto& entry{it == m_vertexBuffers.end() ? empty : it->second};
+
+                const auto record{BeginRecord(m_resourceRecords, CaptureRecordType::VertexBuffer)};
+                m_resourceRecords.push_back(id);
+                m_resourceRecords.push_back(entry.Dynamic);
+                AppendBytes(m_resourceRecords, entry.Bytes);
+                EndRecord(m_resourceRecords, record);
+                break;
+            }
+            case CaptureObjectType::VertexArray:
+            {
+                const auto it{m_vertexArrays.find(static_cast<const VertexArray*>(object))};
+                const VertexArrayEntry empty{};
+                const auto& entry{it == m_vertexArrays.end() ? empty : it->second};
+
+                // Buffers are written before the vertex array that references them.
+                const auto indexBufferId{GetObjectId(CaptureObjectType::IndexBuffer, entry.Indices)};
+                std::vector<uint32_t> vertexBufferIds{};
+                for (const auto& binding : entry.Bindings)
+                {
+                    vertexBufferIds.push_back(GetObjectId(CaptureObjectType::VertexBuffer, binding.Buffer));
+                }
+
+                const auto record{BeginRecord(m_resourceRecords, CaptureRecordType::VertexArray)};
+                m_resourceRecords.push_back(id);
+                m_resourceRecords.push_back(indexBufferId);
+                m_resourceRecords.push_back(static_cast<uint32_t>(entry.Bindings.size()));
+                for (size_t index = 0; index < entry.Bindings.size(); ++index)
+                {
+                    const auto& binding{entry.Bindings[index]};
+                    m_resourceRecords.insert(m_resourceRecords.end(), {vertexBufferIds[index], binding.Location, binding.ByteOffset, binding.ByteStride, binding.NumElements, binding.Type, static_cast<uint32_t>(binding.Normalized), binding.Divisor});
+                }
+                EndRecord(m_resourceRecords, record);
+                break;
+            }
+            case CaptureObjectType::Program:
+            {
+                const auto& program{*static_cast<const ProgramData*>(object)};
+                const auto it{m_programs.find(program.Handle.idx)};
+                const ProgramEntry empty{};
+                const auto& entry{it == m_programs.end() || !bgfx::isValid(program.Handle) ? empty : it->second};
+
+                const auto record{BeginRecord(m_resourceRecords, CaptureRecordType::Program)};
+                m_resourceRecords.push_back(id);
+                AppendBytes(m_resourceRecords, entry.VertexBytes);
+                AppendBytes(m_resourceRecords, entry.FragmentBytes);
+                EndRecord(m_resourceRecords, record);
+                break;
+            }
+            case CaptureObjectType::Uniform:
+            {
+                const auto& uniform{*static_cast<const UniformInfo*>(object)};
+                bgfx::UniformInfo info{};
+                bgfx::getUniformInfo(uniform.Handle, info);
+                const std::string_view name{info.name};
+
+                const auto record{BeginRecord(m_resourceRecords, CaptureRecordType::Uniform)};
+                m_resourceRecords.push_back(id);
+                m_resourceRecords.push_back(uniform.Stage);
+                m_resourceRecords.push_back(static_cast<uint32_t>(info.type));
+                m_resourceRecords.push_back(static_cast<uint32_t>(uniform.MaxElementLength));
+                AppendBytes(m_resourceRecords, gsl::make_span(reinterpret_cast<const uint8_t*>(name.data()), name.size()));
+                EndRecord(m_resourceRecords, record);
+                break;
+            }
+            case CaptureObjectType::Texture:
+            {
+                const auto& texture{*static_cast<const Graphics::Texture*>(object)};
+
+                const auto record{BeginRecord(m_resourceRecords, CaptureRecordType::Texture)};
+                const auto flags{texture.Flags()};
+                m_resourceRecords.insert(m_resourceRecords.end(), {id, texture.Width(), texture.Height(), static_cast<uint32_t>(texture.HasMips()), texture.NumLayers(), static_cast<uint32_t>(texture.Format()), static_cast<uint32_t>(flags), static_cast<uint32_t>(flags >> 32), texture.SamplerFlags()});
+                EndRecord(m_resourceRecords, record);
+                break;
+            }
+            case CaptureObjectType::FrameBuffer:
+            {
+                const auto it{m_frameBuffers.find(static_cast<const Graphics::FrameBuffer*>(object))};
+                const FrameBufferEntry empty{};
+                const auto& entry{it == m_frameBuffers.end() ? empty : it->second};
+
+                const auto textureId{GetObjectId(CaptureObjectType::Texture, entry.ColorTexture)};
+
+                const auto record{BeginRecord(m_resourceRecords, CaptureRecordType::FrameBuffer)};
+                m_resourceRecords.insert(m_resourceRecords.end(), {id, textureId, entry.Width, entry.Height, static_cast<uint32_t>(entry.HasStencil), static_cast<uint32_t>(entry.HasDepth), entry.Samples});
+                EndRecord(m_resourceRecords, record);
+                break;
+            }
+            case CaptureObjectType::Count:
+                break;
+        }
+    }
+
+    void CommandCaptureImpl::CloseCommandsRecord()
+    {
+        if (m_commandsRecordOpen)
+        {
+            EndRecord(m_frameRecords, m_commandsRecordStart);
+            m_commandsRecordOpen = false;
+        }
+    }
+
+    namespace CommandCapture
+    {
+        void Enabled(bool enabled)
+        {
+            if (enabled && !CommandCaptureImpl::GetImpl())
+            {
+                std::atomic_store(&CommandCaptureImpl::Instance, std::make_shared<CommandCaptureImpl>());
+            }
+            else if (!enabled)
+            {
+                // Users of the capture keep it alive until they are done with it.
+                std::atomic_store(&CommandCaptureImpl::Instance, std::shared_ptr<CommandCaptureImpl>{});
+            }
+        }
+
+        bool Enabled()
+        {
+            return CommandCaptureImpl::GetImpl() != nullptr;
+        }
+
+        void CaptureNextFrame(std::string filePath)
+        {
+            auto impl{CommandCaptureImpl::GetImpl()};
+            if (!impl)
+            {
+                throw std::runtime_error{"Command capture must be enabled before capturing a frame."};
+            }
+
+            impl->RequestFrame(std::move(filePath));
+        }
+    }
+}
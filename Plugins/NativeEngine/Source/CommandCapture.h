@@ -0,0 +1,155 @@
+#pragma once
+#include <Babylon/CommandCapture.h>
+#include <Babylon/Plugins/NativeEngine/CommandCaptureFormat.h>
+
+#include <bgfx/bgfx.h>
+#include <gsl/gsl>
+
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace Babylon
+{
+    namespace Graphics
+    {
+        class FrameBuffer;
+        class Texture;
+    }
+
+    class IndexBuffer;
+    class VertexBuffer;
+    class VertexArray;
+
+    // Records frames of NativeEngine commands, along with the resources they reference, into the format described in
+    // CommandCaptureFormat.h. While enabled, it keeps a journal of the creation data of every resource, since the data
+    // is usually handed over to bgfx long before a frame is captured.
+    class CommandCaptureImpl
+    {
+    public:
+        CommandCaptureImpl() = default;
+        ~CommandCaptureImpl() = default;
+
+        // Returns the capture while enabled. Callers keep the returned reference for as long as they use the capture,
+        // since capture may be disabled on another thread in the meantime.
+        static std::shared_ptr<CommandCaptureImpl> GetImpl();
+
+        // A native pointer among the arguments of a command, at a word offset from the start of the arguments.
+        struct ObjectReference
+        {
+            size_t Offset{};
+            CaptureObjectType Type{};
+        };
+
+        // Returns the kind of a native object read by command handlers, if commands may reference it.
+        static std::optional<CaptureObjectType> GetObjectType(const std::type_info& type);
+
+        void AddIndexBuffer(const IndexBuffer* indexBuffer, gsl::span<const uint8_t> bytes, uint16_t flags, bool dynamic);
+        void UpdateIndexBuffer(const IndexBuffer* indexBuffer, gsl::span<const uint8_t> bytes, uint32_t startIndex);
+        void RemoveIndexBuffer(const IndexBuffer* indexBuffer);
+
+        void AddVertexBuffer(const VertexBuffer* vertexBuffer, gsl::span<const uint8_t> bytes, bool dynamic);
+        void UpdateVertexBuffer(const VertexBuffer* vertexBuffer, gsl::span<const uint8_t> bytes, uint32_t byteOffset);
+        void RemoveVertexBuffer(const VertexBuffer* vertexBuffer);
+
+        void RecordIndexBuffer(const VertexArray* vertexArray, const IndexBuffer* indexBuffer);
+        void RecordVertexBuffer(const VertexArray* vertexArray, const VertexBuffer* vertexBuffer, uint32_t location, uint32_t byteOffset, uint32_t byteStride, uint32_t numElements, uint32_t type, bool normalized, uint32_t divisor);
+        void RemoveVertexArray(const VertexArray* vertexArray);
+
+        void AddProgram(bgfx::ProgramHandle handle, gsl::span<const uint8_t> vertexBytes, gsl::span<const uint8_t> fragmentBytes);
+
+        void AddFrameBuffer(const Graphics::FrameBuffer* frameBuffer, const Graphics::Texture* texture, uint16_t width, uint16_t height, bool hasStencil, bool hasDepth, uint32_t samples);
+        void RemoveFrameBuffer(const Graphics::FrameBuffer* frameBuffer);
+
+        void RequestFrame(std::string filePath);
+
+        // Starts capturing if a frame was requested. Returns true if a new frame capture started, in which case the
+        // caller is responsible for calling EndFrame once the frame has been rendered.
+        bool BeginFrame(size_t width, size_t height);
+        bool IsCapturingFrame() const;
+
+        // Records a command given the raw words of its arguments, as read from the command stream, and the native
+        // pointers among them.
+        void RecordCommand(CommandOpcode opcode, gsl::span<const uint32_t> arguments, gsl::span<const ObjectReference> references);
+
+        void EndFrame();
+
+    private:
+        struct BufferEntry
+        {
+            std::vector<uint8_t> Bytes{};
+            uint16_t Flags{};
+            bool Dynamic{};
+        };
+
+        struct VertexBinding
+        {
+            const VertexBuffer* Buffer{};
+            uint32_t Location{};
+            uint32_t ByteOffset{};
+            uint32_t ByteStride{};
+            uint32_t NumElements{};
+            uint32_t Type{};
+            bool Normalized{};
+            uint32_t Divisor{};
+        };
+
+        struct VertexArrayEntry
+        {
+            const IndexBuffer* Indices{};
+            std::vector<VertexBinding> Bindings{};
+        };
+
+        struct ProgramEntry
+        {
+            std::vector<uint8_t> VertexBytes{};
+            std::vector<uint8_t> FragmentBytes{};
+        };
+
+        struct FrameBufferEntry
+        {
+            const Graphics::Texture* ColorTexture{};
+            uint16_t Width{};
+            uint16_t Height{};
+            bool HasStencil{};
+            bool HasDepth{};
+            uint32_t Samples{};
+        };
+
+        uint32_t GetObjectId(CaptureObjectType type, const void* object);
+        void WriteObjectRecord(CaptureObjectType type, uint32_t id, const void* object);
+        void CloseCommandsRecord();
+
+        std::mutex m_mutex{};
+
+        std::unordered_map<const IndexBuffer*, BufferEntry> m_indexBuffers{};
+        std::unordered_map<const VertexBuffer*, BufferEntry> m_vertexBuffers{};
+        std::unordered_map<const VertexArray*, VertexArrayEntry> m_vertexArrays{};
+        std::unordered_map<uint16_t, ProgramEntry> m_programs{};
+        std::unordered_map<const Graphics::FrameBuffer*, FrameBufferEntry> m_frameBuffers{};
+
+        std::string m_requestedFilePath{};
+        std::ofstream m_file{};
+        std::atomic<bool> m_capturingFrame{};
+
+        // Per object kind, the ids of the objects referenced by the frame being captured.
+        // Objects removed during the capture are forgotten so that a new object at the same address gets a new id.
+        static constexpr size_t OBJECT_TYPE_COUNT{static_cast<size_t>(CaptureObjectType::Count)};
+        std::array<std::unordered_map<const void*, uint32_t>, OBJECT_TYPE_COUNT> m_objectIds{};
+        std::array<uint32_t, OBJECT_TYPE_COUNT> m_objectCounts{};
+        std::vector<uint32_t> m_resourceRecords{};
+        std::vector<uint32_t> m_frameRecords{};
+        size_t m_commandsRecordStart{};
+        bool m_commandsRecordOpen{};
+
+        // Accessed with the atomic shared_ptr functions, so that disabling capture never frees it while in use.
+        static inline std::shared_ptr<CommandCaptureImpl> Instance{};
+        friend void CommandCapture::Enabled(bool enabled);
+    };
+}
@@ -0,0 +1,84 @@
+#include "CommandProfiler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace Babylon
+{
+    std::shared_ptr<CommandProfilerImpl> CommandProfilerImpl::GetImpl()
+    {
+        return std::atomic_load(&Instance);
+    }
+
+    bool CommandProfilerImpl::BeginFrame()
+    {
+        std::scoped_lock lock{m_mutex};
+        return !std::exchange(m_frameStarted, true);
+    }
+
+    void CommandProfilerImpl::AddCounters(const CommandCounters& counters)
+    {
+        std::scoped_lock lock{m_mutex};
+        for (size_t index = 0; index < counters.size(); ++index)
+        {
+            auto& frameCounter{m_currentFrame[index]};
+            const auto& counter{counters[index]};
+            frameCounter.Count += counter.Count;
+            frameCounter.Skipped += counter.Skipped;
+            frameCounter.TotalTimeNs += counter.TotalTimeNs;
+            frameCounter.MaxTimeNs = std::max(frameCounter.MaxTimeNs, counter.MaxTimeNs);
+            frameCounter.Bytes += counter.Bytes;
+        }
+    }
+
+    void CommandProfilerImpl::EndFrame()
+    {
+        std::scoped_lock lock{m_mutex};
+        m_lastFrame = m_currentFrame;
+        m_currentFrame = {};
+        m_frameStarted = false;
+    }
+
+    std::vector<CommandProfiler::CommandStats> CommandProfilerImpl::GetLastFrameStats() const
+    {
+        std::scoped_lock lock{m_mutex};
+
+        std::vector<CommandProfiler::CommandStats> stats{};
+        for (size_t index = 0; index < m_lastFrame.size(); ++index)
+        {
+            const auto& counter{m_lastFrame[index]};
+            if (counter.Count != 0)
+            {
+                stats.push_back({GetCommandOpcodeName(static_cast<CommandOpcode>(index)), counter.Count, counter.Skipped, counter.TotalTimeNs, counter.MaxTimeNs, counter.Bytes});
+            }
+        }
+
+        return stats;
+    }
+
+    namespace CommandProfiler
+    {
+        void Enabled(bool enabled)
+        {
+            if (enabled && !CommandProfilerImpl::GetImpl())
+            {
+                std::atomic_store(&CommandProfilerImpl::Instance, std::make_shared<CommandProfilerImpl>());
+            }
+            else if (!enabled)
+            {
+                std::atomic_store(&CommandProfilerImpl::Instance, std::shared_ptr<CommandProfilerImpl>{});
+            }
+        }
+
+        bool Enabled()
+        {
+            return CommandProfilerImpl::GetImpl() != nullptr;
+        }
+
+        std::vector<CommandStats> GetLastFrameStats()
+        {
+            auto impl{CommandProfilerImpl::GetImpl()};
+            return impl ? impl->GetLastFrameStats() : std::vector<CommandStats>{};
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <Babylon/CommandProfiler.h>
+#include <Babylon/Plugins/NativeEngine/CommandOpcodes.h>
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Babylon
+{
+    // Accumulates the per-command statistics of CommandProfiler. Commands are counted by NativeEngine into a
+    // CommandCounters array for each submission, which is then merged into the statistics of the current frame.
+    class CommandProfilerImpl
+    {
+    public:
+        struct CommandCounter
+        {
+            uint32_t Count{};
+            uint32_t Skipped{};
+            uint64_t TotalTimeNs{};
+            uint64_t MaxTimeNs{};
+            uint64_t Bytes{};
+        };
+
+        using CommandCounters = std::array<CommandCounter, static_cast<size_t>(CommandOpcode::Count)>;
+
+        CommandProfilerImpl() = default;
+        ~CommandProfilerImpl() = default;
+
+        // Returns the profiler while enabled. Callers keep the returned reference for as long as they use the profiler,
+        // since profiling may be disabled on another thread in the meantime.
+        static std::shared_ptr<CommandProfilerImpl> GetImpl();
+
+        // Returns true if this is the first submission of a frame, in which case the caller is responsible for calling
+        // EndFrame once the frame has been rendered.
+        bool BeginFrame();
+        void AddCounters(const CommandCounters& counters);
+        void EndFrame();
+
+        std::vector<CommandProfiler::CommandStats> GetLastFrameStats() const;
+
+    private:
+        mutable std::mutex m_mutex{};
+        CommandCounters m_currentFrame{};
+        CommandCounters m_lastFrame{};
+        bool m_frameStarted{};
+
+        // Accessed with the atomic shared_ptr functions, so that disabling profiling never frees it while in use.
+        static inline std::shared_ptr<CommandProfilerImpl> Instance{};
+        friend void CommandProfiler::Enabled(bool enabled);
+    };
+}
@@ -0,0 +1,551 @@
+#include <Babylon/CommandReplay.h>
+#include <Babylon/Plugins/NativeEngine/CommandCaptureFormat.h>
+#include "NativeEngine.h"
+
+#include <Babylon/Graphics/FrameBuffer.h>
+#include <Babylon/Graphics/Texture.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+    constexpr size_t POINTER_WORDS{sizeof(void*) / sizeof(uint32_t)};
+
+    class PayloadReader
+    {
+    public:
+        PayloadReader(const uint32_t* data, size_t size)
+            : m_data{data}
+            , m_size{size}
+        {
+        }
+
+        bool CanRead() const
+        {
+            return m_position < m_size;
+        }
+
+        const uint32_t* ReadWords(size_t count)
+        {
+            if (m_position + count > m_size)
+            {
+                throw std::runtime_error{"Unexpected end of capture record."};
+            }
+
+            const auto* words{m_data + m_position};
+            m_position += count;
+            return words;
+        }
+
+        uint32_t ReadUint32()
+        {
+            return *ReadWords(1);
+        }
+
+        gsl::span<const uint8_t> ReadBytes()
+        {
+            // The word count is computed in size_t, so that a length near 4 GiB cannot wrap around to a few words.
+            const auto length{ReadUint32()};
+            const auto* words{ReadWords((static_cast<size_t>(length) + 3) / 4)};
+            return gsl::make_span(reinterpret_cast<const uint8_t*>(words), length);
+        }
+
+    private:
+        const uint32_t* m_data{};
+        size_t m_size{};
+        size_t m_position{};
+    };
+
+    bool IsDeleteCommand(Babylon::CommandOpcode opcode)
+    {
+        using Babylon::CommandOpcode;
+        return opcode == CommandOpcode::DeleteVertexArray ||
+               opcode == CommandOpcode::DeleteIndexBuffer ||
+               opcode == CommandOpcode::DeleteVertexBuffer ||
+               opcode == CommandOpcode::DeleteProgram ||
+               opcode == CommandOpcode::DeleteFrameBuffer;
+    }
+
+    Babylon::NativeEngine& GetEngine(Napi::Object engine)
+    {
+        auto* nativeEngine{Babylon::NativeEngine::Unwrap(engine)};
+        if (nativeEngine == nullptr)
+        {
+            throw std::runtime_error{"Commands can only be replayed with an engine."};
+        }
+
+        return *nativeEngine;
+    }
+}
+
+namespace Babylon
+{
+    // Recreates the resources of a capture with the same classes as NativeEngine, and translates the captured commands
+    // back into the opcode encoding with pointers to these resources, so that replays run the engine's own handlers.
+    class CommandReplayImpl final
+    {
+    public:
+        CommandReplayImpl(Napi::Object engine, std::vector<uint32_t> capture);
+        ~CommandReplayImpl();
+
+        uint32_t Width() const
+        {
+            return m_width;
+        }
+
+        uint32_t Height() const
+        {
+            return m_height;
+        }
+
+        size_t Run();
+
+    private:
+        // A run of commands submitted at once, or an update of a dynamic buffer made between two submissions.
+        struct Step
+        {
+            std::vector<uint32_t> Commands{};
+            size_t CommandCount{};
+
+            IndexBuffer* UpdatedIndexBuffer{};
+            VertexBuffer* UpdatedVertexBuffer{};
+            uint32_t UpdateOffset{};
+            gsl::span<const uint8_t> UpdateBytes{};
+        };
+
+        void CreateUniform(PayloadReader& reader);
+        void CreateIndexBuffer(PayloadReader& reader);
+        void CreateVertexBuffer(PayloadReader& reader);
+        void CreateVertexArray(PayloadReader& reader);
+        void CreateProgram(PayloadReader& reader);
+        void CreateTexture(PayloadReader& reader);
+        void CreateFrameBuffer(PayloadReader& reader);
+        void AddCommands(PayloadReader& reader);
+        void AddUpdate(PayloadReader& reader, CaptureRecordType type);
+
+        void AddObject(CaptureObjectType type, uint32_t id, void* object);
+
+        template<typename T>
+        T* FindObject(CaptureObjectType type, uint32_t id) const
+        {
+            return static_cast<T*>(FindObject(type, id));
+        }
+
+        void* FindObject(CaptureObjectType type, uint32_t id) const;
+
+        // Unbinds the objects of the replay from the engine, which then never keeps pointers to them.
+        void ResetBindings();
+
+        Napi::ObjectReference m_engineReference;
+        NativeEngine& m_engine;
+
+        const std::vector<uint32_t> m_capture;
+        uint32_t m_width{};
+        uint32_t m_height{};
+
+        std::unordered_map<std::string, uint8_t> m_uniformStages{};
+        std::vector<std::unique_ptr<UniformInfo>> m_uniforms{};
+        std::vector<std::unique_ptr<Graphics::Texture>> m_textures{};
+        std::vector<std::unique_ptr<Graphics::FrameBuffer>> m_frameBuffers{};
+        std::vector<bgfx::TextureHandle> m_depthStencilTextures{};
+        std::vector<std::unique_ptr<ProgramData>> m_programs{};
+        std::vector<std::unique_ptr<IndexBuffer>> m_indexBuffers{};
+        std::vector<std::unique_ptr<VertexBuffer>> m_vertexBuffers{};
+        std::vector<std::unique_ptr<VertexArray>> m_vertexArrays{};
+        std::array<std::unordered_map<uint32_t, void*>, static_cast<size_t>(CaptureObjectType::Count)> m_objects{};
+
+        std::vector<Step> m_steps{};
+    };
+
+    CommandReplayImpl::CommandReplayImpl(Napi::Object engine, std::vector<uint32_t> capture)
+        : m_engineReference{Napi::Persistent(engine)}
+        , m_engine{GetEngine(engine)}
+        , m_capture{std::move(capture)}
+    {
+        if (m_capture.size() < 2 || m_capture[0] != COMMAND_CAPTURE_MAGIC)
+        {
+            throw std::runtime_error{"Not a command capture."};
+        }
+
+        if (m_capture[1] != COMMAND_CAPTURE_VERSION)
+        {
+            throw std::runtime_error{"Unsupported command capture version " + std::to_string(m_capture[1]) + "."};
+        }
+
+        struct Record
+        {
+            CaptureRecordType Type{};
+            const uint32_t* Data{};
+            size_t Size{};
+        };
+
+        std::vector<Record> records{};
+        for (size_t position = 2; position < m_capture.size();)
+        {
+            if (position + 2 > m_capture.size() || position + 2 + m_capture[position + 1] > m_capture.size())
+            {
+                throw std::runtime_error{"Truncated command capture."};
+            }
+
+            records.push_back({static_cast<CaptureRecordType>(m_capture[position]), m_capture.data() + position + 2, m_capture[position + 1]});
+            position += 2 + m_capture[position + 1];
+        }
+
+        // Programs are created with the stages of the uniforms, which may be recorded after them.
+        for (const auto& record : records)
+        {
+            if (record.Type == CaptureRecordType::Uniform)
+            {
+                PayloadReader reader{record.Data, record.Size};
+                CreateUniform(reader);
+            }
+        }
+
+        for (const auto& record : records)
+        {
+            PayloadReader reader{record.Data, record.Size};
+            switch (record.Type)
+            {
+                case CaptureRecordType::FrameInfo:
+                    m_width = reader.ReadUint32();
+                    m_height = reader.ReadUint32();
+                    break;
+                case CaptureRecordType::IndexBuffer:
+                    CreateIndexBuffer(reader);
+                    break;
+                case CaptureRecordType::VertexBuffer:
+                    CreateVertexBuffer(reader);
+                    break;
+                case CaptureRecordType::VertexArray:
+                    CreateVertexArray(reader);
+                    break;
+                case CaptureRecordType::Program:
+                    CreateProgram(reader);
+                    break;
+                case CaptureRecordType::Uniform:
+                    break;
+                case CaptureRecordType::Texture:
+                    CreateTexture(reader);
+                    break;
+                case CaptureRecordType::FrameBuffer:
+                    CreateFrameBuffer(reader);
+                    break;
+                case CaptureRecordType::IndexBufferUpdate:
+                case CaptureRecordType::VertexBufferUpdate:
+                    AddUpdate(reader, record.Type);
+                    break;
+                case CaptureRecordType::Commands:
+                    AddCommands(reader);
+                    break;
+                default:
+                    throw std::runtime_error{"Unknown command capture record " + std::to_string(static_cast<uint32_t>(record.Type)) + "."};
+            }
+        }
+    }
+
+    CommandReplayImpl::~CommandReplayImpl()
+    {
+        // Vertex arrays reference buffers, and frame buffers reference textures.
+        m_vertexArrays.clear();
+        m_vertexBuffers.clear();
+        m_indexBuffers.clear();
+        m_programs.clear();
+        m_frameBuffers.clear();
+
+        for (const auto handle : m_depthStencilTextures)
+        {
+            if (bgfx::isValid(handle))
+            {
+                bgfx::destroy(handle);
+            }
+        }
+
+        m_textures.clear();
+
+        for (const auto& uniform : m_uniforms)
+        {
+            bgfx::destroy(uniform->Handle);
+        }
+    }
+
+    size_t CommandReplayImpl::Run()
+    {
+        auto resetBindings{gsl::finally([this]() { ResetBindings(); })};
+
+        size_t commandCount{};
+        for (auto& step : m_steps)
+        {
+            if (step.UpdatedIndexBuffer != nullptr)
+            {
+                step.UpdatedIndexBuffer->Update(step.UpdateBytes, step.UpdateOffset);
+            }
+            else if (step.UpdatedVertexBuffer != nullptr)
+            {
+                step.UpdatedVertexBuffer->Update(step.UpdateBytes, step.UpdateOffset);
+            }
+            else
+            {
+                const gsl::span<uint32_t> segment{step.Commands};
+                NativeDataStream::Reader reader{NativeDataStream::GetReader(gsl::make_span(&segment, 1))};
+                m_engine.SubmitCommands(reader, CommandEncoding::Opcode);
+                commandCount += step.CommandCount;
+            }
+        }
+
+        return commandCount;
+    }
+
+    void CommandReplayImpl::CreateUniform(PayloadReader& reader)
+    {
+        const auto id{reader.ReadUint32()};
+        const auto stage{static_cast<uint8_t>(reader.ReadUint32())};
+        const auto type{static_cast<bgfx::UniformType::Enum>(reader.ReadUint32())};
+        const auto num{static_cast<uint16_t>(reader.ReadUint32())};
+        const auto nameBytes{reader.ReadBytes()};
+        const std::string name{nameBytes.begin(), nameBytes.end()};
+
+        // bgfx shares uniforms by name, so this is the handle that the shaders of the programs use.
+        m_uniformStages[name] = stage;
+        auto& uniform{m_uniforms.emplace_back(std::make_unique<UniformInfo>(stage, bgfx::createUniform(name.c_str(), type, num), num))};
+        AddObject(CaptureObjectType::Uniform, id, uniform.get());
+    }
+
+    void CommandReplayImpl::CreateIndexBuffer(PayloadReader& reader)
+    {
+        const auto id{reader.ReadUint32()};
+        const auto flags{static_cast<uint16_t>(reader.ReadUint32())};
+        const bool dynamic{reader.ReadUint32() != 0};
+        const auto bytes{reader.ReadBytes()};
+
+        auto& indexBuffer{m_indexBuffers.emplace_back(std::make_unique<IndexBuffer>(m_engine.m_deviceContext, bytes, flags, dynamic, m_engine.m_stagingRing, m_engine.m_topologyConversion))};
+        AddObject(CaptureObjectType::IndexBuffer, id, indexBuffer.get());
+    }
+
+    void CommandReplayImpl::CreateVertexBuffer(PayloadReader& reader)
+    {
+        const auto id{reader.ReadUint32()};
+        const bool dynamic{reader.ReadUint32() != 0};
+        const auto bytes{reader.ReadBytes()};
+
+        auto& vertexBuffer{m_vertexBuffers.emplace_back(std::make_unique<VertexBuffer>(m_engine.m_deviceContext, bytes, dynamic, m_engine.m_stagingRing))};
+        AddObject(CaptureObjectType::VertexBuffer, id, vertexBuffer.get());
+    }
+
+    void CommandReplayImpl::CreateVertexArray(PayloadReader& reader)
+    {
+        const auto id{reader.ReadUint32()};
+        auto& vertexArray{m_vertexArrays.emplace_back(std::make_unique<VertexArray>(m_engine.m_deviceContext, m_engine.m_vertexInterleaving))};
+        AddObject(CaptureObjectType::VertexArray, id, vertexArray.get());
+
+        if (auto* indexBuffer{FindObject<IndexBuffer>(CaptureObjectType::IndexBuffer, reader.ReadUint32())})
+        {
+            vertexArray->RecordIndexBuffer(indexBuffer);
+        }
+
+        const auto bindingCount{reader.ReadUint32()};
+        for (uint32_t index = 0; index < bindingCount; ++index)
+        {
+            auto* vertexBuffer{FindObject<VertexBuffer>(CaptureObjectType::VertexBuffer, reader.ReadUint32())};
+            const auto location{reader.ReadUint32()};
+            const auto byteOffset{reader.ReadUint32()};
+            const auto byteStride{reader.ReadUint32()};
+            const auto numElements{reader.ReadUint32()};
+            const auto type{reader.ReadUint32()};
+            const bool normalized{reader.ReadUint32() != 0};
+            const auto divisor{reader.ReadUint32()};
+
+            if (vertexBuffer != nullptr)
+            {
+                vertexArray->RecordVertexBuffer(vertexBuffer, location, byteOffset, byteStride, numElements, type, normalized, divisor);
+            }
+        }
+    }
+
+    void CommandReplayImpl::CreateProgram(PayloadReader& reader)
+    {
+        const auto id{reader.ReadUint32()};
+        const auto vertexBytes{reader.ReadBytes()};
+        const auto fragmentBytes{reader.ReadBytes()};
+
+        // Programs created before capture was enabled have no shaders. Their draws would be submitted without program,
+        // which bgfx skips, so the replay would not measure the frame that was captured.
+        if (vertexBytes.empty() || fragmentBytes.empty())
+        {
+            throw std::runtime_error{"The capture references a program created before capture was enabled. Enable capture before the scene creates its programs."};
+        }
+
+        ShaderCompiler::BgfxShaderInfo shaderInfo{};
+        shaderInfo.VertexBytes.assign(vertexBytes.begin(), vertexBytes.end());
+        shaderInfo.FragmentBytes.assign(fragmentBytes.begin(), fragmentBytes.end());
+        shaderInfo.UniformStages = m_uniformStages;
+        AddObject(CaptureObjectType::Program, id, m_programs.emplace_back(m_engine.CreateProgramInternal(shaderInfo)).get());
+    }
+
+    void CommandReplayImpl::CreateTexture(PayloadReader& reader)
+    {
+        const auto id{reader.ReadUint32()};
+        const auto width{static_cast<uint16_t>(reader.ReadUint32())};
+        const auto height{static_cast<uint16_t>(reader.ReadUint32())};
+        const bool hasMips{reader.ReadUint32() != 0};
+        const auto numLayers{static_cast<uint16_t>(reader.ReadUint32())};
+        const auto format{static_cast<bgfx::TextureFormat::Enum>(reader.ReadUint32())};
+        const uint64_t flagsLow{reader.ReadUint32()};
+        const uint64_t flagsHigh{reader.ReadUint32()};
+        const auto samplerFlags{reader.ReadUint32()};
+
+        auto& texture{m_textures.emplace_back(std::make_unique<Graphics::Texture>(m_engine.m_deviceContext))};
+        texture->Create2D(width, height, hasMips, std::max<uint16_t>(numLayers, 1), format, flagsLow | (flagsHigh << 32));
+        texture->SamplerFlags(samplerFlags);
+        AddObject(CaptureObjectType::Texture, id, texture.get());
+    }
+
+    void CommandReplayImpl::CreateFrameBuffer(PayloadReader& reader)
+    {
+        const auto id{reader.ReadUint32()};
+        auto* texture{FindObject<Graphics::Texture>(CaptureObjectType::Texture, reader.ReadUint32())};
+        const auto width{static_cast<uint16_t>(reader.ReadUint32())};
+        const auto height{static_cast<uint16_t>(reader.ReadUint32())};
+        const bool generateStencilBuffer{reader.ReadUint32() != 0};
+        const bool generateDepth{reader.ReadUint32() != 0};
+        const auto samples{reader.ReadUint32()};
+
+        bgfx::TextureHandle depthStencilTextureHandle{BGFX_INVALID_HANDLE};
+        auto& frameBuffer{m_frameBuffers.emplace_back(m_engine.CreateFrameBufferInternal(texture, width, height, generateStencilBuffer, generateDepth, samples, depthStencilTextureHandle))};
+        m_depthStencilTextures.push_back(depthStencilTextureHandle);
+        AddObject(CaptureObjectType::FrameBuffer, id, frameBuffer.get());
+    }
+
+    void CommandReplayImpl::AddCommands(PayloadReader& reader)
+    {
+        Step step{};
+        while (reader.CanRead())
+        {
+            const auto opcode{reader.ReadUint32()};
+            const auto argumentCount{reader.ReadUint32()};
+            const auto referenceCount{reader.ReadUint32()};
+            const auto* references{reader.ReadWords(referenceCount * 2)};
+            const auto* arguments{reader.ReadWords(argumentCount)};
+
+            if (opcode >= static_cast<uint32_t>(CommandOpcode::Count))
+            {
+                throw std::runtime_error{"Invalid command opcode " + std::to_string(opcode) + " in command capture."};
+            }
+
+            // Deleting resources would prevent replaying the frame more than once.
+            if (IsDeleteCommand(static_cast<CommandOpcode>(opcode)))
+            {
+                continue;
+            }
+
+            step.Commands.push_back(opcode);
+
+            uint32_t position{};
+            for (uint32_t index = 0; index < referenceCount; ++index)
+            {
+                const auto offset{references[index * 2]};
+                const auto type{references[index * 2 + 1]};
+                if (offset < position || offset >= argumentCount || type >= static_cast<uint32_t>(CaptureObjectType::Count))
+                {
+                    throw std::runtime_error{"Invalid object reference in command capture."};
+                }
+
+                step.Commands.insert(step.Commands.end(), arguments + position, arguments + offset);
+
+                const void* object{FindObject(static_cast<CaptureObjectType>(type), arguments[offset])};
+                const auto pointerStart{step.Commands.size()};
+                step.Commands.resize(pointerStart + POINTER_WORDS);
+                std::memcpy(step.Commands.data() + pointerStart, &object, sizeof(object));
+
+                position = offset + 1;
+            }
+
+            step.Commands.insert(step.Commands.end(), arguments + position, arguments + argumentCount);
+            ++step.CommandCount;
+        }
+
+        m_steps.push_back(std::move(step));
+    }
+
+    void CommandReplayImpl::AddUpdate(PayloadReader& reader, CaptureRecordType type)
+    {
+        Step step{};
+        const auto id{reader.ReadUint32()};
+        if (type == CaptureRecordType::IndexBufferUpdate)
+        {
+            step.UpdatedIndexBuffer = FindObject<IndexBuffer>(CaptureObjectType::IndexBuffer, id);
+        }
+        else
+        {
+            step.UpdatedVertexBuffer = FindObject<VertexBuffer>(CaptureObjectType::VertexBuffer, id);
+        }
+
+        step.UpdateOffset = reader.ReadUint32();
+        step.UpdateBytes = reader.ReadBytes();
+        m_steps.push_back(std::move(step));
+    }
+
+    void CommandReplayImpl::AddObject(CaptureObjectType type, uint32_t id, void* object)
+    {
+        if (!m_objects[static_cast<size_t>(type)].emplace(id, object).second)
+        {
+            throw std::runtime_error{"Duplicate object id " + std::to_string(id) + " in command capture."};
+        }
+    }
+
+    void* CommandReplayImpl::FindObject(CaptureObjectType type, uint32_t id) const
+    {
+        if (id == COMMAND_CAPTURE_NO_OBJECT)
+        {
+            return nullptr;
+        }
+
+        const auto& objects{m_objects[static_cast<size_t>(type)]};
+        const auto it{objects.find(id)};
+        if (it == objects.end())
+        {
+            throw std::runtime_error{"Unknown object id " + std::to_string(id) + " in command capture."};
+        }
+
+        return it->second;
+    }
+
+    void CommandReplayImpl::ResetBindings()
+    {
+        if (m_engine.m_boundFrameBuffer != nullptr && m_engine.m_boundFrameBuffer != &m_engine.m_defaultFrameBuffer)
+        {
+            m_engine.m_boundFrameBuffer->Unbind(*m_engine.GetUpdateToken().GetEncoder());
+            m_engine.m_boundFrameBuffer = nullptr;
+        }
+
+        m_engine.m_boundVertexArray = nullptr;
+        m_engine.m_currentProgram = nullptr;
+        m_engine.m_lastDrawProgram = nullptr;
+    }
+
+    CommandReplay::CommandReplay(Napi::Object engine, std::vector<uint32_t> capture)
+        : m_impl{std::make_unique<CommandReplayImpl>(engine, std::move(capture))}
+    {
+    }
+
+    CommandReplay::~CommandReplay() = default;
+
+    uint32_t CommandReplay::Width() const
+    {
+        return m_impl->Width();
+    }
+
+    uint32_t CommandReplay::Height() const
+    {
+        return m_impl->Height();
+    }
+
+    size_t CommandReplay::Run()
+    {
+        return m_impl->Run();
+    }
+}
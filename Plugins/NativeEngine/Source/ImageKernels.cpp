@@ -0,0 +1,293 @@
+#include <Babylon/Plugins/NativeEngine/ImageKernels.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_KERNELS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define IMAGE_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // Tiles of 32x32 pixels keep the source and destination rows of a tile in the L1 cache, 8KB in total.
+    constexpr uint32_t TILE_SIZE{32};
+
+#if defined(IMAGE_KERNELS_SSE2)
+    using Pixels = __m128i;
+
+    Pixels Load(const uint32_t* pixels)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+    }
+
+    void Store(uint32_t* pixels, Pixels value)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), value);
+    }
+
+    Pixels Reverse(Pixels value)
+    {
+        return _mm_shuffle_epi32(value, _MM_SHUFFLE(0, 1, 2, 3));
+    }
+
+    void Transpose(Pixels& row0, Pixels& row1, Pixels& row2, Pixels& row3)
+    {
+        const Pixels low01{_mm_unpacklo_epi32(row0, row1)};
+        const Pixels low23{_mm_unpacklo_epi32(row2, row3)};
+        const Pixels high01{_mm_unpackhi_epi32(row0, row1)};
+        const Pixels high23{_mm_unpackhi_epi32(row2, row3)};
+        row0 = _mm_unpacklo_epi64(low01, low23);
+        row1 = _mm_unpackhi_epi64(low01, low23);
+        row2 = _mm_unpacklo_epi64(high01, high23);
+        row3 = _mm_unpackhi_epi64(high01, high23);
+    }
+#elif defined(IMAGE_KERNELS_NEON)
+    using Pixels = uint32x4_t;
+
+    Pixels Load(const uint32_t* pixels)
+    {
+        return vld1q_u32(pixels);
+    }
+
+    void Store(uint32_t* pixels, Pixels value)
+    {
+        vst1q_u32(pixels, value);
+    }
+
+    Pixels Reverse(Pixels value)
+    {
+        const Pixels reversedPairs{vrev64q_u32(value)};
+        return vcombine_u32(vget_high_u32(reversedPairs), vget_low_u32(reversedPairs));
+    }
+
+    void Transpose(Pixels& row0, Pixels& row1, Pixels& row2, Pixels& row3)
+    {
+        const uint32x4x2_t rows01{vtrnq_u32(row0, row1)};
+        const uint32x4x2_t rows23{vtrnq_u32(row2, row3)};
+        row0 = vcombine_u32(vget_low_u32(rows01.val[0]), vget_low_u32(rows23.val[0]));
+        row1 = vcombine_u32(vget_low_u32(rows01.val[1]), vget_low_u32(rows23.val[1]));
+        row2 = vcombine_u32(vget_high_u32(rows01.val[0]), vget_high_u32(rows23.val[0]));
+        row3 = vcombine_u32(vget_high_u32(rows01.val[1]), vget_high_u32(rows23.val[1]));
+    }
+#endif
+
+    // Writes the pixels of an image to a destination whose rows are the columns of the source when transposing, and
+    // whose columns and rows are then reversed when mirroring in x and y respectively.
+    void Remap(const uint32_t* source, uint32_t* destination, uint32_t width, uint32_t height, bool transpose, bool mirrorX, bool mirrorY)
+    {
+        const uint32_t destinationWidth{transpose ? height : width};
+        const uint32_t destinationHeight{transpose ? width : height};
+
+        if (!transpose)
+        {
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                const uint32_t* sourceRow{source + static_cast<size_t>(y) * width};
+                uint32_t* destinationRow{destination + static_cast<size_t>(mirrorY ? height - 1 - y : y) * width};
+                if (!mirrorX)
+                {
+                    std::memcpy(destinationRow, sourceRow, width * sizeof(uint32_t));
+                    continue;
+                }
+
+                uint32_t x{0};
+#if defined(IMAGE_KERNELS_SSE2) || defined(IMAGE_KERNELS_NEON)
+                for (; x + 4 <= width; x += 4)
+                {
+                    Store(destinationRow + width - 4 - x, Reverse(Load(sourceRow + x)));
+                }
+#endif
+                for (; x < width; ++x)
+                {
+                    destinationRow[width - 1 - x] = sourceRow[x];
+                }
+            }
+
+            return;
+        }
+
+        const auto copyPixel{[=](uint32_t x, uint32_t y) {
+            const uint32_t destinationX{mirrorX ? destinationWidth - 1 - y : y};
+            const uint32_t destinationY{mirrorY ? destinationHeight - 1 - x : x};
+            destination[static_cast<size_t>(destinationY) * destinationWidth + destinationX] = source[static_cast<size_t>(y) * width + x];
+        }};
+
+        for (uint32_t tileY = 0; tileY < height; tileY += TILE_SIZE)
+        {
+            const uint32_t endY{std::min(tileY + TILE_SIZE, height)};
+            for (uint32_t tileX = 0; tileX < width; tileX += TILE_SIZE)
+            {
+                const uint32_t endX{std::min(tileX + TILE_SIZE, width)};
+
+                uint32_t y{tileY};
+#if defined(IMAGE_KERNELS_SSE2) || defined(IMAGE_KERNELS_NEON)
+                // Blocks of 4x4 pixels are transposed in registers, each source column becoming a destination row.
+                for (; y + 4 <= endY; y += 4)
+                {
+                    uint32_t x{tileX};
+                    for (; x + 4 <= endX; x += 4)
+                    {
+                        const uint32_t* block{source + static_cast<size_t>(y) * width + x};
+                        Pixels rows[4]{Load(block), Load(block + width), Load(block + 2 * width), Load(block + 3 * width)};
+                        Transpose(rows[0], rows[1], rows[2], rows[3]);
+
+                        const uint32_t destinationX{mirrorX ? destinationWidth - 4 - y : y};
+                        for (uint32_t row = 0; row < 4; ++row)
+                        {
+                            const uint32_t destinationY{mirrorY ? destinationHeight - 1 - (x + row) : x + row};
+                            Store(destination + static_cast<size_t>(destinationY) * destinationWidth + destinationX, mirrorX ? Reverse(rows[row]) : rows[row]);
+                        }
+                    }
+
+                    for (; x < endX; ++x)
+                    {
+                        for (uint32_t row = 0; row < 4; ++row)
+                        {
+                            copyPixel(x, y + row);
+                        }
+                    }
+                }
+#endif
+                for (; y < endY; ++y)
+                {
+                    for (uint32_t x = tileX; x < endX; ++x)
+                    {
+                        copyPixel(x, y);
+                    }
+                }
+            }
+        }
+    }
+}
+
+namespace Babylon::ImageKernels
+{
+    void ExpandR8ToRGBA8(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+    {
+        size_t index{0};
+#if defined(IMAGE_KERNELS_SSE2)
+        const __m128i opaque{_mm_set1_epi8(static_cast<char>(0xFF))};
+        for (; index + 16 <= pixelCount; index += 16)
+        {
+            const __m128i gray{_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index))};
+
+            // Pairs of gray values and pairs of gray and alpha values, interleaved into gray, gray, gray, alpha.
+            const __m128i grayGrayLow{_mm_unpacklo_epi8(gray, gray)};
+            const __m128i grayGrayHigh{_mm_unpackhi_epi8(gray, gray)};
+            const __m128i grayAlphaLow{_mm_unpacklo_epi8(gray, opaque)};
+            const __m128i grayAlphaHigh{_mm_unpackhi_epi8(gray, opaque)};
+
+            __m128i* pixels{reinterpret_cast<__m128i*>(destination + index * 4)};
+            _mm_storeu_si128(pixels, _mm_unpacklo_epi16(grayGrayLow, grayAlphaLow));
+            _mm_storeu_si128(pixels + 1, _mm_unpackhi_epi16(grayGrayLow, grayAlphaLow));
+            _mm_storeu_si128(pixels + 2, _mm_unpacklo_epi16(grayGrayHigh, grayAlphaHigh));
+            _mm_storeu_si128(pixels + 3, _mm_unpackhi_epi16(grayGrayHigh, grayAlphaHigh));
+        }
+#elif defined(IMAGE_KERNELS_NEON)
+        for (; index + 16 <= pixelCount; index += 16)
+        {
+            const uint8x16_t gray{vld1q_u8(source + index)};
+            vst4q_u8(destination + index * 4, uint8x16x4_t{{gray, gray, gray, vdupq_n_u8(0xFF)}});
+        }
+#endif
+        for (; index < pixelCount; ++index)
+        {
+            uint8_t* pixel{destination + index * 4};
+            pixel[0] = pixel[1] = pixel[2] = source[index];
+            pixel[3] = 0xFF;
+        }
+    }
+
+    void ExpandRG8ToRGBA8(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+    {
+        size_t index{0};
+#if defined(IMAGE_KERNELS_SSE2)
+        const __m128i grayMask{_mm_set1_epi16(0x00FF)};
+        for (; index + 8 <= pixelCount; index += 8)
+        {
+            // Each 16-bit lane holds the gray value in its low byte and the alpha value in its high byte.
+            const __m128i grayAlpha{_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index * 2))};
+            const __m128i gray{_mm_and_si128(grayAlpha, grayMask)};
+            const __m128i grayGray{_mm_or_si128(gray, _mm_slli_epi16(gray, 8))};
+
+            __m128i* pixels{reinterpret_cast<__m128i*>(destination + index * 4)};
+            _mm_storeu_si128(pixels, _mm_unpacklo_epi16(grayGray, grayAlpha));
+            _mm_storeu_si128(pixels + 1, _mm_unpackhi_epi16(grayGray, grayAlpha));
+        }
+#elif defined(IMAGE_KERNELS_NEON)
+        for (; index + 16 <= pixelCount; index += 16)
+        {
+            const uint8x16x2_t grayAlpha{vld2q_u8(source + index * 2)};
+            vst4q_u8(destination + index * 4, uint8x16x4_t{{grayAlpha.val[0], grayAlpha.val[0], grayAlpha.val[0], grayAlpha.val[1]}});
+        }
+#endif
+        for (; index < pixelCount; ++index)
+        {
+            uint8_t* pixel{destination + index * 4};
+            pixel[0] = pixel[1] = pixel[2] = source[index * 2];
+            pixel[3] = source[index * 2 + 1];
+        }
+    }
+
+    void FlipRows(uint8_t* data, size_t rowPitch, uint32_t height)
+    {
+        for (uint32_t row = 0; row < height / 2; ++row)
+        {
+            uint8_t* front{data + row * rowPitch};
+            uint8_t* back{data + (height - row - 1) * rowPitch};
+
+            size_t offset{0};
+#if defined(IMAGE_KERNELS_SSE2)
+            for (; offset + 16 <= rowPitch; offset += 16)
+            {
+                const __m128i frontBytes{_mm_loadu_si128(reinterpret_cast<const __m128i*>(front + offset))};
+                const __m128i backBytes{_mm_loadu_si128(reinterpret_cast<const __m128i*>(back + offset))};
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(front + offset), backBytes);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(back + offset), frontBytes);
+            }
+#elif defined(IMAGE_KERNELS_NEON)
+            for (; offset + 16 <= rowPitch; offset += 16)
+            {
+                const uint8x16_t frontBytes{vld1q_u8(front + offset)};
+                const uint8x16_t backBytes{vld1q_u8(back + offset)};
+                vst1q_u8(front + offset, backBytes);
+                vst1q_u8(back + offset, frontBytes);
+            }
+#endif
+            std::swap_ranges(front + offset, front + rowPitch, back + offset);
+        }
+    }
+
+    void Transpose(const uint32_t* source, uint32_t* destination, uint32_t width, uint32_t height)
+    {
+        Remap(source, destination, width, height, true, false, false);
+    }
+
+    void Reorient(const uint32_t* source, uint32_t* destination, uint32_t width, uint32_t height, Orientation orientation)
+    {
+        // clang-format off
+        switch (orientation)
+        {
+            case Orientation::R0:        std::memcpy(destination, source, static_cast<size_t>(width) * height * sizeof(uint32_t)); break;
+            case Orientation::R90:       Remap(source, destination, width, height, true, true, false); break;
+            case Orientation::R180:      Remap(source, destination, width, height, false, true, true); break;
+            case Orientation::R270:      Remap(source, destination, width, height, true, false, true); break;
+            case Orientation::HFlip:     Remap(source, destination, width, height, false, true, false); break;
+            case Orientation::HFlipR90:  Remap(source, destination, width, height, true, true, true); break;
+            case Orientation::HFlipR270: Remap(source, destination, width, height, true, false, false); break;
+            case Orientation::VFlip:     Remap(source, destination, width, height, false, false, true); break;
+            default: throw std::runtime_error{"Unexpected image orientation."};
+        }
+        // clang-format on
+    }
+
+    bool SwapsDimensions(Orientation orientation)
+    {
+        return orientation == Orientation::R90 || orientation == Orientation::R270 || orientation == Orientation::HFlipR90 || orientation == Orientation::HFlipR270;
+    }
+}
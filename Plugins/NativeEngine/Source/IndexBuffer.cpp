@@ -1,14 +1,66 @@
 #include "IndexBuffer.h"
 #include "Babylon/Graphics/DeviceContext.h"
 
+#include <algorithm>
+
+namespace
+{
+    // 0xFFFF is the primitive restart index of 16-bit indices on some backends, so it is never produced by narrowing.
+    constexpr uint32_t MAX_NARROWED_INDEX{0xFFFE};
+
+    bool CanNarrow(gsl::span<const uint8_t> bytes)
+    {
+        if (bytes.size() % sizeof(uint32_t) != 0)
+        {
+            return false;
+        }
+
+        uint32_t maxIndex{0};
+        for (size_t offset = 0; offset < static_cast<size_t>(bytes.size()); offset += sizeof(uint32_t))
+        {
+            uint32_t index;
+            std::memcpy(&index, bytes.data() + offset, sizeof(uint32_t));
+            maxIndex = std::max(maxIndex, index);
+        }
+
+        return maxIndex <= MAX_NARROWED_INDEX;
+    }
+
+    void Narrow(gsl::span<const uint8_t> bytes, uint16_t* destination)
+    {
+        for (size_t offset = 0; offset < static_cast<size_t>(bytes.size()); offset += sizeof(uint32_t))
+        {
+            uint32_t index;
+            std::memcpy(&index, bytes.data() + offset, sizeof(uint32_t));
+            *destination++ = static_cast<uint16_t>(index);
+        }
+    }
+
+    // Draws of ranges that change every frame would otherwise grow the conversions of a buffer indefinitely. Only
+    // conversions not used in the current frame are evicted, so a buffer drawn in more ranges per frame keeps them all.
+    constexpr size_t MAX_CONVERSIONS{16};
+}
+
 namespace Babylon
 {
-    IndexBuffer::IndexBuffer(Graphics::DeviceContext& deviceContext, gsl::span<const uint8_t> bytes, uint16_t flags, bool dynamic)
+    IndexBuffer::IndexBuffer(Graphics::DeviceContext& deviceContext, gsl::span<const uint8_t> bytes, uint16_t flags, bool dynamic, std::shared_ptr<StagingRing> stagingRing, bool retainIndices)
         : m_deviceContext{deviceContext}
         , m_deviceID{deviceContext.GetDeviceId()}
         , m_bytes{bytes.data(), bytes.data() + bytes.size()}
         , m_flags{flags}
         , m_dynamic{dynamic}
+        , m_stagingRing{std::move(stagingRing)}
+        , m_retainIndices{retainIndices}
+    {
+    }
+
+    IndexBuffer::IndexBuffer(Graphics::DeviceContext& deviceContext, std::unique_ptr<ReferencedBytes> bytes, uint16_t flags, bool retainIndices)
+        : m_deviceContext{deviceContext}
+        , m_deviceID{deviceContext.GetDeviceId()}
+        , m_referencedBytes{std::move(bytes)}
+        , m_flags{flags}
+        , m_dynamic{false}
+        , m_retainIndices{retainIndices}
     {
     }
 
@@ -36,12 +88,31 @@ namespace Babylon
             }
         }
 
+        if (bgfx::isValid(m_optimizedHandle) && m_deviceID == m_deviceContext.GetDeviceId())
+        {
+            bgfx::destroy(m_optimizedHandle);
+        }
+
+        ReleaseConversions();
+
+        if (!m_pendingUpdates.Empty())
+        {
+            m_stagingRing->Dequeue(this);
+            m_pendingUpdates.Discard(*m_stagingRing);
+        }
+
+        NarrowedBytesTotal -= m_narrowedBytes;
+        m_narrowedBytes = 0;
+
         m_bytes.clear();
+        m_referencedBytes.reset();
+        m_narrowedIndices.clear();
+        m_retainedBytes.clear();
 
         m_disposed = true;
     }
 
-    void IndexBuffer::Update(gsl::span<const uint8_t> bytes, uint32_t startIndex)
+    void IndexBuffer::Update(gsl::span<const uint8_t> bytes, uint32_t startIndex, bool discard)
     {
         if (!m_dynamic)
         {
@@ -50,13 +121,44 @@ namespace Babylon
 
         if (bgfx::isValid(m_dynamicHandle))
         {
-            bgfx::update(m_dynamicHandle, startIndex, bgfx::copy(bytes.data(), static_cast<uint32_t>(bytes.size())));
+            if (m_retainIndices)
+            {
+                const size_t byteOffset{startIndex * (m_flags & BGFX_BUFFER_INDEX32 ? sizeof(uint32_t) : sizeof(uint16_t))};
+                if (byteOffset + bytes.size() > m_retainedBytes.size())
+                {
+                    throw std::runtime_error{"Failed to update index buffer: buffer overflow"};
+                }
+
+                std::memcpy(m_retainedBytes.data() + byteOffset, bytes.data(), bytes.size());
+                ReleaseConversions();
+            }
+
+            if (m_narrowed)
+            {
+                const size_t count{static_cast<size_t>(bytes.size()) / sizeof(uint32_t)};
+                if (startIndex + count > m_narrowedIndices.size())
+                {
+                    throw std::runtime_error{"Failed to update index buffer: buffer overflow"};
+                }
+
+                if (!CanNarrow(bytes))
+                {
+                    Widen(bytes, startIndex);
+                    return;
+                }
+
+                uint16_t* indices{m_narrowedIndices.data() + startIndex};
+                Narrow(bytes, indices);
+                StageUpdate(gsl::make_span(reinterpret_cast<const uint8_t*>(indices), count * sizeof(uint16_t)), startIndex * sizeof(uint16_t), discard);
+            }
+            else
+            {
+                StageUpdate(bytes, startIndex * IndexSize(), discard);
+            }
         }
         else
         {
-            const size_t byteStride = (m_flags & BGFX_BUFFER_INDEX32) ? 4 : 2;
-            const size_t byteOffset = startIndex * byteStride;
-
+            const size_t byteOffset = startIndex * IndexSize();
             if (byteOffset + bytes.size() > m_bytes.size())
             {
                 throw std::runtime_error{"Failed to update index buffer: buffer overflow"};
@@ -70,20 +172,63 @@ namespace Babylon
     {
         if (!bgfx::isValid(m_handle))
         {
-            auto releaseFn = [](void*, void* userData) {
-                delete reinterpret_cast<decltype(m_bytes)*>(userData);
-            };
+            const gsl::span<const uint8_t> bytes{m_referencedBytes ? m_referencedBytes->Bytes() : gsl::span<const uint8_t>{m_bytes}};
+            if (m_retainIndices)
+            {
+                m_retainedBytes.assign(bytes.begin(), bytes.end());
+            }
+
+            m_narrowed = (m_flags & BGFX_BUFFER_INDEX32) && CanNarrow(bytes);
+
+            const bgfx::Memory* memory{};
+            if (m_narrowed)
+            {
+                const size_t count{static_cast<size_t>(bytes.size()) / sizeof(uint32_t)};
+                m_narrowedBytes = count * sizeof(uint16_t);
+                NarrowedBytesTotal += m_narrowedBytes;
+
+                if (m_dynamic)
+                {
+                    m_narrowedIndices.resize(count);
+                    Narrow(bytes, m_narrowedIndices.data());
+                    memory = bgfx::copy(m_narrowedIndices.data(), static_cast<uint32_t>(m_narrowedBytes));
+                }
+                else
+                {
+                    auto releaseFn = [](void*, void* userData) {
+                        delete reinterpret_cast<std::vector<uint16_t>*>(userData);
+                    };
+
+                    auto* indicesPtr = new std::vector<uint16_t>(count);
+                    Narrow(bytes, indicesPtr->data());
+                    memory = bgfx::makeRef(indicesPtr->data(), static_cast<uint32_t>(m_narrowedBytes), releaseFn, indicesPtr);
+                }
+
+                m_bytes = {};
+                m_referencedBytes.reset();
+            }
+            else if (m_referencedBytes)
+            {
+                memory = ReferencedBytes::MakeRef(std::move(m_referencedBytes));
+            }
+            else
+            {
+                auto releaseFn = [](void*, void* userData) {
+                    delete reinterpret_cast<decltype(m_bytes)*>(userData);
+                };
 
-            auto* bytesPtr = new decltype(m_bytes){std::move(m_bytes)};
-            const bgfx::Memory* memory = bgfx::makeRef(bytesPtr->data(), static_cast<uint32_t>(bytesPtr->size()), releaseFn, bytesPtr);
+                auto* bytesPtr = new decltype(m_bytes){std::move(m_bytes)};
+                memory = bgfx::makeRef(bytesPtr->data(), static_cast<uint32_t>(bytesPtr->size()), releaseFn, bytesPtr);
+            }
 
+            const uint16_t flags{static_cast<uint16_t>(m_narrowed ? m_flags & ~BGFX_BUFFER_INDEX32 : m_flags)};
             if (m_dynamic)
             {
-                m_dynamicHandle = bgfx::createDynamicIndexBuffer(memory, m_flags);
+                m_dynamicHandle = bgfx::createDynamicIndexBuffer(memory, flags);
             }
             else
             {
-                m_handle = bgfx::createIndexBuffer(memory, m_flags);
+                m_handle = bgfx::createIndexBuffer(memory, flags);
             }
 
             if (!bgfx::isValid(m_handle))
@@ -93,9 +238,202 @@ namespace Babylon
         }
     }
 
-    void IndexBuffer::Set(bgfx::Encoder* encoder, uint32_t firstIndex, uint32_t numIndices)
+    void IndexBuffer::FlushUpdates()
+    {
+        if (m_deviceID != m_deviceContext.GetDeviceId())
+        {
+            m_pendingUpdates.Discard(*m_stagingRing);
+            return;
+        }
+
+        m_pendingUpdates.Flush([this](size_t byteOffset, const StagingRing::Allocation& staging) {
+            bgfx::update(m_dynamicHandle, static_cast<uint32_t>(byteOffset / IndexSize()), m_stagingRing->MakeRef(staging));
+        });
+    }
+
+    void IndexBuffer::StageUpdate(gsl::span<const uint8_t> bytes, size_t byteOffset, bool discard)
+    {
+        const bool queued{!m_pendingUpdates.Empty()};
+        if (discard)
+        {
+            m_pendingUpdates.Discard(*m_stagingRing);
+        }
+
+        m_pendingUpdates.Add(*m_stagingRing, bytes, byteOffset);
+        if (!queued)
+        {
+            m_stagingRing->Enqueue(this, [this]() { FlushUpdates(); });
+        }
+    }
+
+    void IndexBuffer::Widen(gsl::span<const uint8_t> bytes, uint32_t startIndex)
+    {
+        // The narrowed copy includes the pending updates, which are replaced by the creation of a new 32-bit buffer.
+        std::vector<uint32_t> indices{m_narrowedIndices.begin(), m_narrowedIndices.end()};
+        std::memcpy(indices.data() + startIndex, bytes.data(), bytes.size());
+
+        if (!m_pendingUpdates.Empty())
+        {
+            m_stagingRing->Dequeue(this);
+            m_pendingUpdates.Discard(*m_stagingRing);
+        }
+
+        // Draws already encoded with the narrowed buffer remain valid since bgfx destroys it at the end of the frame.
+        bgfx::destroy(m_dynamicHandle);
+        m_dynamicHandle = bgfx::createDynamicIndexBuffer(bgfx::copy(indices.data(), static_cast<uint32_t>(indices.size() * sizeof(uint32_t))), m_flags);
+        if (!bgfx::isValid(m_dynamicHandle))
+        {
+            throw std::runtime_error{"Failed to create index buffer"};
+        }
+
+        NarrowedBytesTotal -= m_narrowedBytes;
+        m_narrowedBytes = 0;
+        m_narrowed = false;
+        m_narrowedIndices = {};
+    }
+
+    size_t IndexBuffer::IndexSize() const
+    {
+        return (m_flags & BGFX_BUFFER_INDEX32) && !m_narrowed ? 4 : 2;
+    }
+
+    uint64_t IndexBuffer::NarrowedBytes()
+    {
+        return NarrowedBytesTotal;
+    }
+
+    void IndexBuffer::SetOptimizedIndices(gsl::span<const uint32_t> indices)
+    {
+        if (m_disposed || m_dynamic || indices.empty() || bgfx::isValid(m_optimizedHandle) || m_deviceID != m_deviceContext.GetDeviceId())
+        {
+            return;
+        }
+
+        m_optimizedHandle = CreateHandle(indices);
+        m_optimizedCount = static_cast<uint32_t>(indices.size());
+    }
+
+    std::optional<TopologyConverter::Indices> IndexBuffer::Convert(TopologyConversion conversion, uint32_t firstIndex, uint32_t numIndices)
+    {
+        if (!m_retainIndices || m_disposed || m_deviceID != m_deviceContext.GetDeviceId())
+        {
+            return std::nullopt;
+        }
+
+        const uint32_t frameNumber{m_deviceContext.GetFrameNumber()};
+        const ConversionKey key{conversion, firstIndex, numIndices};
+        if (const auto it{m_conversions.find(key)}; it != m_conversions.end())
+        {
+            it->second.LastUsedFrame = frameNumber;
+            return TopologyConverter::Indices{it->second.Handle, it->second.Count};
+        }
+
+        const size_t indexSize{m_flags & BGFX_BUFFER_INDEX32 ? sizeof(uint32_t) : sizeof(uint16_t)};
+        if (static_cast<size_t>(firstIndex) + numIndices > m_retainedBytes.size() / indexSize)
+        {
+            return std::nullopt;
+        }
+
+        std::vector<uint32_t> indices(numIndices);
+        const uint8_t* source{m_retainedBytes.data() + firstIndex * indexSize};
+        if (indexSize == sizeof(uint32_t))
+        {
+            std::memcpy(indices.data(), source, numIndices * sizeof(uint32_t));
+        }
+        else
+        {
+            for (uint32_t index = 0; index < numIndices; ++index)
+            {
+                uint16_t value;
+                std::memcpy(&value, source + index * sizeof(uint16_t), sizeof(uint16_t));
+                indices[index] = value;
+            }
+        }
+
+        const std::vector<uint32_t> converted{TopologyConverter::Convert(conversion, indices)};
+
+        if (m_conversions.size() >= MAX_CONVERSIONS)
+        {
+            // Evict the least recently used conversion, unless all of them are used in this frame.
+            auto oldest{m_conversions.end()};
+            for (auto it = m_conversions.begin(); it != m_conversions.end(); ++it)
+            {
+                if (it->second.LastUsedFrame != frameNumber && (oldest == m_conversions.end() || frameNumber - it->second.LastUsedFrame > frameNumber - oldest->second.LastUsedFrame))
+                {
+                    oldest = it;
+                }
+            }
+
+            if (oldest != m_conversions.end())
+            {
+                if (bgfx::isValid(oldest->second.Handle))
+                {
+                    bgfx::destroy(oldest->second.Handle);
+                }
+
+                m_conversions.erase(oldest);
+            }
+        }
+
+        Conversion& entry{m_conversions[key]};
+        entry.LastUsedFrame = frameNumber;
+        entry.Count = static_cast<uint32_t>(converted.size());
+        if (!converted.empty())
+        {
+            entry.Handle = CreateHandle(converted);
+        }
+
+        return TopologyConverter::Indices{entry.Handle, entry.Count};
+    }
+
+    void IndexBuffer::ReleaseConversions()
+    {
+        if (m_deviceID == m_deviceContext.GetDeviceId())
+        {
+            for (const auto& [key, conversion] : m_conversions)
+            {
+                if (bgfx::isValid(conversion.Handle))
+                {
+                    bgfx::destroy(conversion.Handle);
+                }
+            }
+        }
+
+        m_conversions.clear();
+    }
+
+    bgfx::IndexBufferHandle IndexBuffer::CreateHandle(gsl::span<const uint32_t> indices)
     {
-        if (m_dynamic)
+        const bool is32Bits{!indices.empty() && *std::max_element(indices.begin(), indices.end()) > MAX_NARROWED_INDEX};
+        const bgfx::Memory* memory{};
+        if (is32Bits)
+        {
+            memory = bgfx::copy(indices.data(), static_cast<uint32_t>(indices.size() * sizeof(uint32_t)));
+        }
+        else
+        {
+            memory = bgfx::alloc(static_cast<uint32_t>(indices.size() * sizeof(uint16_t)));
+            std::transform(indices.begin(), indices.end(), reinterpret_cast<uint16_t*>(memory->data), [](uint32_t index) {
+                return static_cast<uint16_t>(index);
+            });
+        }
+
+        const bgfx::IndexBufferHandle handle{bgfx::createIndexBuffer(memory, is32Bits ? BGFX_BUFFER_INDEX32 : BGFX_BUFFER_NONE)};
+        if (!bgfx::isValid(handle))
+        {
+            throw std::runtime_error{"Failed to create index buffer"};
+        }
+
+        return handle;
+    }
+
+    void IndexBuffer::Set(bgfx::Encoder* encoder, uint32_t firstIndex, uint32_t numIndices, bool triangleList)
+    {
+        if (triangleList && firstIndex == 0 && numIndices == m_optimizedCount && bgfx::isValid(m_optimizedHandle))
+        {
+            encoder->setIndexBuffer(m_optimizedHandle, 0, numIndices);
+        }
+        else if (m_dynamic)
         {
             encoder->setIndexBuffer(m_dynamicHandle, firstIndex, numIndices);
         }
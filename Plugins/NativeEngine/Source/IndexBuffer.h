@@ -3,8 +3,15 @@
 #include <bgfx/bgfx.h>
 #include <napi/napi.h>
 #include <gsl/gsl>
+#include "ReferencedBytes.h"
+#include "StagingRing.h"
+#include "TopologyConverter.h"
 
+#include <atomic>
+#include <map>
 #include <optional>
+#include <tuple>
+#include <vector>
 
 namespace Babylon
 {
@@ -16,7 +23,12 @@ namespace Babylon
     class IndexBuffer final
     {
     public:
-        IndexBuffer(Graphics::DeviceContext& deviceContext, gsl::span<const uint8_t> bytes, uint16_t flags, bool dynamic);
+        // Buffers that retain their indices keep a copy of them once built, from which they can convert the indices
+        // of their draws, see Convert.
+        IndexBuffer(Graphics::DeviceContext& deviceContext, gsl::span<const uint8_t> bytes, uint16_t flags, bool dynamic, std::shared_ptr<StagingRing> stagingRing, bool retainIndices);
+
+        // Creates a non-dynamic index buffer that references the bytes instead of copying them.
+        IndexBuffer(Graphics::DeviceContext& deviceContext, std::unique_ptr<ReferencedBytes> bytes, uint16_t flags, bool retainIndices);
         ~IndexBuffer();
 
         // No copy or move semantics
@@ -25,26 +37,87 @@ namespace Babylon
 
         void Dispose();
 
-        void Update(gsl::span<const uint8_t> bytes, uint32_t startIndex);
+        // Once the buffer is built, updates are staged in the ring and applied when the ring is flushed. Discarding
+        // drops the updates still pending, for which the update provides new contents.
+        void Update(gsl::span<const uint8_t> bytes, uint32_t startIndex, bool discard = false);
 
         void Build();
 
-        void Set(bgfx::Encoder* encoder, uint32_t firstIndex, uint32_t numIndices);
+        // Sets the indices of a non-dynamic buffer reordered for the vertex cache, see IndexOptimizer. They are
+        // stored in an additional bgfx buffer, which is only used by triangle list draws of all the indices, since
+        // the triangles of partial ranges or other topologies must stay in their original order. The original buffer
+        // is kept for those draws, so the optimized indices double the GPU memory used by the buffer.
+        void SetOptimizedIndices(gsl::span<const uint32_t> indices);
+
+        // Converts the indices of a range of the buffer, if the buffer retains its indices. The converted indices
+        // are stored in an additional bgfx buffer, which is kept until the buffer is updated. Returns the converted
+        // indices, whose handle is invalid if they have no primitives, or std::nullopt if the indices cannot be
+        // converted. The handle can be used until the end of the frame even if the conversion is released in the
+        // meantime, since bgfx destroys buffers at the end of the frame.
+        std::optional<TopologyConverter::Indices> Convert(TopologyConversion conversion, uint32_t firstIndex, uint32_t numIndices);
+
+        void Set(bgfx::Encoder* encoder, uint32_t firstIndex, uint32_t numIndices, bool triangleList);
+
+        // Creates a static bgfx index buffer of the given indices, stored as 16-bit indices if they fit.
+        static bgfx::IndexBufferHandle CreateHandle(gsl::span<const uint32_t> indices);
+
+        // The number of bytes saved by narrowing 32-bit indices to 16 bits, over all the index buffers alive.
+        static uint64_t NarrowedBytes();
 
     private:
+        void FlushUpdates();
+        void StageUpdate(gsl::span<const uint8_t> bytes, size_t byteOffset, bool discard);
+        void Widen(gsl::span<const uint8_t> bytes, uint32_t startIndex);
+        void ReleaseConversions();
+
+        // The size of the indices as stored by bgfx, which is also the size of the indices given by JavaScript
+        // unless the buffer was narrowed.
+        size_t IndexSize() const;
+
         Graphics::DeviceContext& m_deviceContext;
         const uintptr_t m_deviceID{};
 
         std::vector<uint8_t> m_bytes{};
+        std::unique_ptr<ReferencedBytes> m_referencedBytes{};
         const uint16_t m_flags{};
         const bool m_dynamic{};
 
+        const std::shared_ptr<StagingRing> m_stagingRing{};
+        PendingUpdates m_pendingUpdates{};
+
+        // Set when the 32-bit indices given by JavaScript are stored as 16-bit indices. Dynamic buffers keep a copy
+        // of their narrowed indices, in case an update does not fit in 16 bits and the buffer needs to be widened.
+        bool m_narrowed{};
+        size_t m_narrowedBytes{};
+        std::vector<uint16_t> m_narrowedIndices{};
+
         union
         {
             bgfx::IndexBufferHandle m_handle{bgfx::kInvalidHandle};
             bgfx::DynamicIndexBufferHandle m_dynamicHandle;
         };
 
+        bgfx::IndexBufferHandle m_optimizedHandle{bgfx::kInvalidHandle};
+        uint32_t m_optimizedCount{};
+
+        // The indices in the format given by JavaScript, kept once the buffer is built when it retains its indices,
+        // and the conversions of ranges of them, by conversion and range. Fans and line loops depend on where the
+        // range starts and ends, so ranges are converted separately rather than as part of the whole buffer.
+        struct Conversion
+        {
+            bgfx::IndexBufferHandle Handle{bgfx::kInvalidHandle};
+            uint32_t Count{};
+            uint32_t LastUsedFrame{};
+        };
+
+        using ConversionKey = std::tuple<TopologyConversion, uint32_t, uint32_t>;
+
+        const bool m_retainIndices{};
+        std::vector<uint8_t> m_retainedBytes{};
+        std::map<ConversionKey, Conversion> m_conversions{};
+
         bool m_disposed{};
+
+        static inline std::atomic<uint64_t> NarrowedBytesTotal{};
     };
 }
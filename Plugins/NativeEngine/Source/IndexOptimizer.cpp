@@ -0,0 +1,274 @@
+#include "IndexOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+namespace
+{
+    // Cached results are evicted, least recently used first, beyond this size.
+    constexpr size_t MAX_CACHE_SIZE{64 * 1024 * 1024};
+
+    // Parameters of the scoring function, as tuned by the original algorithm.
+    constexpr size_t CACHE_SIZE{32};
+    constexpr float CACHE_DECAY_POWER{1.5f};
+    constexpr float LAST_TRIANGLE_SCORE{0.75f};
+    constexpr float VALENCE_BOOST_SCALE{2.0f};
+    constexpr float VALENCE_BOOST_POWER{0.5f};
+    constexpr uint32_t MAX_VALENCE{64};
+
+    struct ScoreTable
+    {
+        ScoreTable()
+        {
+            for (size_t position = 0; position < CACHE_SIZE; ++position)
+            {
+                // The vertices of the last triangle get a fixed score, so that the next triangle does not simply
+                // reuse the same edge in a strip-like order.
+                CacheScores[position] = position < 3 ? LAST_TRIANGLE_SCORE : std::pow(1.0f - static_cast<float>(position - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+
+            for (uint32_t valence = 1; valence < MAX_VALENCE; ++valence)
+            {
+                // Vertices with few triangles left are boosted, so that they leave the cache for good sooner.
+                ValenceScores[valence] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(valence), -VALENCE_BOOST_POWER);
+            }
+        }
+
+        float VertexScore(int32_t cachePosition, uint32_t remainingTriangles) const
+        {
+            if (remainingTriangles == 0)
+            {
+                return -1.0f;
+            }
+
+            const float cacheScore{cachePosition < 0 ? 0.0f : CacheScores[cachePosition]};
+            return cacheScore + ValenceScores[std::min(remainingTriangles, MAX_VALENCE - 1)];
+        }
+
+        std::array<float, CACHE_SIZE> CacheScores{};
+        std::array<float, MAX_VALENCE> ValenceScores{};
+    };
+}
+
+namespace Babylon
+{
+    std::shared_ptr<const std::vector<uint32_t>> IndexOptimizer::Optimize(std::vector<uint8_t> bytes, bool is32Bits)
+    {
+        // The hash only selects the entry, whose indices are compared to make sure that the result is theirs.
+        const Key key{std::hash<std::string_view>{}(std::string_view{reinterpret_cast<const char*>(bytes.data()), bytes.size()}), bytes.size(), is32Bits};
+
+        {
+            std::scoped_lock lock{s_mutex};
+            const auto it{s_entriesByKey.find(key)};
+            if (it != s_entriesByKey.end() && it->second->Bytes == bytes)
+            {
+                s_entries.splice(s_entries.begin(), s_entries, it->second);
+                return it->second->Indices;
+            }
+        }
+
+        const size_t indexSize{is32Bits ? sizeof(uint32_t) : sizeof(uint16_t)};
+        auto indices{std::make_shared<std::vector<uint32_t>>(bytes.size() / indexSize)};
+        for (size_t index = 0; index < indices->size(); ++index)
+        {
+            if (is32Bits)
+            {
+                std::memcpy(&(*indices)[index], bytes.data() + index * sizeof(uint32_t), sizeof(uint32_t));
+            }
+            else
+            {
+                uint16_t value;
+                std::memcpy(&value, bytes.data() + index * sizeof(uint16_t), sizeof(uint16_t));
+                (*indices)[index] = value;
+            }
+        }
+
+        if (!OptimizeTriangles(*indices))
+        {
+            // Remember that the indices cannot be optimized, rather than trying again.
+            indices.reset();
+        }
+
+        std::scoped_lock lock{s_mutex};
+        if (s_entriesByKey.find(key) == s_entriesByKey.end())
+        {
+            s_entries.push_front({key, std::move(bytes), indices});
+            s_entriesByKey.emplace(key, s_entries.begin());
+            s_entriesSize += s_entries.front().Size();
+
+            while (s_entriesSize > MAX_CACHE_SIZE && s_entries.size() > 1)
+            {
+                const Entry& oldest{s_entries.back()};
+                s_entriesSize -= oldest.Size();
+                s_entriesByKey.erase(oldest.Id);
+                s_entries.pop_back();
+            }
+        }
+
+        return indices;
+    }
+
+    bool IndexOptimizer::OptimizeTriangles(gsl::span<uint32_t> indices)
+    {
+        static const ScoreTable scoreTable{};
+
+        const size_t triangleCount{static_cast<size_t>(indices.size()) / 3};
+        if (triangleCount < 2)
+        {
+            return true;
+        }
+
+        // Checked before adding one, which would overflow for the highest 32-bit index.
+        const uint32_t maxIndex{*std::max_element(indices.begin(), indices.begin() + triangleCount * 3)};
+        if (maxIndex >= triangleCount * 3)
+        {
+            return false;
+        }
+
+        const uint32_t vertexCount{maxIndex + 1};
+
+        // Triangles of every vertex, as ranges of a single array.
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+        for (size_t index = 0; index < triangleCount * 3; ++index)
+        {
+            ++triangleOffsets[indices[index] + 1];
+        }
+
+        for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+        {
+            triangleOffsets[vertex + 1] += triangleOffsets[vertex];
+        }
+
+        std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+        std::vector<uint32_t> remainingTriangles(vertexCount);
+        for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+        {
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t vertex{indices[triangle * 3 + corner]};
+                vertexTriangles[triangleOffsets[vertex] + remainingTriangles[vertex]++] = triangle;
+            }
+        }
+
+        std::vector<int32_t> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+        {
+            vertexScores[vertex] = scoreTable.VertexScore(-1, remainingTriangles[vertex]);
+        }
+
+        std::vector<float> triangleScores(triangleCount);
+        for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+        {
+            triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+        }
+
+        std::vector<bool> emitted(triangleCount);
+        std::vector<uint32_t> output(triangleCount * 3);
+
+        // The cache holds 3 extra entries for the vertices pushed out by the last triangle.
+        std::array<uint32_t, CACHE_SIZE + 3> cache{};
+        std::array<uint32_t, CACHE_SIZE + 3> nextCache{};
+        size_t cacheCount{0};
+
+        size_t nextCandidate{0};
+        std::optional<uint32_t> bestTriangle{};
+
+        for (size_t outputTriangle = 0; outputTriangle < triangleCount; ++outputTriangle)
+        {
+            if (!bestTriangle)
+            {
+                // No triangle touches the cache, so pick the best of the triangles not emitted yet. Since scores only
+                // matter relative to the cache, the first remaining triangle is as good a restart as any.
+                while (emitted[nextCandidate])
+                {
+                    ++nextCandidate;
+                }
+
+                bestTriangle = static_cast<uint32_t>(nextCandidate);
+            }
+
+            const uint32_t triangle{*bestTriangle};
+            emitted[triangle] = true;
+
+            const std::array<uint32_t, 3> vertices{indices[triangle * 3], indices[triangle * 3 + 1], indices[triangle * 3 + 2]};
+            std::copy(vertices.begin(), vertices.end(), output.begin() + outputTriangle * 3);
+
+            // Remove the triangle from the triangles of its vertices.
+            for (const uint32_t vertex : vertices)
+            {
+                const auto begin{vertexTriangles.begin() + triangleOffsets[vertex]};
+                const auto end{begin + remainingTriangles[vertex]};
+                std::iter_swap(std::find(begin, end, triangle), end - 1);
+                --remainingTriangles[vertex];
+            }
+
+            // Move the vertices of the triangle to the front of the cache.
+            size_t nextCacheCount{0};
+            for (const uint32_t vertex : vertices)
+            {
+                // Degenerate triangles reference the same vertex more than once.
+                if (std::find(nextCache.begin(), nextCache.begin() + nextCacheCount, vertex) == nextCache.begin() + nextCacheCount)
+                {
+                    nextCache[nextCacheCount++] = vertex;
+                }
+            }
+
+            for (size_t position = 0; position < cacheCount; ++position)
+            {
+                const uint32_t vertex{cache[position]};
+                if (vertex != vertices[0] && vertex != vertices[1] && vertex != vertices[2])
+                {
+                    nextCache[nextCacheCount++] = vertex;
+                }
+            }
+
+            std::swap(cache, nextCache);
+            cacheCount = nextCacheCount;
+
+            // Update the scores of the vertices in the cache and of their triangles, and find the best triangle.
+            float bestScore{-1.0f};
+            bestTriangle.reset();
+            for (size_t position = 0; position < cacheCount; ++position)
+            {
+                const uint32_t vertex{cache[position]};
+                cachePositions[vertex] = position < CACHE_SIZE ? static_cast<int32_t>(position) : -1;
+
+                const float score{scoreTable.VertexScore(cachePositions[vertex], remainingTriangles[vertex])};
+                const float scoreDelta{score - vertexScores[vertex]};
+                vertexScores[vertex] = score;
+
+                const uint32_t begin{triangleOffsets[vertex]};
+                for (uint32_t entry = begin; entry < begin + remainingTriangles[vertex]; ++entry)
+                {
+                    const uint32_t adjacentTriangle{vertexTriangles[entry]};
+                    triangleScores[adjacentTriangle] += scoreDelta;
+                }
+            }
+
+            for (size_t position = 0; position < std::min(cacheCount, CACHE_SIZE); ++position)
+            {
+                const uint32_t vertex{cache[position]};
+                const uint32_t begin{triangleOffsets[vertex]};
+                for (uint32_t entry = begin; entry < begin + remainingTriangles[vertex]; ++entry)
+                {
+                    const uint32_t adjacentTriangle{vertexTriangles[entry]};
+                    if (triangleScores[adjacentTriangle] > bestScore)
+                    {
+                        bestScore = triangleScores[adjacentTriangle];
+                        bestTriangle = adjacentTriangle;
+                    }
+                }
+            }
+
+            cacheCount = std::min(cacheCount, CACHE_SIZE);
+        }
+
+        std::copy(output.begin(), output.end(), indices.begin());
+        return true;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <gsl/gsl>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Babylon
+{
+    // Reorders the triangles of indexed triangle lists for the post-transform vertex cache of the GPU, using Tom
+    // Forsyth's linear-speed vertex cache optimization. Results are cached along with the indices they were computed
+    // from, so that meshes created again with the same indices, such as clones or reloaded assets, are only optimized
+    // once.
+    class IndexOptimizer final
+    {
+    public:
+        // Returns the optimized indices of a triangle list of 16-bit or 32-bit indices, or nullptr if they cannot be
+        // optimized, see OptimizeTriangles. Can be called from any thread.
+        static std::shared_ptr<const std::vector<uint32_t>> Optimize(std::vector<uint8_t> bytes, bool is32Bits);
+
+        // Reorders the triangles of a triangle list in place. The vertex count is not known here, so it is bounded by
+        // the number of indices: returns false, leaving the indices as they are, if they reference a higher vertex.
+        static bool OptimizeTriangles(gsl::span<uint32_t> indices);
+
+    private:
+        struct Key
+        {
+            size_t Hash{};
+            size_t Size{};
+            bool Is32Bits{};
+
+            bool operator==(const Key& other) const
+            {
+                return Hash == other.Hash && Size == other.Size && Is32Bits == other.Is32Bits;
+            }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const
+            {
+                return key.Hash;
+            }
+        };
+
+        struct Entry
+        {
+            Key Id{};
+            std::vector<uint8_t> Bytes{};
+            std::shared_ptr<const std::vector<uint32_t>> Indices{};
+
+            size_t Size() const
+            {
+                return Bytes.size() + (Indices ? Indices->size() * sizeof(uint32_t) : 0);
+            }
+        };
+
+        static inline std::mutex s_mutex{};
+
+        // Entries from the most to the least recently used, and their positions by key.
+        static inline std::list<Entry> s_entries{};
+        static inline std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> s_entriesByKey{};
+        static inline size_t s_entriesSize{};
+    };
+}
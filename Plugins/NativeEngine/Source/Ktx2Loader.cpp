@@ -0,0 +1,385 @@
+#include "Ktx2Loader.h"
+#include "MipGenerator.h"
+
+#include <bgfx/bgfx.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+    using Babylon::Plugins::NativeEngine::TranscodeFormat;
+
+    constexpr uint8_t IDENTIFIER[]{0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+    // Offsets of the fields of the header and index of a container, see the KTX2 specification.
+    constexpr size_t VK_FORMAT_OFFSET{12};
+    constexpr size_t PIXEL_WIDTH_OFFSET{20};
+    constexpr size_t PIXEL_HEIGHT_OFFSET{24};
+    constexpr size_t PIXEL_DEPTH_OFFSET{28};
+    constexpr size_t LAYER_COUNT_OFFSET{32};
+    constexpr size_t FACE_COUNT_OFFSET{36};
+    constexpr size_t LEVEL_COUNT_OFFSET{40};
+    constexpr size_t SUPERCOMPRESSION_SCHEME_OFFSET{44};
+    constexpr size_t DFD_BYTE_OFFSET_OFFSET{48};
+    constexpr size_t DFD_BYTE_LENGTH_OFFSET{52};
+    constexpr size_t LEVEL_INDEX_OFFSET{80};
+    constexpr size_t LEVEL_INDEX_ENTRY_SIZE{24};
+
+    // Offsets of the fields of the basic data format descriptor block, from the start of the descriptor.
+    constexpr size_t DFD_BLOCK_SIZE_OFFSET{10};
+    constexpr size_t DFD_COLOR_MODEL_OFFSET{12};
+    constexpr size_t DFD_TRANSFER_FUNCTION_OFFSET{14};
+    constexpr size_t DFD_FIRST_SAMPLE_CHANNEL_TYPE_OFFSET{31};
+    constexpr size_t DFD_BLOCK_HEADER_SIZE{24};
+    constexpr size_t DFD_SAMPLE_SIZE{16};
+
+    constexpr uint32_t VK_FORMAT_UNDEFINED{0};
+    constexpr uint32_t SUPERCOMPRESSION_NONE{0};
+    constexpr uint32_t SUPERCOMPRESSION_BASIS_LZ{1};
+    constexpr uint8_t COLOR_MODEL_UASTC{166};
+    constexpr uint8_t TRANSFER_FUNCTION_SRGB{2};
+    constexpr uint8_t UASTC_CHANNEL_RGBA{3};
+    constexpr uint8_t UASTC_CHANNEL_RRRG{5};
+
+    struct DirectFormat
+    {
+        uint32_t VkFormat;
+        bimg::TextureFormat::Enum Format;
+    };
+
+    // The Vulkan formats of containers whose payloads are loaded as they are. The sRGB formats are loaded as sRGB
+    // textures of the same format.
+    constexpr DirectFormat DIRECT_FORMATS[]{
+        {9, bimg::TextureFormat::R8},
+        {15, bimg::TextureFormat::R8},
+        {16, bimg::TextureFormat::RG8},
+        {22, bimg::TextureFormat::RG8},
+        {37, bimg::TextureFormat::RGBA8},
+        {43, bimg::TextureFormat::RGBA8},
+        {44, bimg::TextureFormat::BGRA8},
+        {50, bimg::TextureFormat::BGRA8},
+        {76, bimg::TextureFormat::R16F},
+        {83, bimg::TextureFormat::RG16F},
+        {97, bimg::TextureFormat::RGBA16F},
+        {100, bimg::TextureFormat::R32F},
+        {103, bimg::TextureFormat::RG32F},
+        {109, bimg::TextureFormat::RGBA32F},
+        {131, bimg::TextureFormat::BC1},
+        {132, bimg::TextureFormat::BC1},
+        {133, bimg::TextureFormat::BC1},
+        {134, bimg::TextureFormat::BC1},
+        {135, bimg::TextureFormat::BC2},
+        {136, bimg::TextureFormat::BC2},
+        {137, bimg::TextureFormat::BC3},
+        {138, bimg::TextureFormat::BC3},
+        {139, bimg::TextureFormat::BC4},
+        {141, bimg::TextureFormat::BC5},
+        {143, bimg::TextureFormat::BC6H},
+        {145, bimg::TextureFormat::BC7},
+        {146, bimg::TextureFormat::BC7},
+        {147, bimg::TextureFormat::ETC2},
+        {148, bimg::TextureFormat::ETC2},
+        {149, bimg::TextureFormat::ETC2A1},
+        {150, bimg::TextureFormat::ETC2A1},
+        {151, bimg::TextureFormat::ETC2A},
+        {152, bimg::TextureFormat::ETC2A},
+        {157, bimg::TextureFormat::ASTC4x4},
+        {158, bimg::TextureFormat::ASTC4x4},
+        {161, bimg::TextureFormat::ASTC5x5},
+        {162, bimg::TextureFormat::ASTC5x5},
+        {165, bimg::TextureFormat::ASTC6x6},
+        {166, bimg::TextureFormat::ASTC6x6},
+    };
+
+    constexpr uint32_t SRGB_VK_FORMATS[]{15, 22, 43, 50, 132, 134, 136, 138, 146, 148, 150, 152, 158, 162, 166};
+
+    struct TranscodeTarget
+    {
+        TranscodeFormat Format;
+        bimg::TextureFormat::Enum ImageFormat;
+        bool WithAlpha;
+        bool WithoutAlpha;
+    };
+
+    // In the order of TranscodeFormat. BC3 and ETC2A are twice the size of BC1 and ETC2, which are used for payloads
+    // without alpha.
+    constexpr TranscodeTarget TRANSCODE_TARGETS[]{
+        {TranscodeFormat::BC7, bimg::TextureFormat::BC7, true, true},
+        {TranscodeFormat::BC3, bimg::TextureFormat::BC3, true, false},
+        {TranscodeFormat::BC1, bimg::TextureFormat::BC1, false, true},
+        {TranscodeFormat::ETC2A, bimg::TextureFormat::ETC2A, true, false},
+        {TranscodeFormat::ETC2, bimg::TextureFormat::ETC2, false, true},
+        {TranscodeFormat::ASTC4x4, bimg::TextureFormat::ASTC4x4, true, true},
+        {TranscodeFormat::RGBA8, bimg::TextureFormat::RGBA8, true, true},
+    };
+
+    class Reader
+    {
+    public:
+        explicit Reader(gsl::span<const uint8_t> data)
+            : m_data{data}
+        {
+        }
+
+        template<typename T>
+        T Read(size_t offset) const
+        {
+            Check(offset, sizeof(T));
+            T value{};
+            std::memcpy(&value, m_data.data() + offset, sizeof(T));
+            return value;
+        }
+
+        gsl::span<const uint8_t> Range(uint64_t offset, uint64_t length) const
+        {
+            Check(offset, length);
+            return m_data.subspan(static_cast<size_t>(offset), static_cast<size_t>(length));
+        }
+
+    private:
+        void Check(uint64_t offset, uint64_t length) const
+        {
+            const uint64_t size{static_cast<uint64_t>(m_data.size())};
+            if (offset > size || length > size - offset)
+            {
+                throw std::runtime_error{"Invalid KTX2 container."};
+            }
+        }
+
+        gsl::span<const uint8_t> m_data;
+    };
+
+    struct ImageDeleter
+    {
+        void operator()(bimg::ImageContainer* image) const
+        {
+            bimg::imageFree(image);
+        }
+    };
+
+    using ImagePtr = std::unique_ptr<bimg::ImageContainer, ImageDeleter>;
+
+    // Allocates an image of a face with the mips of the container. Containers without mips have a level count of 0 or 1.
+    ImagePtr AllocateFace(bx::AllocatorI& allocator, bimg::TextureFormat::Enum format, uint32_t width, uint32_t height, uint32_t levelCount)
+    {
+        ImagePtr image{bimg::imageAlloc(&allocator, format, static_cast<uint16_t>(width), static_cast<uint16_t>(height), 1, 1, false, levelCount > 1)};
+        image->m_numMips = static_cast<uint8_t>(std::min<uint32_t>(image->m_numMips, std::max(levelCount, 1u)));
+        return image;
+    }
+
+    void CopyMip(const bimg::ImageContainer& source, bimg::ImageContainer& destination, uint8_t mip)
+    {
+        bimg::ImageMip sourceMip{};
+        bimg::ImageMip destinationMip{};
+        bimg::imageGetRawData(source, 0, mip, source.m_data, source.m_size, sourceMip);
+        bimg::imageGetRawData(destination, 0, mip, destination.m_data, destination.m_size, destinationMip);
+        std::memcpy(const_cast<uint8_t*>(destinationMip.m_data), sourceMip.m_data, std::min(sourceMip.m_size, destinationMip.m_size));
+    }
+
+    // Fills a mip with every other block of the mip above, in both directions, for formats that cannot be filtered.
+    void DecimateMip(bimg::ImageContainer& image, uint8_t mip)
+    {
+        const bimg::ImageBlockInfo& blockInfo{bimg::getBlockInfo(image.m_format)};
+        const uint32_t blockSize{blockInfo.blockSize};
+
+        bimg::ImageMip sourceMip{};
+        bimg::ImageMip destinationMip{};
+        bimg::imageGetRawData(image, 0, mip - 1, image.m_data, image.m_size, sourceMip);
+        bimg::imageGetRawData(image, 0, mip, image.m_data, image.m_size, destinationMip);
+
+        // The mips of block formats are at least a block in size, in whole blocks.
+        const uint32_t sourceColumns{std::max(sourceMip.m_width / blockInfo.blockWidth, 1u)};
+        const uint32_t sourceRows{std::max(sourceMip.m_height / blockInfo.blockHeight, 1u)};
+        const uint32_t destinationColumns{std::max(destinationMip.m_width / blockInfo.blockWidth, 1u)};
+        const uint32_t destinationRows{std::max(destinationMip.m_height / blockInfo.blockHeight, 1u)};
+
+        uint8_t* destination{const_cast<uint8_t*>(destinationMip.m_data)};
+        for (uint32_t row = 0; row < destinationRows; ++row)
+        {
+            const uint32_t sourceRow{std::min(row * 2, sourceRows - 1)};
+            for (uint32_t column = 0; column < destinationColumns; ++column)
+            {
+                const uint32_t sourceColumn{std::min(column * 2, sourceColumns - 1)};
+                std::memcpy(destination + (row * destinationColumns + column) * blockSize, sourceMip.m_data + (sourceRow * sourceColumns + sourceColumn) * blockSize, blockSize);
+            }
+        }
+    }
+
+    // Completes the mips of a face, see Ktx2Loader::Load.
+    void CompleteMips(bx::AllocatorI& allocator, ImagePtr& face, bool srgb, bool generateMips)
+    {
+        const uint8_t levelCount{face->m_numMips};
+        const uint8_t mipCount{bimg::imageGetNumMips(face->m_format, static_cast<uint16_t>(face->m_width), static_cast<uint16_t>(face->m_height))};
+        if (levelCount == mipCount || (levelCount == 1 && !generateMips))
+        {
+            return;
+        }
+
+        if (Babylon::MipGenerator::IsSupported(face->m_format))
+        {
+            // Filter all the mips from the base level, then put back the levels of the container.
+            bimg::ImageContainer base{*face};
+            base.m_numMips = 1;
+            ImagePtr generated{Babylon::MipGenerator::Generate(allocator, base, srgb)};
+            for (uint8_t mip = 1; mip < levelCount; ++mip)
+            {
+                CopyMip(*face, *generated, mip);
+            }
+
+            face = std::move(generated);
+        }
+        else if (levelCount > 1)
+        {
+            // Faces with mips were allocated with all of them.
+            face->m_numMips = mipCount;
+            for (uint8_t mip = levelCount; mip < mipCount; ++mip)
+            {
+                DecimateMip(*face, mip);
+            }
+        }
+    }
+}
+
+namespace Babylon
+{
+    bool Ktx2Loader::IsContainer(gsl::span<const uint8_t> data)
+    {
+        return static_cast<size_t>(data.size()) >= sizeof(IDENTIFIER) && std::memcmp(data.data(), IDENTIFIER, sizeof(IDENTIFIER)) == 0;
+    }
+
+    Ktx2Loader::Image Ktx2Loader::Load(bx::AllocatorI& allocator, gsl::span<const uint8_t> data, uint32_t faceCount, const Plugins::NativeEngine::BasisTranscoder& transcoder, bool srgb, bool generateMips)
+    {
+        if (!IsContainer(data))
+        {
+            throw std::runtime_error{"Invalid KTX2 container."};
+        }
+
+        const Reader reader{data};
+        const auto vkFormat{reader.Read<uint32_t>(VK_FORMAT_OFFSET)};
+        const auto width{reader.Read<uint32_t>(PIXEL_WIDTH_OFFSET)};
+        const auto height{reader.Read<uint32_t>(PIXEL_HEIGHT_OFFSET)};
+        const auto levelCount{reader.Read<uint32_t>(LEVEL_COUNT_OFFSET)};
+        const auto supercompressionScheme{reader.Read<uint32_t>(SUPERCOMPRESSION_SCHEME_OFFSET)};
+
+        if (width == 0 || height == 0 || width > UINT16_MAX || height > UINT16_MAX)
+        {
+            throw std::runtime_error{"Unsupported KTX2 image size."};
+        }
+
+        if (reader.Read<uint32_t>(PIXEL_DEPTH_OFFSET) > 1 || reader.Read<uint32_t>(LAYER_COUNT_OFFSET) > 1)
+        {
+            throw std::runtime_error{"KTX2 volumes and arrays are not supported."};
+        }
+
+        if (reader.Read<uint32_t>(FACE_COUNT_OFFSET) != faceCount)
+        {
+            throw std::runtime_error{faceCount == 6 ? "Expected a KTX2 cube map." : "Unexpected KTX2 cube map."};
+        }
+
+        const auto dfd{reader.Range(reader.Read<uint32_t>(DFD_BYTE_OFFSET_OFFSET), reader.Read<uint32_t>(DFD_BYTE_LENGTH_OFFSET))};
+        const Reader dfdReader{dfd};
+        const auto colorModel{dfdReader.Read<uint8_t>(DFD_COLOR_MODEL_OFFSET)};
+
+        Image result{};
+        result.Srgb = srgb ||
+                      dfdReader.Read<uint8_t>(DFD_TRANSFER_FUNCTION_OFFSET) == TRANSFER_FUNCTION_SRGB ||
+                      std::find(std::begin(SRGB_VK_FORMATS), std::end(SRGB_VK_FORMATS), vkFormat) != std::end(SRGB_VK_FORMATS);
+
+        const auto level{[&reader](uint32_t index) {
+            const size_t entry{LEVEL_INDEX_OFFSET + index * LEVEL_INDEX_ENTRY_SIZE};
+            return reader.Range(reader.Read<uint64_t>(entry), reader.Read<uint64_t>(entry + sizeof(uint64_t)));
+        }};
+
+        std::vector<ImagePtr> faces{};
+        if (vkFormat == VK_FORMAT_UNDEFINED && (supercompressionScheme == SUPERCOMPRESSION_BASIS_LZ || colorModel == COLOR_MODEL_UASTC))
+        {
+            if (!transcoder)
+            {
+                throw std::runtime_error{"No transcoder for the Basis Universal payload of a KTX2 container."};
+            }
+
+            // ETC1S payloads have a second slice for alpha, UASTC payloads declare their channels in their first sample.
+            const auto sampleCount{(dfdReader.Read<uint16_t>(DFD_BLOCK_SIZE_OFFSET) - DFD_BLOCK_HEADER_SIZE) / DFD_SAMPLE_SIZE};
+            const auto channel{static_cast<uint8_t>(dfdReader.Read<uint8_t>(DFD_FIRST_SAMPLE_CHANNEL_TYPE_OFFSET) & 0xF)};
+            const bool hasAlpha{colorModel == COLOR_MODEL_UASTC ? (channel == UASTC_CHANNEL_RGBA || channel == UASTC_CHANNEL_RRRG) : sampleCount > 1};
+
+            const auto format{SelectTranscodeFormat(hasAlpha, result.Srgb, faceCount == 6)};
+            const auto target{std::find_if(std::begin(TRANSCODE_TARGETS), std::end(TRANSCODE_TARGETS), [format](const auto& target) { return target.Format == format; })};
+
+            for (uint32_t face = 0; face < faceCount; ++face)
+            {
+                ImagePtr& image{faces.emplace_back(AllocateFace(allocator, target->ImageFormat, width, height, levelCount))};
+                for (uint8_t mip = 0; mip < image->m_numMips; ++mip)
+                {
+                    bimg::ImageMip imageMip{};
+                    bimg::imageGetRawData(*image, 0, mip, image->m_data, image->m_size, imageMip);
+                    if (!transcoder(data.data(), static_cast<size_t>(data.size()), mip, face, format, const_cast<uint8_t*>(imageMip.m_data), imageMip.m_size))
+                    {
+                        throw std::runtime_error{"Failed to transcode a KTX2 container."};
+                    }
+                }
+            }
+        }
+        else
+        {
+            const auto directFormat{std::find_if(std::begin(DIRECT_FORMATS), std::end(DIRECT_FORMATS), [vkFormat](const auto& format) { return format.VkFormat == vkFormat; })};
+            if (directFormat == std::end(DIRECT_FORMATS) || supercompressionScheme != SUPERCOMPRESSION_NONE)
+            {
+                throw std::runtime_error{"Unsupported KTX2 format."};
+            }
+
+            for (uint32_t face = 0; face < faceCount; ++face)
+            {
+                faces.emplace_back(AllocateFace(allocator, directFormat->Format, width, height, levelCount));
+            }
+
+            // The faces of a level are stored one after the other, each with the size of the level in the format.
+            for (uint8_t mip = 0; mip < faces.front()->m_numMips; ++mip)
+            {
+                const auto levelData{level(mip)};
+                for (uint32_t face = 0; face < faceCount; ++face)
+                {
+                    bimg::ImageMip imageMip{};
+                    bimg::imageGetRawData(*faces[face], 0, mip, faces[face]->m_data, faces[face]->m_size, imageMip);
+                    if (static_cast<size_t>(levelData.size()) != static_cast<size_t>(imageMip.m_size) * faceCount)
+                    {
+                        throw std::runtime_error{"Invalid KTX2 level size."};
+                    }
+
+                    std::memcpy(const_cast<uint8_t*>(imageMip.m_data), levelData.data() + face * imageMip.m_size, imageMip.m_size);
+                }
+            }
+        }
+
+        for (ImagePtr& face : faces)
+        {
+            CompleteMips(allocator, face, result.Srgb, generateMips);
+        }
+
+        for (ImagePtr& face : faces)
+        {
+            result.Faces.push_back(face.release());
+        }
+
+        return result;
+    }
+
+    Plugins::NativeEngine::TranscodeFormat Ktx2Loader::SelectTranscodeFormat(bool hasAlpha, bool srgb, bool cube)
+    {
+        const bgfx::Caps* caps{bgfx::getCaps()};
+        const uint16_t required{static_cast<uint16_t>(cube ? (srgb ? BGFX_CAPS_FORMAT_TEXTURE_CUBE_SRGB : BGFX_CAPS_FORMAT_TEXTURE_CUBE) : (srgb ? BGFX_CAPS_FORMAT_TEXTURE_2D_SRGB : BGFX_CAPS_FORMAT_TEXTURE_2D))};
+
+        for (const auto& target : TRANSCODE_TARGETS)
+        {
+            if ((hasAlpha ? target.WithAlpha : target.WithoutAlpha) && (caps->formats[target.ImageFormat] & required) == required)
+            {
+                return target.Format;
+            }
+        }
+
+        return TranscodeFormat::RGBA8;
+    }
+}
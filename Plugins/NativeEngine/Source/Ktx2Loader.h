@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Babylon/Plugins/NativeEngine.h>
+
+#include <bimg/bimg.h>
+#include <bx/allocator.h>
+
+#include <gsl/gsl>
+
+#include <vector>
+
+namespace Babylon
+{
+    // Loads the images of KTX2 containers. Payloads in GPU formats are used as they are, with the mips of the
+    // container. Basis Universal payloads are transcoded to the first format of TranscodeFormat that the device
+    // supports, with a transcoder given by the application.
+    class Ktx2Loader final
+    {
+    public:
+        struct Image
+        {
+            // An image per face of the container, 1 or 6, with all the mips of the container.
+            std::vector<bimg::ImageContainer*> Faces{};
+
+            // Whether the container declares the sRGB transfer function.
+            bool Srgb{};
+        };
+
+        static bool IsContainer(gsl::span<const uint8_t> data);
+
+        // Loads a container of 1 face for 2D textures or 6 faces for cube textures. Can be called from any thread. The
+        // transcoder is only needed for Basis Universal payloads. The faces are loaded as sRGB if either the container
+        // or srgb says so. bgfx textures have either one mip or all of them, so the levels missing from containers with
+        // some mips are generated, and containers without mips get generated mips if generateMips is set and their
+        // format supports it. Payloads are not flipped, since compressed blocks cannot be.
+        static Image Load(bx::AllocatorI& allocator, gsl::span<const uint8_t> data, uint32_t faceCount, const Plugins::NativeEngine::BasisTranscoder& transcoder, bool srgb, bool generateMips);
+
+        static Plugins::NativeEngine::TranscodeFormat SelectTranscodeFormat(bool hasAlpha, bool srgb, bool cube);
+    };
+}
@@ -0,0 +1,440 @@
+#include "MipGenerator.h"
+
+#include <arcana/threading/task.h>
+#include <arcana/threading/task_schedulers.h>
+
+#include <bx/math.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MIP_GENERATOR_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // Mips smaller than this are filtered on the calling thread, since a band is not worth the cost of a task.
+    constexpr uint32_t MIN_BAND_PIXELS{128 * 1024};
+    constexpr uint32_t MAX_BAND_COUNT{8};
+
+    constexpr size_t LINEAR_TO_SRGB_TABLE_SIZE{16384};
+
+    enum class ChannelEncoding
+    {
+        Unorm8,
+        Srgb8,
+        Half,
+        Float,
+    };
+
+    struct Format
+    {
+        ChannelEncoding Encoding{};
+        uint32_t Channels{};
+        uint32_t BytesPerChannel{};
+    };
+
+    struct Level
+    {
+        uint8_t* Data{};
+        uint32_t Width{};
+        uint32_t Height{};
+    };
+
+    std::optional<Format> GetFormat(bimg::TextureFormat::Enum format, bool srgb)
+    {
+        switch (format)
+        {
+            case bimg::TextureFormat::R8:
+                return Format{ChannelEncoding::Unorm8, 1, 1};
+            case bimg::TextureFormat::RG8:
+                return Format{ChannelEncoding::Unorm8, 2, 1};
+            case bimg::TextureFormat::RGB8:
+                return Format{srgb ? ChannelEncoding::Srgb8 : ChannelEncoding::Unorm8, 3, 1};
+            case bimg::TextureFormat::RGBA8:
+                return Format{srgb ? ChannelEncoding::Srgb8 : ChannelEncoding::Unorm8, 4, 1};
+            case bimg::TextureFormat::RGBA16F:
+                return Format{ChannelEncoding::Half, 4, 2};
+            case bimg::TextureFormat::RGBA32F:
+                return Format{ChannelEncoding::Float, 4, 4};
+            default:
+                return std::nullopt;
+        }
+    }
+
+    const std::array<float, 256>& SrgbToLinearTable()
+    {
+        static const auto table{[]() {
+            std::array<float, 256> values{};
+            for (size_t index = 0; index < values.size(); ++index)
+            {
+                const float value{index / 255.0f};
+                values[index] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            }
+            return values;
+        }()};
+
+        return table;
+    }
+
+    const std::array<uint8_t, LINEAR_TO_SRGB_TABLE_SIZE>& LinearToSrgbTable()
+    {
+        static const auto table{[]() {
+            std::array<uint8_t, LINEAR_TO_SRGB_TABLE_SIZE> values{};
+            for (size_t index = 0; index < values.size(); ++index)
+            {
+                const float value{static_cast<float>(index) / (LINEAR_TO_SRGB_TABLE_SIZE - 1)};
+                const float encoded{value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f};
+                values[index] = static_cast<uint8_t>(encoded * 255.0f + 0.5f);
+            }
+            return values;
+        }()};
+
+        return table;
+    }
+
+    // Decodes a row to floats, in linear space for sRGB rows. The alpha channel of sRGB rows is always linear.
+    void DecodeRow(const Format& format, const uint8_t* source, float* destination, uint32_t width)
+    {
+        const size_t count{static_cast<size_t>(width) * format.Channels};
+        switch (format.Encoding)
+        {
+            case ChannelEncoding::Srgb8:
+            {
+                const auto& table{SrgbToLinearTable()};
+                for (size_t index = 0; index < count; ++index)
+                {
+                    destination[index] = index % format.Channels == 3 ? source[index] / 255.0f : table[source[index]];
+                }
+                break;
+            }
+            case ChannelEncoding::Half:
+            {
+                for (size_t index = 0; index < count; ++index)
+                {
+                    uint16_t value;
+                    std::memcpy(&value, source + index * sizeof(uint16_t), sizeof(uint16_t));
+                    destination[index] = bx::halfToFloat(value);
+                }
+                break;
+            }
+            default:
+            {
+                std::memcpy(destination, source, count * sizeof(float));
+                break;
+            }
+        }
+    }
+
+    void EncodeRow(const Format& format, const float* source, uint8_t* destination, uint32_t width)
+    {
+        const size_t count{static_cast<size_t>(width) * format.Channels};
+        switch (format.Encoding)
+        {
+            case ChannelEncoding::Srgb8:
+            {
+                const auto& table{LinearToSrgbTable()};
+                for (size_t index = 0; index < count; ++index)
+                {
+                    const float value{std::clamp(source[index], 0.0f, 1.0f)};
+                    destination[index] = index % format.Channels == 3
+                        ? static_cast<uint8_t>(value * 255.0f + 0.5f)
+                        : table[static_cast<size_t>(value * (LINEAR_TO_SRGB_TABLE_SIZE - 1) + 0.5f)];
+                }
+                break;
+            }
+            case ChannelEncoding::Half:
+            {
+                for (size_t index = 0; index < count; ++index)
+                {
+                    const uint16_t value{bx::halfFromFloat(source[index])};
+                    std::memcpy(destination + index * sizeof(uint16_t), &value, sizeof(uint16_t));
+                }
+                break;
+            }
+            default:
+            {
+                std::memcpy(destination, source, count * sizeof(float));
+                break;
+            }
+        }
+    }
+
+    // Averages the 2x2 blocks of two rows of 8-bit values, clamping the blocks at the right edge of the source.
+    void DownsampleUnorm8Row(const uint8_t* row0, const uint8_t* row1, uint8_t* destination, uint32_t sourceWidth, uint32_t width, uint32_t channels)
+    {
+        uint32_t x{0};
+
+        if (channels == 4 && sourceWidth > 1)
+        {
+            // Two destination pixels from four source pixels of each row.
+#if defined(MIP_GENERATOR_SSE2)
+            const __m128i zero{_mm_setzero_si128()};
+            const __m128i two{_mm_set1_epi16(2)};
+            for (; x + 2 <= width; x += 2)
+            {
+                const __m128i top{_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8))};
+                const __m128i bottom{_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8))};
+                const __m128i low{_mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero))};
+                const __m128i high{_mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero))};
+                const __m128i sum{_mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high))};
+                const __m128i average{_mm_srli_epi16(_mm_add_epi16(sum, two), 2)};
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + x * 4), _mm_packus_epi16(average, zero));
+            }
+#elif defined(MIP_GENERATOR_NEON)
+            for (; x + 2 <= width; x += 2)
+            {
+                const uint8x16_t top{vld1q_u8(row0 + x * 8)};
+                const uint8x16_t bottom{vld1q_u8(row1 + x * 8)};
+                const uint16x8_t low{vaddl_u8(vget_low_u8(top), vget_low_u8(bottom))};
+                const uint16x8_t high{vaddl_u8(vget_high_u8(top), vget_high_u8(bottom))};
+                const uint16x8_t sum{vaddq_u16(vcombine_u16(vget_low_u16(low), vget_low_u16(high)), vcombine_u16(vget_high_u16(low), vget_high_u16(high)))};
+                vst1_u8(destination + x * 4, vrshrn_n_u16(sum, 2));
+            }
+#endif
+        }
+
+        for (; x < width; ++x)
+        {
+            const uint32_t x0{x * 2};
+            const uint32_t x1{std::min(x0 + 1, sourceWidth - 1)};
+            for (uint32_t channel = 0; channel < channels; ++channel)
+            {
+                const uint32_t sum{
+                    static_cast<uint32_t>(row0[x0 * channels + channel]) + row0[x1 * channels + channel] +
+                    row1[x0 * channels + channel] + row1[x1 * channels + channel]};
+                destination[x * channels + channel] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+
+    void DownsampleFloatRow(const float* row0, const float* row1, float* destination, uint32_t sourceWidth, uint32_t width, uint32_t channels)
+    {
+        uint32_t x{0};
+
+        if (channels == 4 && sourceWidth > 1)
+        {
+#if defined(MIP_GENERATOR_SSE2)
+            const __m128 quarter{_mm_set1_ps(0.25f)};
+            for (; x < width; ++x)
+            {
+                const __m128 top{_mm_add_ps(_mm_loadu_ps(row0 + x * 8), _mm_loadu_ps(row0 + x * 8 + 4))};
+                const __m128 bottom{_mm_add_ps(_mm_loadu_ps(row1 + x * 8), _mm_loadu_ps(row1 + x * 8 + 4))};
+                _mm_storeu_ps(destination + x * 4, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+            }
+#elif defined(MIP_GENERATOR_NEON)
+            for (; x < width; ++x)
+            {
+                const float32x4_t top{vaddq_f32(vld1q_f32(row0 + x * 8), vld1q_f32(row0 + x * 8 + 4))};
+                const float32x4_t bottom{vaddq_f32(vld1q_f32(row1 + x * 8), vld1q_f32(row1 + x * 8 + 4))};
+                vst1q_f32(destination + x * 4, vmulq_n_f32(vaddq_f32(top, bottom), 0.25f));
+            }
+#endif
+        }
+
+        for (; x < width; ++x)
+        {
+            const uint32_t x0{x * 2};
+            const uint32_t x1{std::min(x0 + 1, sourceWidth - 1)};
+            for (uint32_t channel = 0; channel < channels; ++channel)
+            {
+                destination[x * channels + channel] =
+                    (row0[x0 * channels + channel] + row0[x1 * channels + channel] +
+                        row1[x0 * channels + channel] + row1[x1 * channels + channel]) *
+                    0.25f;
+            }
+        }
+    }
+
+    // Filters the rows [begin, end) of a mip from the previous mip.
+    void DownsampleRows(const Format& format, const Level& source, const Level& destination, uint32_t begin, uint32_t end)
+    {
+        const size_t sourcePitch{static_cast<size_t>(source.Width) * format.Channels * format.BytesPerChannel};
+        const size_t destinationPitch{static_cast<size_t>(destination.Width) * format.Channels * format.BytesPerChannel};
+
+        // Rows of other encodings are filtered as floats, which only needs a few rows of scratch memory.
+        std::vector<float> scratch{};
+        if (format.Encoding == ChannelEncoding::Srgb8 || format.Encoding == ChannelEncoding::Half)
+        {
+            scratch.resize((static_cast<size_t>(source.Width) * 2 + destination.Width) * format.Channels);
+        }
+
+        for (uint32_t y = begin; y < end; ++y)
+        {
+            const uint8_t* row0{source.Data + y * 2 * sourcePitch};
+            const uint8_t* row1{source.Data + std::min(y * 2 + 1, source.Height - 1) * sourcePitch};
+            uint8_t* row{destination.Data + y * destinationPitch};
+
+            switch (format.Encoding)
+            {
+                case ChannelEncoding::Unorm8:
+                {
+                    DownsampleUnorm8Row(row0, row1, row, source.Width, destination.Width, format.Channels);
+                    break;
+                }
+                case ChannelEncoding::Float:
+                {
+                    DownsampleFloatRow(reinterpret_cast<const float*>(row0), reinterpret_cast<const float*>(row1), reinterpret_cast<float*>(row), source.Width, destination.Width, format.Channels);
+                    break;
+                }
+                default:
+                {
+                    float* floatRow0{scratch.data()};
+                    float* floatRow1{floatRow0 + static_cast<size_t>(source.Width) * format.Channels};
+                    float* floatRow{floatRow1 + static_cast<size_t>(source.Width) * format.Channels};
+                    DecodeRow(format, row0, floatRow0, source.Width);
+                    DecodeRow(format, row1, floatRow1, source.Width);
+                    DownsampleFloatRow(floatRow0, floatRow1, floatRow, source.Width, destination.Width, format.Channels);
+                    EncodeRow(format, floatRow, row, destination.Width);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Runs the bands of rows of a mip on the calling thread and on the thread pool. Bands are claimed from a counter,
+    // so the calling thread only waits for bands that a task is already processing. Tasks that start late find no
+    // band left, which avoids a deadlock when the thread pool is busy, as it is when textures are loaded in batches.
+    void ForEachBand(uint32_t rows, uint32_t bandCount, std::function<void(uint32_t, uint32_t)> process)
+    {
+        struct State
+        {
+            std::function<void(uint32_t, uint32_t)> Process{};
+            uint32_t Rows{};
+            uint32_t BandCount{};
+            std::atomic<uint32_t> NextBand{};
+
+            std::mutex Mutex{};
+            std::condition_variable Condition{};
+            uint32_t Completed{};
+            std::exception_ptr Exception{};
+
+            void Run()
+            {
+                for (uint32_t band = NextBand++; band < BandCount; band = NextBand++)
+                {
+                    std::exception_ptr exception{};
+                    try
+                    {
+                        Process(Rows * band / BandCount, Rows * (band + 1) / BandCount);
+                    }
+                    catch (...)
+                    {
+                        exception = std::current_exception();
+                    }
+
+                    std::scoped_lock lock{Mutex};
+                    if (exception && !Exception)
+                    {
+                        Exception = exception;
+                    }
+
+                    if (++Completed == BandCount)
+                    {
+                        Condition.notify_one();
+                    }
+                }
+            }
+        };
+
+        auto state{std::make_shared<State>()};
+        state->Process = std::move(process);
+        state->Rows = rows;
+        state->BandCount = bandCount;
+
+        for (uint32_t task = 1; task < bandCount; ++task)
+        {
+            arcana::make_task(arcana::threadpool_scheduler, arcana::cancellation::none(), [state]() {
+                state->Run();
+            });
+        }
+
+        state->Run();
+
+        std::unique_lock lock{state->Mutex};
+        state->Condition.wait(lock, [&state]() { return state->Completed == state->BandCount; });
+        if (state->Exception)
+        {
+            std::rethrow_exception(state->Exception);
+        }
+    }
+}
+
+namespace Babylon
+{
+    bool MipGenerator::IsSupported(bimg::TextureFormat::Enum format)
+    {
+        return GetFormat(format, false).has_value();
+    }
+
+    bimg::ImageContainer* MipGenerator::Generate(bx::AllocatorI& allocator, const bimg::ImageContainer& image, bool srgb)
+    {
+        const auto format{GetFormat(image.m_format, srgb)};
+        if (!format || image.m_numMips != 1 || image.m_depth != 1 || image.m_numLayers != 1 || image.m_cubeMap)
+        {
+            throw std::runtime_error{"Unsupported image for mip generation"};
+        }
+
+        bimg::ImageMip sourceMip{};
+        if (!bimg::imageGetRawData(image, 0, 0, image.m_data, image.m_size, sourceMip))
+        {
+            throw std::runtime_error{"Failed to get image data"};
+        }
+
+        bimg::ImageContainer* result{bimg::imageAlloc(&allocator, image.m_format, static_cast<uint16_t>(image.m_width), static_cast<uint16_t>(image.m_height), 1, 1, false, true)};
+        if (result == nullptr)
+        {
+            throw std::runtime_error{"Failed to allocate image"};
+        }
+
+        result->m_orientation = image.m_orientation;
+
+        const uint32_t maxBandCount{std::min(MAX_BAND_COUNT, std::max(std::thread::hardware_concurrency(), 1u))};
+
+        Level previous{};
+        for (uint8_t mip = 0; mip < result->m_numMips; ++mip)
+        {
+            bimg::ImageMip imageMip{};
+            bimg::imageGetRawData(*result, 0, mip, result->m_data, result->m_size, imageMip);
+            const Level level{const_cast<uint8_t*>(imageMip.m_data), imageMip.m_width, imageMip.m_height};
+
+            if (mip == 0)
+            {
+                std::memcpy(level.Data, sourceMip.m_data, std::min(sourceMip.m_size, imageMip.m_size));
+            }
+            else
+            {
+                const uint32_t bandCount{std::clamp(level.Width * level.Height / MIN_BAND_PIXELS, 1u, std::min(maxBandCount, level.Height))};
+                if (bandCount == 1)
+                {
+                    DownsampleRows(*format, previous, level, 0, level.Height);
+                }
+                else
+                {
+                    ForEachBand(level.Height, bandCount, [&format, &previous, &level](uint32_t begin, uint32_t end) {
+                        DownsampleRows(*format, previous, level, begin, end);
+                    });
+                }
+            }
+
+            previous = level;
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <bimg/bimg.h>
+#include <bx/allocator.h>
+
+namespace Babylon
+{
+    // Generates the mips of images in their own format with a 2x2 box filter, instead of converting them to RGBA8 or
+    // RGBA32F for bimg::imageGenerateMips, which quadruples the memory of half-float images. 8-bit sRGB images are
+    // filtered in linear space. Large mips are split into bands of rows that are filtered on the thread pool.
+    class MipGenerator final
+    {
+    public:
+        static bool IsSupported(bimg::TextureFormat::Enum format);
+
+        // Returns a new image with all the mips of an image of a single mip. Can be called from any thread.
+        static bimg::ImageContainer* Generate(bx::AllocatorI& allocator, const bimg::ImageContainer& image, bool srgb);
+    };
+}
@@ -21,9 +21,20 @@
 #include <stb/stb_image_resize.h>
 #include <bx/math.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <map>
 #include <Babylon/ShaderCache.h>
 #include "ShaderCache.h"
+#include "CommandCapture.h"
+#include "CommandProfiler.h"
+#include "IndexOptimizer.h"
+#include "Ktx2Loader.h"
+#include "MipGenerator.h"
+#include "ReadbackPool.h"
+
+#include <Babylon/Plugins/NativeEngine/ImageKernels.h>
 
 namespace Babylon
 {
@@ -71,6 +82,18 @@ namespace Babylon
             constexpr uint64_t SCREENMODE = BGFX_STATE_BLEND_FUNC_SEPARATE(BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_INV_SRC_COLOR, BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_INV_SRC_ALPHA);
         }
 
+        // The fill mode of Babylon.js for filled triangle lists, the only fill mode that can use optimized indices.
+        constexpr uint32_t MATERIAL_TRIANGLE_FILL_MODE{0};
+
+        // The fill modes of Babylon.js whose indices are converted, see TopologyConverter.
+        constexpr uint32_t MATERIAL_LINE_LOOP_DRAW_MODE{5};
+        constexpr uint32_t MATERIAL_TRIANGLE_FAN_DRAW_MODE{8};
+
+        // The fill modes of Babylon.js up to this one draw lists of triangles, lines or points, whose primitives are
+        // independent of each other, so that contiguous index ranges draw the same as their concatenation. Strips
+        // would join the ranges with extra primitives.
+        constexpr uint32_t MATERIAL_LINE_LIST_DRAW_MODE{4};
+
         static_assert(static_cast<bgfx::TextureFormat::Enum>(bimg::TextureFormat::Count) == bgfx::TextureFormat::Count);
         static_assert(static_cast<bgfx::TextureFormat::Enum>(bimg::TextureFormat::RGBA8) == bgfx::TextureFormat::RGBA8);
         static_assert(static_cast<bgfx::TextureFormat::Enum>(bimg::TextureFormat::RGB8) == bgfx::TextureFormat::RGB8);
@@ -80,58 +103,13 @@ namespace Babylon
             return static_cast<bgfx::TextureFormat::Enum>(format);
         }
 
-        using TransformFn = void (*)(const uint8_t*, uint8_t*);
-        void TransformImage(const bimg::ImageContainer* src, bimg::ImageContainer* dst, TransformFn transformFn)
-        {
-            const uint8_t* srcData{static_cast<const uint8_t*>(src->m_data)};
-            const uint8_t srcBytesPerPixel{static_cast<uint8_t>(bimg::getBitsPerPixel(src->m_format) >> 3)};
-            const uint8_t* srcDataEnd{srcData + src->m_size};
-
-            uint8_t* dstData{static_cast<uint8_t*>(dst->m_data)};
-            const uint8_t dstBytesPerPixel{static_cast<uint8_t>(bimg::getBitsPerPixel(dst->m_format) >> 3)};
-            const uint8_t* dstDataEnd{dstData + dst->m_size};
-
-            while (srcData < srcDataEnd && dstData < dstDataEnd)
-            {
-                transformFn(srcData, dstData);
-                srcData += srcBytesPerPixel;
-                dstData += dstBytesPerPixel;
-            }
-        }
-
         void FlipImage(gsl::span<uint8_t> image, uint32_t height)
         {
-            const size_t rowPitch{image.size() / height};
-
-            std::vector<uint8_t> buffer(rowPitch);
-            for (size_t row = 0; row < height / 2; row++)
-            {
-                uint8_t* frontPtr{image.data() + (row * rowPitch)};
-                uint8_t* backPtr{image.data() + ((height - row - 1) * rowPitch)};
-
-                std::memcpy(buffer.data(), frontPtr, rowPitch);
-                std::memcpy(frontPtr, backPtr, rowPitch);
-                std::memcpy(backPtr, buffer.data(), rowPitch);
-            }
+            ImageKernels::FlipRows(image.data(), image.size() / height, height);
         }
 
-        std::function<std::pair<uint32_t, uint32_t>(uint32_t x, uint32_t y)> GetPixelMapper(bimg::Orientation::Enum orientation, uint32_t width, uint32_t height)
-        {
-            // clang-format off
-            switch (orientation)
-            {
-                case bimg::Orientation::R0: return [](uint32_t x, uint32_t y) { return std::make_pair(x, y); };
-                case bimg::Orientation::R90: return [height](uint32_t x, uint32_t y) { return std::make_pair(height - y - 1, x); };
-                case bimg::Orientation::R180: return [width, height](uint32_t x, uint32_t y) { return std::make_pair(width - x - 1, height - y - 1); };
-                case bimg::Orientation::R270: return [width](uint32_t x, uint32_t y) { return std::make_pair(y, width - x - 1); };
-                case bimg::Orientation::HFlip: return [width](uint32_t x, uint32_t y) { return std::make_pair(width - x - 1, y); };
-                case bimg::Orientation::HFlipR90: return [width, height](uint32_t x, uint32_t y) { return std::make_pair(height - y - 1, width - x - 1); };
-                case bimg::Orientation::HFlipR270: return [](uint32_t x, uint32_t y) { return std::make_pair(y, x); };
-                case bimg::Orientation::VFlip: return [height](uint32_t x, uint32_t y) { return std::make_pair(x, height - y - 1); };
-                default: throw std::runtime_error{"Unexpected image orientation."};
-            }
-            // clang-format on
-        }
+        static_assert(static_cast<ImageKernels::Orientation>(bimg::Orientation::R90) == ImageKernels::Orientation::R90);
+        static_assert(static_cast<ImageKernels::Orientation>(bimg::Orientation::VFlip) == ImageKernels::Orientation::VFlip);
 
         using RGBA8ImageData = gsl::span<uint32_t>;
         void ReorientImage(RGBA8ImageData image, uint32_t& width, uint32_t& height, bimg::Orientation::Enum orientation)
@@ -141,43 +119,26 @@ namespace Babylon
             {
                 // No-op
             }
-            // If we only need a vflip, use the more efficient FlipImage function.
+            // If we only need a vflip, flip the rows in place.
             else if (orientation == bimg::Orientation::VFlip)
             {
                 FlipImage(gsl::make_span(reinterpret_cast<uint8_t*>(image.data()), image.size_bytes()), height);
             }
-            // Otherwise we'll do a pixel by pixel transformation, using a temporary image buffer.
-            else if (orientation != bimg::Orientation::R0)
+            // Otherwise transform the pixels to a temporary image buffer.
+            else
             {
-                uint32_t newWidth = width;
-                uint32_t newHeight = height;
-
-                // If the orientation is 90 or 270, the final image width and height will be swapped.
-                if (orientation == bimg::Orientation::R90 || orientation == bimg::Orientation::R270 || orientation == bimg::Orientation::HFlipR90 || orientation == bimg::Orientation::HFlipR270)
-                {
-                    std::swap(newWidth, newHeight);
-                }
-
-                // Transform the pixels from the original image data to a temp image buffer.
+                const auto imageOrientation{static_cast<ImageKernels::Orientation>(orientation)};
                 std::vector<uint32_t> buffer(image.size());
-                auto mapPixel = GetPixelMapper(orientation, width, height);
-                for (uint32_t y = 0; y < height; y++)
-                {
-                    for (uint32_t x = 0; x < width; x++)
-                    {
-                        const RGBA8ImageData::size_type index = y * width + x;
-                        const std::pair<uint32_t, uint32_t> mappedPixel{mapPixel(x, y)};
-                        const RGBA8ImageData::size_type newIndex = mappedPixel.second * newWidth + mappedPixel.first;
-                        buffer[newIndex] = image[index];
-                    }
-                }
+                ImageKernels::Reorient(image.data(), buffer.data(), width, height, imageOrientation);
 
                 // Copy the temp image buffer over the original image data.
                 std::memcpy(image.data(), buffer.data(), image.size_bytes());
 
-                // Update the final width and height.
-                width = newWidth;
-                height = newHeight;
+                // If the orientation is 90 or 270, the final image width and height are swapped.
+                if (ImageKernels::SwapsDimensions(imageOrientation))
+                {
+                    std::swap(width, height);
+                }
             }
         }
 
@@ -198,14 +159,19 @@ namespace Babylon
             if (image->m_format == bimg::TextureFormat::R8 ||
                 image->m_format == bimg::TextureFormat::RG8)
             {
-                static const TransformFn UnpackR8{[](const uint8_t* src, uint8_t* dst) { dst[0] = dst[1] = dst[2] = src[0]; dst[3] = 1; }};
-                static const TransformFn UnpackRG8{[](const uint8_t* src, uint8_t* dst) { dst[0] = dst[1] = dst[2] = src[0]; dst[3] = src[1]; }};
-
                 // bimg loads grayscale textures with and without alpha as R8 and RG8 respectively.
                 // Unpack to RGB and RGBA such that RGB is the grayscale and the A is the alpha.
                 bimg::ImageContainer* oldImage{image};
                 image = bimg::imageAlloc(&allocator, bimg::TextureFormat::RGBA8, static_cast<uint16_t>(image->m_width), static_cast<uint16_t>(image->m_height), 1, 1, false, false);
-                TransformImage(oldImage, image, image->m_format == bimg::TextureFormat::R8 ? UnpackR8 : UnpackRG8);
+                const size_t pixelCount{static_cast<size_t>(oldImage->m_width) * oldImage->m_height};
+                if (oldImage->m_format == bimg::TextureFormat::R8)
+                {
+                    ImageKernels::ExpandR8ToRGBA8(static_cast<const uint8_t*>(oldImage->m_data), static_cast<uint8_t*>(image->m_data), pixelCount);
+                }
+                else
+                {
+                    ImageKernels::ExpandRG8ToRGBA8(static_cast<const uint8_t*>(oldImage->m_data), static_cast<uint8_t*>(image->m_data), pixelCount);
+                }
                 bimg::imageFree(oldImage);
             }
 
@@ -262,30 +228,50 @@ namespace Babylon
                 assert(bgfx::isTextureValid(1, false, 1, Cast(image->m_format), BGFX_TEXTURE_SRGB));
             }
 
-            if (generateMips)
+            if (generateMips && MipGenerator::IsSupported(image->m_format))
             {
-                if (image->m_format == bimg::TextureFormat::RGB8)
-                {
-                    bimg::ImageContainer* oldImage{image};
-                    image = bimg::imageConvert(&allocator, bimg::TextureFormat::RGBA8, *image, false);
-                    bimg::imageFree(oldImage);
-                }
-                else if (image->m_format == bimg::TextureFormat::RGBA16F || image->m_format == bimg::TextureFormat::RGBA16 || image->m_format == bimg::TextureFormat::R16)
-                {
-                    bimg::ImageContainer* oldImage{image};
-                    image = bimg::imageConvert(&allocator, bimg::TextureFormat::RGBA32F, *image, false);
-                    bimg::imageFree(oldImage);
-                }
-
                 bimg::ImageContainer* oldImage{image};
-                image = bimg::imageGenerateMips(&allocator, *image);
+                image = MipGenerator::Generate(allocator, *image, srgb);
                 bimg::imageFree(oldImage);
             }
+            else if (generateMips && (image->m_format == bimg::TextureFormat::R16 || image->m_format == bimg::TextureFormat::RGBA16))
+            {
+                // bimg only generates the mips of RGBA8 and RGBA32F images, so 16-bit images are converted to RGBA32F.
+                bimg::ImageContainer* convertedImage{bimg::imageConvert(&allocator, bimg::TextureFormat::RGBA32F, *image, false)};
+                bimg::imageFree(image);
+                image = bimg::imageGenerateMips(&allocator, *convertedImage);
+                bimg::imageFree(convertedImage);
+            }
+            else if (generateMips)
+            {
+                bimg::imageFree(image);
+                throw std::runtime_error{"Unsupported image format for mip generation"};
+            }
 
             assert(image != nullptr);
             return image;
         }
 
+        // Copies the pixels of a texture read back to the RGBA8 pixels of a destination, converting and flipping them
+        // row by row. The rows of the source are sourcePitch bytes apart, to read regions of larger textures.
+        void CopyReadPixels(const uint8_t* source, size_t sourcePitch, const bgfx::TextureInfo& sourceInfo, uint8_t* destination, const bgfx::TextureInfo& destinationInfo, bool flip)
+        {
+            const size_t destinationPitch{destinationInfo.storageSize / destinationInfo.height};
+            for (uint32_t row = 0; row < destinationInfo.height; ++row)
+            {
+                const uint8_t* sourceRow{source + row * sourcePitch};
+                uint8_t* destinationRow{destination + (flip ? destinationInfo.height - 1 - row : row) * destinationPitch};
+                if (sourceInfo.format == destinationInfo.format)
+                {
+                    std::memcpy(destinationRow, sourceRow, destinationPitch);
+                }
+                else if (!bimg::imageConvert(&Graphics::DeviceContext::GetDefaultAllocator(), destinationRow, bimg::TextureFormat::Enum(destinationInfo.format), sourceRow, bimg::TextureFormat::Enum(sourceInfo.format), destinationInfo.width, /*height*/ 1, /*depth*/ 1))
+                {
+                    throw std::runtime_error{"Texture conversion to RBGA8 failed."};
+                }
+            }
+        }
+
         void LoadTextureFromImage(Graphics::Texture* texture, bimg::ImageContainer* image, bool srgb)
         {
             if (texture->IsValid())
@@ -402,11 +388,61 @@ namespace Babylon
 
             return BGFX_TEXTURE_NONE;
         }
-
-        using CommandFunctionPointerT = void (NativeEngine::*)(NativeDataStream::Reader&);
     }
 
-    void BABYLON_API NativeEngine::Initialize(Napi::Env env)
+    const std::array<NativeEngine::CommandFunctionPointerT, static_cast<size_t>(CommandOpcode::Count)> NativeEngine::s_commandTable{[]() {
+        std::array<CommandFunctionPointerT, static_cast<size_t>(CommandOpcode::Count)> table{};
+        table[static_cast<size_t>(CommandOpcode::DeleteVertexArray)] = &NativeEngine::DeleteVertexArray;
+        table[static_cast<size_t>(CommandOpcode::DeleteIndexBuffer)] = &NativeEngine::DeleteIndexBuffer;
+        table[static_cast<size_t>(CommandOpcode::DeleteVertexBuffer)] = &NativeEngine::DeleteVertexBuffer;
+        table[static_cast<size_t>(CommandOpcode::SetProgram)] = &NativeEngine::SetProgram;
+        table[static_cast<size_t>(CommandOpcode::DeleteProgram)] = &NativeEngine::DeleteProgram;
+        table[static_cast<size_t>(CommandOpcode::SetMatrices)] = &NativeEngine::SetMatrices;
+        table[static_cast<size_t>(CommandOpcode::SetMatrix)] = &NativeEngine::SetMatrix;
+        table[static_cast<size_t>(CommandOpcode::SetMatrix3x3)] = &NativeEngine::SetMatrix3x3;
+        table[static_cast<size_t>(CommandOpcode::SetMatrix2x2)] = &NativeEngine::SetMatrix2x2;
+        table[static_cast<size_t>(CommandOpcode::SetInt)] = &NativeEngine::SetInt;
+        table[static_cast<size_t>(CommandOpcode::SetIntArray)] = &NativeEngine::SetIntArray;
+        table[static_cast<size_t>(CommandOpcode::SetIntArray2)] = &NativeEngine::SetIntArray2;
+        table[static_cast<size_t>(CommandOpcode::SetIntArray3)] = &NativeEngine::SetIntArray3;
+        table[static_cast<size_t>(CommandOpcode::SetIntArray4)] = &NativeEngine::SetIntArray4;
+        table[static_cast<size_t>(CommandOpcode::SetFloatArray)] = &NativeEngine::SetFloatArray;
+        table[static_cast<size_t>(CommandOpcode::SetFloatArray2)] = &NativeEngine::SetFloatArray2;
+        table[static_cast<size_t>(CommandOpcode::SetFloatArray3)] = &NativeEngine::SetFloatArray3;
+        table[static_cast<size_t>(CommandOpcode::SetFloatArray4)] = &NativeEngine::SetFloatArray4;
+        table[static_cast<size_t>(CommandOpcode::SetTextureSampling)] = &NativeEngine::SetTextureSampling;
+        table[static_cast<size_t>(CommandOpcode::SetTextureWrapMode)] = &NativeEngine::SetTextureWrapMode;
+        table[static_cast<size_t>(CommandOpcode::SetTextureAnisotropicLevel)] = &NativeEngine::SetTextureAnisotropicLevel;
+        table[static_cast<size_t>(CommandOpcode::SetTexture)] = &NativeEngine::SetTexture;
+        table[static_cast<size_t>(CommandOpcode::UnsetTexture)] = &NativeEngine::UnsetTexture;
+        table[static_cast<size_t>(CommandOpcode::DiscardAllTextures)] = &NativeEngine::DiscardAllTextures;
+        table[static_cast<size_t>(CommandOpcode::BindVertexArray)] = &NativeEngine::BindVertexArray;
+        table[static_cast<size_t>(CommandOpcode::SetState)] = &NativeEngine::SetState;
+        table[static_cast<size_t>(CommandOpcode::SetZOffset)] = &NativeEngine::SetZOffset;
+        table[static_cast<size_t>(CommandOpcode::SetZOffsetUnits)] = &NativeEngine::SetZOffsetUnits;
+        table[static_cast<size_t>(CommandOpcode::SetDepthTest)] = &NativeEngine::SetDepthTest;
+        table[static_cast<size_t>(CommandOpcode::SetDepthWrite)] = &NativeEngine::SetDepthWrite;
+        table[static_cast<size_t>(CommandOpcode::SetColorWrite)] = &NativeEngine::SetColorWrite;
+        table[static_cast<size_t>(CommandOpcode::SetBlendMode)] = &NativeEngine::SetBlendMode;
+        table[static_cast<size_t>(CommandOpcode::SetFloat)] = &NativeEngine::SetFloat;
+        table[static_cast<size_t>(CommandOpcode::SetFloat2)] = &NativeEngine::SetFloat2;
+        table[static_cast<size_t>(CommandOpcode::SetFloat3)] = &NativeEngine::SetFloat3;
+        table[static_cast<size_t>(CommandOpcode::SetFloat4)] = &NativeEngine::SetFloat4;
+        table[static_cast<size_t>(CommandOpcode::BindFrameBuffer)] = &NativeEngine::BindFrameBuffer;
+        table[static_cast<size_t>(CommandOpcode::UnbindFrameBuffer)] = &NativeEngine::UnbindFrameBuffer;
+        table[static_cast<size_t>(CommandOpcode::DeleteFrameBuffer)] = &NativeEngine::DeleteFrameBuffer;
+        table[static_cast<size_t>(CommandOpcode::DrawIndexed)] = &NativeEngine::DrawIndexed;
+        table[static_cast<size_t>(CommandOpcode::DrawIndexedInstanced)] = &NativeEngine::DrawIndexedInstanced;
+        table[static_cast<size_t>(CommandOpcode::Draw)] = &NativeEngine::Draw;
+        table[static_cast<size_t>(CommandOpcode::DrawInstanced)] = &NativeEngine::DrawInstanced;
+        table[static_cast<size_t>(CommandOpcode::Clear)] = &NativeEngine::Clear;
+        table[static_cast<size_t>(CommandOpcode::SetStencil)] = &NativeEngine::SetStencil;
+        table[static_cast<size_t>(CommandOpcode::SetViewPort)] = &NativeEngine::SetViewPort;
+        table[static_cast<size_t>(CommandOpcode::SetScissor)] = &NativeEngine::SetScissor;
+        return table;
+    }()};
+
+    void BABYLON_API NativeEngine::Initialize(Napi::Env env, const Plugins::NativeEngine::Options& options)
     {
         // Initialize the JavaScript side.
         Napi::HandleScope scope{env};
@@ -654,6 +690,57 @@ namespace Babylon
                 StaticValue("COMMAND_SETVIEWPORT", Napi::FunctionPointer::Create(env, &NativeEngine::SetViewPort)),
                 StaticValue("COMMAND_SETSCISSOR", Napi::FunctionPointer::Create(env, &NativeEngine::SetScissor)),
 
+                StaticValue("COMMAND_ENCODING_FUNCTION_POINTER", Napi::Number::From(env, static_cast<uint32_t>(CommandEncoding::FunctionPointer))),
+                StaticValue("COMMAND_ENCODING_OPCODE", Napi::Number::From(env, static_cast<uint32_t>(CommandEncoding::Opcode))),
+                StaticValue("COMMAND_OPCODE_VERSION", Napi::Number::From(env, COMMAND_OPCODE_VERSION)),
+                StaticValue("OPCODE_DELETEVERTEXARRAY", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::DeleteVertexArray))),
+                StaticValue("OPCODE_DELETEINDEXBUFFER", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::DeleteIndexBuffer))),
+                StaticValue("OPCODE_DELETEVERTEXBUFFER", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::DeleteVertexBuffer))),
+                StaticValue("OPCODE_SETPROGRAM", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetProgram))),
+                StaticValue("OPCODE_DELETEPROGRAM", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::DeleteProgram))),
+                StaticValue("OPCODE_SETMATRICES", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetMatrices))),
+                StaticValue("OPCODE_SETMATRIX", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetMatrix))),
+                StaticValue("OPCODE_SETMATRIX3X3", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetMatrix3x3))),
+                StaticValue("OPCODE_SETMATRIX2X2", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetMatrix2x2))),
+                StaticValue("OPCODE_SETINT", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetInt))),
+                StaticValue("OPCODE_SETINTARRAY", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetIntArray))),
+                StaticValue("OPCODE_SETINTARRAY2", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetIntArray2))),
+                StaticValue("OPCODE_SETINTARRAY3", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetIntArray3))),
+                StaticValue("OPCODE_SETINTARRAY4", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetIntArray4))),
+                StaticValue("OPCODE_SETFLOATARRAY", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetFloatArray))),
+                StaticValue("OPCODE_SETFLOATARRAY2", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetFloatArray2))),
+                StaticValue("OPCODE_SETFLOATARRAY3", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetFloatArray3))),
+                StaticValue("OPCODE_SETFLOATARRAY4", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetFloatArray4))),
+                StaticValue("OPCODE_SETTEXTURESAMPLING", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetTextureSampling))),
+                StaticValue("OPCODE_SETTEXTUREWRAPMODE", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetTextureWrapMode))),
+                StaticValue("OPCODE_SETTEXTUREANISOTROPICLEVEL", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetTextureAnisotropicLevel))),
+                StaticValue("OPCODE_SETTEXTURE", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetTexture))),
+                StaticValue("OPCODE_UNSETTEXTURE", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::UnsetTexture))),
+                StaticValue("OPCODE_DISCARDALLTEXTURES", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::DiscardAllTextures))),
+                StaticValue("OPCODE_BINDVERTEXARRAY", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::BindVertexArray))),
+                StaticValue("OPCODE_SETSTATE", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetState))),
+                StaticValue("OPCODE_SETZOFFSET", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetZOffset))),
+                StaticValue("OPCODE_SETZOFFSETUNITS", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetZOffsetUnits))),
+                StaticValue("OPCODE_SETDEPTHTEST", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetDepthTest))),
+                StaticValue("OPCODE_SETDEPTHWRITE", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetDepthWrite))),
+                StaticValue("OPCODE_SETCOLORWRITE", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetColorWrite))),
+                StaticValue("OPCODE_SETBLENDMODE", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetBlendMode))),
+                StaticValue("OPCODE_SETFLOAT", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetFloat))),
+                StaticValue("OPCODE_SETFLOAT2", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetFloat2))),
+                StaticValue("OPCODE_SETFLOAT3", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetFloat3))),
+                StaticValue("OPCODE_SETFLOAT4", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetFloat4))),
+                StaticValue("OPCODE_BINDFRAMEBUFFER", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::BindFrameBuffer))),
+                StaticValue("OPCODE_UNBINDFRAMEBUFFER", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::UnbindFrameBuffer))),
+                StaticValue("OPCODE_DELETEFRAMEBUFFER", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::DeleteFrameBuffer))),
+                StaticValue("OPCODE_DRAWINDEXED", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::DrawIndexed))),
+                StaticValue("OPCODE_DRAWINDEXEDINSTANCED", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::DrawIndexedInstanced))),
+                StaticValue("OPCODE_DRAW", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::Draw))),
+                StaticValue("OPCODE_DRAWINSTANCED", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::DrawInstanced))),
+                StaticValue("OPCODE_CLEAR", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::Clear))),
+                StaticValue("OPCODE_SETSTENCIL", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetStencil))),
+                StaticValue("OPCODE_SETVIEWPORT", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetViewPort))),
+                StaticValue("OPCODE_SETSCISSOR", Napi::Number::From(env, static_cast<uint32_t>(CommandOpcode::SetScissor))),
+
                 InstanceMethod("dispose", &NativeEngine::Dispose),
 
                 InstanceMethod("requestAnimationFrame", &NativeEngine::RequestAnimationFrame),
@@ -707,6 +794,7 @@ namespace Babylon
             });
 
         JsRuntime::NativeObject::GetFromJavaScript(env).Set(JS_CONSTRUCTOR_NAME, func);
+        JsRuntime::NativeObject::GetFromJavaScript(env).Set(JS_OPTIONS_NAME, Napi::External<Plugins::NativeEngine::Options>::New(env, new Plugins::NativeEngine::Options{options}, [](Napi::Env, Plugins::NativeEngine::Options* options) { delete options; }));
     }
 
     NativeEngine::NativeEngine(const Napi::CallbackInfo& info)
@@ -731,6 +819,28 @@ namespace Babylon
             auto jsInfo = info[0].As<Napi::Object>();
             m_jsInfo.NonFloatVertexBuffers = jsInfo.Get("nonFloatVertexBuffers").As<Napi::Boolean>();
         }
+
+        const auto jsOptions{JsRuntime::NativeObject::GetFromJavaScript(info.Env()).Get(JS_OPTIONS_NAME)};
+        if (!jsOptions.IsUndefined())
+        {
+            const auto& options{*jsOptions.As<Napi::External<Plugins::NativeEngine::Options>>().Data()};
+            if (options.ParallelEncoding)
+            {
+                m_parallelEncoder = std::make_unique<ParallelEncoder>();
+            }
+
+            m_drawMerging = options.DrawMerging && !options.ParallelEncoding;
+
+            if (options.ReferenceStaticGeometry)
+            {
+                m_releaseQueue = std::make_shared<ReferencedBytes::ReleaseQueue>();
+            }
+
+            m_vertexCacheOptimization = options.VertexCacheOptimization;
+            m_vertexInterleaving = options.VertexInterleaving;
+            m_topologyConversion = options.TopologyConversion;
+            m_ktx2Transcoder = options.Ktx2Transcoder;
+        }
     }
 
     NativeEngine::~NativeEngine()
@@ -760,20 +870,44 @@ namespace Babylon
 
     Napi::Value NativeEngine::CreateVertexArray(const Napi::CallbackInfo& info)
     {
-        VertexArray* vertexArray = new VertexArray{};
-        return Napi::Pointer<VertexArray>::Create(info.Env(), vertexArray, Napi::NapiPointerDeleter(vertexArray));
+        VertexArray* vertexArray = new VertexArray{m_deviceContext, m_vertexInterleaving};
+        return Napi::Pointer<VertexArray>::Create(info.Env(), vertexArray, [vertexArray]() {
+            if (auto capture{CommandCaptureImpl::GetImpl()})
+            {
+                capture->RemoveVertexArray(vertexArray);
+            }
+
+            delete vertexArray;
+        });
     }
 
     void NativeEngine::DeleteVertexArray(NativeDataStream::Reader& data)
     {
-        data.ReadPointer<VertexArray>()->Dispose();
+        VertexArray* vertexArray = data.ReadPointer<VertexArray>();
+        FlushMergedDraw();
+
+        if (m_parallelEncoder)
+        {
+            // Recorded draws may still reference the vertex array.
+            m_parallelEncoder->Defer([vertexArray]() { vertexArray->Dispose(); });
+        }
+        else
+        {
+            vertexArray->Dispose();
+        }
         // TODO: should we clear the m_boundVertexArray if it gets deleted?
         //assert(vertexArray != m_boundVertexArray);
     }
 
     void NativeEngine::BindVertexArray(NativeDataStream::Reader& data)
     {
-        m_boundVertexArray = data.ReadPointer<VertexArray>();
+        VertexArray* vertexArray = data.ReadPointer<VertexArray>();
+        if (vertexArray != m_boundVertexArray)
+        {
+            FlushMergedDraw();
+        }
+
+        m_boundVertexArray = vertexArray;
     }
 
     Napi::Value NativeEngine::CreateIndexBuffer(const Napi::CallbackInfo& info)
@@ -785,13 +919,64 @@ namespace Babylon
         const bool dynamic = info[4].As<Napi::Boolean>().Value();
 
         const uint16_t flags = (is32Bits ? BGFX_BUFFER_INDEX32 : 0);
-        IndexBuffer* indexBuffer = new IndexBuffer{m_deviceContext, gsl::make_span(static_cast<uint8_t*>(dataBuffer.Data()) + dataByteOffset, dataByteLength), flags, dynamic};
-        return Napi::Pointer<IndexBuffer>::Create(info.Env(), indexBuffer, Napi::NapiPointerDeleter(indexBuffer));
+        const auto bytes{gsl::make_span(static_cast<uint8_t*>(dataBuffer.Data()) + dataByteOffset, dataByteLength)};
+        IndexBuffer* indexBuffer{};
+        if (m_releaseQueue && !dynamic)
+        {
+            m_releaseQueue->Drain();
+            indexBuffer = new IndexBuffer{m_deviceContext, std::make_unique<ReferencedBytes>(dataBuffer, bytes, m_releaseQueue), flags, m_topologyConversion};
+        }
+        else
+        {
+            indexBuffer = new IndexBuffer{m_deviceContext, bytes, flags, dynamic, m_stagingRing, m_topologyConversion};
+        }
+
+        if (auto capture{CommandCaptureImpl::GetImpl()})
+        {
+            capture->AddIndexBuffer(indexBuffer, bytes, flags, dynamic);
+        }
+
+        Napi::Value jsIndexBuffer = Napi::Pointer<IndexBuffer>::Create(info.Env(), indexBuffer, [indexBuffer]() {
+            if (auto capture{CommandCaptureImpl::GetImpl()})
+            {
+                capture->RemoveIndexBuffer(indexBuffer);
+            }
+
+            delete indexBuffer;
+        });
+
+        if (m_vertexCacheOptimization && !dynamic)
+        {
+            // The JavaScript object keeps the index buffer alive until the optimized indices are set.
+            arcana::make_task(arcana::threadpool_scheduler, *m_cancellationSource,
+                [indices = std::vector<uint8_t>{bytes.begin(), bytes.end()}, is32Bits]() mutable {
+                    return IndexOptimizer::Optimize(std::move(indices), is32Bits);
+                })
+                .then(m_runtimeScheduler, *m_cancellationSource,
+                    [indexBuffer, jsIndexBufferRef{Napi::Persistent(jsIndexBuffer)}](const std::shared_ptr<const std::vector<uint32_t>>& indices) {
+                        if (indices)
+                        {
+                            indexBuffer->SetOptimizedIndices(*indices);
+                        }
+                    });
+        }
+
+        return jsIndexBuffer;
     }
 
     void NativeEngine::DeleteIndexBuffer(NativeDataStream::Reader& data)
     {
-        data.ReadPointer<IndexBuffer>()->Dispose();
+        IndexBuffer* indexBuffer = data.ReadPointer<IndexBuffer>();
+        FlushMergedDraw();
+
+        if (m_parallelEncoder)
+        {
+            m_parallelEncoder->Defer([indexBuffer]() { indexBuffer->Dispose(); });
+        }
+        else
+        {
+            indexBuffer->Dispose();
+        }
     }
 
     void NativeEngine::RecordIndexBuffer(const Napi::CallbackInfo& info)
@@ -802,6 +987,10 @@ namespace Babylon
         try
         {
             vertexArray->RecordIndexBuffer(indexBuffer);
+            if (auto capture{CommandCaptureImpl::GetImpl()})
+            {
+                capture->RecordIndexBuffer(vertexArray, indexBuffer);
+            }
         }
         catch (std::exception& ex)
         {
@@ -820,10 +1009,16 @@ namespace Babylon
         const uint32_t dataByteOffset = info[2].As<Napi::Number>().Uint32Value();
         const uint32_t dataByteLength = info[3].As<Napi::Number>().Uint32Value();
         const uint32_t startingIndex = info[4].As<Napi::Number>().Uint32Value();
+        const bool discard = !info[5].IsUndefined() && info[5].As<Napi::Boolean>().Value();
 
         try
         {
-            indexBuffer->Update(gsl::make_span(static_cast<uint8_t*>(dataBuffer.Data()) + dataByteOffset, dataByteLength), startingIndex);
+            const auto bytes{gsl::make_span(static_cast<uint8_t*>(dataBuffer.Data()) + dataByteOffset, dataByteLength)};
+            indexBuffer->Update(bytes, startingIndex, discard);
+            if (auto capture{CommandCaptureImpl::GetImpl()})
+            {
+                capture->UpdateIndexBuffer(indexBuffer, bytes, startingIndex);
+            }
         }
         catch (std::exception& ex)
         {
@@ -842,13 +1037,46 @@ namespace Babylon
         const uint32_t dataByteLength = info[2].As<Napi::Number>().Uint32Value();
         const bool dynamic = info[3].As<Napi::Boolean>().Value();
 
-        VertexBuffer* vertexBuffer = new VertexBuffer(m_deviceContext, gsl::make_span(static_cast<uint8_t*>(dataBuffer.Data()) + dataByteOffset, dataByteLength), dynamic);
-        return Napi::Pointer<VertexBuffer>::Create(info.Env(), vertexBuffer, Napi::NapiPointerDeleter(vertexBuffer));
+        const auto bytes{gsl::make_span(static_cast<uint8_t*>(dataBuffer.Data()) + dataByteOffset, dataByteLength)};
+        VertexBuffer* vertexBuffer{};
+        if (m_releaseQueue && !dynamic)
+        {
+            m_releaseQueue->Drain();
+            vertexBuffer = new VertexBuffer{m_deviceContext, std::make_unique<ReferencedBytes>(dataBuffer, bytes, m_releaseQueue)};
+        }
+        else
+        {
+            vertexBuffer = new VertexBuffer(m_deviceContext, bytes, dynamic, m_stagingRing);
+        }
+
+        if (auto capture{CommandCaptureImpl::GetImpl()})
+        {
+            capture->AddVertexBuffer(vertexBuffer, bytes, dynamic);
+        }
+
+        return Napi::Pointer<VertexBuffer>::Create(info.Env(), vertexBuffer, [vertexBuffer]() {
+            if (auto capture{CommandCaptureImpl::GetImpl()})
+            {
+                capture->RemoveVertexBuffer(vertexBuffer);
+            }
+
+            delete vertexBuffer;
+        });
     }
 
     void NativeEngine::DeleteVertexBuffer(NativeDataStream::Reader& data)
     {
-        data.ReadPointer<VertexBuffer>()->Dispose();
+        VertexBuffer* vertexBuffer = data.ReadPointer<VertexBuffer>();
+        FlushMergedDraw();
+
+        if (m_parallelEncoder)
+        {
+            m_parallelEncoder->Defer([vertexBuffer]() { vertexBuffer->Dispose(); });
+        }
+        else
+        {
+            vertexBuffer->Dispose();
+        }
     }
 
     void NativeEngine::RecordVertexBuffer(const Napi::CallbackInfo& info)
@@ -889,6 +1117,10 @@ namespace Babylon
         try
         {
             vertexArray->RecordVertexBuffer(vertexBuffer, location, byteOffset, byteStride, numElements, type, normalized, divisor);
+            if (auto capture{CommandCaptureImpl::GetImpl()})
+            {
+                capture->RecordVertexBuffer(vertexArray, vertexBuffer, location, byteOffset, byteStride, numElements, type, normalized, divisor);
+            }
         }
         catch (std::exception& ex)
         {
@@ -907,10 +1139,16 @@ namespace Babylon
         const uint32_t dataByteOffset = info[2].As<Napi::Number>().Uint32Value();
         const uint32_t dataByteLength = info[3].As<Napi::Number>().Uint32Value();
         const uint32_t vertexByteOffset = info[4].IsUndefined() ? 0 : info[4].As<Napi::Number>().Uint32Value();
+        const bool discard = !info[5].IsUndefined() && info[5].As<Napi::Boolean>().Value();
 
         try
         {
-            vertexBuffer->Update(gsl::make_span(static_cast<uint8_t*>(dataBuffer.Data()) + dataByteOffset, dataByteLength), vertexByteOffset);
+            const auto bytes{gsl::make_span(static_cast<uint8_t*>(dataBuffer.Data()) + dataByteOffset, dataByteLength)};
+            vertexBuffer->Update(bytes, vertexByteOffset, discard);
+            if (auto capture{CommandCaptureImpl::GetImpl()})
+            {
+                capture->UpdateVertexBuffer(vertexBuffer, bytes, vertexByteOffset);
+            }
         }
         catch (std::exception& ex)
         {
@@ -991,8 +1229,13 @@ namespace Babylon
             shaderInfo = &bgfxShaderInfo;
         }
 
+        return CreateProgramInternal(*shaderInfo);
+    }
+
+    std::unique_ptr<ProgramData> NativeEngine::CreateProgramInternal(const ShaderCompiler::BgfxShaderInfo& shaderInfo)
+    {
         static auto InitUniformInfos{
-            [](bgfx::ShaderHandle shader, const std::unordered_map<std::string, uint8_t>& uniformStages, std::unordered_map<uint16_t, UniformInfo>& uniformInfos, std::unordered_map<std::string, uint16_t>& uniformNameToIndex) {
+            [](bgfx::ShaderHandle shader, const std::unordered_map<std::string, uint8_t>& uniformStages, ProgramData& program) {
                 auto numUniforms = bgfx::getShaderUniforms(shader);
                 std::vector<bgfx::UniformHandle> uniforms{numUniforms};
                 bgfx::getShaderUniforms(shader, uniforms.data(), gsl::narrow_cast<uint16_t>(uniforms.size()));
@@ -1004,20 +1247,25 @@ namespace Babylon
                     bgfx::getUniformInfo(uniforms[index], info);
                     auto itStage = uniformStages.find(info.name);
                     auto& handle = uniforms[index];
-                    uniformInfos.emplace(std::make_pair(handle.idx, UniformInfo{itStage == uniformStages.end() ? uint8_t{} : itStage->second, handle, info.num}));
-                    uniformNameToIndex[info.name] = handleIndex;
+                    program.UniformInfos.emplace(std::make_pair(handle.idx, UniformInfo{itStage == uniformStages.end() ? uint8_t{} : itStage->second, handle, info.num}));
+                    program.UniformNameToIndex[info.name] = handleIndex;
+                    program.AddUniform(handle, info.type, info.num);
                 }
             } };
 
         std::unique_ptr<ProgramData> program = std::make_unique<ProgramData>(m_deviceContext);
-        auto vertexShader = bgfx::createShader(bgfx::copy(shaderInfo->VertexBytes.data(), static_cast<uint32_t>(shaderInfo->VertexBytes.size())));
-        InitUniformInfos(vertexShader, shaderInfo->UniformStages, program->UniformInfos, program->UniformNameToIndex);
+        auto vertexShader = bgfx::createShader(bgfx::copy(shaderInfo.VertexBytes.data(), static_cast<uint32_t>(shaderInfo.VertexBytes.size())));
+        InitUniformInfos(vertexShader, shaderInfo.UniformStages, *program);
 
-        auto fragmentShader = bgfx::createShader(bgfx::copy(shaderInfo->FragmentBytes.data(), static_cast<uint32_t>(shaderInfo->FragmentBytes.size())));
-        InitUniformInfos(fragmentShader, shaderInfo->UniformStages, program->UniformInfos, program->UniformNameToIndex);
+        auto fragmentShader = bgfx::createShader(bgfx::copy(shaderInfo.FragmentBytes.data(), static_cast<uint32_t>(shaderInfo.FragmentBytes.size())));
+        InitUniformInfos(fragmentShader, shaderInfo.UniformStages, *program);
 
         program->Handle = bgfx::createProgram(vertexShader, fragmentShader, true);
-        program->VertexAttributeLocations = std::move(shaderInfo->VertexAttributeLocations);
+        if (auto capture{CommandCaptureImpl::GetImpl()})
+        {
+            capture->AddProgram(program->Handle, shaderInfo.VertexBytes, shaderInfo.FragmentBytes);
+        }
+        program->VertexAttributeLocations = shaderInfo.VertexAttributeLocations;
 
         return program;
     }
@@ -1128,7 +1376,13 @@ namespace Babylon
 
     void NativeEngine::SetProgram(NativeDataStream::Reader& data)
     {
-        m_currentProgram = data.ReadPointer<ProgramData>();
+        ProgramData* program = data.ReadPointer<ProgramData>();
+        if (program != m_currentProgram)
+        {
+            FlushMergedDraw();
+        }
+
+        m_currentProgram = program;
     }
 
     void NativeEngine::SetState(NativeDataStream::Reader& data)
@@ -1140,6 +1394,7 @@ namespace Babylon
         const bool cullBackFaces = data.ReadUint32();
         const bool reverseSide = data.ReadUint32();
 
+        const auto previousState{m_engineState};
         m_engineState &= ~(BGFX_STATE_CULL_MASK | BGFX_STATE_FRONT_CCW);
         m_engineState |= reverseSide ? 0 : BGFX_STATE_FRONT_CCW;
 
@@ -1147,11 +1402,15 @@ namespace Babylon
         {
             m_engineState |= cullBackFaces ? BGFX_STATE_CULL_CCW : BGFX_STATE_CULL_CW;
         }
+
+        m_redundantCommand = (m_engineState == previousState);
     }
 
     void NativeEngine::DeleteProgram(NativeDataStream::Reader& data)
     {
-        data.ReadPointer<ProgramData>()->Dispose();
+        ProgramData* program = data.ReadPointer<ProgramData>();
+        FlushMergedDraw();
+        program->Dispose();
     }
 
     void NativeEngine::SetZOffset(NativeDataStream::Reader& data)
@@ -1159,6 +1418,7 @@ namespace Babylon
         /*const auto zOffset =*/data.ReadFloat32();
 
         // STUB: Stub.
+        m_redundantCommand = true;
     }
 
     void NativeEngine::SetZOffsetUnits(NativeDataStream::Reader& data)
@@ -1166,45 +1426,63 @@ namespace Babylon
         /*const auto zOffsetUnits =*/data.ReadFloat32();
 
         // STUB: Stub.
+        m_redundantCommand = true;
     }
 
     void NativeEngine::SetDepthTest(NativeDataStream::Reader& data)
     {
         const auto depthTest = data.ReadUint32();
 
+        const auto previousState{m_engineState};
         m_engineState &= ~BGFX_STATE_DEPTH_TEST_MASK;
         m_engineState |= depthTest;
+
+        m_redundantCommand = (m_engineState == previousState);
     }
 
     void NativeEngine::SetDepthWrite(NativeDataStream::Reader& data)
     {
         const auto enable = static_cast<bool>(data.ReadUint32());
 
+        const auto previousState{m_engineState};
         m_engineState &= ~BGFX_STATE_WRITE_Z;
         m_engineState |= enable ? BGFX_STATE_WRITE_Z : 0;
+
+        m_redundantCommand = (m_engineState == previousState);
     }
 
     void NativeEngine::SetColorWrite(NativeDataStream::Reader& data)
     {
         const auto enable = static_cast<bool>(data.ReadUint32());
 
+        const auto previousState{m_engineState};
         m_engineState &= ~(BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A);
         m_engineState |= enable ? (BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A) : 0;
+
+        m_redundantCommand = (m_engineState == previousState);
     }
 
     void NativeEngine::SetBlendMode(NativeDataStream::Reader& data)
     {
         const auto blendMode = data.ReadUint32();
 
+        const auto previousState{m_engineState};
         m_engineState &= ~BGFX_STATE_BLEND_MASK;
         m_engineState |= blendMode;
+
+        m_redundantCommand = (m_engineState == previousState);
     }
 
     void NativeEngine::SetInt(NativeDataStream::Reader& data)
     {
         const auto& uniformInfo{*data.ReadPointer<UniformInfo>()};
         const auto value{static_cast<float>(data.ReadInt32())};
-        m_currentProgram->SetUniform(uniformInfo.Handle, gsl::make_span(&value, 1));
+        SetUniform(uniformInfo, gsl::make_span(&value, 1));
+    }
+
+    void NativeEngine::SetUniform(const UniformInfo& uniformInfo, gsl::span<const float> data, size_t elementLength)
+    {
+        m_redundantCommand = !m_currentProgram->SetUniform(uniformInfo.Handle, data, elementLength);
     }
 
     template<int size, typename arrayType>
@@ -1222,7 +1500,7 @@ namespace Babylon
             m_scratch.insert(m_scratch.end(), values, values + 4);
         }
 
-        m_currentProgram->SetUniform(uniformInfo.Handle, m_scratch, elementLength / size);
+        SetUniform(uniformInfo, m_scratch, elementLength / size);
     }
 
     template<int size>
@@ -1236,7 +1514,7 @@ namespace Babylon
             (size > 3) ? data.ReadFloat32() : 0.f,
         };
 
-        m_currentProgram->SetUniform(uniformInfo.Handle, values);
+        SetUniform(uniformInfo, values);
     }
 
     template<int size>
@@ -1258,11 +1536,11 @@ namespace Babylon
                     matrixValues[line * 4 + col] = matrix[index++];
                 }
             }
-            m_currentProgram->SetUniform(uniformInfo.Handle, matrixValues);
+            SetUniform(uniformInfo, matrixValues);
         }
         else
         {
-            m_currentProgram->SetUniform(uniformInfo.Handle, matrix);
+            SetUniform(uniformInfo, matrix);
         }
     }
 
@@ -1329,7 +1607,7 @@ namespace Babylon
 
         assert(matrices.size() % 16 == 0);
 
-        m_currentProgram->SetUniform(uniform.Handle, matrices, matrices.size() / 16);
+        SetUniform(uniform, matrices, matrices.size() / 16);
     }
 
     void NativeEngine::SetMatrix2x2(NativeDataStream::Reader& data)
@@ -1410,7 +1688,14 @@ namespace Babylon
         const auto dataSpan = gsl::make_span(static_cast<uint8_t*>(data.ArrayBuffer().Data()) + data.ByteOffset(), data.ByteLength());
 
         arcana::make_task(arcana::threadpool_scheduler, *m_cancellationSource,
-            [dataSpan, generateMips, invertY, srgb, texture, cancellationSource{m_cancellationSource}]() {
+            [dataSpan, generateMips, invertY, srgb, texture, transcoder{m_ktx2Transcoder}, cancellationSource{m_cancellationSource}]() {
+                if (Ktx2Loader::IsContainer(dataSpan))
+                {
+                    const Ktx2Loader::Image image{Ktx2Loader::Load(Graphics::DeviceContext::GetDefaultAllocator(), dataSpan, 1, transcoder, srgb, generateMips)};
+                    LoadTextureFromImage(texture, image.Faces.front(), image.Srgb);
+                    return;
+                }
+
                 bimg::ImageContainer* image{ParseImage(Graphics::DeviceContext::GetDefaultAllocator(), dataSpan)};
                 image = PrepareImage(Graphics::DeviceContext::GetDefaultAllocator(), image, invertY, srgb, generateMips);
                 LoadTextureFromImage(texture, image, srgb);
@@ -1525,23 +1810,53 @@ namespace Babylon
         const auto onError{info[6].As<Napi::Function>()};
 
         std::array<Napi::Reference<Napi::TypedArray>, 6> dataRefs;
-        std::array<arcana::task<bimg::ImageContainer*, std::exception_ptr>, 6> tasks;
-        for (uint32_t face = 0; face < data.Length(); face++)
+        arcana::task<void, std::exception_ptr> loadTask{};
+
+        // A single KTX2 container holds all the faces of a cube map.
+        if (data.Length() == 1)
         {
-            const auto typedArray{data[face].As<Napi::TypedArray>()};
+            const auto typedArray{data[0u].As<Napi::TypedArray>()};
             const auto dataSpan{gsl::make_span(static_cast<uint8_t*>(typedArray.ArrayBuffer().Data()) + typedArray.ByteOffset(), typedArray.ByteLength())};
-            dataRefs[face] = Napi::Persistent(typedArray);
-            tasks[face] = arcana::make_task(arcana::threadpool_scheduler, *m_cancellationSource, [dataSpan, invertY, generateMips, srgb]() {
-                bimg::ImageContainer* image{ParseImage(Graphics::DeviceContext::GetDefaultAllocator(), dataSpan)};
-                image = PrepareImage(Graphics::DeviceContext::GetDefaultAllocator(), image, invertY, srgb, generateMips);
-                return image;
+            if (!Ktx2Loader::IsContainer(dataSpan))
+            {
+                throw Napi::Error::New(info.Env(), "The single image of a cube texture must be a KTX2 container.");
+            }
+
+            dataRefs[0] = Napi::Persistent(typedArray);
+            loadTask = arcana::make_task(arcana::threadpool_scheduler, *m_cancellationSource, [dataSpan, generateMips, srgb, transcoder{m_ktx2Transcoder}]() {
+                return Ktx2Loader::Load(Graphics::DeviceContext::GetDefaultAllocator(), dataSpan, 6, transcoder, srgb, generateMips);
+            }).then(arcana::inline_scheduler, *m_cancellationSource, [texture, cancellationSource{m_cancellationSource}](Ktx2Loader::Image image) {
+                LoadCubeTextureFromImages(texture, image.Faces, image.Srgb);
             });
         }
+        else
+        {
+            std::array<arcana::task<bimg::ImageContainer*, std::exception_ptr>, 6> tasks;
+            for (uint32_t face = 0; face < data.Length(); face++)
+            {
+                const auto typedArray{data[face].As<Napi::TypedArray>()};
+                const auto dataSpan{gsl::make_span(static_cast<uint8_t*>(typedArray.ArrayBuffer().Data()) + typedArray.ByteOffset(), typedArray.ByteLength())};
+                dataRefs[face] = Napi::Persistent(typedArray);
+                tasks[face] = arcana::make_task(arcana::threadpool_scheduler, *m_cancellationSource, [dataSpan, invertY, generateMips, srgb, transcoder{m_ktx2Transcoder}]() {
+                    // The faces of a cube map are all loaded as sRGB or not as requested, whatever their containers declare.
+                    if (Ktx2Loader::IsContainer(dataSpan))
+                    {
+                        return Ktx2Loader::Load(Graphics::DeviceContext::GetDefaultAllocator(), dataSpan, 1, transcoder, srgb, generateMips).Faces.front();
+                    }
 
-        arcana::when_all(gsl::make_span(tasks))
-            .then(arcana::inline_scheduler, *m_cancellationSource, [texture, srgb, cancellationSource{m_cancellationSource}](std::vector<bimg::ImageContainer*> images) {
-                LoadCubeTextureFromImages(texture, images, srgb);
-            })
+                    bimg::ImageContainer* image{ParseImage(Graphics::DeviceContext::GetDefaultAllocator(), dataSpan)};
+                    image = PrepareImage(Graphics::DeviceContext::GetDefaultAllocator(), image, invertY, srgb, generateMips);
+                    return image;
+                });
+            }
+
+            loadTask = arcana::when_all(gsl::make_span(tasks))
+                .then(arcana::inline_scheduler, *m_cancellationSource, [texture, srgb, cancellationSource{m_cancellationSource}](std::vector<bimg::ImageContainer*> images) {
+                    LoadCubeTextureFromImages(texture, images, srgb);
+                });
+        }
+
+        loadTask
             .then(m_runtimeScheduler, *m_cancellationSource, [dataRefs{std::move(dataRefs)}, onSuccessRef{Napi::Persistent(onSuccess)}, onErrorRef{Napi::Persistent(onError)}, cancellationSource{m_cancellationSource}](arcana::expected<void, std::exception_ptr> result) {
                 if (result.has_error())
                 {
@@ -1672,7 +1987,11 @@ namespace Babylon
         const UniformInfo* uniformInfo = data.ReadPointer<UniformInfo>();
         const Graphics::Texture* texture = data.ReadPointer<Graphics::Texture>();
 
-        encoder->setTexture(uniformInfo->Stage, uniformInfo->Handle, texture->Handle(), texture->SamplerFlags());
+        if (SetTextureBinding(uniformInfo->Stage, {uniformInfo->Handle.idx, texture->Handle().idx, texture->SamplerFlags()}) && !m_parallelEncoder)
+        {
+            FlushMergedDraw();
+            encoder->setTexture(uniformInfo->Stage, uniformInfo->Handle, texture->Handle(), texture->SamplerFlags());
+        }
     }
 
     void NativeEngine::UnsetTexture(NativeDataStream::Reader& data)
@@ -1681,15 +2000,48 @@ namespace Babylon
 
         const UniformInfo* uniformInfo = data.ReadPointer<UniformInfo>();
 
-        encoder->setTexture(uniformInfo->Stage, uniformInfo->Handle, BGFX_INVALID_HANDLE);
+        if (SetTextureBinding(uniformInfo->Stage, {uniformInfo->Handle.idx, bgfx::kInvalidHandle, UINT32_MAX}) && !m_parallelEncoder)
+        {
+            FlushMergedDraw();
+            encoder->setTexture(uniformInfo->Stage, uniformInfo->Handle, BGFX_INVALID_HANDLE);
+        }
     }
 
     void NativeEngine::DiscardAllTextures(NativeDataStream::Reader&)
     {
+        m_textureBindings.clear();
+
+        if (m_parallelEncoder)
+        {
+            m_textureBindingsChanged = true;
+            return;
+        }
+
+        FlushMergedDraw();
+
         bgfx::Encoder* encoder = GetUpdateToken().GetEncoder();
         encoder->discard(BGFX_DISCARD_BINDINGS);
     }
 
+    bool NativeEngine::SetTextureBinding(uint8_t stage, const TextureBinding& binding)
+    {
+        if (m_textureBindings.size() <= stage)
+        {
+            m_textureBindings.resize(stage + 1);
+        }
+
+        auto& currentBinding{m_textureBindings[stage]};
+        if (currentBinding && currentBinding->Uniform == binding.Uniform && currentBinding->Texture == binding.Texture && currentBinding->SamplerFlags == binding.SamplerFlags)
+        {
+            m_redundantCommand = true;
+            return false;
+        }
+
+        currentBinding = binding;
+        m_textureBindingsChanged = true;
+        return true;
+    }
+
     void NativeEngine::DeleteTexture(const Napi::CallbackInfo& info)
     {
         Graphics::Texture* texture = info[0].As<Napi::Pointer<Graphics::Texture>>().Get();
@@ -1702,7 +2054,7 @@ namespace Babylon
         const Napi::Env env{info.Env()};
 
         Graphics::Texture* texture{info[0].As<Napi::Pointer<Graphics::Texture>>().Get()};
-        uint8_t mipLevel{static_cast<uint8_t>(info[1].As<Napi::Number>().Uint32Value())};
+        const uint8_t mipLevel{static_cast<uint8_t>(info[1].As<Napi::Number>().Uint32Value())};
         const uint16_t x{static_cast<uint16_t>(info[2].As<Napi::Number>().Uint32Value())};
         const uint16_t y{static_cast<uint16_t>(info[3].As<Napi::Number>().Uint32Value())};
         const uint16_t width{static_cast<uint16_t>(info[4].As<Napi::Number>().Uint32Value())};
@@ -1744,78 +2096,78 @@ namespace Babylon
         }
         else
         {
-            bgfx::TextureHandle sourceTextureHandle{texture->Handle()};
-            auto tempTexture{false};
+            const bool convert{sourceTextureFormat != targetTextureFormat};
+            const bool flip{bgfx::getCaps()->originBottomLeft};
+            uint8_t* const destination{static_cast<uint8_t*>(buffer.Data()) + bufferOffset};
+
+            // RGBA8 pixels are read back to the ArrayBuffer directly. Other pixels are read back to a staging buffer,
+            // from which they are converted, flipped and copied to the ArrayBuffer in one pass.
+            std::shared_ptr<ReadbackPool::Staging> staging{};
+            arcana::task<void, std::exception_ptr> readTask{};
+            const uint32_t bytesPerPixel{sourceTextureInfo.bitsPerPixel / 8u};
+            size_t sourceOffset{0};
+            size_t sourcePitch{static_cast<size_t>(width) * bytesPerPixel};
+            bool direct{!convert};
 
             // If the image needs to be cropped (not starting at 0, or less than full width/height (accounting for requested mip level)),
-            // or if the texture was not created with the BGFX_TEXTURE_READ_BACK flag, then blit it to a temp texture.
-            if (x != 0 || y != 0 || width != (texture->Width() >> mipLevel) || height != (texture->Height() >> mipLevel) || (texture->Flags() & BGFX_TEXTURE_READ_BACK) == 0)
+            // if the texture was not created with the BGFX_TEXTURE_READ_BACK flag, or if its pixels need to be converted,
+            // then blit it to a pooled staging texture.
+            if (x != 0 || y != 0 || width != (texture->Width() >> mipLevel) || height != (texture->Height() >> mipLevel) || (texture->Flags() & BGFX_TEXTURE_READ_BACK) == 0 || convert)
             {
-                const bgfx::TextureHandle blitTextureHandle{bgfx::createTexture2D(width, height, /*hasMips*/ false, /*numLayers*/ 1, sourceTextureFormat, BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK)};
-                bgfx::Encoder* encoder{GetUpdateToken().GetEncoder()};
-                encoder->blit(static_cast<uint16_t>(bgfx::getCaps()->limits.maxViews - 1), blitTextureHandle, /*dstMip*/ 0, /*dstX*/ 0, /*dstY*/ 0, /*dstZ*/ 0, sourceTextureHandle, mipLevel, x, y, /*srcZ*/ 0, width, height, /*depth*/ 0);
+                uint16_t stagingX{0};
+                uint16_t stagingY{0};
+                if (auto region{m_readbackPool.Reserve(width, height, sourceTextureFormat)})
+                {
+                    staging = std::move(region->Atlas);
+                    stagingX = region->X;
+                    stagingY = region->Y;
+                    readTask = std::move(region->Read);
+                    direct = false;
+                }
+                else
+                {
+                    staging = m_readbackPool.Acquire(width, height, sourceTextureFormat);
+                    if (direct)
+                    {
+                        readTask = m_deviceContext.ReadTextureAsync(staging->Handle, {destination, targetTextureInfo.storageSize});
+                    }
+                    else
+                    {
+                        staging->Data.resize(sourceTextureInfo.storageSize);
+                        readTask = m_deviceContext.ReadTextureAsync(staging->Handle, staging->Data);
+                    }
+                }
 
-                sourceTextureHandle = blitTextureHandle;
-                tempTexture = true;
+                bgfx::Encoder* encoder{GetUpdateToken().GetEncoder()};
+                encoder->blit(Graphics::DeviceContext::GetReservedViewId(Graphics::DeviceContext::ReservedView::ReadBack), staging->Handle, /*dstMip*/ 0, stagingX, stagingY, /*dstZ*/ 0, texture->Handle(), mipLevel, x, y, /*srcZ*/ 0, width, height, /*depth*/ 0);
 
-                // The requested mip level was blitted, so the source texture now has just one mip, so reset the mip level to 0.
-                mipLevel = 0;
+                sourcePitch = static_cast<size_t>(staging->Width) * bytesPerPixel;
+                sourceOffset = stagingY * sourcePitch + stagingX * bytesPerPixel;
+            }
+            else
+            {
+                readTask = m_deviceContext.ReadTextureAsync(texture->Handle(), {destination, targetTextureInfo.storageSize}, mipLevel);
             }
 
-            // Allocate a buffer to store the source pixel data.
-            std::vector<uint8_t> textureBuffer(sourceTextureInfo.storageSize);
-
-            // Read the source texture.
-            m_deviceContext.ReadTextureAsync(sourceTextureHandle, textureBuffer, mipLevel)
-                .then(arcana::inline_scheduler, *m_cancellationSource, [textureBuffer{std::move(textureBuffer)}, sourceTextureInfo, targetTextureInfo]() mutable {
-                    // If the source texture format does not match the target texture format, convert it.
-                    if (targetTextureInfo.format != sourceTextureInfo.format)
+            readTask
+                .then(arcana::inline_scheduler, *m_cancellationSource, [staging, direct, destination, sourceOffset, sourcePitch, sourceTextureInfo, targetTextureInfo, flip]() {
+                    if (direct)
                     {
-                        std::vector<uint8_t> convertedTextureBuffer(targetTextureInfo.storageSize);
-                        if (!bimg::imageConvert(&Graphics::DeviceContext::GetDefaultAllocator(), convertedTextureBuffer.data(), bimg::TextureFormat::Enum(targetTextureInfo.format), textureBuffer.data(), bimg::TextureFormat::Enum(sourceTextureInfo.format), sourceTextureInfo.width, sourceTextureInfo.height, /*depth*/ 1))
+                        if (flip)
                         {
-                            throw std::runtime_error{"Texture conversion to RBGA8 failed."};
+                            FlipImage({destination, targetTextureInfo.storageSize}, targetTextureInfo.height);
                         }
-                        textureBuffer = convertedTextureBuffer;
                     }
-
-                    // Ensure the final texture buffer has the expected size.
-                    assert(textureBuffer.size() == targetTextureInfo.storageSize);
-
-                    // Flip the image vertically if needed.
-                    if (bgfx::getCaps()->originBottomLeft)
+                    else
                     {
-                        FlipImage(textureBuffer, targetTextureInfo.height);
+                        CopyReadPixels(staging->Data.data() + sourceOffset, sourcePitch, sourceTextureInfo, destination, targetTextureInfo, flip);
                     }
-
-                    return textureBuffer;
                 })
-                .then(m_runtimeScheduler, *m_cancellationSource, [this, bufferRef{Napi::Persistent(buffer)}, bufferOffset, deferred, tempTexture, sourceTextureHandle](std::vector<uint8_t> textureBuffer) mutable {
-                    // Double check the destination buffer length. This is redundant with prior checks, but we'll be extra sure before the memcpy.
-                    assert(bufferRef.Value().ByteLength() - bufferOffset >= textureBuffer.size());
-
-                    // Copy the pixel data into the JS ArrayBuffer.
-                    uint8_t* buffer{static_cast<uint8_t*>(bufferRef.Value().Data())};
-                    std::memcpy(buffer + bufferOffset, textureBuffer.data(), textureBuffer.size());
-
-                    // Dispose of the texture handle before resolving the promise.
-                    // TODO: Handle properly handle stale handles after BGFX shutdown
-                    if (tempTexture && !m_cancellationSource->cancelled())
-                    {
-                        bgfx::destroy(sourceTextureHandle);
-                        tempTexture = false;
-                    }
-
+                .then(m_runtimeScheduler, *m_cancellationSource, [bufferRef{Napi::Persistent(buffer)}, deferred, staging]() {
+                    // The staging texture returns to the pool once the last read of its pixels completes.
                     deferred.Resolve(bufferRef.Value());
                 })
-                .then(m_runtimeScheduler, arcana::cancellation::none(), [this, env, deferred, tempTexture, sourceTextureHandle](const arcana::expected<void, std::exception_ptr>& result) {
-                    // Dispose of the texture handle if not yet disposed.
-                    // TODO: Handle properly handle stale handles after BGFX shutdown
-                    if (tempTexture && !m_cancellationSource->cancelled())
-                    {
-                        bgfx::destroy(sourceTextureHandle);
-                    }
-
+                .then(m_runtimeScheduler, arcana::cancellation::none(), [env, deferred](const arcana::expected<void, std::exception_ptr>& result) {
                     if (result.has_error())
                     {
                         deferred.Reject(Napi::Error::New(env, result.error()).Value());
@@ -1835,6 +2187,39 @@ namespace Babylon
         const bool generateDepth = info[4].As<Napi::Boolean>();
         const uint32_t samples = info[5].IsUndefined() ? 1 : info[5].As<Napi::Number>().Uint32Value();
 
+        if (generateStencilBuffer && !generateDepth)
+        {
+            JsConsoleLogger::LogWarn(info.Env(), "Stencil without depth is not supported, assuming depth and stencil");
+        }
+
+        bgfx::TextureHandle depthStencilTextureHandle = BGFX_INVALID_HANDLE;
+        Graphics::FrameBuffer* frameBuffer{};
+        try
+        {
+            frameBuffer = CreateFrameBufferInternal(texture, width, height, generateStencilBuffer, generateDepth, samples, depthStencilTextureHandle).release();
+        }
+        catch (const std::exception& ex)
+        {
+            throw Napi::Error::New(info.Env(), ex.what());
+        }
+
+        return Napi::Pointer<Graphics::FrameBuffer>::Create(info.Env(), frameBuffer, [frameBuffer, depthStencilTextureHandle]() {
+            if (auto capture{CommandCaptureImpl::GetImpl()})
+            {
+                capture->RemoveFrameBuffer(frameBuffer);
+            }
+
+            if (bgfx::isValid(depthStencilTextureHandle))
+            {
+                bgfx::destroy(depthStencilTextureHandle);
+            }
+
+            delete frameBuffer;
+        });
+    }
+
+    std::unique_ptr<Graphics::FrameBuffer> NativeEngine::CreateFrameBufferInternal(Graphics::Texture* texture, uint16_t width, uint16_t height, bool generateStencilBuffer, bool generateDepth, uint32_t samples, bgfx::TextureHandle& depthStencilTextureHandle)
+    {
         std::array<bgfx::Attachment, 2> attachments{};
         uint8_t numAttachments = 0;
 
@@ -1843,14 +2228,9 @@ namespace Babylon
             attachments[numAttachments++].init(texture->Handle());
         }
 
-        bgfx::TextureHandle depthStencilTextureHandle = BGFX_INVALID_HANDLE;
+        depthStencilTextureHandle = BGFX_INVALID_HANDLE;
         if (generateStencilBuffer || generateDepth)
         {
-            if (generateStencilBuffer && !generateDepth)
-            {
-                JsConsoleLogger::LogWarn(info.Env(), "Stencil without depth is not supported, assuming depth and stencil");
-            }
-
             auto flags = BGFX_TEXTURE_RT_WRITE_ONLY | RenderTargetSamplesToBgfxMsaaFlag(samples);
 #ifdef ANDROID
             // On Android with Mali GPU (Oppo Find x5 lite, Google Pixel 8, Samsung Galaxy Tab Active 3, ...)
@@ -1877,20 +2257,19 @@ namespace Babylon
             if (bgfx::isValid(depthStencilTextureHandle))
             {
                 bgfx::destroy(depthStencilTextureHandle);
+                depthStencilTextureHandle = BGFX_INVALID_HANDLE;
             }
 
-            throw Napi::Error::New(info.Env(), "Failed to create frame buffer");
+            throw std::runtime_error{"Failed to create frame buffer"};
         }
 
-        Graphics::FrameBuffer* frameBuffer = new Graphics::FrameBuffer(m_deviceContext, frameBufferHandle, width, height, false, generateDepth, generateStencilBuffer);
-        return Napi::Pointer<Graphics::FrameBuffer>::Create(info.Env(), frameBuffer, [frameBuffer, depthStencilTextureHandle]() {
-            if (bgfx::isValid(depthStencilTextureHandle))
-            {
-                bgfx::destroy(depthStencilTextureHandle);
-            }
+        auto frameBuffer{std::make_unique<Graphics::FrameBuffer>(m_deviceContext, frameBufferHandle, width, height, false, generateDepth, generateStencilBuffer)};
+        if (auto capture{CommandCaptureImpl::GetImpl()})
+        {
+            capture->AddFrameBuffer(frameBuffer.get(), texture, width, height, generateStencilBuffer, generateDepth, samples);
+        }
 
-            delete frameBuffer;
-        });
+        return frameBuffer;
     }
 
     // TODO: This doesn't get called when an Engine instance is disposed.
@@ -1904,6 +2283,16 @@ namespace Babylon
         auto encoder = GetUpdateToken().GetEncoder();
 
         Graphics::FrameBuffer* frameBuffer = data.ReadPointer<Graphics::FrameBuffer>();
+        if (frameBuffer == m_boundFrameBuffer && !m_boundFrameBufferNeedsRebinding.Get(*encoder) && frameBuffer->HasLastView())
+        {
+            // Binding the frame buffer again would only start a new view. A new view is still needed when other views
+            // were acquired since, such as the views of mip generation, so that later draws are ordered after them.
+            m_redundantCommand = true;
+            return;
+        }
+
+        FlushMergedDraw();
+
         m_boundFrameBuffer->Unbind(*encoder);
         m_boundFrameBuffer = frameBuffer;
         m_boundFrameBuffer->Bind(*encoder);
@@ -1919,6 +2308,8 @@ namespace Babylon
         assert(m_boundFrameBuffer == frameBuffer);
         UNUSED(frameBuffer);
 
+        FlushMergedDraw();
+
         m_boundFrameBuffer->Unbind(*encoder);
         m_boundFrameBuffer = nullptr;
         m_boundFrameBufferNeedsRebinding.Set(*encoder, false);
@@ -1934,9 +2325,44 @@ namespace Babylon
         const uint32_t indexStart = data.ReadUint32();
         const uint32_t indexCount = data.ReadUint32();
 
+        const TopologyConversion conversion{GetTopologyConversion(fillMode)};
+        TopologyConverter::Indices converted{};
+        if (!ConvertIndices(conversion, indexStart, indexCount, converted))
+        {
+            return;
+        }
+
+        if (m_parallelEncoder)
+        {
+            ParallelEncoder::Draw draw{};
+            draw.Indexed = !bgfx::isValid(converted.Handle);
+            draw.Indices = converted.Handle;
+            draw.IndexStart = draw.Indexed ? indexStart : 0;
+            draw.IndexCount = draw.Indexed ? indexCount : converted.Count;
+            draw.VertexCount = std::numeric_limits<uint32_t>::max();
+            RecordDraw(encoder, fillMode, draw);
+            return;
+        }
+
+        if (m_drawMerging && conversion == TopologyConversion::None && fillMode <= MATERIAL_LINE_LIST_DRAW_MODE)
+        {
+            MergeDrawIndexed(encoder, fillMode, indexStart, indexCount);
+            return;
+        }
+
+        FlushMergedDraw();
+
+        if (bgfx::isValid(converted.Handle))
+        {
+            encoder->setIndexBuffer(converted.Handle, 0, converted.Count);
+        }
+        else if (m_boundVertexArray != nullptr)
+        {
+            m_boundVertexArray->SetIndexBuffer(encoder, indexStart, indexCount, fillMode == MATERIAL_TRIANGLE_FILL_MODE);
+        }
+
         if (m_boundVertexArray != nullptr)
         {
-            m_boundVertexArray->SetIndexBuffer(encoder, indexStart, indexCount);
             m_boundVertexArray->SetVertexBuffers(encoder, 0, std::numeric_limits<uint32_t>::max());
         }
 
@@ -1952,9 +2378,39 @@ namespace Babylon
         const uint32_t indexCount = data.ReadUint32();
         const uint32_t instanceCount = data.ReadUint32();
 
+        const TopologyConversion conversion{GetTopologyConversion(fillMode)};
+        TopologyConverter::Indices converted{};
+        if (!ConvertIndices(conversion, indexStart, indexCount, converted))
+        {
+            return;
+        }
+
+        if (m_parallelEncoder)
+        {
+            ParallelEncoder::Draw draw{};
+            draw.Indexed = !bgfx::isValid(converted.Handle);
+            draw.Indices = converted.Handle;
+            draw.IndexStart = draw.Indexed ? indexStart : 0;
+            draw.IndexCount = draw.Indexed ? indexCount : converted.Count;
+            draw.VertexCount = std::numeric_limits<uint32_t>::max();
+            draw.InstanceCount = instanceCount;
+            RecordDraw(encoder, fillMode, draw);
+            return;
+        }
+
+        FlushMergedDraw();
+
+        if (bgfx::isValid(converted.Handle))
+        {
+            encoder->setIndexBuffer(converted.Handle, 0, converted.Count);
+        }
+        else if (m_boundVertexArray != nullptr)
+        {
+            m_boundVertexArray->SetIndexBuffer(encoder, indexStart, indexCount, fillMode == MATERIAL_TRIANGLE_FILL_MODE);
+        }
+
         if (m_boundVertexArray != nullptr)
         {
-            m_boundVertexArray->SetIndexBuffer(encoder, indexStart, indexCount);
             m_boundVertexArray->SetVertexBuffers(encoder, 0, std::numeric_limits<uint32_t>::max(), instanceCount);
         }
 
@@ -1971,6 +2427,34 @@ namespace Babylon
         const uint32_t verticesStart = data.ReadUint32();
         const uint32_t verticesCount = data.ReadUint32();
 
+        TopologyConverter::Indices sequence{};
+        if (const TopologyConversion conversion{GetTopologyConversion(fillMode)}; conversion != TopologyConversion::None)
+        {
+            sequence = m_topologyConverter.ConvertSequence(conversion, verticesCount);
+            if (!bgfx::isValid(sequence.Handle))
+            {
+                return;
+            }
+        }
+
+        if (m_parallelEncoder)
+        {
+            ParallelEncoder::Draw draw{};
+            draw.Indices = sequence.Handle;
+            draw.IndexCount = sequence.Count;
+            draw.VertexStart = verticesStart;
+            draw.VertexCount = verticesCount;
+            RecordDraw(encoder, fillMode, draw);
+            return;
+        }
+
+        FlushMergedDraw();
+
+        if (bgfx::isValid(sequence.Handle))
+        {
+            encoder->setIndexBuffer(sequence.Handle, 0, sequence.Count);
+        }
+
         if (m_boundVertexArray != nullptr)
         {
             m_boundVertexArray->SetVertexBuffers(encoder, verticesStart, verticesCount);
@@ -1988,6 +2472,35 @@ namespace Babylon
         const uint32_t verticesCount = data.ReadUint32();
         const uint32_t instanceCount = data.ReadUint32();
 
+        TopologyConverter::Indices sequence{};
+        if (const TopologyConversion conversion{GetTopologyConversion(fillMode)}; conversion != TopologyConversion::None)
+        {
+            sequence = m_topologyConverter.ConvertSequence(conversion, verticesCount);
+            if (!bgfx::isValid(sequence.Handle))
+            {
+                return;
+            }
+        }
+
+        if (m_parallelEncoder)
+        {
+            ParallelEncoder::Draw draw{};
+            draw.Indices = sequence.Handle;
+            draw.IndexCount = sequence.Count;
+            draw.VertexStart = verticesStart;
+            draw.VertexCount = verticesCount;
+            draw.InstanceCount = instanceCount;
+            RecordDraw(encoder, fillMode, draw);
+            return;
+        }
+
+        FlushMergedDraw();
+
+        if (bgfx::isValid(sequence.Handle))
+        {
+            encoder->setIndexBuffer(sequence.Handle, 0, sequence.Count);
+        }
+
         if (m_boundVertexArray != nullptr)
         {
             m_boundVertexArray->SetVertexBuffers(encoder, verticesStart, verticesCount, instanceCount);
@@ -1998,6 +2511,9 @@ namespace Babylon
 
     void NativeEngine::Clear(NativeDataStream::Reader& data)
     {
+        // Clearing touches the view on the encoder, which would submit the pending draw.
+        FlushMergedDraw();
+
         bgfx::Encoder* encoder{GetUpdateToken().GetEncoder()};
 
         uint16_t flags{0};
@@ -2181,14 +2697,40 @@ namespace Babylon
     {
         const auto callback{info[0].As<Napi::Function>()};
 
+        // The pixels are encoded on the worker thread that converts them when a mime type is given.
+        Graphics::BgfxCallback::ScreenShotFormat format{Graphics::BgfxCallback::ScreenShotFormat::RGBA8};
+        if (info.Length() > 1 && info[1].IsString())
+        {
+            const auto mimeType{info[1].As<Napi::String>().Utf8Value()};
+            if (mimeType != "image/png")
+            {
+                throw Napi::Error::New(info.Env(), "Unsupported frame buffer data mime type: " + mimeType);
+            }
+
+            format = Graphics::BgfxCallback::ScreenShotFormat::PNG;
+        }
+
         auto callbackPtr{std::make_shared<Napi::FunctionReference>(Napi::Persistent(callback))};
-        m_deviceContext.RequestScreenShot([this, callbackPtr{std::move(callbackPtr)}](std::vector<uint8_t> array) {
-            m_runtime.Dispatch([callbackPtr{std::move(callbackPtr)}, array{std::move(array)}](Napi::Env env) {
-                auto arrayBuffer{Napi::ArrayBuffer::New(env, const_cast<uint8_t*>(array.data()), array.size())};
-                auto typedArray{Napi::Uint8Array::New(env, array.size(), arrayBuffer, 0)};
+        m_deviceContext.RequestScreenShot([&runtime{m_runtime}, callbackPtr{std::move(callbackPtr)}](std::vector<uint8_t> array, std::exception_ptr error) {
+            // The data is moved to an external ArrayBuffer, which owns it for as long as JavaScript references it.
+            auto data{std::make_shared<std::vector<uint8_t>>(std::move(array))};
+            runtime.Dispatch([callbackPtr{std::move(callbackPtr)}, data{std::move(data)}, error](Napi::Env env) {
+                // A screenshot that could not be produced is reported to the callback with an error as its only argument,
+                // which JavaScript tells apart from the data with instanceof Error.
+                if (error)
+                {
+                    callbackPtr->Value().Call({Napi::Error::New(env, error).Value()});
+                    return;
+                }
+
+                auto arrayBuffer{Napi::ArrayBuffer::New(
+                    env, data->data(), data->size(),
+                    [](Napi::Env, void*, std::shared_ptr<std::vector<uint8_t>>* owner) { delete owner; },
+                    new std::shared_ptr<std::vector<uint8_t>>{data})};
+                auto typedArray{Napi::Uint8Array::New(env, data->size(), arrayBuffer, 0)};
                 callbackPtr->Value().Call({typedArray});
             });
-        });
+        }, format);
     }
 
     void NativeEngine::SetStencil(NativeDataStream::Reader& data)
@@ -2200,6 +2742,7 @@ namespace Babylon
         const uint32_t func{data.ReadUint32()};
         const uint32_t ref{data.ReadUint32()};
 
+        const auto previousStencilState{m_stencilState};
         m_stencilState = BGFX_STENCIL_FUNC_RMASK(0xFF); //  always 0xFF
         m_stencilState |= stencilOpFail;
         m_stencilState |= depthOpFail;
@@ -2216,10 +2759,14 @@ namespace Babylon
         }
         m_stencilState |= func;
         m_stencilState |= BGFX_STENCIL_FUNC_REF(ref);
+
+        m_redundantCommand = (m_stencilState == previousStencilState);
     }
 
     void NativeEngine::SetViewPort(NativeDataStream::Reader& data)
     {
+        FlushMergedDraw();
+
         bgfx::Encoder* encoder{GetUpdateToken().GetEncoder()};
 
         const float x{data.ReadFloat32()};
@@ -2233,6 +2780,8 @@ namespace Babylon
 
     void NativeEngine::SetScissor(NativeDataStream::Reader& data)
     {
+        FlushMergedDraw();
+
         bgfx::Encoder* encoder{GetUpdateToken().GetEncoder()};
 
         const float x{data.ReadFloat32()};
@@ -2248,6 +2797,13 @@ namespace Babylon
         // TODO: This should be moved to the constructor once multi-update is available.
         Napi::Object jsCommandStream = info[0].ToObject();
         m_commandStream = Napi::ObjectWrap<NativeDataStream>::Unwrap(jsCommandStream.Get("_nativeDataStream").As<Napi::Object>());
+
+        // Older versions of nativeEngine.ts only pass the stream and always use function pointer encoding.
+        m_commandEncoding = info.Length() > 1 && !info[1].IsUndefined() ? static_cast<CommandEncoding>(info[1].As<Napi::Number>().Uint32Value()) : CommandEncoding::FunctionPointer;
+        if (m_commandEncoding != CommandEncoding::FunctionPointer && m_commandEncoding != CommandEncoding::Opcode)
+        {
+            throw Napi::Error::New(info.Env(), "Unsupported command encoding.");
+        }
     }
 
     void NativeEngine::SubmitCommands(const Napi::CallbackInfo& info)
@@ -2255,10 +2811,7 @@ namespace Babylon
         try
         {
             NativeDataStream::Reader reader = m_commandStream->GetReader();
-            while (reader.CanRead())
-            {
-                std::invoke(reader.ReadPointer<CommandFunctionPointerT>(), this, reader);
-            }
+            SubmitCommands(reader, m_commandEncoding);
         }
         catch (const std::exception& exception)
         {
@@ -2266,6 +2819,203 @@ namespace Babylon
         }
     }
 
+    void NativeEngine::SubmitCommands(NativeDataStream::Reader& reader, CommandEncoding encoding)
+    {
+        try
+        {
+            if (m_releaseQueue)
+            {
+                m_releaseQueue->Drain();
+            }
+
+            // Updates of dynamic buffers since the last submission apply to the draws of this one.
+            m_stagingRing->Flush();
+
+            // Other users of the encoder may have changed the texture bindings and uniforms since the last submission.
+            // Recorded draws set their own bindings and uniforms at the start of every view instead.
+            if (!m_parallelEncoder)
+            {
+                m_textureBindings.clear();
+            }
+
+            m_lastDrawProgram = nullptr;
+            m_lastDrawView.reset();
+
+            auto capture{CommandCaptureImpl::GetImpl()};
+            if (capture && capture->BeginFrame(m_deviceContext.GetWidth(), m_deviceContext.GetHeight()))
+            {
+                // The capture ends once the frame containing the commands has been rendered.
+                arcana::make_task(m_deviceContext.AfterRenderScheduler(), arcana::cancellation::none(), [capture]() {
+                    capture->EndFrame();
+                });
+            }
+
+            auto profiler{CommandProfilerImpl::GetImpl()};
+            if (profiler && profiler->BeginFrame())
+            {
+                arcana::make_task(m_deviceContext.AfterRenderScheduler(), arcana::cancellation::none(), [profiler]() {
+                    profiler->EndFrame();
+                });
+            }
+
+            if (capture && !capture->IsCapturingFrame())
+            {
+                capture.reset();
+            }
+
+            if (capture || profiler)
+            {
+                SubmitInstrumentedCommands(reader, encoding, capture.get(), profiler.get());
+            }
+            else if (encoding == CommandEncoding::Opcode)
+            {
+                while (reader.CanRead())
+                {
+                    const auto opcode{reader.ReadUint32()};
+                    if (opcode >= s_commandTable.size())
+                    {
+                        throw std::runtime_error{"Invalid command opcode " + std::to_string(opcode) + "."};
+                    }
+
+                    const auto command{s_commandTable[opcode]};
+                    m_redundantCommand = false;
+                    std::invoke(command, this, reader);
+                    FlushMergedDrawAfter(command);
+                }
+            }
+            else
+            {
+                while (reader.CanRead())
+                {
+                    const auto command{reader.ReadPointer<CommandFunctionPointerT>()};
+                    m_redundantCommand = false;
+                    std::invoke(command, this, reader);
+                    FlushMergedDrawAfter(command);
+                }
+            }
+
+            FlushMergedDraw();
+
+            if (m_parallelEncoder)
+            {
+                m_parallelEncoder->Encode(*GetUpdateToken().GetEncoder());
+            }
+        }
+        catch (...)
+        {
+            FlushMergedDraw();
+
+            if (m_parallelEncoder)
+            {
+                m_parallelEncoder->Discard();
+            }
+
+            throw;
+        }
+    }
+
+    CommandOpcode NativeEngine::GetCommandOpcode(CommandFunctionPointerT function)
+    {
+        // Member function pointers can only be compared for equality, so the table is indexed by their bytes, which are
+        // the bytes that JavaScript copied into the command stream.
+        using FunctionBytes = std::array<uint8_t, sizeof(CommandFunctionPointerT)>;
+        static const auto s_commandOpcodes{[]() {
+            std::map<FunctionBytes, CommandOpcode> opcodes{};
+            for (size_t index = 0; index < s_commandTable.size(); ++index)
+            {
+                FunctionBytes bytes{};
+                std::memcpy(bytes.data(), &s_commandTable[index], bytes.size());
+                opcodes.emplace(bytes, static_cast<CommandOpcode>(index));
+            }
+            return opcodes;
+        }()};
+
+        FunctionBytes bytes{};
+        std::memcpy(bytes.data(), &function, bytes.size());
+        const auto it{s_commandOpcodes.find(bytes)};
+        if (it == s_commandOpcodes.end())
+        {
+            throw std::runtime_error{"Unknown command function pointer."};
+        }
+
+        return it->second;
+    }
+
+    void NativeEngine::SubmitInstrumentedCommands(NativeDataStream::Reader& reader, CommandEncoding encoding, CommandCaptureImpl* capture, CommandProfilerImpl* profiler)
+    {
+        CommandProfilerImpl::CommandCounters counters{};
+
+        // The handlers report the native objects they read, which are the object references of the captured commands.
+        NativeDataStream::Reader::Position argumentsStart{};
+        const NativeDataStream::Reader::PointerListenerT pointerListener{[this, &reader, &argumentsStart](const std::type_info& type) {
+            if (const auto objectType{CommandCaptureImpl::GetObjectType(type)})
+            {
+                m_captureReferences.push_back({reader.WordsSince(argumentsStart), *objectType});
+            }
+        }};
+
+        if (capture)
+        {
+            reader.SetPointerListener(&pointerListener);
+        }
+
+        auto resetListener{gsl::finally([&reader]() { reader.SetPointerListener(nullptr); })};
+
+        while (reader.CanRead())
+        {
+            const auto commandStart{reader.GetPosition()};
+
+            CommandOpcode opcode{};
+            if (encoding == CommandEncoding::Opcode)
+            {
+                const auto value{reader.ReadUint32()};
+                if (value >= s_commandTable.size())
+                {
+                    throw std::runtime_error{"Invalid command opcode " + std::to_string(value) + "."};
+                }
+
+                opcode = static_cast<CommandOpcode>(value);
+            }
+            else
+            {
+                opcode = GetCommandOpcode(reader.ReadPointer<CommandFunctionPointerT>());
+            }
+
+            argumentsStart = reader.GetPosition();
+            m_captureReferences.clear();
+
+            const auto startTime{std::chrono::steady_clock::now()};
+            const auto command{s_commandTable[static_cast<size_t>(opcode)]};
+            m_redundantCommand = false;
+            std::invoke(command, this, reader);
+            FlushMergedDrawAfter(command);
+            const auto endTime{std::chrono::steady_clock::now()};
+
+            if (profiler)
+            {
+                const auto timeNs{static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count())};
+                auto& counter{counters[static_cast<size_t>(opcode)]};
+                ++counter.Count;
+                counter.Skipped += m_redundantCommand ? 1 : 0;
+                counter.TotalTimeNs += timeNs;
+                counter.MaxTimeNs = std::max(counter.MaxTimeNs, timeNs);
+                counter.Bytes += reader.WordsSince(commandStart) * sizeof(uint32_t);
+            }
+
+            if (capture)
+            {
+                m_captureScratch.clear();
+                reader.CopySince(argumentsStart, m_captureScratch);
+                capture->RecordCommand(opcode, m_captureScratch, m_captureReferences);
+            }
+        }
+
+        if (profiler)
+        {
+            profiler->AddCounters(counters);
+        }
+    }
+
     void NativeEngine::PopulateFrameStats(const Napi::CallbackInfo& info)
     {
         const auto updateToken{m_update.GetUpdateToken()};
@@ -2274,9 +3024,161 @@ namespace Babylon
         const double gpuTimeNs = (stats->gpuTimeEnd - stats->gpuTimeBegin) * toGpuNs;
         Napi::Object jsStatsObject = info[0].As<Napi::Object>();
         jsStatsObject.Set("gpuTimeNs", gpuTimeNs);
+
+        if (auto profiler{CommandProfilerImpl::GetImpl()})
+        {
+            const auto commandStats{profiler->GetLastFrameStats()};
+            Napi::Array jsCommandStats{Napi::Array::New(info.Env(), commandStats.size())};
+            for (uint32_t index = 0; index < commandStats.size(); ++index)
+            {
+                const auto& stats{commandStats[index]};
+                Napi::Object jsCommandStatsObject{Napi::Object::New(info.Env())};
+                jsCommandStatsObject.Set("name", stats.Name);
+                jsCommandStatsObject.Set("count", stats.Count);
+                jsCommandStatsObject.Set("skipped", stats.Skipped);
+                jsCommandStatsObject.Set("totalTimeNs", static_cast<double>(stats.TotalTimeNs));
+                jsCommandStatsObject.Set("maxTimeNs", static_cast<double>(stats.MaxTimeNs));
+                jsCommandStatsObject.Set("bytes", static_cast<double>(stats.Bytes));
+                jsCommandStats.Set(index, jsCommandStatsObject);
+            }
+
+            jsStatsObject.Set("commandStats", jsCommandStats);
+        }
     }
 
     void NativeEngine::DrawInternal(bgfx::Encoder* encoder, uint32_t fillMode)
+    {
+        auto& boundFrameBuffer = PrepareDraw(encoder, fillMode);
+
+        // Discard everything except textures since we keep the state of everything else.
+        boundFrameBuffer.Submit(*encoder, m_currentProgram->Handle, BGFX_DISCARD_ALL & ~BGFX_DISCARD_BINDINGS);
+    }
+
+    Graphics::FrameBuffer& NativeEngine::PrepareDraw(bgfx::Encoder* encoder, uint32_t fillMode)
+    {
+        // Draws using another program may have changed the values of uniforms with the same handles.
+        if (m_currentProgram != m_lastDrawProgram)
+        {
+            m_currentProgram->MarkUniformsDirty();
+            m_lastDrawProgram = m_currentProgram;
+        }
+
+        m_currentProgram->SubmitUniforms(*encoder);
+
+        auto& boundFrameBuffer = GetBoundFrameBuffer(*encoder);
+        encoder->setState(GetDrawState(boundFrameBuffer, fillMode));
+        boundFrameBuffer.SetStencil(*encoder, m_stencilState);
+        return boundFrameBuffer;
+    }
+
+    void NativeEngine::MergeDrawIndexed(bgfx::Encoder* encoder, uint32_t fillMode, uint32_t indexStart, uint32_t indexCount)
+    {
+        // Every other command that changes state flushes the pending draw, see FlushMergedDrawAfter, so this only
+        // needs to check that the draw continues its index range. The state is compared all the same since it is
+        // cheap and keeps a merge from ever applying the wrong state.
+        if (m_mergedDraw &&
+            m_boundVertexArray != nullptr &&
+            m_mergedDraw->Vertices == m_boundVertexArray &&
+            m_mergedDraw->Program == m_currentProgram &&
+            !m_currentProgram->HasDirtyUniforms() &&
+            m_mergedDraw->EngineState == m_engineState &&
+            m_mergedDraw->StencilState == m_stencilState &&
+            m_mergedDraw->FillMode == fillMode &&
+            m_mergedDraw->IndexStart + m_mergedDraw->IndexCount == indexStart &&
+            m_mergedDraw->ViewId == GetBoundFrameBuffer(*encoder).PrepareView(*encoder))
+        {
+            m_mergedDraw->IndexCount += indexCount;
+            m_boundVertexArray->SetIndexBuffer(encoder, m_mergedDraw->IndexStart, m_mergedDraw->IndexCount, fillMode == MATERIAL_TRIANGLE_FILL_MODE);
+            m_redundantCommand = true;
+            return;
+        }
+
+        FlushMergedDraw();
+
+        if (m_boundVertexArray != nullptr)
+        {
+            m_boundVertexArray->SetIndexBuffer(encoder, indexStart, indexCount, fillMode == MATERIAL_TRIANGLE_FILL_MODE);
+            m_boundVertexArray->SetVertexBuffers(encoder, 0, std::numeric_limits<uint32_t>::max());
+        }
+
+        auto& boundFrameBuffer = PrepareDraw(encoder, fillMode);
+        m_mergedDraw = MergedDraw{boundFrameBuffer.PrepareView(*encoder), m_currentProgram, m_boundVertexArray, m_engineState, m_stencilState, fillMode, indexStart, indexCount};
+    }
+
+    void NativeEngine::FlushMergedDraw()
+    {
+        if (m_mergedDraw)
+        {
+            // Discard everything except textures since we keep the state of everything else.
+            GetUpdateToken().GetEncoder()->submit(m_mergedDraw->ViewId, m_mergedDraw->Program->Handle, 0, BGFX_DISCARD_ALL & ~BGFX_DISCARD_BINDINGS);
+            m_mergedDraw.reset();
+        }
+    }
+
+    void NativeEngine::FlushMergedDrawAfter(CommandFunctionPointerT command)
+    {
+        // The pending draw is already prepared on the encoder. Handlers that use the encoder flush it first, and the
+        // ones that only change the state kept for the next draw flush it here, unless they found nothing to change.
+        // Indexed draws extend the pending draw instead, and program and vertex array changes flush it in their
+        // handlers since those commands do not report when they are redundant.
+        if (m_mergedDraw && !m_redundantCommand &&
+            command != &NativeEngine::DrawIndexed &&
+            command != &NativeEngine::SetProgram &&
+            command != &NativeEngine::BindVertexArray)
+        {
+            FlushMergedDraw();
+        }
+    }
+
+    void NativeEngine::RecordDraw(bgfx::Encoder* encoder, uint32_t fillMode, ParallelEncoder::Draw draw)
+    {
+        auto& boundFrameBuffer = GetBoundFrameBuffer(*encoder);
+        draw.ViewId = boundFrameBuffer.PrepareView(*encoder);
+        draw.Program = m_currentProgram->Handle;
+        draw.State = GetDrawState(boundFrameBuffer, fillMode);
+        draw.Stencil = boundFrameBuffer.HasStencil() ? m_stencilState : 0;
+        draw.Vertices = m_boundVertexArray;
+
+        if (m_boundVertexArray != nullptr)
+        {
+            m_boundVertexArray->Build();
+            draw.Instances = m_boundVertexArray->UpdateInstanceBuffer();
+        }
+
+        // Views may be encoded on different threads, so the first draw of every view sets all its uniforms and
+        // texture bindings.
+        const bool newView{draw.ViewId != m_lastDrawView};
+        m_lastDrawView = draw.ViewId;
+
+        if (newView || m_currentProgram != m_lastDrawProgram)
+        {
+            m_currentProgram->MarkUniformsDirty();
+            m_lastDrawProgram = m_currentProgram;
+        }
+
+        m_currentProgram->ForEachDirtyUniform([this](const ProgramData::UniformValue& value) {
+            const uint32_t size{value.MaxElementLength == 0 ? 0 : value.Capacity / value.MaxElementLength * value.ElementLength};
+            m_parallelEncoder->AddUniform(value.Handle, m_currentProgram->UniformData.data() + value.Offset, size, value.ElementLength);
+        });
+
+        if (newView || m_textureBindingsChanged)
+        {
+            for (size_t stage = 0; stage < m_textureBindings.size(); ++stage)
+            {
+                if (const auto& binding{m_textureBindings[stage]})
+                {
+                    m_parallelEncoder->AddTextureBinding({static_cast<uint8_t>(stage), {binding->Uniform}, {binding->Texture}, binding->SamplerFlags});
+                }
+            }
+
+            draw.ResetTextureBindings = true;
+            m_textureBindingsChanged = false;
+        }
+
+        m_parallelEncoder->AddDraw(draw);
+    }
+
+    uint64_t NativeEngine::GetDrawState(const Graphics::FrameBuffer& frameBuffer, uint32_t fillMode) const
     {
         uint64_t fillModeState{0}; // indexed triangle list
         switch (fillMode)
@@ -2300,7 +3202,8 @@ namespace Babylon
             }
             case 5: // MATERIAL_LineLoopDrawMode
             {
-                // TODO: unsupported mode
+                // Line loops are converted to line strips, see GetTopologyConversion.
+                fillModeState = BGFX_STATE_PT_LINESTRIP;
                 break;
             }
             case 6: // MATERIAL_LineStripDrawMode
@@ -2315,31 +3218,57 @@ namespace Babylon
             }
             case 8: // MATERIAL_TriangleFanDrawMode
             {
-                // TODO: unsupported mode
+                // Triangle fans are converted to triangle lists, see GetTopologyConversion.
+                fillModeState = 0;
                 break;
             }
         }
 
-        for (const auto& it : m_currentProgram->Uniforms)
+        if (frameBuffer.HasDepth())
         {
-            const ProgramData::UniformValue& value = it.second;
-            encoder->setUniform({it.first}, value.Data.data(), value.ElementLength);
+            return m_engineState | fillModeState;
         }
 
-        auto& boundFrameBuffer = GetBoundFrameBuffer(*encoder);
-        if (boundFrameBuffer.HasDepth())
+        return (m_engineState & ~BGFX_STATE_WRITE_Z) | fillModeState;
+    }
+
+    TopologyConversion NativeEngine::GetTopologyConversion(uint32_t fillMode) const
+    {
+        switch (fillMode)
         {
-            encoder->setState(m_engineState | fillModeState);
+            case MATERIAL_LINE_LOOP_DRAW_MODE:
+            {
+                return TopologyConversion::LoopToStrip;
+            }
+            case MATERIAL_TRIANGLE_FAN_DRAW_MODE:
+            {
+                return TopologyConversion::FanToList;
+            }
+            default:
+            {
+                return TopologyConversion::None;
+            }
         }
-        else
+    }
+
+    bool NativeEngine::ConvertIndices(TopologyConversion conversion, uint32_t indexStart, uint32_t indexCount, TopologyConverter::Indices& converted)
+    {
+        converted = {};
+        if (conversion == TopologyConversion::None || m_boundVertexArray == nullptr)
         {
-            encoder->setState((m_engineState & ~BGFX_STATE_WRITE_Z) | fillModeState);
+            return true;
         }
 
-        boundFrameBuffer.SetStencil(*encoder, m_stencilState);
+        // Ranges that cannot be converted are drawn with their original indices, while ranges without primitives
+        // once converted are not drawn at all.
+        const auto indices{m_boundVertexArray->ConvertIndices(conversion, indexStart, indexCount)};
+        if (!indices)
+        {
+            return true;
+        }
 
-        // Discard everything except textures since we keep the state of everything else.
-        boundFrameBuffer.Submit(*encoder, m_currentProgram->Handle, BGFX_DISCARD_ALL & ~BGFX_DISCARD_BINDINGS);
+        converted = *indices;
+        return converted.Count > 0;
     }
 
     Graphics::UpdateToken& NativeEngine::GetUpdateToken()
@@ -2348,6 +3277,7 @@ namespace Babylon
         {
             m_updateToken.emplace(m_update.GetUpdateToken());
             m_runtime.Dispatch([this](auto) {
+                m_readbackPool.EndBatches();
                 m_updateToken.reset();
             });
         }
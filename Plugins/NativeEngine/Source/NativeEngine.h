@@ -1,12 +1,20 @@
 #pragma once
 
-#include "NativeDataStream.h"
+#include "CommandCapture.h"
+#include "ParallelEncoder.h"
 #include "PerFrameValue.h"
+#include "ReadbackPool.h"
+#include "ReferencedBytes.h"
 #include "ShaderCompiler.h"
+#include "StagingRing.h"
+#include "TopologyConverter.h"
 #include "VertexArray.h"
 
 #include <Babylon/JsRuntime.h>
 #include <Babylon/JsRuntimeScheduler.h>
+#include <Babylon/Plugins/NativeEngine.h>
+#include <Babylon/Plugins/NativeEngine/CommandOpcodes.h>
+#include <Babylon/Plugins/NativeEngine/NativeDataStream.h>
 
 #include <Babylon/Graphics/DeviceContext.h>
 #include <Babylon/Graphics/BgfxCallback.h>
@@ -23,10 +31,17 @@
 #include <gsl/gsl>
 
 #include <arcana/threading/cancellation.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
 #include <unordered_map>
 
 namespace Babylon
 {
+    class CommandProfilerImpl;
+    class CommandReplayImpl;
+
     struct UniformInfo final
     {
         UniformInfo(uint8_t stage, bgfx::UniformHandle handle, size_t maxElementLength)
@@ -57,6 +72,9 @@ namespace Babylon
         ProgramData(ProgramData&& other) noexcept
             : Handle{other.Handle}
             , Uniforms{std::move(other.Uniforms)}
+            , UniformData{std::move(other.UniformData)}
+            , UniformSlots{std::move(other.UniformSlots)}
+            , DirtyUniforms{std::move(other.DirtyUniforms)}
             , UniformNameToIndex{std::move(other.UniformNameToIndex)}
             , UniformInfos{std::move(other.UniformInfos)}
             , VertexAttributeLocations{std::move(other.VertexAttributeLocations)}
@@ -71,6 +89,9 @@ namespace Babylon
             Handle = std::move(other.Handle);
             other.Handle = BGFX_INVALID_HANDLE;
             Uniforms = std::move(other.Uniforms);
+            UniformData = std::move(other.UniformData);
+            UniformSlots = std::move(other.UniformSlots);
+            DirtyUniforms = std::move(other.DirtyUniforms);
             UniformNameToIndex = std::move(other.UniformNameToIndex);
             UniformInfos = std::move(other.UniformInfos);
             VertexAttributeLocations = std::move(other.VertexAttributeLocations);
@@ -93,32 +114,136 @@ namespace Babylon
 
         bgfx::ProgramHandle Handle{bgfx::kInvalidHandle};
 
+        // A uniform of the program, whose values are stored in UniformData starting at Offset.
         struct UniformValue
         {
-            std::vector<float> Data{};
+            bgfx::UniformHandle Handle{bgfx::kInvalidHandle};
+            uint32_t Offset{};
+            uint32_t Capacity{};
+            uint32_t Size{};
+            uint16_t MaxElementLength{};
             uint16_t ElementLength{};
         };
 
-        std::unordered_map<uint16_t, UniformValue> Uniforms{};
+        static constexpr uint16_t NO_UNIFORM_SLOT{0xFFFF};
+
+        // Uniforms of the program, with their values laid out contiguously in UniformData. UniformSlots maps uniform
+        // handle indices to indices in Uniforms, and DirtyUniforms has a bit set for every uniform that changed since
+        // the uniforms were last submitted.
+        std::vector<UniformValue> Uniforms{};
+        std::vector<float> UniformData{};
+        std::vector<uint16_t> UniformSlots{};
+        std::vector<uint64_t> DirtyUniforms{};
+
         std::unordered_map<std::string, uint16_t> UniformNameToIndex{};
         std::unordered_map<uint16_t, UniformInfo> UniformInfos{};
         std::unordered_map<std::string, uint32_t> VertexAttributeLocations{};
         uintptr_t DeviceID;
         Graphics::DeviceContext& DeviceContext;
 
-        void SetUniform(bgfx::UniformHandle handle, gsl::span<const float> data, size_t elementLength = 1)
+        // Reserves storage for a uniform used by one of the shaders of the program.
+        void AddUniform(bgfx::UniformHandle handle, bgfx::UniformType::Enum type, uint16_t maxElementLength)
+        {
+            if (UniformSlots.size() <= handle.idx)
+            {
+                UniformSlots.resize(handle.idx + 1, NO_UNIFORM_SLOT);
+            }
+
+            if (UniformSlots[handle.idx] != NO_UNIFORM_SLOT || type == bgfx::UniformType::Sampler)
+            {
+                return;
+            }
+
+            uint32_t elementSize{4};
+            if (type == bgfx::UniformType::Mat3)
+            {
+                elementSize = 9;
+            }
+            else if (type == bgfx::UniformType::Mat4)
+            {
+                elementSize = 16;
+            }
+
+            UniformSlots[handle.idx] = static_cast<uint16_t>(Uniforms.size());
+            UniformValue& value = Uniforms.emplace_back();
+            value.Handle = handle;
+            value.Offset = static_cast<uint32_t>(UniformData.size());
+            value.Capacity = elementSize * maxElementLength;
+            value.MaxElementLength = maxElementLength;
+            UniformData.resize(UniformData.size() + value.Capacity);
+            DirtyUniforms.resize((Uniforms.size() + 63) / 64);
+        }
+
+        // Returns false if the uniform already had the given value, or if the program does not use it.
+        bool SetUniform(bgfx::UniformHandle handle, gsl::span<const float> data, size_t elementLength = 1)
         {
-            UniformValue& value = Uniforms[handle.idx];
+            const uint16_t slot{handle.idx < UniformSlots.size() ? UniformSlots[handle.idx] : NO_UNIFORM_SLOT};
+            if (slot == NO_UNIFORM_SLOT)
+            {
+                return false;
+            }
 
-            const auto itUniformInfo{UniformInfos.find(handle.idx)};
+            UniformValue& value = Uniforms[slot];
+            elementLength = std::min<size_t>(value.MaxElementLength, elementLength);
+            const auto size{std::min<uint32_t>(value.Capacity, static_cast<uint32_t>(data.size()))};
+            float* values{UniformData.data() + value.Offset};
 
-            if (itUniformInfo != UniformInfos.end())
+            // Compare bitwise so that values such as -0.0 and 0.0 are not considered equal.
+            if (value.ElementLength == elementLength && value.Size == size && std::memcmp(values, data.data(), size * sizeof(float)) == 0)
             {
-                elementLength = std::min(itUniformInfo->second.MaxElementLength, elementLength);
+                return false;
             }
 
-            value.Data.assign(data.begin(), data.end());
+            std::memcpy(values, data.data(), size * sizeof(float));
+            value.Size = size;
             value.ElementLength = static_cast<uint16_t>(elementLength);
+            DirtyUniforms[slot / 64] |= uint64_t{1} << (slot % 64);
+            return true;
+        }
+
+        // Marks all the uniforms that have a value as changed, for instance because another program may have
+        // submitted different values for the same uniform handles.
+        void MarkUniformsDirty()
+        {
+            for (size_t slot = 0; slot < Uniforms.size(); ++slot)
+            {
+                if (Uniforms[slot].ElementLength != 0)
+                {
+                    DirtyUniforms[slot / 64] |= uint64_t{1} << (slot % 64);
+                }
+            }
+        }
+
+        // Calls the callback for every uniform that changed since the last call, and clears the changes.
+        template<typename CallableT>
+        void ForEachDirtyUniform(CallableT&& callback)
+        {
+            for (size_t word = 0; word < DirtyUniforms.size(); ++word)
+            {
+                for (size_t slot = word * 64; DirtyUniforms[word] != 0; ++slot)
+                {
+                    const uint64_t bit{uint64_t{1} << (slot % 64)};
+                    if ((DirtyUniforms[word] & bit) != 0)
+                    {
+                        DirtyUniforms[word] &= ~bit;
+                        callback(Uniforms[slot]);
+                    }
+                }
+            }
+        }
+
+        bool HasDirtyUniforms() const
+        {
+            return std::any_of(DirtyUniforms.begin(), DirtyUniforms.end(), [](uint64_t word) { return word != 0; });
+        }
+
+        // Sets the uniforms that changed since the last call on the encoder. bgfx keeps the values of the uniforms
+        // across draws, so the other uniforms keep the values submitted previously.
+        void SubmitUniforms(bgfx::Encoder& encoder)
+        {
+            ForEachDirtyUniform([this, &encoder](const UniformValue& value) {
+                encoder.setUniform(value.Handle, UniformData.data() + value.Offset, value.ElementLength);
+            });
         }
     };
 
@@ -126,15 +251,19 @@ namespace Babylon
     {
         static constexpr auto JS_CLASS_NAME = "_NativeEngine";
         static constexpr auto JS_CONSTRUCTOR_NAME = "Engine";
+        static constexpr auto JS_OPTIONS_NAME = "_NativeEngineOptions";
 
     public:
         NativeEngine(const Napi::CallbackInfo& info);
         NativeEngine(const Napi::CallbackInfo& info, JsRuntime& runtime);
         ~NativeEngine();
 
-        static void Initialize(Napi::Env env);
+        static void Initialize(Napi::Env env, const Plugins::NativeEngine::Options& options);
 
     private:
+        // Replays captured commands through the handlers below, with objects created like the ones of JavaScript.
+        friend class CommandReplayImpl;
+
         void Dispose();
 
         void Dispose(const Napi::CallbackInfo& info);
@@ -151,6 +280,7 @@ namespace Babylon
         void RecordVertexBuffer(const Napi::CallbackInfo& info);
         void UpdateDynamicVertexBuffer(const Napi::CallbackInfo& info);
         std::unique_ptr<ProgramData> CreateProgramInternal(const std::string vertexSource, const std::string fragmentSource);
+        std::unique_ptr<ProgramData> CreateProgramInternal(const ShaderCompiler::BgfxShaderInfo& shaderInfo);
         Napi::Value CreateProgram(const Napi::CallbackInfo& info);
         Napi::Value CreateProgramAsync(const Napi::CallbackInfo& info);
         Napi::Value GetUniforms(const Napi::CallbackInfo& info);
@@ -200,6 +330,7 @@ namespace Babylon
         void DeleteTexture(const Napi::CallbackInfo& info);
         Napi::Value ReadTexture(const Napi::CallbackInfo& info);
         Napi::Value CreateFrameBuffer(const Napi::CallbackInfo& info);
+        std::unique_ptr<Graphics::FrameBuffer> CreateFrameBufferInternal(Graphics::Texture* texture, uint16_t width, uint16_t height, bool generateStencilBuffer, bool generateDepth, uint32_t samples, bgfx::TextureHandle& depthStencilTextureHandle);
         void DeleteFrameBuffer(NativeDataStream::Reader& data);
         void BindFrameBuffer(NativeDataStream::Reader& data);
         void UnbindFrameBuffer(NativeDataStream::Reader& data);
@@ -221,11 +352,25 @@ namespace Babylon
         void SetScissor(NativeDataStream::Reader& data);
         void SetCommandDataStream(const Napi::CallbackInfo& info);
         void SubmitCommands(const Napi::CallbackInfo& info);
+        void SubmitCommands(NativeDataStream::Reader& reader, CommandEncoding encoding);
+        void SubmitInstrumentedCommands(NativeDataStream::Reader& reader, CommandEncoding encoding, CommandCaptureImpl* capture, CommandProfilerImpl* profiler);
         void PopulateFrameStats(const Napi::CallbackInfo& info);
         void DrawInternal(bgfx::Encoder* encoder, uint32_t fillMode);
+        Graphics::FrameBuffer& PrepareDraw(bgfx::Encoder* encoder, uint32_t fillMode);
+        void MergeDrawIndexed(bgfx::Encoder* encoder, uint32_t fillMode, uint32_t indexStart, uint32_t indexCount);
+        void FlushMergedDraw();
+        void RecordDraw(bgfx::Encoder* encoder, uint32_t fillMode, ParallelEncoder::Draw draw);
+        uint64_t GetDrawState(const Graphics::FrameBuffer& frameBuffer, uint32_t fillMode) const;
+        TopologyConversion GetTopologyConversion(uint32_t fillMode) const;
+
+        // Returns false if the range has no primitives once converted. Otherwise the converted indices of the range are
+        // given, with an invalid handle if the range is drawn with its own indices.
+        bool ConvertIndices(TopologyConversion conversion, uint32_t indexStart, uint32_t indexCount, TopologyConverter::Indices& converted);
 
         std::string ProcessShaderCoordinates(const std::string& vertexSource);
 
+        void SetUniform(const UniformInfo& uniformInfo, gsl::span<const float> data, size_t elementLength = 1);
+
         Graphics::UpdateToken& GetUpdateToken();
         Graphics::FrameBuffer& GetBoundFrameBuffer(bgfx::Encoder& encoder);
 
@@ -235,6 +380,9 @@ namespace Babylon
 
         ProgramData* m_currentProgram{nullptr};
 
+        // The program used by the last draw of the current submission, whose uniforms were submitted to the encoder.
+        ProgramData* m_lastDrawProgram{nullptr};
+
         JsRuntime& m_runtime;
         Graphics::DeviceContext& m_deviceContext;
         Graphics::Update m_update;
@@ -276,6 +424,79 @@ namespace Babylon
 
         // TODO: This should be changed to a non-owning ref once multi-update is available.
         NativeDataStream* m_commandStream{};
+        CommandEncoding m_commandEncoding{CommandEncoding::FunctionPointer};
+
+        using CommandFunctionPointerT = void (NativeEngine::*)(NativeDataStream::Reader&);
+        static const std::array<CommandFunctionPointerT, static_cast<size_t>(CommandOpcode::Count)> s_commandTable;
+
+        // Returns the opcode of a command given in the function pointer encoding. Throws if it is not a command.
+        static CommandOpcode GetCommandOpcode(CommandFunctionPointerT function);
+
+        // Submits the pending merged draw after a command that changed state.
+        void FlushMergedDrawAfter(CommandFunctionPointerT command);
+
+        // Raw words and object references of the last command read, used when capturing a frame.
+        std::vector<uint32_t> m_captureScratch{};
+        std::vector<CommandCaptureImpl::ObjectReference> m_captureReferences{};
+
+        // Set by command handlers when a command is filtered out because it would not change any state.
+        bool m_redundantCommand{};
+
+        // Texture bindings made on the encoder by SetTexture and UnsetTexture, indexed by stage. Bindings are kept
+        // by bgfx across draws, so binding the same texture again is skipped. This is reset at the start of every
+        // submission and whenever the bindings are discarded, since other users of the encoder may discard them.
+        struct TextureBinding
+        {
+            uint16_t Uniform{bgfx::kInvalidHandle};
+            uint16_t Texture{bgfx::kInvalidHandle};
+            uint32_t SamplerFlags{};
+        };
+        std::vector<std::optional<TextureBinding>> m_textureBindings{};
+        bool SetTextureBinding(uint8_t stage, const TextureBinding& binding);
+
+        // Set when parallel encoding is enabled, in which case draws are recorded rather than submitted to the
+        // encoder, and the texture bindings above are recorded along with the draws when they changed.
+        std::unique_ptr<ParallelEncoder> m_parallelEncoder{};
+        std::optional<bgfx::ViewId> m_lastDrawView{};
+        bool m_textureBindingsChanged{};
+
+        // Set when draw merging is enabled, in which case the last indexed draw is prepared on the encoder but not
+        // submitted until a command that cannot be merged into it. An indexed draw of the index range that follows,
+        // with the same program, uniforms, vertex array, render state and view, only extends the pending draw.
+        struct MergedDraw
+        {
+            bgfx::ViewId ViewId{};
+            ProgramData* Program{};
+            VertexArray* Vertices{};
+            uint64_t EngineState{};
+            uint32_t StencilState{};
+            uint32_t FillMode{};
+            uint32_t IndexStart{};
+            uint32_t IndexCount{};
+        };
+        bool m_drawMerging{};
+        std::optional<MergedDraw> m_mergedDraw{};
+
+        // Set when static geometry references its JavaScript data instead of copying it. Holds the references that
+        // bgfx no longer needs until they can be released on the JavaScript thread.
+        std::shared_ptr<ReferencedBytes::ReleaseQueue> m_releaseQueue{};
+
+        bool m_vertexCacheOptimization{};
+        bool m_vertexInterleaving{};
+
+        // Set when index buffers retain their indices, in which case indexed line loops and triangle fans are drawn
+        // with converted indices. Draws without index buffer are always converted.
+        bool m_topologyConversion{};
+        TopologyConverter m_topologyConverter{m_deviceContext};
+
+        // Staging textures of readTexture, and the atlases of the small reads of the current update.
+        ReadbackPool m_readbackPool{m_deviceContext};
+
+        // Transcodes the Basis Universal payloads of KTX2 containers on the thread pool, if given by the options.
+        Plugins::NativeEngine::BasisTranscoder m_ktx2Transcoder{};
+
+        // Stages the updates of dynamic buffers until the next submitCommands.
+        std::shared_ptr<StagingRing> m_stagingRing{std::make_shared<StagingRing>()};
 
         // Information from the JS side used for backwards compatibility.
         struct
@@ -1,12 +1,25 @@
 #include <Babylon/Plugins/NativeEngine.h>
-#include "NativeDataStream.h"
+#include <Babylon/Plugins/NativeEngine/NativeDataStream.h>
+#include "IndexBuffer.h"
 #include "NativeEngine.h"
 
 namespace Babylon::Plugins::NativeEngine
 {
     void Initialize(Napi::Env env)
+    {
+        Initialize(env, {});
+    }
+
+    void Initialize(Napi::Env env, const Options& options)
     {
         Babylon::NativeDataStream::Initialize(env);
-        Babylon::NativeEngine::Initialize(env);
+        Babylon::NativeEngine::Initialize(env, options);
+    }
+
+    Statistics GetStatistics()
+    {
+        Statistics statistics{};
+        statistics.NarrowedIndexBytes = Babylon::IndexBuffer::NarrowedBytes();
+        return statistics;
     }
 }
@@ -0,0 +1,235 @@
+#include "ParallelEncoder.h"
+#include "VertexArray.h"
+
+#include <arcana/threading/task.h>
+#include <arcana/threading/task_schedulers.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    // Chunks smaller than this are not worth the cost of dispatching them to a worker thread.
+    constexpr size_t MIN_DRAWS_PER_CHUNK{64};
+
+    // bgfx supports a limited number of encoders, which are shared with the other users of the device.
+    constexpr size_t MAX_WORKER_COUNT{3};
+}
+
+namespace Babylon
+{
+    ParallelEncoder::ParallelEncoder()
+        : m_workerCount{std::min<size_t>(std::max(std::thread::hardware_concurrency(), 2u) - 1, MAX_WORKER_COUNT)}
+    {
+    }
+
+    void ParallelEncoder::AddUniform(bgfx::UniformHandle handle, const float* data, uint32_t size, uint16_t elementLength)
+    {
+        m_uniforms.push_back({handle, static_cast<uint32_t>(m_uniformData.size()), elementLength});
+        m_uniformData.insert(m_uniformData.end(), data, data + size);
+    }
+
+    void ParallelEncoder::AddTextureBinding(const TextureBinding& binding)
+    {
+        m_textureBindings.push_back(binding);
+    }
+
+    void ParallelEncoder::AddDraw(Draw draw)
+    {
+        draw.UniformsEnd = static_cast<uint32_t>(m_uniforms.size());
+        draw.TextureBindingsEnd = static_cast<uint32_t>(m_textureBindings.size());
+        m_draws.push_back(draw);
+    }
+
+    void ParallelEncoder::Defer(std::function<void()> command)
+    {
+        m_deferredCommands.push_back(std::move(command));
+    }
+
+    void ParallelEncoder::Encode(bgfx::Encoder& encoder)
+    {
+        // Split the draws at view boundaries into chunks of similar sizes. Every draw that starts a view replaces the
+        // texture bindings and sets all the uniforms it uses, so chunks can be encoded independently.
+        std::vector<std::pair<size_t, size_t>> chunks{};
+        const size_t chunkCount{std::min(m_workerCount + 1, m_draws.size() / MIN_DRAWS_PER_CHUNK)};
+        if (chunkCount > 1)
+        {
+            const size_t targetSize{(m_draws.size() + chunkCount - 1) / chunkCount};
+            size_t begin{0};
+            for (size_t index = 1; index < m_draws.size(); ++index)
+            {
+                if (m_draws[index].ViewId != m_draws[index - 1].ViewId && index - begin >= targetSize)
+                {
+                    chunks.emplace_back(begin, index);
+                    begin = index;
+                }
+            }
+
+            chunks.emplace_back(begin, m_draws.size());
+        }
+        else if (!m_draws.empty())
+        {
+            chunks.emplace_back(0, m_draws.size());
+        }
+
+        struct
+        {
+            std::mutex Mutex{};
+            std::condition_variable Condition{};
+            size_t Remaining{};
+            std::exception_ptr Exception{};
+            std::vector<std::pair<size_t, size_t>> Skipped{};
+        } workers{};
+
+        workers.Remaining = chunks.empty() ? 0 : chunks.size() - 1;
+        for (size_t index = 1; index < chunks.size(); ++index)
+        {
+            arcana::make_task(arcana::threadpool_scheduler, arcana::cancellation::none(), [this, &workers, chunk = chunks[index]]() {
+                std::exception_ptr exception{};
+                bool encoded{};
+                if (bgfx::Encoder* workerEncoder{bgfx::begin(true)})
+                {
+                    try
+                    {
+                        EncodeDraws(*workerEncoder, chunk.first, chunk.second);
+                    }
+                    catch (...)
+                    {
+                        exception = std::current_exception();
+                    }
+
+                    bgfx::end(workerEncoder);
+                    encoded = true;
+                }
+
+                std::scoped_lock lock{workers.Mutex};
+                if (exception && !workers.Exception)
+                {
+                    workers.Exception = exception;
+                }
+
+                if (!encoded)
+                {
+                    workers.Skipped.push_back(chunk);
+                }
+
+                if (--workers.Remaining == 0)
+                {
+                    workers.Condition.notify_one();
+                }
+            });
+        }
+
+        std::exception_ptr exception{};
+        try
+        {
+            if (!chunks.empty())
+            {
+                EncodeDraws(encoder, chunks.front().first, chunks.front().second);
+            }
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+
+        {
+            std::unique_lock lock{workers.Mutex};
+            workers.Condition.wait(lock, [&workers]() { return workers.Remaining == 0; });
+        }
+
+        // Chunks for which no encoder was available are encoded on this thread instead.
+        if (!exception)
+        {
+            try
+            {
+                for (const auto& chunk : workers.Skipped)
+                {
+                    EncodeDraws(encoder, chunk.first, chunk.second);
+                }
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+        }
+
+        Reset();
+
+        if (exception || (exception = workers.Exception))
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    void ParallelEncoder::Discard()
+    {
+        Reset();
+    }
+
+    void ParallelEncoder::EncodeDraws(bgfx::Encoder& encoder, size_t begin, size_t end) const
+    {
+        uint32_t uniformIndex{begin == 0 ? 0 : m_draws[begin - 1].UniformsEnd};
+        uint32_t textureBindingIndex{begin == 0 ? 0 : m_draws[begin - 1].TextureBindingsEnd};
+
+        for (size_t index = begin; index < end; ++index)
+        {
+            const Draw& draw = m_draws[index];
+
+            if (draw.ResetTextureBindings)
+            {
+                encoder.discard(BGFX_DISCARD_BINDINGS);
+            }
+
+            for (; textureBindingIndex < draw.TextureBindingsEnd; ++textureBindingIndex)
+            {
+                const TextureBinding& binding = m_textureBindings[textureBindingIndex];
+                encoder.setTexture(binding.Stage, binding.Uniform, binding.Texture, binding.SamplerFlags);
+            }
+
+            for (; uniformIndex < draw.UniformsEnd; ++uniformIndex)
+            {
+                const Uniform& uniform = m_uniforms[uniformIndex];
+                encoder.setUniform(uniform.Handle, m_uniformData.data() + uniform.Offset, uniform.ElementLength);
+            }
+
+            if (bgfx::isValid(draw.Indices))
+            {
+                encoder.setIndexBuffer(draw.Indices, draw.IndexStart, draw.IndexCount);
+            }
+
+            if (draw.Vertices != nullptr)
+            {
+                if (draw.Indexed)
+                {
+                    draw.Vertices->SetIndexBuffer(&encoder, draw.IndexStart, draw.IndexCount, (draw.State & BGFX_STATE_PT_MASK) == 0);
+                }
+
+                draw.Vertices->SetVertexBuffers(&encoder, draw.VertexStart, draw.VertexCount, draw.InstanceCount, draw.Instances);
+            }
+
+            encoder.setState(draw.State);
+            encoder.setStencil(draw.Stencil);
+
+            // Discard everything except textures since the bindings are only recorded when they change.
+            encoder.submit(draw.ViewId, draw.Program, 0, BGFX_DISCARD_ALL & ~BGFX_DISCARD_BINDINGS);
+        }
+    }
+
+    void ParallelEncoder::Reset()
+    {
+        m_draws.clear();
+        m_uniforms.clear();
+        m_uniformData.clear();
+        m_textureBindings.clear();
+
+        auto deferredCommands{std::move(m_deferredCommands)};
+        m_deferredCommands.clear();
+        for (auto& command : deferredCommands)
+        {
+            command();
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "TopologyConverter.h"
+#include "VertexArray.h"
+
+#include <bgfx/bgfx.h>
+
+#include <functional>
+#include <vector>
+
+namespace Babylon
+{
+    // Encodes the draws of a command stream on multiple threads. NativeEngine processes commands on the JavaScript
+    // thread as usual, but records draws here instead of submitting them to its encoder. The recorded draws are then
+    // split at view boundaries into chunks that are encoded in parallel, each with its own encoder. Views are acquired
+    // in increasing order and bgfx sorts draws by view, so the order of the draws is preserved.
+    class ParallelEncoder
+    {
+    public:
+        struct Draw
+        {
+            bgfx::ViewId ViewId{};
+            bgfx::ProgramHandle Program{bgfx::kInvalidHandle};
+            uint64_t State{};
+            uint32_t Stencil{};
+            VertexArray* Vertices{};
+            bool Indexed{};
+            uint32_t IndexStart{};
+            uint32_t IndexCount{};
+            uint32_t VertexStart{};
+            uint32_t VertexCount{};
+            uint32_t InstanceCount{};
+
+            // Instance data of the vertex array when the draw is recorded, since it may be updated again before the
+            // draw is encoded.
+            VertexArray::Instances Instances{};
+
+            // Converted indices that replace the index range of the vertex array, or the vertices of draws without index
+            // buffer, see TopologyConverter. They are resolved when the draw is recorded, so that the draw is encoded
+            // with them even if the conversion is released before the draws are encoded.
+            bgfx::IndexBufferHandle Indices{bgfx::kInvalidHandle};
+
+            // Whether the texture bindings of the encoder are replaced by the bindings recorded for this draw, rather
+            // than updated by them.
+            bool ResetTextureBindings{};
+
+            // Ends of the ranges of uniforms and texture bindings recorded for this draw. The ranges start at the
+            // ends of the previous draw.
+            uint32_t UniformsEnd{};
+            uint32_t TextureBindingsEnd{};
+        };
+
+        struct TextureBinding
+        {
+            uint8_t Stage{};
+            bgfx::UniformHandle Uniform{bgfx::kInvalidHandle};
+            bgfx::TextureHandle Texture{bgfx::kInvalidHandle};
+            uint32_t SamplerFlags{};
+        };
+
+        ParallelEncoder();
+
+        // Records the value of a uniform, to be set on the encoder before the next recorded draw.
+        void AddUniform(bgfx::UniformHandle handle, const float* data, uint32_t size, uint16_t elementLength);
+
+        // Records a texture binding, to be set on the encoder before the next recorded draw.
+        void AddTextureBinding(const TextureBinding& binding);
+
+        void AddDraw(Draw draw);
+
+        // Defers a command until the recorded draws have been encoded, typically the deletion of an object that the
+        // recorded draws may reference.
+        void Defer(std::function<void()> command);
+
+        // Encodes the recorded draws, using the given encoder for the first chunk and worker threads for the others,
+        // then runs the deferred commands. Blocks until all the draws are encoded.
+        void Encode(bgfx::Encoder& encoder);
+
+        // Drops the recorded draws and runs the deferred commands.
+        void Discard();
+
+    private:
+        struct Uniform
+        {
+            bgfx::UniformHandle Handle{bgfx::kInvalidHandle};
+            uint32_t Offset{};
+            uint16_t ElementLength{};
+        };
+
+        void EncodeDraws(bgfx::Encoder& encoder, size_t begin, size_t end) const;
+        void Reset();
+
+        const size_t m_workerCount{};
+
+        std::vector<Draw> m_draws{};
+        std::vector<Uniform> m_uniforms{};
+        std::vector<float> m_uniformData{};
+        std::vector<TextureBinding> m_textureBindings{};
+        std::vector<std::function<void()>> m_deferredCommands{};
+    };
+}
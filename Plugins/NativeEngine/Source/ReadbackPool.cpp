@@ -0,0 +1,180 @@
+#include "ReadbackPool.h"
+
+#include <bimg/bimg.h>
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+
+namespace
+{
+    // Staging textures kept for reuse, over all sizes and formats. The least recently released ones are destroyed
+    // first when more are released.
+    constexpr size_t MAX_POOLED_TEXTURES{16};
+
+    // Reads of at most this many pixels in both dimensions are batched, into atlases of ATLAS_SIZE by ATLAS_SIZE
+    // pixels. This covers picking and other reads of a few pixels.
+    constexpr uint16_t MAX_BATCHED_SIZE{64};
+    constexpr uint16_t ATLAS_SIZE{256};
+}
+
+namespace Babylon
+{
+    struct ReadbackPool::Pool
+    {
+        std::mutex Mutex{};
+        uintptr_t DeviceId{};
+        std::vector<std::unique_ptr<Staging>> Textures{};
+
+        void Recycle(std::unique_ptr<Staging> staging)
+        {
+            std::scoped_lock lock{Mutex};
+
+            // Textures of a previous device were destroyed with it.
+            if (staging->DeviceId != DeviceId)
+            {
+                return;
+            }
+
+            Textures.push_back(std::move(staging));
+            if (Textures.size() > MAX_POOLED_TEXTURES)
+            {
+                bgfx::destroy(Textures.front()->Handle);
+                Textures.erase(Textures.begin());
+            }
+        }
+    };
+
+    ReadbackPool::ReadbackPool(Graphics::DeviceContext& deviceContext)
+        : m_deviceContext{deviceContext}
+        , m_pool{std::make_shared<Pool>()}
+    {
+        m_pool->DeviceId = deviceContext.GetDeviceId();
+    }
+
+    ReadbackPool::~ReadbackPool()
+    {
+        m_batches.clear();
+
+        std::scoped_lock lock{m_pool->Mutex};
+        if (m_pool->DeviceId == m_deviceContext.GetDeviceId())
+        {
+            for (const auto& staging : m_pool->Textures)
+            {
+                bgfx::destroy(staging->Handle);
+            }
+        }
+
+        m_pool->Textures.clear();
+    }
+
+    std::shared_ptr<ReadbackPool::Staging> ReadbackPool::Acquire(uint16_t width, uint16_t height, bgfx::TextureFormat::Enum format)
+    {
+        std::unique_ptr<Staging> staging{};
+        {
+            std::scoped_lock lock{m_pool->Mutex};
+
+            const uintptr_t deviceId{m_deviceContext.GetDeviceId()};
+            if (m_pool->DeviceId != deviceId)
+            {
+                m_pool->Textures.clear();
+                m_pool->DeviceId = deviceId;
+            }
+
+            auto& textures{m_pool->Textures};
+            const auto it{std::find_if(textures.rbegin(), textures.rend(), [width, height, format](const auto& texture) {
+                return texture->Width == width && texture->Height == height && texture->Format == format;
+            })};
+
+            if (it != textures.rend())
+            {
+                staging = std::move(*it);
+                textures.erase(std::next(it).base());
+            }
+            else
+            {
+                staging = std::make_unique<Staging>();
+                staging->Handle = bgfx::createTexture2D(width, height, /*hasMips*/ false, /*numLayers*/ 1, format, BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK);
+                staging->Width = width;
+                staging->Height = height;
+                staging->Format = format;
+                staging->DeviceId = deviceId;
+            }
+        }
+
+        return {staging.release(), [pool{std::weak_ptr<Pool>{m_pool}}](Staging* staging) {
+            std::unique_ptr<Staging> owned{staging};
+            if (const auto lockedPool{pool.lock()})
+            {
+                lockedPool->Recycle(std::move(owned));
+            }
+        }};
+    }
+
+    std::optional<ReadbackPool::Region> ReadbackPool::Reserve(uint16_t width, uint16_t height, bgfx::TextureFormat::Enum format)
+    {
+        if (width > MAX_BATCHED_SIZE || height > MAX_BATCHED_SIZE)
+        {
+            return {};
+        }
+
+        auto it{m_batches.find(format)};
+        if (it != m_batches.end())
+        {
+            // Regions are packed in shelves as high as their highest region, starting a new shelf when a region does
+            // not fit in the width of the atlas, and a new batch when it does not fit in its height.
+            Batch& batch{it->second};
+            if (batch.CursorX + width > ATLAS_SIZE)
+            {
+                batch.CursorX = 0;
+                batch.CursorY += batch.ShelfHeight;
+                batch.ShelfHeight = 0;
+            }
+
+            if (batch.CursorY + height > ATLAS_SIZE)
+            {
+                m_batches.erase(it);
+                it = m_batches.end();
+            }
+        }
+
+        if (it == m_batches.end())
+        {
+            Batch batch{};
+            batch.Atlas = Acquire(ATLAS_SIZE, ATLAS_SIZE, format);
+            batch.Atlas->Data.resize(static_cast<size_t>(ATLAS_SIZE) * ATLAS_SIZE * bimg::getBitsPerPixel(static_cast<bimg::TextureFormat::Enum>(format)) / 8);
+            batch.Readers = std::make_shared<std::vector<arcana::task_completion_source<void, std::exception_ptr>>>();
+
+            // Read backs are performed after all the views of a frame, so the atlas is read back once with all the
+            // regions blitted to it during the update, however many there are. The atlas is kept until then even if
+            // the reads of all its regions are cancelled.
+            m_deviceContext.ReadTextureAsync(batch.Atlas->Handle, batch.Atlas->Data)
+                .then(arcana::inline_scheduler, arcana::cancellation::none(), [atlas{batch.Atlas}, readers{batch.Readers}](const arcana::expected<void, std::exception_ptr>& result) {
+                    for (auto& reader : *readers)
+                    {
+                        if (result.has_error())
+                        {
+                            reader.complete(result.error());
+                        }
+                        else
+                        {
+                            reader.complete();
+                        }
+                    }
+                });
+
+            it = m_batches.emplace(format, std::move(batch)).first;
+        }
+
+        Batch& batch{it->second};
+        Region region{batch.Atlas, batch.CursorX, batch.CursorY, batch.Readers->emplace_back().as_task()};
+        batch.CursorX += width;
+        batch.ShelfHeight = std::max(batch.ShelfHeight, height);
+        return region;
+    }
+
+    void ReadbackPool::EndBatches()
+    {
+        m_batches.clear();
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Babylon/Graphics/DeviceContext.h>
+
+#include <arcana/threading/task.h>
+
+#include <bgfx/bgfx.h>
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace Babylon
+{
+    // Pools the staging textures that textures are blitted to for reading them back, by size and format, so that
+    // reading textures every frame does not create and destroy a texture every frame. Small reads of a format during
+    // an update are packed into a shared atlas that is read back once.
+    class ReadbackPool final
+    {
+    public:
+        struct Staging
+        {
+            bgfx::TextureHandle Handle{bgfx::kInvalidHandle};
+            uint16_t Width{};
+            uint16_t Height{};
+            bgfx::TextureFormat::Enum Format{};
+            uintptr_t DeviceId{};
+
+            // Receives the pixels of the texture when they cannot be read back to their destination directly. Kept
+            // with the texture so that its allocation is reused as well.
+            std::vector<uint8_t> Data{};
+        };
+
+        struct Region
+        {
+            std::shared_ptr<Staging> Atlas{};
+            uint16_t X{};
+            uint16_t Y{};
+
+            // Completes when the Data of the atlas holds the pixels of the frame.
+            arcana::task<void, std::exception_ptr> Read{};
+        };
+
+        ReadbackPool(Graphics::DeviceContext& deviceContext);
+        ~ReadbackPool();
+
+        ReadbackPool(const ReadbackPool&) = delete;
+        ReadbackPool& operator=(const ReadbackPool&) = delete;
+
+        // Returns a staging texture that returns to the pool when the last reference to it is released.
+        std::shared_ptr<Staging> Acquire(uint16_t width, uint16_t height, bgfx::TextureFormat::Enum format);
+
+        // Reserves a region of the atlas of the current batch of a format, which is read back with the frame of the
+        // current update. Returns no region for reads too large to batch.
+        std::optional<Region> Reserve(uint16_t width, uint16_t height, bgfx::TextureFormat::Enum format);
+
+        // Ends the current batches. Must be called before the frame of the update in which they were reserved ends.
+        void EndBatches();
+
+    private:
+        struct Pool;
+
+        struct Batch
+        {
+            std::shared_ptr<Staging> Atlas{};
+            uint16_t CursorX{};
+            uint16_t CursorY{};
+            uint16_t ShelfHeight{};
+            std::shared_ptr<std::vector<arcana::task_completion_source<void, std::exception_ptr>>> Readers{};
+        };
+
+        Graphics::DeviceContext& m_deviceContext;
+        std::shared_ptr<Pool> m_pool;
+        std::map<bgfx::TextureFormat::Enum, Batch> m_batches{};
+    };
+}
@@ -0,0 +1,51 @@
+#include "ReferencedBytes.h"
+
+namespace Babylon
+{
+    ReferencedBytes::ReleaseQueue::~ReleaseQueue()
+    {
+        // The queue can outlive the JavaScript environment, in which case the references can no longer be released.
+        for (auto& reference : m_references)
+        {
+            reference.release();
+        }
+    }
+
+    void ReferencedBytes::ReleaseQueue::Push(std::unique_ptr<Napi::Reference<Napi::ArrayBuffer>> reference)
+    {
+        std::scoped_lock lock{m_mutex};
+        m_references.push_back(std::move(reference));
+    }
+
+    void ReferencedBytes::ReleaseQueue::Drain()
+    {
+        std::vector<std::unique_ptr<Napi::Reference<Napi::ArrayBuffer>>> references{};
+
+        {
+            std::scoped_lock lock{m_mutex};
+            references.swap(m_references);
+        }
+    }
+
+    ReferencedBytes::ReferencedBytes(Napi::ArrayBuffer arrayBuffer, gsl::span<const uint8_t> bytes, std::shared_ptr<ReleaseQueue> releaseQueue)
+        : m_reference{std::make_unique<Napi::Reference<Napi::ArrayBuffer>>(Napi::Persistent(arrayBuffer))}
+        , m_bytes{bytes}
+        , m_releaseQueue{std::move(releaseQueue)}
+    {
+    }
+
+    ReferencedBytes::~ReferencedBytes()
+    {
+        m_releaseQueue->Push(std::move(m_reference));
+    }
+
+    const bgfx::Memory* ReferencedBytes::MakeRef(std::unique_ptr<ReferencedBytes> referencedBytes)
+    {
+        auto releaseFn = [](void*, void* userData) {
+            delete static_cast<ReferencedBytes*>(userData);
+        };
+
+        const auto bytes{referencedBytes->m_bytes};
+        return bgfx::makeRef(bytes.data(), static_cast<uint32_t>(bytes.size()), releaseFn, referencedBytes.release());
+    }
+}
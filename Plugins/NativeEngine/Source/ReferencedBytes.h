@@ -0,0 +1,56 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <napi/napi.h>
+#include <gsl/gsl>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Babylon
+{
+    // Bytes of a JavaScript ArrayBuffer that are referenced rather than copied. The ArrayBuffer is kept alive until
+    // the bytes are destroyed. Since bgfx releases memory on the render thread, the reference is then handed back to
+    // the JavaScript thread through a release queue, which the JavaScript thread drains periodically.
+    class ReferencedBytes final
+    {
+    public:
+        class ReleaseQueue final
+        {
+        public:
+            ReleaseQueue() = default;
+            ~ReleaseQueue();
+
+            // Can be called from any thread.
+            void Push(std::unique_ptr<Napi::Reference<Napi::ArrayBuffer>> reference);
+
+            // Must be called on the JavaScript thread.
+            void Drain();
+
+        private:
+            std::mutex m_mutex{};
+            std::vector<std::unique_ptr<Napi::Reference<Napi::ArrayBuffer>>> m_references{};
+        };
+
+        ReferencedBytes(Napi::ArrayBuffer arrayBuffer, gsl::span<const uint8_t> bytes, std::shared_ptr<ReleaseQueue> releaseQueue);
+        ~ReferencedBytes();
+
+        // No copy or move semantics
+        ReferencedBytes(const ReferencedBytes&) = delete;
+        ReferencedBytes(ReferencedBytes&&) = delete;
+
+        gsl::span<const uint8_t> Bytes() const
+        {
+            return m_bytes;
+        }
+
+        // Creates a bgfx memory reference to the bytes, which takes ownership of them until bgfx no longer needs them.
+        static const bgfx::Memory* MakeRef(std::unique_ptr<ReferencedBytes> referencedBytes);
+
+    private:
+        std::unique_ptr<Napi::Reference<Napi::ArrayBuffer>> m_reference{};
+        gsl::span<const uint8_t> m_bytes{};
+        std::shared_ptr<ReleaseQueue> m_releaseQueue{};
+    };
+}
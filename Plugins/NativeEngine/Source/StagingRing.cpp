@@ -0,0 +1,173 @@
+#include "StagingRing.h"
+
+#include <algorithm>
+
+namespace
+{
+    constexpr size_t BLOCK_SIZE{1024 * 1024};
+}
+
+namespace Babylon
+{
+    struct StagingRing::Block
+    {
+        Block(size_t capacity)
+            : Data{std::make_unique<uint8_t[]>(capacity)}
+            , Capacity{capacity}
+        {
+        }
+
+        // One reference is held by the ring, plus one per allocation that has not been freed or released by bgfx.
+        std::atomic<uint32_t> References{1};
+
+        const std::unique_ptr<uint8_t[]> Data{};
+        const size_t Capacity{};
+        size_t Offset{};
+    };
+
+    uint8_t* StagingRing::Allocation::Data() const
+    {
+        return Owner->Data.get() + Offset;
+    }
+
+    StagingRing::~StagingRing()
+    {
+        // Blocks still referenced by bgfx are deleted by the release of their last allocation.
+        for (Block* block : m_blocks)
+        {
+            Release(block);
+        }
+    }
+
+    StagingRing::Allocation StagingRing::Allocate(size_t size)
+    {
+        const auto isFree = [](const Block* block) {
+            return block->References.load(std::memory_order_acquire) == 1;
+        };
+
+        if (m_current != nullptr && isFree(m_current))
+        {
+            m_current->Offset = 0;
+        }
+
+        if (m_current == nullptr || m_current->Offset + size > m_current->Capacity)
+        {
+            const auto it{std::find_if(m_blocks.begin(), m_blocks.end(), [&isFree, size](const Block* block) {
+                return isFree(block) && block->Capacity >= size;
+            })};
+
+            if (it != m_blocks.end())
+            {
+                m_current = *it;
+                m_current->Offset = 0;
+            }
+            else
+            {
+                m_current = m_blocks.emplace_back(new Block{std::max(size, BLOCK_SIZE)});
+            }
+        }
+
+        Allocation allocation{m_current, m_current->Offset, size};
+        m_current->Offset += size;
+        m_current->References.fetch_add(1, std::memory_order_relaxed);
+        return allocation;
+    }
+
+    bool StagingRing::Extend(Allocation& allocation, size_t size)
+    {
+        Block* block{allocation.Owner};
+        if (block != m_current || allocation.Offset + allocation.Size != block->Offset || allocation.Offset + size > block->Capacity)
+        {
+            return false;
+        }
+
+        block->Offset = allocation.Offset + size;
+        allocation.Size = size;
+        return true;
+    }
+
+    void StagingRing::Free(const Allocation& allocation)
+    {
+        Release(allocation.Owner);
+    }
+
+    const bgfx::Memory* StagingRing::MakeRef(const Allocation& allocation)
+    {
+        auto releaseFn = [](void*, void* userData) {
+            Release(static_cast<Block*>(userData));
+        };
+
+        return bgfx::makeRef(allocation.Data(), static_cast<uint32_t>(allocation.Size), releaseFn, allocation.Owner);
+    }
+
+    void StagingRing::Enqueue(const void* owner, std::function<void()> flush)
+    {
+        m_queue.emplace_back(owner, std::move(flush));
+    }
+
+    void StagingRing::Dequeue(const void* owner)
+    {
+        m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(), [owner](const auto& entry) { return entry.first == owner; }), m_queue.end());
+    }
+
+    void StagingRing::Flush()
+    {
+        for (auto& [owner, flush] : m_queue)
+        {
+            flush();
+        }
+
+        m_queue.clear();
+    }
+
+    void StagingRing::Release(Block* block)
+    {
+        if (block->References.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete block;
+        }
+    }
+
+    void PendingUpdates::Add(StagingRing& ring, gsl::span<const uint8_t> bytes, size_t byteOffset)
+    {
+        const size_t size{static_cast<size_t>(bytes.size())};
+        const size_t end{byteOffset + size};
+
+        m_updates.erase(std::remove_if(m_updates.begin(), m_updates.end(), [&ring, byteOffset, end](const Update& pending) {
+            if (pending.ByteOffset >= byteOffset && pending.ByteOffset + pending.Staging.Size <= end)
+            {
+                ring.Free(pending.Staging);
+                return true;
+            }
+
+            return false;
+        }), m_updates.end());
+
+        if (!m_updates.empty())
+        {
+            // Only the last update can take the new bytes, since a later update could overlap an earlier one.
+            Update& last{m_updates.back()};
+            const size_t lastEnd{last.ByteOffset + last.Staging.Size};
+            if (byteOffset >= last.ByteOffset && byteOffset <= lastEnd &&
+                (end <= lastEnd || ring.Extend(last.Staging, end - last.ByteOffset)))
+            {
+                std::memcpy(last.Staging.Data() + (byteOffset - last.ByteOffset), bytes.data(), size);
+                return;
+            }
+        }
+
+        const auto staging{ring.Allocate(size)};
+        std::memcpy(staging.Data(), bytes.data(), size);
+        m_updates.push_back({byteOffset, staging});
+    }
+
+    void PendingUpdates::Discard(StagingRing& ring)
+    {
+        for (const auto& pending : m_updates)
+        {
+            ring.Free(pending.Staging);
+        }
+
+        m_updates.clear();
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <gsl/gsl>
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Babylon
+{
+    // Staging memory for the updates of dynamic buffers. Updates are copied into large blocks that are handed over to
+    // bgfx by reference, and blocks are reused once bgfx has released all the memory referenced in them, so that the
+    // steady state does not allocate. Buffers with pending updates are queued here until the next flush, which lets
+    // them coalesce all their updates of a frame into a few bgfx updates.
+    class StagingRing final
+    {
+    public:
+        struct Block;
+
+        struct Allocation
+        {
+            Block* Owner{};
+            size_t Offset{};
+            size_t Size{};
+
+            uint8_t* Data() const;
+        };
+
+        StagingRing() = default;
+        ~StagingRing();
+
+        // No copy or move semantics
+        StagingRing(const StagingRing&) = delete;
+        StagingRing(StagingRing&&) = delete;
+
+        // The memory of an allocation stays valid until it is either freed or handed over to bgfx.
+        Allocation Allocate(size_t size);
+
+        // Grows an allocation in place, which is only possible for the last allocation of a block.
+        bool Extend(Allocation& allocation, size_t size);
+
+        void Free(const Allocation& allocation);
+
+        // Hands over an allocation to bgfx, which releases it once it has been uploaded.
+        const bgfx::Memory* MakeRef(const Allocation& allocation);
+
+        // Queues the flush of a buffer with pending updates until the next call to Flush.
+        void Enqueue(const void* owner, std::function<void()> flush);
+
+        // Removes a buffer from the queue, typically because it is disposed.
+        void Dequeue(const void* owner);
+
+        // Flushes the queued buffers, in the order in which they were queued.
+        void Flush();
+
+    private:
+        static void Release(Block* block);
+
+        std::vector<Block*> m_blocks{};
+        Block* m_current{};
+
+        std::vector<std::pair<const void*, std::function<void()>>> m_queue{};
+    };
+
+    // The pending updates of a buffer, as byte ranges staged in a ring. Updates are coalesced as they are added: an
+    // update within or directly following the last one is written into its staging memory, and updates entirely
+    // overwritten by a new one are dropped. The remaining updates are applied in order, since they may overlap.
+    class PendingUpdates final
+    {
+    public:
+        bool Empty() const
+        {
+            return m_updates.empty();
+        }
+
+        void Add(StagingRing& ring, gsl::span<const uint8_t> bytes, size_t byteOffset);
+
+        // Drops the pending updates, whose contents are no longer needed.
+        void Discard(StagingRing& ring);
+
+        // Calls the given function with the byte offset and staging memory of every pending update, in order, then
+        // clears them. The function takes over the staging memory, which it hands over to bgfx with MakeRef.
+        template<typename UpdateFn>
+        void Flush(UpdateFn&& update)
+        {
+            for (const auto& pending : m_updates)
+            {
+                update(pending.ByteOffset, pending.Staging);
+            }
+
+            m_updates.clear();
+        }
+
+    private:
+        struct Update
+        {
+            size_t ByteOffset{};
+            StagingRing::Allocation Staging{};
+        };
+
+        std::vector<Update> m_updates{};
+    };
+}
@@ -0,0 +1,111 @@
+#include "TopologyConverter.h"
+#include "IndexBuffer.h"
+#include "Babylon/Graphics/DeviceContext.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+    // Draws without index buffer whose vertex counts change every frame would otherwise grow the cache indefinitely.
+    constexpr size_t MAX_SEQUENCES{64};
+}
+
+namespace Babylon
+{
+    TopologyConverter::TopologyConverter(Graphics::DeviceContext& deviceContext)
+        : m_deviceContext{deviceContext}
+        , m_deviceId{deviceContext.GetDeviceId()}
+    {
+    }
+
+    TopologyConverter::~TopologyConverter()
+    {
+        if (m_deviceId == m_deviceContext.GetDeviceId())
+        {
+            for (const auto& [key, indices] : m_sequences)
+            {
+                if (bgfx::isValid(indices.Handle))
+                {
+                    bgfx::destroy(indices.Handle);
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> TopologyConverter::Convert(TopologyConversion conversion, gsl::span<const uint32_t> indices)
+    {
+        const size_t count{static_cast<size_t>(indices.size())};
+        std::vector<uint32_t> converted{};
+
+        switch (conversion)
+        {
+            case TopologyConversion::None:
+            {
+                converted.assign(indices.begin(), indices.end());
+                break;
+            }
+            case TopologyConversion::FanToList:
+            {
+                if (count >= 3)
+                {
+                    converted.reserve((count - 2) * 3);
+                    for (size_t index = 1; index + 1 < count; ++index)
+                    {
+                        converted.insert(converted.end(), {indices[0], indices[index], indices[index + 1]});
+                    }
+                }
+                break;
+            }
+            case TopologyConversion::LoopToStrip:
+            {
+                if (count >= 2)
+                {
+                    converted.reserve(count + 1);
+                    converted.assign(indices.begin(), indices.end());
+                    converted.push_back(indices[0]);
+                }
+                break;
+            }
+        }
+
+        return converted;
+    }
+
+    TopologyConverter::Indices TopologyConverter::ConvertSequence(TopologyConversion conversion, uint32_t vertexCount)
+    {
+        const auto key{std::make_pair(conversion, vertexCount)};
+        if (const auto it{m_sequences.find(key)}; it != m_sequences.end())
+        {
+            return it->second;
+        }
+
+        if (m_sequences.size() >= MAX_SEQUENCES)
+        {
+            // Draws already encoded with these buffers remain valid since bgfx destroys them at the end of the frame.
+            for (const auto& [sequenceKey, indices] : m_sequences)
+            {
+                if (bgfx::isValid(indices.Handle))
+                {
+                    bgfx::destroy(indices.Handle);
+                }
+            }
+
+            m_sequences.clear();
+        }
+
+        std::vector<uint32_t> sequence(vertexCount);
+        std::iota(sequence.begin(), sequence.end(), 0);
+        const std::vector<uint32_t> converted{Convert(conversion, sequence)};
+
+        Indices indices{};
+        if (!converted.empty())
+        {
+            indices.Handle = IndexBuffer::CreateHandle(converted);
+            indices.Count = static_cast<uint32_t>(converted.size());
+        }
+
+        m_sequences.emplace(key, indices);
+        return indices;
+    }
+}
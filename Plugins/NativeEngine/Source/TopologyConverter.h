@@ -0,0 +1,59 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+#include <gsl/gsl>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace Babylon
+{
+    namespace Graphics
+    {
+        class DeviceContext;
+    }
+
+    // Conversions of the indices of a draw into indices of a topology supported by bgfx.
+    enum class TopologyConversion
+    {
+        None,
+
+        // Triangle fans are drawn as triangle lists.
+        FanToList,
+
+        // Line loops are drawn as line strips that end with the first index.
+        LoopToStrip,
+    };
+
+    // Converts the indices of the topologies of Babylon.js that bgfx does not support. Index buffers keep the
+    // conversions of their own indices, see IndexBuffer, while the conversions of draws without index buffer, which
+    // only depend on the number of vertices, are kept here.
+    class TopologyConverter final
+    {
+    public:
+        struct Indices
+        {
+            bgfx::IndexBufferHandle Handle{bgfx::kInvalidHandle};
+            uint32_t Count{};
+        };
+
+        TopologyConverter(Graphics::DeviceContext& deviceContext);
+        ~TopologyConverter();
+
+        TopologyConverter(const TopologyConverter&) = delete;
+        TopologyConverter& operator=(const TopologyConverter&) = delete;
+
+        static std::vector<uint32_t> Convert(TopologyConversion conversion, gsl::span<const uint32_t> indices);
+
+        // Returns the converted indices of a draw of the given number of vertices without index buffer, relative to
+        // its first vertex. The handle is invalid if the conversion has no primitives.
+        Indices ConvertSequence(TopologyConversion conversion, uint32_t vertexCount);
+
+    private:
+        Graphics::DeviceContext& m_deviceContext;
+        const uintptr_t m_deviceId{};
+
+        std::map<std::pair<TopologyConversion, uint32_t>, Indices> m_sequences{};
+    };
+}
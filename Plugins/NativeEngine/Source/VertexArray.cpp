@@ -1,9 +1,85 @@
 #include "VertexArray.h"
+#include "VertexLayoutCache.h"
 #include <cassert>
 #include "Babylon/Graphics/DeviceContext.h"
 
+#include <bx/math.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace
+{
+    // bgfx supports at most this many vec4 of instance data per instance.
+    constexpr size_t MAX_INSTANCE_ATTRIBUTES{5};
+
+    constexpr uint32_t INSTANCE_ATTRIBUTE_SIZE{4 * sizeof(float)};
+
+    uint32_t GetComponentSize(bgfx::AttribType::Enum type)
+    {
+        switch (type)
+        {
+            case bgfx::AttribType::Int8:
+            case bgfx::AttribType::Uint8:
+                return 1;
+            case bgfx::AttribType::Int16:
+            case bgfx::AttribType::Uint16:
+            case bgfx::AttribType::Half:
+                return 2;
+            case bgfx::AttribType::Float:
+                return 4;
+            default:
+                throw std::runtime_error{"Unsupported instanced vertex buffer attribute type"};
+        }
+    }
+
+    template<typename T>
+    float ReadNormalizable(const uint8_t* source, bool normalized)
+    {
+        T value;
+        std::memcpy(&value, source, sizeof(T));
+        return normalized ? std::max(static_cast<float>(value) / std::numeric_limits<T>::max(), -1.0f) : static_cast<float>(value);
+    }
+
+    float ReadComponent(const uint8_t* source, bgfx::AttribType::Enum type, bool normalized)
+    {
+        switch (type)
+        {
+            case bgfx::AttribType::Int8:
+                return ReadNormalizable<int8_t>(source, normalized);
+            case bgfx::AttribType::Uint8:
+                return ReadNormalizable<uint8_t>(source, normalized);
+            case bgfx::AttribType::Int16:
+                return ReadNormalizable<int16_t>(source, normalized);
+            case bgfx::AttribType::Uint16:
+                return ReadNormalizable<uint16_t>(source, normalized);
+            case bgfx::AttribType::Half:
+            {
+                uint16_t value;
+                std::memcpy(&value, source, sizeof(value));
+                return bx::halfToFloat(value);
+            }
+            default:
+            {
+                float value;
+                std::memcpy(&value, source, sizeof(value));
+                return value;
+            }
+        }
+    }
+}
+
 namespace Babylon
 {
+    VertexArray::VertexArray(Graphics::DeviceContext& deviceContext, bool interleave)
+        : m_deviceContext{deviceContext}
+        , m_deviceId{deviceContext.GetDeviceId()}
+        , m_interleave{interleave}
+    {
+    }
+
     VertexArray::~VertexArray()
     {
         Dispose();
@@ -17,8 +93,20 @@ namespace Babylon
         }
 
         m_indexBuffer = nullptr;
-        m_vertexBufferRecords.clear();
+
+        ReleaseVertexStreams();
+
+        m_vertexBufferBindings.clear();
         m_vertexBufferInstances.clear();
+        m_instanceData.clear();
+
+        if (bgfx::isValid(m_instanceBuffer) && m_deviceId == m_deviceContext.GetDeviceId())
+        {
+            bgfx::destroy(m_instanceBuffer);
+        }
+
+        m_instanceBuffer = BGFX_INVALID_HANDLE;
+        m_instances = {};
 
         m_disposed = true;
     }
@@ -36,9 +124,12 @@ namespace Babylon
 
         if (divisor == 1)
         {
-            if (attribType != bgfx::AttribType::Float || normalized)
+            // Validates the type.
+            GetComponentSize(attribType);
+
+            if (numElements == 0 || numElements > 4)
             {
-                throw std::runtime_error{"Unsupported vertex buffer attribute type or normalized flag"};
+                throw std::runtime_error{"Instanced vertex buffer attributes must have between 1 and 4 elements"};
             }
 
             // Check if instancing is supported.
@@ -48,56 +139,324 @@ namespace Babylon
                 throw std::runtime_error{"Instancing is not supported"};
             }
 
-            // bgfx allows instancing on at most 4 vec4 attributes
-            if (m_vertexBufferInstances.size() > 4)
+            if (m_vertexBufferInstances.count(attrib) == 0 && m_vertexBufferInstances.size() == MAX_INSTANCE_ATTRIBUTES)
             {
-                throw std::runtime_error{"Number of vertex buffer instances greater than 4 is not supported"};
+                throw std::runtime_error{"Number of vertex buffer instances greater than " + std::to_string(MAX_INSTANCE_ATTRIBUTES) + " is not supported"};
             }
 
-            m_vertexBufferInstances[attrib] = {vertexBuffer, byteOffset, byteStride, static_cast<uint16_t>(sizeof(float) * numElements)};
+            m_vertexBufferInstances[attrib] = {vertexBuffer, byteOffset, byteStride, numElements, attribType, normalized};
+            m_instancesDirty = true;
         }
         else
         {
-            vertexBuffer->Build(byteStride);
+            if (m_interleave)
+            {
+                vertexBuffer->SetByteStride(byteStride);
+            }
+            else
+            {
+                vertexBuffer->Build(byteStride);
+            }
 
-            bgfx::VertexLayout layout{};
-            layout.begin();
-            layout.add(attrib, static_cast<uint8_t>(numElements), attribType, normalized);
-            layout.m_stride = static_cast<uint16_t>(byteStride);
-            layout.m_offset[attrib] = static_cast<uint16_t>(byteOffset % byteStride);
-            layout.end();
+            const auto it{std::lower_bound(m_vertexBufferBindings.begin(), m_vertexBufferBindings.end(), attrib, [](const VertexBufferBinding& binding, bgfx::Attrib::Enum attrib) {
+                return binding.Attrib < attrib;
+            })};
 
-            if (!m_vertexBufferRecords.try_emplace(attrib, vertexBuffer, byteOffset / byteStride, bgfx::createVertexLayout(layout)).second)
+            if (it != m_vertexBufferBindings.end() && it->Attrib == attrib)
             {
                 throw std::runtime_error{"Multiple vertex buffers with the same attribute cannot be recorded"};
             }
+
+            m_vertexBufferBindings.insert(it, {attrib, vertexBuffer, byteOffset, byteStride, static_cast<uint8_t>(numElements), attribType, normalized});
+            m_vertexStreamsDirty = true;
+        }
+    }
+
+    std::optional<TopologyConverter::Indices> VertexArray::ConvertIndices(TopologyConversion conversion, uint32_t firstIndex, uint32_t numIndices)
+    {
+        if (m_indexBuffer == nullptr)
+        {
+            return std::nullopt;
         }
+
+        return m_indexBuffer->Convert(conversion, firstIndex, numIndices);
     }
 
-    void VertexArray::SetIndexBuffer(bgfx::Encoder* encoder, uint32_t firstIndex, uint32_t numIndices)
+    void VertexArray::SetIndexBuffer(bgfx::Encoder* encoder, uint32_t firstIndex, uint32_t numIndices, bool triangleList)
     {
         if (m_indexBuffer != nullptr)
         {
-            m_indexBuffer->Set(encoder, firstIndex, numIndices);
+            m_indexBuffer->Set(encoder, firstIndex, numIndices, triangleList);
         }
     }
 
     void VertexArray::SetVertexBuffers(bgfx::Encoder* encoder, uint32_t startVertex, uint32_t numVertices, uint32_t instanceCount)
     {
-        // Check if instancing is supported.
-        const bool instancingSupported = 0 != (BGFX_CAPS_INSTANCING & bgfx::getCaps()->supported);
-        if (!m_vertexBufferInstances.empty() && instancingSupported)
+        Build();
+        SetVertexBuffers(encoder, startVertex, numVertices, instanceCount, UpdateInstanceBuffer());
+    }
+
+    void VertexArray::SetVertexBuffers(bgfx::Encoder* encoder, uint32_t startVertex, uint32_t numVertices, uint32_t instanceCount, const Instances& instances)
+    {
+        const uint32_t count{instanceCount == 0 ? instances.Count : std::min(instanceCount, instances.Count)};
+        if (instances.Transient.data != nullptr)
         {
-            bgfx::InstanceDataBuffer instanceDataBuffer{};
-            VertexBuffer::BuildInstanceDataBuffer(instanceDataBuffer, m_vertexBufferInstances, instanceCount);
-            encoder->setInstanceDataBuffer(&instanceDataBuffer);
+            encoder->setInstanceDataBuffer(&instances.Transient, 0, count);
+        }
+        else if (bgfx::isValid(instances.Buffer))
+        {
+            encoder->setInstanceDataBuffer(instances.Buffer, 0, count);
         }
 
         uint8_t stream = 0;
-        for (const auto& pair : m_vertexBufferRecords)
+        for (const auto& vertexStream : m_vertexStreams)
+        {
+            vertexStream.Buffer->Set(encoder, stream++, vertexStream.StartVertex + startVertex, numVertices, vertexStream.LayoutHandle);
+        }
+    }
+
+    void VertexArray::Build()
+    {
+        if (!m_vertexStreamsDirty)
+        {
+            return;
+        }
+
+        m_vertexStreamsDirty = false;
+        ReleaseVertexStreams();
+
+        if (m_interleave)
+        {
+            // Interleave the buffers that can be, grouped by vertex count.
+            std::vector<VertexBuffer*> buffers{};
+            for (const auto& binding : m_vertexBufferBindings)
+            {
+                if (binding.Buffer->CanInterleave() && std::find(buffers.begin(), buffers.end(), binding.Buffer) == buffers.end())
+                {
+                    buffers.push_back(binding.Buffer);
+                }
+            }
+
+            std::stable_sort(buffers.begin(), buffers.end(), [](const VertexBuffer* a, const VertexBuffer* b) {
+                return a->VertexCount() < b->VertexCount();
+            });
+
+            for (auto begin = buffers.begin(); begin != buffers.end();)
+            {
+                const auto end{std::find_if(begin, buffers.end(), [begin](const VertexBuffer* buffer) {
+                    return buffer->VertexCount() != (*begin)->VertexCount();
+                })};
+
+                if (end - begin > 1)
+                {
+                    VertexBuffer::Interleave(gsl::make_span(&*begin, end - begin));
+                }
+
+                begin = end;
+            }
+        }
+
+        // Group the attributes by the buffer and vertex they are bound from.
+        struct Attribute
+        {
+            const VertexBufferBinding* Binding{};
+            uint16_t Offset{};
+        };
+
+        struct Stream
+        {
+            VertexStream Target{};
+            uint32_t ByteStride{};
+            std::vector<Attribute> Attributes{};
+        };
+
+        std::vector<Stream> streams{};
+        for (const auto& binding : m_vertexBufferBindings)
+        {
+            binding.Buffer->Build(binding.ByteStride);
+
+            const auto& interleavedBuffer{binding.Buffer->InterleavedBuffer()};
+            VertexBuffer* buffer{interleavedBuffer ? interleavedBuffer.get() : binding.Buffer};
+            const uint32_t startVertex{binding.ByteOffset / binding.ByteStride};
+            const uint16_t offset{static_cast<uint16_t>(binding.Buffer->InterleavedOffset() + binding.ByteOffset % binding.ByteStride)};
+
+            auto it{std::find_if(streams.begin(), streams.end(), [buffer, startVertex](const Stream& stream) {
+                return stream.Target.Buffer == buffer && stream.Target.StartVertex == startVertex;
+            })};
+
+            if (it == streams.end())
+            {
+                it = streams.insert(streams.end(), {{buffer, interleavedBuffer, startVertex}, buffer->ByteStride(), {}});
+            }
+
+            it->Attributes.push_back({&binding, offset});
+        }
+
+        for (auto& stream : streams)
+        {
+            bgfx::VertexLayout layout{};
+            layout.begin();
+            for (const auto& attribute : stream.Attributes)
+            {
+                layout.add(attribute.Binding->Attrib, attribute.Binding->NumElements, attribute.Binding->Type, attribute.Binding->Normalized);
+            }
+
+            for (const auto& attribute : stream.Attributes)
+            {
+                layout.m_offset[attribute.Binding->Attrib] = attribute.Offset;
+            }
+
+            layout.m_stride = static_cast<uint16_t>(stream.ByteStride);
+            layout.end();
+
+            stream.Target.LayoutHandle = VertexLayoutCache::Acquire(m_deviceContext, layout);
+            stream.Target.LayoutHash = layout.m_hash;
+            m_vertexStreams.push_back(std::move(stream.Target));
+        }
+    }
+
+    void VertexArray::ReleaseVertexStreams()
+    {
+        for (const auto& vertexStream : m_vertexStreams)
+        {
+            VertexLayoutCache::Release(m_deviceContext, m_deviceId, vertexStream.LayoutHash, vertexStream.LayoutHandle);
+        }
+
+        m_vertexStreams.clear();
+    }
+
+    const VertexArray::Instances& VertexArray::UpdateInstanceBuffer()
+    {
+        // Transient instance data is only valid in the frame it was allocated in, which is also the frame in which
+        // the instance buffer was last updated.
+        const uint32_t frameNumber{m_deviceContext.GetFrameNumber()};
+        bool dirty{m_instancesDirty || (m_instances.Transient.data != nullptr && m_instanceBufferFrame != frameNumber)};
+        for (const auto& [attrib, instance] : m_vertexBufferInstances)
+        {
+            dirty |= (instance.Version != instance.Buffer->Version());
+        }
+
+        if (!dirty)
+        {
+            return m_instances;
+        }
+
+        m_instancesDirty = false;
+
+        // Use as many instances as all the vertex buffers can provide.
+        uint32_t instanceCount{std::numeric_limits<uint32_t>::max()};
+        for (auto& [attrib, instance] : m_vertexBufferInstances)
         {
-            auto& record{pair.second};
-            record.Buffer->Set(encoder, stream++, record.Offset + startVertex, numVertices, record.LayoutHandle);
+            instance.Version = instance.Buffer->Version();
+
+            const size_t size{static_cast<size_t>(instance.Buffer->Bytes().size())};
+            const size_t elementSize{instance.NumElements * GetComponentSize(instance.Type)};
+            const uint32_t count{size < instance.Offset + elementSize ? 0 : static_cast<uint32_t>((size - instance.Offset - elementSize) / instance.Stride + 1)};
+            instanceCount = std::min(instanceCount, count);
+        }
+
+        // Without instances, the instance data of the previous update is no longer bound.
+        m_instances = {};
+        if (instanceCount == 0 || m_vertexBufferInstances.empty())
+        {
+            return m_instances;
+        }
+
+        const size_t attributeCount{m_vertexBufferInstances.size()};
+        const size_t instanceStride{attributeCount * 4};
+        m_instanceData.resize(instanceCount * instanceStride);
+
+        size_t attribute{0};
+        for (const auto& [attrib, instance] : m_vertexBufferInstances)
+        {
+#if D3D11 || D3D12
+            // Reverse because bgfx is also reversed: https://github.com/bkaradzic/bgfx/blob/4581f14cd481bad1e0d6292f0dd0a6e298c2ee18/src/renderer_d3d11.cpp#L2701
+            const size_t slot{attributeCount - 1 - attribute++};
+#else
+            const size_t slot{attribute++};
+#endif
+            const uint8_t* source{instance.Buffer->Bytes().data() + instance.Offset};
+            float* destination{m_instanceData.data() + slot * 4};
+
+            if (instance.Type == bgfx::AttribType::Float && instance.NumElements == 4)
+            {
+                for (uint32_t index = 0; index < instanceCount; ++index)
+                {
+                    std::memcpy(destination + index * instanceStride, source + index * instance.Stride, INSTANCE_ATTRIBUTE_SIZE);
+                }
+            }
+            else
+            {
+                // Convert to floats, filling the missing components like vertex attributes are.
+                const uint32_t componentSize{GetComponentSize(instance.Type)};
+                for (uint32_t index = 0; index < instanceCount; ++index)
+                {
+                    float* values{destination + index * instanceStride};
+                    values[0] = 0.0f;
+                    values[1] = 0.0f;
+                    values[2] = 0.0f;
+                    values[3] = 1.0f;
+
+                    for (uint32_t component = 0; component < instance.NumElements; ++component)
+                    {
+                        values[component] = ReadComponent(source + index * instance.Stride + component * componentSize, instance.Type, instance.Normalized);
+                    }
+                }
+            }
+        }
+
+        const uint32_t byteSize{static_cast<uint32_t>(m_instanceData.size() * sizeof(float))};
+        const uint16_t stride{static_cast<uint16_t>(attributeCount * INSTANCE_ATTRIBUTE_SIZE)};
+        m_instances.Count = instanceCount;
+
+        if (bgfx::isValid(m_instanceBuffer) && m_instanceBufferFrame == frameNumber)
+        {
+            // bgfx applies the updates of a buffer before all the draws of the frame, so updating the instance buffer
+            // again would also change the instances of the draws that already used it in this frame. The instances
+            // are copied into transient instance data instead, and the instance buffer is updated in a later frame.
+            if (bgfx::getAvailInstanceDataBuffer(instanceCount, stride) == instanceCount)
+            {
+                bgfx::allocInstanceDataBuffer(&m_instances.Transient, instanceCount, stride);
+                std::memcpy(m_instances.Transient.data, m_instanceData.data(), byteSize);
+                return m_instances;
+            }
+
+            // Without enough transient memory left, the instance buffer is replaced instead. bgfx keeps the destroyed
+            // buffer until the end of the frame, for the draws that already used it.
+            bgfx::destroy(m_instanceBuffer);
+            m_instanceBuffer = BGFX_INVALID_HANDLE;
+        }
+
+        const bgfx::Memory* memory{bgfx::copy(m_instanceData.data(), byteSize)};
+        m_instanceBufferFrame = frameNumber;
+
+        if (bgfx::isValid(m_instanceBuffer) && m_instanceBufferCapacity >= instanceCount && m_instanceBufferStride == stride)
+        {
+            bgfx::update(m_instanceBuffer, 0, memory);
         }
+        else
+        {
+            if (bgfx::isValid(m_instanceBuffer))
+            {
+                bgfx::destroy(m_instanceBuffer);
+            }
+
+            bgfx::VertexLayout layout;
+            layout.begin();
+            layout.m_stride = stride;
+            layout.end();
+
+            m_instanceBuffer = bgfx::createDynamicVertexBuffer(memory, layout);
+            m_instanceBufferCapacity = instanceCount;
+            m_instanceBufferStride = stride;
+
+            if (!bgfx::isValid(m_instanceBuffer))
+            {
+                throw std::runtime_error{"Failed to create instance buffer"};
+            }
+        }
+
+        m_instances.Buffer = m_instanceBuffer;
+        return m_instances;
     }
 }
@@ -4,13 +4,17 @@
 #include "VertexBuffer.h"
 #include <set>
 #include <map>
+#include <optional>
+#include <vector>
 
 namespace Babylon
 {
     class VertexArray final
     {
     public:
-        VertexArray() = default;
+        // When interleaving is enabled, the static vertex buffers of the vertex array that were not uploaded yet are
+        // interleaved into a single buffer when the vertex array is built.
+        VertexArray(Graphics::DeviceContext& deviceContext, bool interleave);
         ~VertexArray();
 
         VertexArray(const VertexArray&) = delete;
@@ -21,29 +25,99 @@ namespace Babylon
         void RecordIndexBuffer(IndexBuffer* indexBuffer);
         void RecordVertexBuffer(VertexBuffer* vertexBuffer, uint32_t location, uint32_t byteOffset, uint32_t byteStride, uint32_t numElements, uint32_t type, bool normalized, uint32_t divisor);
 
-        void SetIndexBuffer(bgfx::Encoder* encoder, uint32_t firstIndex, uint32_t numIndices);
+        // Converts the indices of a range of the index buffer, see IndexBuffer. Returns std::nullopt if the vertex
+        // array has no index buffer or its indices cannot be converted.
+        std::optional<TopologyConverter::Indices> ConvertIndices(TopologyConversion conversion, uint32_t firstIndex, uint32_t numIndices);
+
+        // Triangle lists drawn with all the indices of the buffer may use its optimized indices, and ranges converted
+        // by ConvertIndices use their converted indices, see IndexBuffer.
+        void SetIndexBuffer(bgfx::Encoder* encoder, uint32_t firstIndex, uint32_t numIndices, bool triangleList);
         void SetVertexBuffers(bgfx::Encoder* encoder, uint32_t startVertex, uint32_t numVertices, uint32_t instanceCount = 0);
 
+        // The instance data bound by SetVertexBuffers, in the instance buffer or, when the instances are updated more
+        // than once in a frame, in transient instance data that is only valid until the end of the frame.
+        struct Instances
+        {
+            bgfx::DynamicVertexBufferHandle Buffer{bgfx::kInvalidHandle};
+            bgfx::InstanceDataBuffer Transient{};
+            uint32_t Count{};
+        };
+
+        // Binds the given instance data rather than the current one, for draws recorded before the instances were
+        // updated again. Neither builds the vertex array nor updates its instance data.
+        void SetVertexBuffers(bgfx::Encoder* encoder, uint32_t startVertex, uint32_t numVertices, uint32_t instanceCount, const Instances& instances);
+
+        // Builds the vertex buffers and the streams bound by SetVertexBuffers if vertex buffers were recorded since
+        // the last build. This is called by SetVertexBuffers, but must be called on the JavaScript thread first when
+        // SetVertexBuffers is called from other threads.
+        void Build();
+
+        // Packs the instanced attributes into the instance buffer if any of their vertex buffers changed since they
+        // were last packed, and returns the instance data to bind. This is called by SetVertexBuffers, but must be
+        // called on the JavaScript thread first when SetVertexBuffers is called from other threads.
+        const Instances& UpdateInstanceBuffer();
+
     private:
+        Graphics::DeviceContext& m_deviceContext;
+        const uintptr_t m_deviceId{};
+
         IndexBuffer* m_indexBuffer{};
 
-        struct VertexBufferRecord
+        void ReleaseVertexStreams();
+
+        const bool m_interleave{};
+
+        // Vertex buffer bindings, sorted by attribute.
+        struct VertexBufferBinding
+        {
+            bgfx::Attrib::Enum Attrib{};
+            VertexBuffer* Buffer{};
+            uint32_t ByteOffset{};
+            uint32_t ByteStride{};
+            uint8_t NumElements{};
+            bgfx::AttribType::Enum Type{};
+            bool Normalized{};
+        };
+
+        std::vector<VertexBufferBinding> m_vertexBufferBindings{};
+
+        // Streams built from the bindings, which SetVertexBuffers binds in order. Attributes bound from the same
+        // buffer at the same vertex, which is the case of interleaved buffers, share a stream.
+        struct VertexStream
+        {
+            VertexBuffer* Buffer{};
+            std::shared_ptr<VertexBuffer> InterleavedBuffer{};
+            uint32_t StartVertex{};
+            bgfx::VertexLayoutHandle LayoutHandle{bgfx::kInvalidHandle};
+            uint32_t LayoutHash{};
+        };
+
+        std::vector<VertexStream> m_vertexStreams{};
+        bool m_vertexStreamsDirty{};
+
+        struct VertexBufferInstance
         {
             VertexBuffer* Buffer{};
-            const uint32_t Offset{};
-            const bgfx::VertexLayoutHandle LayoutHandle{};
-
-            VertexBufferRecord(VertexBuffer* buffer, const uint32_t offset, bgfx::VertexLayoutHandle layoutHandle)
-                : Buffer{buffer}
-                , Offset{offset}
-                , LayoutHandle{layoutHandle}
-            {
-            }
+            uint32_t Offset{};
+            uint32_t Stride{};
+            uint32_t NumElements{};
+            bgfx::AttribType::Enum Type{};
+            bool Normalized{};
+            uint32_t Version{};
         };
 
-        std::map<bgfx::Attrib::Enum, VertexBufferRecord> m_vertexBufferRecords{};
+        std::map<bgfx::Attrib::Enum, VertexBufferInstance> m_vertexBufferInstances{};
 
-        std::map<bgfx::Attrib::Enum, VertexBuffer::InstanceInfo> m_vertexBufferInstances;
+        // Instanced attributes are packed into one vec4 per attribute and per instance, as read by the shaders, and
+        // kept in a dynamic vertex buffer that is only updated when the vertex buffers of the attributes change, at
+        // most once per frame.
+        std::vector<float> m_instanceData{};
+        bgfx::DynamicVertexBufferHandle m_instanceBuffer{bgfx::kInvalidHandle};
+        uint32_t m_instanceBufferCapacity{};
+        uint16_t m_instanceBufferStride{};
+        uint32_t m_instanceBufferFrame{};
+        Instances m_instances{};
+        bool m_instancesDirty{};
 
         bool m_disposed{};
     };
@@ -4,11 +4,28 @@
 
 namespace Babylon
 {
-    VertexBuffer::VertexBuffer(Graphics::DeviceContext& deviceContext, gsl::span<const uint8_t> bytes, bool dynamic)
+    VertexBuffer::VertexBuffer(Graphics::DeviceContext& deviceContext, gsl::span<const uint8_t> bytes, bool dynamic, std::shared_ptr<StagingRing> stagingRing)
         : m_deviceContext{deviceContext}
         , m_deviceId{m_deviceContext.GetDeviceId()}
         , m_bytes{bytes.data(), bytes.data() + bytes.size()}
         , m_dynamic{dynamic}
+        , m_stagingRing{std::move(stagingRing)}
+    {
+    }
+
+    VertexBuffer::VertexBuffer(Graphics::DeviceContext& deviceContext, std::unique_ptr<ReferencedBytes> bytes)
+        : m_deviceContext{deviceContext}
+        , m_deviceId{m_deviceContext.GetDeviceId()}
+        , m_referencedBytes{std::move(bytes)}
+        , m_dynamic{false}
+    {
+    }
+
+    VertexBuffer::VertexBuffer(Graphics::DeviceContext& deviceContext, std::vector<uint8_t> bytes)
+        : m_deviceContext{deviceContext}
+        , m_deviceId{m_deviceContext.GetDeviceId()}
+        , m_bytes{std::move(bytes)}
+        , m_dynamic{false}
     {
     }
 
@@ -36,12 +53,20 @@ namespace Babylon
             }
         }
 
+        if (!m_pendingUpdates.Empty())
+        {
+            m_stagingRing->Dequeue(this);
+            m_pendingUpdates.Discard(*m_stagingRing);
+        }
+
         m_bytes.clear();
+        m_referencedBytes.reset();
+        m_interleavedBuffer.reset();
 
         m_disposed = true;
     }
 
-    void VertexBuffer::Update(gsl::span<const uint8_t> bytes, size_t byteOffset)
+    void VertexBuffer::Update(gsl::span<const uint8_t> bytes, size_t byteOffset, bool discard)
     {
         if (!m_dynamic)
         {
@@ -50,15 +75,23 @@ namespace Babylon
 
         if (bgfx::isValid(m_dynamicHandle))
         {
-            const uint32_t startVertex = static_cast<uint32_t>(byteOffset / m_byteStride);
-
             if (byteOffset % m_byteStride != 0)
             {
                 // bgfx only supports vertex start index and not arbitrary byte offsets.
                 throw std::runtime_error{"Cannot update dynamic vertex buffer with a byte offset not divisible by its byte stride"};
             }
 
-            bgfx::update(m_dynamicHandle, startVertex, bgfx::copy(bytes.data(), static_cast<uint32_t>(bytes.size())));
+            const bool queued{!m_pendingUpdates.Empty()};
+            if (discard)
+            {
+                m_pendingUpdates.Discard(*m_stagingRing);
+            }
+
+            m_pendingUpdates.Add(*m_stagingRing, bytes, byteOffset);
+            if (!queued)
+            {
+                m_stagingRing->Enqueue(this, [this]() { FlushUpdates(); });
+            }
         }
         else
         {
@@ -69,9 +102,11 @@ namespace Babylon
 
             std::memcpy(m_bytes.data() + byteOffset, bytes.data(), bytes.size());
         }
+
+        ++m_version;
     }
 
-    void VertexBuffer::Build(uint32_t byteStride)
+    void VertexBuffer::SetByteStride(uint32_t byteStride)
     {
         if (m_byteStride == 0)
         {
@@ -81,15 +116,28 @@ namespace Babylon
         {
             throw std::runtime_error{"Attributes of a vertex buffer must have the same byte stride"};
         }
+    }
+
+    void VertexBuffer::Build(uint32_t byteStride)
+    {
+        SetByteStride(byteStride);
 
-        if (!bgfx::isValid(m_handle))
+        if (!bgfx::isValid(m_handle) && !m_interleavedBuffer)
         {
-            auto releaseFn = [](void*, void* userData) {
-                delete reinterpret_cast<decltype(m_bytes)*>(userData);
-            };
+            const bgfx::Memory* memory{};
+            if (m_referencedBytes)
+            {
+                memory = ReferencedBytes::MakeRef(std::move(m_referencedBytes));
+            }
+            else
+            {
+                auto releaseFn = [](void*, void* userData) {
+                    delete reinterpret_cast<decltype(m_bytes)*>(userData);
+                };
 
-            auto* bytesPtr = new decltype(m_bytes){std::move(m_bytes)};
-            const bgfx::Memory* memory = bgfx::makeRef(bytesPtr->data(), static_cast<uint32_t>(bytesPtr->size()), releaseFn, bytesPtr);
+                auto* bytesPtr = new decltype(m_bytes){std::move(m_bytes)};
+                memory = bgfx::makeRef(bytesPtr->data(), static_cast<uint32_t>(bytesPtr->size()), releaseFn, bytesPtr);
+            }
 
             bgfx::VertexLayout layout;
             layout.begin();
@@ -112,53 +160,76 @@ namespace Babylon
         }
     }
 
-    void VertexBuffer::Set(bgfx::Encoder* encoder, uint8_t stream, uint32_t startVertex, uint32_t numVertices, bgfx::VertexLayoutHandle layout)
+    bool VertexBuffer::CanInterleave() const
     {
-        if (m_dynamic)
-        {
-            encoder->setVertexBuffer(stream, m_dynamicHandle, startVertex, numVertices, layout);
-        }
-        else
-        {
-            encoder->setVertexBuffer(stream, m_handle, startVertex, numVertices, layout);
-        }
+        const size_t size{static_cast<size_t>(Bytes().size())};
+        return !m_dynamic && !m_disposed && m_byteStride != 0 && !bgfx::isValid(m_handle) && !m_interleavedBuffer &&
+               size != 0 && size % m_byteStride == 0;
+    }
+
+    uint32_t VertexBuffer::VertexCount() const
+    {
+        return m_byteStride == 0 ? 0 : static_cast<uint32_t>(Bytes().size() / m_byteStride);
     }
 
-    void VertexBuffer::BuildInstanceDataBuffer(bgfx::InstanceDataBuffer& instanceDataBuffer, const std::map<bgfx::Attrib::Enum, InstanceInfo>& instances, uint32_t instanceCount)
+    void VertexBuffer::Interleave(gsl::span<VertexBuffer* const> buffers)
     {
-        uint16_t instanceStride{};
-        for (auto& pair : instances)
+        // Keep the vertices of every buffer aligned to 4 bytes, as required for vertex attributes by some backends.
+        std::vector<uint32_t> offsets{};
+        uint32_t byteStride{0};
+        for (const VertexBuffer* buffer : buffers)
+        {
+            offsets.push_back(byteStride);
+            byteStride += (buffer->m_byteStride + 3) & ~3u;
+        }
+
+        const uint32_t vertexCount{buffers[0]->VertexCount()};
+        std::vector<uint8_t> bytes(static_cast<size_t>(vertexCount) * byteStride);
+        for (size_t index = 0; index < static_cast<size_t>(buffers.size()); ++index)
         {
-            if (instanceCount == 0)
+            const VertexBuffer* buffer{buffers[index]};
+            const uint8_t* source{buffer->Bytes().data()};
+            for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
             {
-                const auto* vertexBuffer{pair.second.Buffer};
-                instanceCount = static_cast<uint32_t>(vertexBuffer->m_bytes.size()) / pair.second.Stride;
+                std::memcpy(bytes.data() + vertex * byteStride + offsets[index], source + vertex * buffer->m_byteStride, buffer->m_byteStride);
             }
+        }
 
-            instanceStride += static_cast<uint16_t>(pair.second.ElementSize);
+        auto interleavedBuffer{std::make_shared<VertexBuffer>(buffers[0]->m_deviceContext, std::move(bytes))};
+        interleavedBuffer->Build(byteStride);
+
+        for (size_t index = 0; index < static_cast<size_t>(buffers.size()); ++index)
+        {
+            VertexBuffer* buffer{buffers[index]};
+            buffer->m_interleavedBuffer = interleavedBuffer;
+            buffer->m_interleavedOffset = offsets[index];
+            buffer->m_bytes = {};
+            buffer->m_referencedBytes.reset();
         }
+    }
 
-        // Create instance datas. Instance Data Buffer is transient.
-        bgfx::allocInstanceDataBuffer(&instanceDataBuffer, instanceCount, instanceStride);
+    void VertexBuffer::FlushUpdates()
+    {
+        if (m_deviceId != m_deviceContext.GetDeviceId())
+        {
+            m_pendingUpdates.Discard(*m_stagingRing);
+            return;
+        }
 
-        // Copy instance data.
-        uint8_t* data{instanceDataBuffer.data};
-        uint32_t offset{};
+        m_pendingUpdates.Flush([this](size_t byteOffset, const StagingRing::Allocation& staging) {
+            bgfx::update(m_dynamicHandle, static_cast<uint32_t>(byteOffset / m_byteStride), m_stagingRing->MakeRef(staging));
+        });
+    }
 
-        // Reverse because bgfx is also reversed: https://github.com/bkaradzic/bgfx/blob/4581f14cd481bad1e0d6292f0dd0a6e298c2ee18/src/renderer_d3d11.cpp#L2701
-#if D3D11 || D3D12
-        for (auto iter = instances.rbegin(); iter != instances.rend(); ++iter)
-#else
-        for (auto iter = instances.cbegin(); iter != instances.cend(); ++iter)
-#endif
+    void VertexBuffer::Set(bgfx::Encoder* encoder, uint8_t stream, uint32_t startVertex, uint32_t numVertices, bgfx::VertexLayoutHandle layout)
+    {
+        if (m_dynamic)
         {
-            const auto& element{iter->second};
-            const auto* source{element.Buffer->m_bytes.data()};
-            for (uint32_t instance = 0; instance < instanceCount; instance++)
-            {
-                std::memcpy(data + instance * instanceStride + offset, source + instance * element.Stride + element.Offset, element.ElementSize);
-            }
-            offset += iter->second.ElementSize;
+            encoder->setVertexBuffer(stream, m_dynamicHandle, startVertex, numVertices, layout);
+        }
+        else
+        {
+            encoder->setVertexBuffer(stream, m_handle, startVertex, numVertices, layout);
         }
     }
 }
@@ -3,9 +3,12 @@
 #include <bgfx/bgfx.h>
 #include <napi/napi.h>
 #include <gsl/gsl>
+#include "ReferencedBytes.h"
+#include "StagingRing.h"
 #include <list>
 #include <map>
 #include <optional>
+#include <vector>
 
 namespace Babylon
 {
@@ -17,7 +20,13 @@ namespace Babylon
     class VertexBuffer final
     {
     public:
-        VertexBuffer(Graphics::DeviceContext& deviceContext, gsl::span<const uint8_t> bytes, bool dynamic);
+        VertexBuffer(Graphics::DeviceContext& deviceContext, gsl::span<const uint8_t> bytes, bool dynamic, std::shared_ptr<StagingRing> stagingRing);
+
+        // Creates a non-dynamic vertex buffer that references the bytes instead of copying them.
+        VertexBuffer(Graphics::DeviceContext& deviceContext, std::unique_ptr<ReferencedBytes> bytes);
+
+        // Creates a non-dynamic vertex buffer that takes ownership of the bytes.
+        VertexBuffer(Graphics::DeviceContext& deviceContext, std::vector<uint8_t> bytes);
         ~VertexBuffer();
 
         // No copy or move semantics
@@ -26,29 +35,58 @@ namespace Babylon
 
         void Dispose();
 
-        void Update(gsl::span<const uint8_t> bytes, size_t byteOffset);
+        // Once the buffer is built, updates are staged in the ring and applied when the ring is flushed. Discarding
+        // drops the updates still pending, for which the update provides new contents.
+        void Update(gsl::span<const uint8_t> bytes, size_t byteOffset, bool discard = false);
 
+        // Sets the byte stride of the buffer, which must be the same for all its attributes.
+        void SetByteStride(uint32_t byteStride);
+
+        // Uploads the buffer, unless it was interleaved into another buffer.
         void Build(uint32_t byteStride);
 
+        // Whether the buffer can be interleaved with other buffers: it is not dynamic, its stride is known, and it
+        // was neither uploaded nor interleaved yet.
+        bool CanInterleave() const;
+
+        uint32_t VertexCount() const;
+
+        // Moves the vertices of buffers of the same vertex count into a single new buffer, in which every vertex holds
+        // the vertices of all the buffers. The buffers are then bound from the new buffer, see InterleavedBuffer.
+        static void Interleave(gsl::span<VertexBuffer* const> buffers);
+
+        // The buffer this buffer was interleaved into, if any, and the byte offset of the vertices of this buffer
+        // within the vertices of that buffer.
+        const std::shared_ptr<VertexBuffer>& InterleavedBuffer() const { return m_interleavedBuffer; }
+        uint32_t InterleavedOffset() const { return m_interleavedOffset; }
+
+        uint32_t ByteStride() const { return m_byteStride; }
+
         void Set(bgfx::Encoder* encoder, uint8_t stream, uint32_t startVertex, uint32_t numVertices, bgfx::VertexLayoutHandle layout);
 
-        struct InstanceInfo
-        {
-            VertexBuffer* Buffer{};
-            uint32_t Offset{};
-            uint32_t Stride{};
-            uint32_t ElementSize{};
-        };
+        // The bytes of the buffer, which are only kept on the CPU until the buffer is built.
+        gsl::span<const uint8_t> Bytes() const { return m_referencedBytes ? m_referencedBytes->Bytes() : gsl::span<const uint8_t>{m_bytes}; }
 
-        static void BuildInstanceDataBuffer(bgfx::InstanceDataBuffer& instanceDataBuffer, const std::map<bgfx::Attrib::Enum, InstanceInfo>& instances, uint32_t instanceCount);
+        // Incremented every time the bytes of the buffer are updated.
+        uint32_t Version() const { return m_version; }
 
     private:
+        void FlushUpdates();
+
         Graphics::DeviceContext& m_deviceContext;
         const uintptr_t m_deviceId{};
 
         std::vector<uint8_t> m_bytes{};
+        std::unique_ptr<ReferencedBytes> m_referencedBytes{};
         const bool m_dynamic{};
         uint32_t m_byteStride{};
+        uint32_t m_version{};
+
+        const std::shared_ptr<StagingRing> m_stagingRing{};
+        PendingUpdates m_pendingUpdates{};
+
+        std::shared_ptr<VertexBuffer> m_interleavedBuffer{};
+        uint32_t m_interleavedOffset{};
 
         union
         {
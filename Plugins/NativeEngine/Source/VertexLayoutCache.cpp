@@ -0,0 +1,78 @@
+#include "VertexLayoutCache.h"
+#include "Babylon/Graphics/DeviceContext.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    bool LayoutEquals(const bgfx::VertexLayout& a, const bgfx::VertexLayout& b)
+    {
+        return a.m_stride == b.m_stride &&
+               std::memcmp(a.m_offset, b.m_offset, sizeof(a.m_offset)) == 0 &&
+               std::memcmp(a.m_attributes, b.m_attributes, sizeof(a.m_attributes)) == 0;
+    }
+}
+
+namespace Babylon
+{
+    bgfx::VertexLayoutHandle VertexLayoutCache::Acquire(Graphics::DeviceContext& deviceContext, const bgfx::VertexLayout& layout)
+    {
+        const uintptr_t deviceId{deviceContext.GetDeviceId()};
+
+        std::scoped_lock lock{s_mutex};
+
+        auto& entries{s_entries[layout.m_hash]};
+        for (auto& entry : entries)
+        {
+            if (entry.DeviceId == deviceId && LayoutEquals(entry.Layout, layout))
+            {
+                ++entry.RefCount;
+                return entry.Handle;
+            }
+        }
+
+        const bgfx::VertexLayoutHandle handle{bgfx::createVertexLayout(layout)};
+        if (!bgfx::isValid(handle))
+        {
+            throw std::runtime_error{"Failed to create vertex layout"};
+        }
+
+        entries.push_back({deviceId, layout, handle, 1});
+        return handle;
+    }
+
+    void VertexLayoutCache::Release(Graphics::DeviceContext& deviceContext, uintptr_t deviceId, uint32_t layoutHash, bgfx::VertexLayoutHandle handle)
+    {
+        std::scoped_lock lock{s_mutex};
+
+        const auto it{s_entries.find(layoutHash)};
+        if (it == s_entries.end())
+        {
+            return;
+        }
+
+        auto& entries{it->second};
+        const auto entry{std::find_if(entries.begin(), entries.end(), [deviceId, handle](const Entry& entry) {
+            return entry.DeviceId == deviceId && entry.Handle.idx == handle.idx;
+        })};
+
+        if (entry == entries.end() || --entry->RefCount != 0)
+        {
+            return;
+        }
+
+        // Handles of a device that was reset are no longer valid.
+        if (deviceId == deviceContext.GetDeviceId())
+        {
+            bgfx::destroy(handle);
+        }
+
+        entries.erase(entry);
+        if (entries.empty())
+        {
+            s_entries.erase(it);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <bgfx/bgfx.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Babylon
+{
+    namespace Graphics
+    {
+        class DeviceContext;
+    }
+
+    // Shares vertex layout handles between all the vertex arrays of a device. Most meshes use a handful of layouts,
+    // while bgfx only supports a limited number of layout handles. Handles are reference counted and destroyed
+    // once the last vertex array using them releases them.
+    class VertexLayoutCache final
+    {
+    public:
+        static bgfx::VertexLayoutHandle Acquire(Graphics::DeviceContext& deviceContext, const bgfx::VertexLayout& layout);
+        static void Release(Graphics::DeviceContext& deviceContext, uintptr_t deviceId, uint32_t layoutHash, bgfx::VertexLayoutHandle handle);
+
+    private:
+        struct Entry
+        {
+            uintptr_t DeviceId{};
+            bgfx::VertexLayout Layout{};
+            bgfx::VertexLayoutHandle Handle{bgfx::kInvalidHandle};
+            uint32_t RefCount{};
+        };
+
+        static inline std::mutex s_mutex{};
+
+        // Entries by layout hash.
+        static inline std::unordered_map<uint32_t, std::vector<Entry>> s_entries{};
+    };
+}